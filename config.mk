@@ -10,25 +10,37 @@ SIMD ?= AVX512
 OPT_SCHEME ?= clusterpair
 # Enable likwid (true or false)
 ENABLE_LIKWID ?= false
+# Collect hardware counters at the likwid markers via perf_event_open (true or false)
+ENABLE_PERFCTR ?= false
+# Measure package and DRAM energy via the RAPL powercap interface (true or false)
+ENABLE_RAPL ?= false
 # Enable OpenMP parallelization (true or false)
 ENABLE_OPENMP ?= false
 # SP or DP
 DATA_TYPE ?= SP
 # AOS or SOA
 DATA_LAYOUT ?= AOS
+# Integer type for array offsets, e.g. into neighbor lists (INT32/INT64)
+INDEX_TYPE ?= INT64
 # Debug
 DEBUG ?= false
 
-# Sort atoms when reneighboring (true or false)
+# Sort atoms by bin unless sort_atoms is set at runtime (true or false)
 SORT_ATOMS ?= false
 # Simulate only for one atom type, without table lookup for parameters (true or false)
 ONE_ATOM_TYPE ?= false
 # Trace memory addresses for cache simulator (true or false)
 MEM_TRACER ?= false
+# Format of the memory trace files (TEXT/BINARY/NONE), BINARY is delta encoded
+MEM_TRACER_FORMAT ?= TEXT
+# Feed traced addresses into the built-in cache model (true or false), implies MEM_TRACER
+CACHE_SIM ?= false
 # Trace indexes and distances for gather-md (true or false)
 INDEX_TRACER ?= false
 # Compute statistics
 COMPUTE_STATS ?= true
+# Back large arrays with huge pages (NONE/THP/EXPLICIT)
+HUGE_PAGES ?= NONE
 
 # Configurations for verletlist optimization scheme
 # Use omp simd pragma when running with half neighbor-lists
@@ -39,6 +51,10 @@ ENABLE_OMP_SIMD ?= false
 USE_REFERENCE_VERSION ?= false
 # Enable XTC output (a GROMACS file format for trajectories)
 XTC_OUTPUT ?= false
+# Count active SIMD lanes in the force kernels (true or false)
+LANE_STATS ?= false
+# Periodic images via shift vectors in the cluster pair lists instead of ghost clusters
+PBC_SHIFTS ?= false
 
 # Configurations for CUDA
 # Use CUDA pinned memory to optimize transfers
@@ -118,6 +134,12 @@ else
     DEFINES +=  -DPRECISION=2
 endif
 
+ifeq ($(strip $(INDEX_TYPE)),INT32)
+    DEFINES +=  -DINDEX_BITS=32
+else
+    DEFINES +=  -DINDEX_BITS=64
+endif
+
 ifeq ($(strip $(SORT_ATOMS)),true)
     DEFINES += -DSORT_ATOMS
 endif
@@ -126,18 +148,42 @@ ifeq ($(strip $(ONE_ATOM_TYPE)),true)
     DEFINES += -DONE_ATOM_TYPE
 endif
 
+ifeq ($(strip $(CACHE_SIM)),true)
+    MEM_TRACER = true
+    DEFINES += -DCACHE_SIM
+endif
+
 ifeq ($(strip $(MEM_TRACER)),true)
     DEFINES += -DMEM_TRACER
+    ifeq ($(strip $(MEM_TRACER_FORMAT)),TEXT)
+        DEFINES += -DMEM_TRACER_TEXT
+    else ifeq ($(strip $(MEM_TRACER_FORMAT)),BINARY)
+        DEFINES += -DMEM_TRACER_BINARY
+    endif
 endif
 
 ifeq ($(strip $(INDEX_TRACER)),true)
     DEFINES += -DINDEX_TRACER
 endif
 
+ifeq ($(strip $(ENABLE_PERFCTR)),true)
+    DEFINES += -DPERFCTR
+endif
+
+ifeq ($(strip $(ENABLE_RAPL)),true)
+    DEFINES += -DRAPL
+endif
+
 ifeq ($(strip $(COMPUTE_STATS)),true)
     DEFINES += -DCOMPUTE_STATS
 endif
 
+ifeq ($(strip $(HUGE_PAGES)),THP)
+    DEFINES += -DHUGE_PAGES_THP
+else ifeq ($(strip $(HUGE_PAGES)),EXPLICIT)
+    DEFINES += -DHUGE_PAGES_EXPLICIT
+endif
+
 ifeq ($(strip $(XTC_OUTPUT)),true)
     DEFINES += -DXTC_OUTPUT
 endif
@@ -146,6 +192,14 @@ ifeq ($(strip $(USE_REFERENCE_VERSION)),true)
     DEFINES += -DUSE_REFERENCE_VERSION
 endif
 
+ifeq ($(strip $(LANE_STATS)),true)
+    DEFINES += -DLANE_STATS
+endif
+
+ifeq ($(strip $(PBC_SHIFTS)),true)
+    DEFINES += -DPBC_SHIFTS
+endif
+
 ifeq ($(strip $(DEBUG)),true)
     DEFINES += -DDEBUG
 endif
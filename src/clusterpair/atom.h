@@ -16,6 +16,13 @@
 #define CJ_SCALAR_BASE_INDEX(a) (CJ_BASE_INDEX(a, 1))
 #define CJ_VECTOR_BASE_INDEX(a) (CJ_BASE_INDEX(a, 3))
 
+// Periodic images of the box are addressed by a shift index, the shift vector
+// of image (sx, sy, sz) with sx, sy, sz in {-1, 0, 1} is (sx * xprd, sy * yprd,
+// sz * zprd); the image -s of s has index NUM_SHIFTS - 1 - s
+#define NUM_SHIFTS              27
+#define CENTER_SHIFT            13
+#define SHIFT_INDEX(sx, sy, sz) (((sz) + 1) * 9 + ((sy) + 1) * 3 + (sx) + 1)
+
 typedef struct {
     int natoms;
     MD_FLOAT bbminx, bbmaxx;
@@ -36,6 +43,7 @@ typedef struct {
     MD_FLOAT* cutforcesq;
     MD_FLOAT* cutneighsq;
     int *PBCx, *PBCy, *PBCz;
+    MD_FLOAT shiftvec[NUM_SHIFTS][3];
     // Data in cluster format
     MD_FLOAT* cl_x;
     MD_FLOAT* cl_v;
@@ -64,6 +72,7 @@ extern int readAtomPdb(Atom*, Parameter*);
 extern int readAtomGro(Atom*, Parameter*);
 extern int readAtomDmp(Atom*, Parameter*);
 extern void growAtom(Atom*);
+extern void reserveAtom(Atom*, int);
 extern void growClusters(Atom*);
 
 #ifdef AOS
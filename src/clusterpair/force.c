@@ -9,6 +9,7 @@
 #include <stdlib.h>
 
 ComputeForceFunction computeForce;
+ComputeForceFunction computeForceList;
 
 void initForce(Parameter* param)
 {
@@ -41,4 +42,9 @@ void initForce(Parameter* param)
         computeForce = computeForceLJCUDA;
 #endif
     }
+
+    computeForceList = computeForce;
+    if (param->force_direct) {
+        computeForce = computeForceLJDirect;
+    }
 }
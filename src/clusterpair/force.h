@@ -15,6 +15,8 @@
 
 typedef double (*ComputeForceFunction)(Parameter*, Atom*, Neighbor*, Stats*);
 extern ComputeForceFunction computeForce;
+// The neighbor list kernel, differs from computeForce in the direct force mode
+extern ComputeForceFunction computeForceList;
 
 enum forcetype { FF_LJ = 0, FF_EAM };
 
@@ -27,6 +29,7 @@ extern double computeForceLJ2xnFullNeigh(Parameter*, Atom*, Neighbor*, Stats*);
 extern double computeForceLJ2xnnHalfNeigh(Parameter*, Atom*, Neighbor*, Stats*);
 extern double computeForceLJ2xnnFullNeigh(Parameter*, Atom*, Neighbor*, Stats*);
 extern double computeForceEam(Parameter*, Atom*, Neighbor*, Stats*);
+extern double computeForceLJDirect(Parameter*, Atom*, Neighbor*, Stats*);
 
 // Nbnxn layouts (as of GROMACS):
 // Simd4xN: M=4, N=VECTOR_WIDTH
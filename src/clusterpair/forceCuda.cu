@@ -79,7 +79,7 @@ extern "C" void initDevice(Atom* atom, Neighbor* neighbor)
     cuda_PBCz             = (int*)allocateGPU(atom->Nclusters_max * sizeof(int));
     cuda_numneigh         = (int*)allocateGPU(atom->Nclusters_max * sizeof(int));
     cuda_neighbors        = (int*)allocateGPU(
-        atom->Nclusters_max * neighbor->maxneighs * sizeof(int));
+        (MD_INDEX)atom->Nclusters_max * neighbor->maxneighs * sizeof(int));
     natoms  = (int*)malloc(atom->Nclusters_max * sizeof(int));
     ngatoms = (int*)malloc(atom->Nclusters_max * sizeof(int));
 }
@@ -115,7 +115,7 @@ extern "C" void copyDataToCUDADevice(Atom* atom, Neighbor* neighbor)
     memcpyToGPU(cuda_numneigh, neighbor->numneigh, atom->Nclusters_local * sizeof(int));
     memcpyToGPU(cuda_neighbors,
         neighbor->neighbors,
-        atom->Nclusters_local * neighbor->maxneighs * sizeof(int));
+        (MD_INDEX)atom->Nclusters_local * neighbor->maxneighs * sizeof(int));
 }
 
 extern "C" void copyDataFromCUDADevice(Atom* atom)
@@ -238,7 +238,7 @@ __global__ void computeForceLJCudaFullNeigh(
     int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
     MD_FLOAT* ci_x  = &cuda_cl_x[ci_vec_base];
     MD_FLOAT* ci_f  = &cuda_cl_f[ci_vec_base];
-    int* neighs     = &cuda_neighs[ci * maxneighs];
+    int* neighs     = &cuda_neighs[(MD_INDEX)ci * maxneighs];
     int numneighs   = cuda_numneigh[ci];
     MD_FLOAT xtmp   = ci_x[CL_X_OFFSET + cii];
     MD_FLOAT ytmp   = ci_x[CL_Y_OFFSET + cii];
@@ -344,7 +344,7 @@ __global__ void computeForceLJCudaHalfNeigh(
     int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
     MD_FLOAT* ci_x  = &cuda_cl_x[ci_vec_base];
     MD_FLOAT* ci_f  = &cuda_cl_f[ci_vec_base];
-    int* neighs     = &cuda_neighs[ci * maxneighs];
+    int* neighs     = &cuda_neighs[(MD_INDEX)ci * maxneighs];
     int numneighs   = cuda_numneigh[ci];
     MD_FLOAT xtmp   = ci_x[CL_X_OFFSET + cii];
     MD_FLOAT ytmp   = ci_x[CL_Y_OFFSET + cii];
@@ -22,7 +22,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
     /*
     if(eam->nmax < atom->Nmax) {
         eam->nmax = atom->Nmax;
-        if(eam->fp != NULL) { free(eam->fp); }
+        if(eam->fp != NULL) { deallocate(eam->fp); }
         eam->fp = (MD_FLOAT *) allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
     }
 
@@ -40,7 +40,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
     /*
     #pragma omp parallel for
     for(int i = 0; i < Nlocal; i++) {
-        neighs = &neighbor->neighbors[i * neighbor->maxneighs];
+        neighs = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
         int numneighs = neighbor->numneigh[i];
         MD_FLOAT xtmp = atom_x(i);
         MD_FLOAT ytmp = atom_y(i);
@@ -109,7 +109,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
 
     LIKWID_MARKER_START("force_eam");
     for(int i = 0; i < Nlocal; i++) {
-        neighs = &neighbor->neighbors[i * neighbor->maxneighs];
+        neighs = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
         int numneighs = neighbor->numneigh[i];
         MD_FLOAT xtmp = atom_x(i);
         MD_FLOAT ytmp = atom_y(i);
@@ -5,7 +5,12 @@
  * license that can be found in the LICENSE file.
  */
 #include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+#include <allocate.h>
 #include <atom.h>
 #include <force.h>
 #include <likwid-marker.h>
@@ -13,9 +18,55 @@
 #include <parameter.h>
 #include <simd.h>
 #include <stats.h>
+#include <timers.h>
 #include <timing.h>
 #include <util.h>
 
+#ifdef PBC_SHIFTS
+/* Lists built with shift vectors consist of segments of j-clusters in the same
+ * periodic image. When k enters the next segment the i-cluster coordinates are
+ * moved by the opposite shift, the masked entries always lie in the first
+ * (center) segment so only the unmasked loops check for it. */
+#define NEXT_SEGMENT_2XNN(k)                                                             \
+    while ((k) >= seg_end) {                                                             \
+        const MD_FLOAT* sh = atom->shiftvec[segments[++seg].shift];                      \
+        seg_end            = segments[seg].end;                                          \
+        xi0_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]), simd_real_broadcast(sh[0]));  \
+        xi2_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 2]), simd_real_broadcast(sh[0]));  \
+        yi0_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 0]), simd_real_broadcast(sh[1]));  \
+        yi2_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 2]), simd_real_broadcast(sh[1]));  \
+        zi0_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 0]), simd_real_broadcast(sh[2]));  \
+        zi2_tmp            = simd_real_sub(                                              \
+            simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 2]), simd_real_broadcast(sh[2]));  \
+    }
+
+#define NEXT_SEGMENT_4XN(k)                                                              \
+    while ((k) >= seg_end) {                                                             \
+        const MD_FLOAT* sh = atom->shiftvec[segments[++seg].shift];                      \
+        seg_end            = segments[seg].end;                                          \
+        xi0_tmp            = simd_real_broadcast(ci_x[CL_X_OFFSET + 0] - sh[0]);         \
+        xi1_tmp            = simd_real_broadcast(ci_x[CL_X_OFFSET + 1] - sh[0]);         \
+        xi2_tmp            = simd_real_broadcast(ci_x[CL_X_OFFSET + 2] - sh[0]);         \
+        xi3_tmp            = simd_real_broadcast(ci_x[CL_X_OFFSET + 3] - sh[0]);         \
+        yi0_tmp            = simd_real_broadcast(ci_x[CL_Y_OFFSET + 0] - sh[1]);         \
+        yi1_tmp            = simd_real_broadcast(ci_x[CL_Y_OFFSET + 1] - sh[1]);         \
+        yi2_tmp            = simd_real_broadcast(ci_x[CL_Y_OFFSET + 2] - sh[1]);         \
+        yi3_tmp            = simd_real_broadcast(ci_x[CL_Y_OFFSET + 3] - sh[1]);         \
+        zi0_tmp            = simd_real_broadcast(ci_x[CL_Z_OFFSET + 0] - sh[2]);         \
+        zi1_tmp            = simd_real_broadcast(ci_x[CL_Z_OFFSET + 1] - sh[2]);         \
+        zi2_tmp            = simd_real_broadcast(ci_x[CL_Z_OFFSET + 2] - sh[2]);         \
+        zi3_tmp            = simd_real_broadcast(ci_x[CL_Z_OFFSET + 3] - sh[2]);         \
+    }
+#else
+#define NEXT_SEGMENT_2XNN(k)
+#define NEXT_SEGMENT_4XN(k)
+#endif
+
 /*
 static inline void gmx_load_simd_2xnn_interactions(
     int excl,
@@ -65,21 +116,33 @@ double computeForceLJRef(Parameter* param, Atom* atom, Neighbor* neighbor, Stats
         }
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, atom->Nclusters_local);
+
     double S = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for schedule(runtime)
-        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int ci = getPartBegin(balance, part); ci < getPartEnd(balance, part); ci++) {
             int ci_cj0      = CJ0_FROM_CI(ci);
             int ci_cj1      = CJ1_FROM_CI(ci);
             int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
             MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
-            neighs          = &neighbor->neighbors[ci * neighbor->maxneighs];
+            neighs          = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
             int numneighs   = neighbor->numneigh[ci];
+            // Shift of the j-clusters, the self exclusions only hold in the center
+            const MD_FLOAT* sh = atom->shiftvec[CENTER_SHIFT];
+#ifdef PBC_SHIFTS
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int seg = -1, seg_end = 0;
+#endif
 
 #ifndef ONE_ATOM_TYPE
             int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
@@ -87,6 +150,15 @@ double computeForceLJRef(Parameter* param, Atom* atom, Neighbor* neighbor, Stats
 #endif
 
             for (int k = 0; k < numneighs; k++) {
+#ifdef PBC_SHIFTS
+                while (k >= seg_end) {
+                    const int shift = segments[++seg].shift;
+                    seg_end         = segments[seg].end;
+                    sh              = atom->shiftvec[shift];
+                    ci_cj0          = (shift == CENTER_SHIFT) ? CJ0_FROM_CI(ci) : -1;
+                    ci_cj1          = (shift == CENTER_SHIFT) ? CJ1_FROM_CI(ci) : -1;
+                }
+#endif
                 int cj          = neighs[k];
                 int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
                 int any         = 0;
@@ -102,9 +174,9 @@ double computeForceLJRef(Parameter* param, Atom* atom, Neighbor* neighbor, Stats
 #ifndef ONE_ATOM_TYPE
                     int type_i = ci_t[cii];
 #endif
-                    MD_FLOAT xtmp = ci_x[CL_X_OFFSET + cii];
-                    MD_FLOAT ytmp = ci_x[CL_Y_OFFSET + cii];
-                    MD_FLOAT ztmp = ci_x[CL_Z_OFFSET + cii];
+                    MD_FLOAT xtmp = ci_x[CL_X_OFFSET + cii] - sh[0];
+                    MD_FLOAT ytmp = ci_x[CL_Y_OFFSET + cii] - sh[1];
+                    MD_FLOAT ztmp = ci_x[CL_Z_OFFSET + cii] - sh[2];
                     MD_FLOAT fix  = 0;
                     MD_FLOAT fiy  = 0;
                     MD_FLOAT fiz  = 0;
@@ -180,6 +252,7 @@ double computeForceLJRef(Parameter* param, Atom* atom, Neighbor* neighbor, Stats
                 (long long int)((double)numneighs * CLUSTER_M / CLUSTER_N));
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -216,11 +289,16 @@ double computeForceLJ2xnnHalfNeigh(
         }
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, atom->Nclusters_local);
+
     double S = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
 
         /*
         MD_SIMD_BITMASK filter0 = simd_real_load_bitmask((const int *)
@@ -253,8 +331,10 @@ double computeForceLJ2xnnHalfNeigh(
         #endif
         */
 
-#pragma omp for schedule(runtime)
-        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int ci = getPartBegin(balance, part); ci < getPartEnd(balance, part); ci++) {
             int ci_cj0           = CJ0_FROM_CI(ci);
 #if CLUSTER_M > CLUSTER_N
             int ci_cj1           = CJ1_FROM_CI(ci);
@@ -262,9 +342,13 @@ double computeForceLJ2xnnHalfNeigh(
             int ci_vec_base      = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x       = &atom->cl_x[ci_vec_base];
             MD_FLOAT* ci_f       = &atom->cl_f[ci_vec_base];
-            neighs               = &neighbor->neighbors[ci * neighbor->maxneighs];
+            neighs               = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
             int numneighs        = neighbor->numneigh[ci];
             int numneighs_masked = neighbor->numneigh_masked[ci];
+#ifdef PBC_SHIFTS
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int seg = -1, seg_end = 0;
+#endif
 
             MD_SIMD_FLOAT xi0_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]);
             MD_SIMD_FLOAT xi2_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 2]);
@@ -393,6 +477,9 @@ double computeForceLJ2xnnHalfNeigh(
                 #endif
                 */
 
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask2),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask2));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
 
@@ -439,6 +526,7 @@ double computeForceLJ2xnnHalfNeigh(
             }
 
             for (int k = numneighs_masked; k < numneighs; k++) {
+                NEXT_SEGMENT_2XNN(k);
                 int cj          = neighs[k];
                 int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
                 MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
@@ -500,6 +588,9 @@ double computeForceLJ2xnnHalfNeigh(
                 MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutforcesq0);
                 MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutforcesq2);
 
+                addLaneStats(CLUSTER_M * CLUSTER_N,
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask2));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
 
@@ -555,6 +646,7 @@ double computeForceLJ2xnnHalfNeigh(
                 (long long int)((double)numneighs * CLUSTER_M / CLUSTER_N));
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -591,14 +683,21 @@ double computeForceLJ2xnnFullNeigh(
         }
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, atom->Nclusters_local);
+
     double S = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
 
-#pragma omp for schedule(runtime)
-        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int ci = getPartBegin(balance, part); ci < getPartEnd(balance, part); ci++) {
             int ci_cj0           = CJ0_FROM_CI(ci);
 #if CLUSTER_M > CLUSTER_N
             int ci_cj1           = CJ1_FROM_CI(ci);
@@ -606,9 +705,13 @@ double computeForceLJ2xnnFullNeigh(
             int ci_vec_base      = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x       = &atom->cl_x[ci_vec_base];
             MD_FLOAT* ci_f       = &atom->cl_f[ci_vec_base];
-            neighs               = &neighbor->neighbors[ci * neighbor->maxneighs];
+            neighs               = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
             int numneighs        = neighbor->numneigh[ci];
             int numneighs_masked = neighbor->numneigh_masked[ci];
+#ifdef PBC_SHIFTS
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int seg = -1, seg_end = 0;
+#endif
 
             MD_SIMD_FLOAT xi0_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]);
             MD_SIMD_FLOAT xi2_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 2]);
@@ -714,6 +817,9 @@ double computeForceLJ2xnnFullNeigh(
                 MD_SIMD_MASK cutoff_mask2 = simd_mask_and(excl_mask2,
                     simd_mask_cond_lt(rsq2, cutforcesq2));
 
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask2),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask2));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
 
@@ -752,6 +858,7 @@ double computeForceLJ2xnnFullNeigh(
             }
 
             for (int k = numneighs_masked; k < numneighs; k++) {
+                NEXT_SEGMENT_2XNN(k);
                 int cj          = neighs[k];
                 int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
                 MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
@@ -812,6 +919,9 @@ double computeForceLJ2xnnFullNeigh(
                 MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutforcesq0);
                 MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutforcesq2);
 
+                addLaneStats(CLUSTER_M * CLUSTER_N,
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask2));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
 
@@ -860,6 +970,7 @@ double computeForceLJ2xnnFullNeigh(
             // CLUSTER_N));
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -896,14 +1007,21 @@ double computeForceLJ4xnHalfNeigh(
         }
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, atom->Nclusters_local);
+
     double S = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
 
-#pragma omp for schedule(runtime)
-        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int ci = getPartBegin(balance, part); ci < getPartEnd(balance, part); ci++) {
             int ci_cj0           = CJ0_FROM_CI(ci);
 #if CLUSTER_M > CLUSTER_N
             int ci_cj1           = CJ1_FROM_CI(ci);
@@ -911,9 +1029,13 @@ double computeForceLJ4xnHalfNeigh(
             int ci_vec_base      = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x       = &atom->cl_x[ci_vec_base];
             MD_FLOAT* ci_f       = &atom->cl_f[ci_vec_base];
-            neighs               = &neighbor->neighbors[ci * neighbor->maxneighs];
+            neighs               = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
             int numneighs        = neighbor->numneigh[ci];
             int numneighs_masked = neighbor->numneigh_masked[ci];
+#ifdef PBC_SHIFTS
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int seg = -1, seg_end = 0;
+#endif
 
             MD_SIMD_FLOAT xi0_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 0]);
             MD_SIMD_FLOAT xi1_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 1]);
@@ -1088,6 +1210,11 @@ double computeForceLJ4xnHalfNeigh(
                 MD_SIMD_MASK cutoff_mask3 = simd_mask_and(excl_mask3,
                     simd_mask_cond_lt(rsq3, cutforcesq3));
 
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask1) +
+                                 laneCount(excl_mask2) + laneCount(excl_mask3),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask1) +
+                        laneCount(cutoff_mask2) + laneCount(cutoff_mask3));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_1 = simd_real_reciprocal(rsq1);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
@@ -1175,6 +1302,7 @@ double computeForceLJ4xnHalfNeigh(
             }
 
             for (int k = numneighs_masked; k < numneighs; k++) {
+                NEXT_SEGMENT_4XN(k);
                 int cj          = neighs[k];
                 int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
                 MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
@@ -1281,6 +1409,10 @@ double computeForceLJ4xnHalfNeigh(
                 MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutforcesq2);
                 MD_SIMD_MASK cutoff_mask3 = simd_mask_cond_lt(rsq3, cutforcesq3);
 
+                addLaneStats(CLUSTER_M * CLUSTER_N,
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask1) +
+                        laneCount(cutoff_mask2) + laneCount(cutoff_mask3));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_1 = simd_real_reciprocal(rsq1);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
@@ -1377,6 +1509,7 @@ double computeForceLJ4xnHalfNeigh(
                 (long long int)((double)numneighs * CLUSTER_M / CLUSTER_N));
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -1413,14 +1546,21 @@ double computeForceLJ4xnFullNeigh(
         }
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, atom->Nclusters_local);
+
     double S = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
 
-#pragma omp for schedule(runtime)
-        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int ci = getPartBegin(balance, part); ci < getPartEnd(balance, part); ci++) {
             int ci_cj0           = CJ0_FROM_CI(ci);
 #if CLUSTER_M > CLUSTER_N
             int ci_cj1           = CJ1_FROM_CI(ci);
@@ -1428,9 +1568,13 @@ double computeForceLJ4xnFullNeigh(
             int ci_vec_base      = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x       = &atom->cl_x[ci_vec_base];
             MD_FLOAT* ci_f       = &atom->cl_f[ci_vec_base];
-            neighs               = &neighbor->neighbors[ci * neighbor->maxneighs];
+            neighs               = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
             int numneighs        = neighbor->numneigh[ci];
             int numneighs_masked = neighbor->numneigh_masked[ci];
+#ifdef PBC_SHIFTS
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int seg = -1, seg_end = 0;
+#endif
 
             MD_SIMD_FLOAT xi0_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 0]);
             MD_SIMD_FLOAT xi1_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 1]);
@@ -1604,6 +1748,11 @@ double computeForceLJ4xnFullNeigh(
                 MD_SIMD_MASK cutoff_mask3 = simd_mask_and(excl_mask3,
                     simd_mask_cond_lt(rsq3, cutforcesq3));
 
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask1) +
+                                 laneCount(excl_mask2) + laneCount(excl_mask3),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask1) +
+                        laneCount(cutoff_mask2) + laneCount(cutoff_mask3));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_1 = simd_real_reciprocal(rsq1);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
@@ -1674,6 +1823,7 @@ double computeForceLJ4xnFullNeigh(
             }
 
             for (int k = numneighs_masked; k < numneighs; k++) {
+                NEXT_SEGMENT_4XN(k);
                 int cj          = neighs[k];
                 int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
                 MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
@@ -1779,6 +1929,10 @@ double computeForceLJ4xnFullNeigh(
                 MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutforcesq2);
                 MD_SIMD_MASK cutoff_mask3 = simd_mask_cond_lt(rsq3, cutforcesq3);
 
+                addLaneStats(CLUSTER_M * CLUSTER_N,
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask1) +
+                        laneCount(cutoff_mask2) + laneCount(cutoff_mask3));
+
                 MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
                 MD_SIMD_FLOAT sr2_1 = simd_real_reciprocal(rsq1);
                 MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
@@ -1859,6 +2013,7 @@ double computeForceLJ4xnFullNeigh(
             // CLUSTER_N));
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -1868,6 +2023,740 @@ double computeForceLJ4xnFullNeigh(
 }
 #endif
 
+/* per-thread buffers of the j-clusters and shifts the direct kernel collects for an
+ * i-cluster, they only grow and are kept across force calls */
+static int** direct_cjs     = NULL;
+static int** direct_shifts  = NULL;
+static int* direct_capacity = NULL;
+
+static void initDirectBuffers(void)
+{
+    if (direct_cjs == NULL) {
+#ifdef _OPENMP
+        const int nthreads = omp_get_max_threads();
+#else
+        const int nthreads = 1;
+#endif
+        direct_cjs      = (int**)calloc(nthreads, sizeof(int*));
+        direct_shifts   = (int**)calloc(nthreads, sizeof(int*));
+        direct_capacity = (int*)calloc(nthreads, sizeof(int));
+    }
+}
+
+// Collects the j-clusters of ci into the buffers of the calling thread
+static int collectDirect(Atom* atom, int ci, int** cjs, int** shifts)
+{
+#ifdef _OPENMP
+    const int t = omp_get_thread_num();
+#else
+    const int t = 0;
+#endif
+    int ncj = collectDirectClusters(atom,
+        ci,
+        direct_cjs[t],
+        direct_shifts[t],
+        direct_capacity[t]);
+
+    if (ncj > direct_capacity[t]) {
+        // allocate() keeps a table of its mappings shared by all threads
+#pragma omp critical(direct_buffers)
+        {
+            if (direct_cjs[t]) deallocate(direct_cjs[t]);
+            if (direct_shifts[t]) deallocate(direct_shifts[t]);
+            direct_capacity[t] = GROW_CAPACITY(ncj, 256);
+            direct_cjs[t]      = (int*)allocate(ALIGNMENT,
+                direct_capacity[t] * sizeof(int));
+            direct_shifts[t]   = (int*)allocate(ALIGNMENT,
+                direct_capacity[t] * sizeof(int));
+        }
+
+        ncj = collectDirectClusters(atom,
+            ci,
+            direct_cjs[t],
+            direct_shifts[t],
+            direct_capacity[t]);
+    }
+
+    *cjs    = direct_cjs[t];
+    *shifts = direct_shifts[t];
+    return ncj;
+}
+
+/* forces straight from the cluster bins without stored neighbor lists, every
+ * i-cluster collects the j-clusters of its stencil bins that pass the bounding box
+ * test and computes them right away with the inner loop of the list kernel. The
+ * collected clusters come in runs of the same shift, the i-cluster coordinates are
+ * moved when the shift changes and the diagonal masks only apply in the center */
+#if defined(CLUSTERPAIR_KERNEL_4XN)
+double computeForceLJDirect(
+    Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats)
+{
+    DEBUG_MESSAGE("computeForceLJDirect begin\n");
+    MD_FLOAT cutforcesq          = param->cutforce * param->cutforce;
+    MD_FLOAT sigma6              = param->sigma6;
+    MD_FLOAT epsilon             = param->epsilon;
+    MD_SIMD_FLOAT c48_vec        = simd_real_broadcast(48.0);
+    MD_SIMD_FLOAT c05_vec        = simd_real_broadcast(0.5);
+
+#ifdef ONE_ATOM_TYPE
+    MD_SIMD_FLOAT cutforcesq_vec = simd_real_broadcast(cutforcesq);
+    MD_SIMD_FLOAT sigma6_vec     = simd_real_broadcast(sigma6);
+    MD_SIMD_FLOAT eps_vec        = simd_real_broadcast(epsilon);
+#endif
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            ci_f[CL_X_OFFSET + cii] = 0.0;
+            ci_f[CL_Y_OFFSET + cii] = 0.0;
+            ci_f[CL_Z_OFFSET + cii] = 0.0;
+        }
+    }
+
+    initDirectBuffers();
+    double S = getTimeStamp();
+
+#pragma omp parallel
+    {
+        LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
+
+#pragma omp for schedule(runtime) nowait
+        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+            int* cjs;
+            int* shifts;
+            int ncj         = collectDirect(atom, ci, &cjs, &shifts);
+            int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+            MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+            MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+            int shift       = CENTER_SHIFT;
+
+            MD_SIMD_FLOAT xi0_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 0]);
+            MD_SIMD_FLOAT xi1_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 1]);
+            MD_SIMD_FLOAT xi2_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 2]);
+            MD_SIMD_FLOAT xi3_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 3]);
+            MD_SIMD_FLOAT yi0_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 0]);
+            MD_SIMD_FLOAT yi1_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 1]);
+            MD_SIMD_FLOAT yi2_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 2]);
+            MD_SIMD_FLOAT yi3_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 3]);
+            MD_SIMD_FLOAT zi0_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 0]);
+            MD_SIMD_FLOAT zi1_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 1]);
+            MD_SIMD_FLOAT zi2_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 2]);
+            MD_SIMD_FLOAT zi3_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 3]);
+            MD_SIMD_FLOAT fix0    = simd_real_zero();
+            MD_SIMD_FLOAT fiy0    = simd_real_zero();
+            MD_SIMD_FLOAT fiz0    = simd_real_zero();
+            MD_SIMD_FLOAT fix1    = simd_real_zero();
+            MD_SIMD_FLOAT fiy1    = simd_real_zero();
+            MD_SIMD_FLOAT fiz1    = simd_real_zero();
+            MD_SIMD_FLOAT fix2    = simd_real_zero();
+            MD_SIMD_FLOAT fiy2    = simd_real_zero();
+            MD_SIMD_FLOAT fiz2    = simd_real_zero();
+            MD_SIMD_FLOAT fix3    = simd_real_zero();
+            MD_SIMD_FLOAT fiy3    = simd_real_zero();
+            MD_SIMD_FLOAT fiz3    = simd_real_zero();
+
+#ifndef ONE_ATOM_TYPE
+            int ci_sca_base       = CI_SCALAR_BASE_INDEX(ci);
+            int* ci_t             = &atom->cl_t[ci_sca_base];
+            MD_SIMD_INT tbase0    = simd_i32_broadcast(ci_t[0] * atom->ntypes);
+            MD_SIMD_INT tbase1    = simd_i32_broadcast(ci_t[1] * atom->ntypes);
+            MD_SIMD_INT tbase2    = simd_i32_broadcast(ci_t[2] * atom->ntypes);
+            MD_SIMD_INT tbase3    = simd_i32_broadcast(ci_t[3] * atom->ntypes);
+#endif
+
+            for (int k = 0; k < ncj; k++) {
+                if (shifts[k] != shift) {
+                    const MD_FLOAT* sh = atom->shiftvec[shifts[k]];
+                    shift              = shifts[k];
+                    xi0_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 0] - sh[0]);
+                    xi1_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 1] - sh[0]);
+                    xi2_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 2] - sh[0]);
+                    xi3_tmp = simd_real_broadcast(ci_x[CL_X_OFFSET + 3] - sh[0]);
+                    yi0_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 0] - sh[1]);
+                    yi1_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 1] - sh[1]);
+                    yi2_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 2] - sh[1]);
+                    yi3_tmp = simd_real_broadcast(ci_x[CL_Y_OFFSET + 3] - sh[1]);
+                    zi0_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 0] - sh[2]);
+                    zi1_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 1] - sh[2]);
+                    zi2_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 2] - sh[2]);
+                    zi3_tmp = simd_real_broadcast(ci_x[CL_Z_OFFSET + 3] - sh[2]);
+                }
+
+                int cj          = cjs[k];
+                int center      = (shift == CENTER_SHIFT);
+                int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
+                MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
+
+#ifndef ONE_ATOM_TYPE
+                int cj_sca_base = CJ_SCALAR_BASE_INDEX(cj);
+                int* cj_t       = &atom->cl_t[cj_sca_base];
+#endif
+
+                MD_SIMD_FLOAT xj_tmp    = simd_real_load(&cj_x[CL_X_OFFSET]);
+                MD_SIMD_FLOAT yj_tmp    = simd_real_load(&cj_x[CL_Y_OFFSET]);
+                MD_SIMD_FLOAT zj_tmp    = simd_real_load(&cj_x[CL_Z_OFFSET]);
+                MD_SIMD_FLOAT delx0     = simd_real_sub(xi0_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely0     = simd_real_sub(yi0_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz0     = simd_real_sub(zi0_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx1     = simd_real_sub(xi1_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely1     = simd_real_sub(yi1_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz1     = simd_real_sub(zi1_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx2     = simd_real_sub(xi2_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely2     = simd_real_sub(yi2_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz2     = simd_real_sub(zi2_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx3     = simd_real_sub(xi3_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely3     = simd_real_sub(yi3_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz3     = simd_real_sub(zi3_tmp, zj_tmp);
+
+#if CLUSTER_M == CLUSTER_N
+                unsigned int cond0      = (unsigned int)(center && cj == CJ0_FROM_CI(ci));
+                MD_SIMD_MASK excl_mask0 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 4 + 0]);
+                MD_SIMD_MASK excl_mask1 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 4 + 1]);
+                MD_SIMD_MASK excl_mask2 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 4 + 2]);
+                MD_SIMD_MASK excl_mask3 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 4 + 3]);
+#else
+#if CLUSTER_M < CLUSTER_N
+                unsigned int cond0      = (unsigned int)(center && (cj << 1) + 0 == ci);
+                unsigned int cond1      = (unsigned int)(center && (cj << 1) + 1 == ci);
+#else
+                unsigned int cond0 = (unsigned int)(center && cj == CJ0_FROM_CI(ci));
+                unsigned int cond1 = (unsigned int)(center && cj == CJ1_FROM_CI(ci));
+#endif
+                MD_SIMD_MASK excl_mask0 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 8 + cond1 * 4 + 0]);
+                MD_SIMD_MASK excl_mask1 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 8 + cond1 * 4 + 1]);
+                MD_SIMD_MASK excl_mask2 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 8 + cond1 * 4 + 2]);
+                MD_SIMD_MASK excl_mask3 = simd_mask_from_u32(
+                    atom->masks_4xn_fn[cond0 * 8 + cond1 * 4 + 3]);
+#endif
+
+                MD_SIMD_FLOAT rsq0 = simd_real_fma(delx0,
+                    delx0,
+                    simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
+                MD_SIMD_FLOAT rsq1 = simd_real_fma(delx1,
+                    delx1,
+                    simd_real_fma(dely1, dely1, simd_real_mul(delz1, delz1)));
+                MD_SIMD_FLOAT rsq2 = simd_real_fma(delx2,
+                    delx2,
+                    simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
+                MD_SIMD_FLOAT rsq3 = simd_real_fma(delx3,
+                    delx3,
+                    simd_real_fma(dely3, dely3, simd_real_mul(delz3, delz3)));
+
+#ifndef ONE_ATOM_TYPE
+                MD_SIMD_INT tj_tmp = simd_i32_load(cj_t);
+                MD_SIMD_INT tvec0  = simd_i32_add(tbase0, tj_tmp);
+                MD_SIMD_INT tvec1  = simd_i32_add(tbase1, tj_tmp);
+                MD_SIMD_INT tvec2  = simd_i32_add(tbase2, tj_tmp);
+                MD_SIMD_INT tvec3  = simd_i32_add(tbase3, tj_tmp);
+
+                MD_SIMD_FLOAT cutforcesq0 = simd_real_gather(tvec0,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT cutforcesq1 = simd_real_gather(tvec1,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT cutforcesq2 = simd_real_gather(tvec2,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT cutforcesq3 = simd_real_gather(tvec3,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+
+                MD_SIMD_FLOAT sigma6_0 = simd_real_gather(tvec0,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT sigma6_1 = simd_real_gather(tvec1,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT sigma6_2 = simd_real_gather(tvec2,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT sigma6_3 = simd_real_gather(tvec3,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+
+                MD_SIMD_FLOAT eps0 = simd_real_gather(tvec0,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT eps1 = simd_real_gather(tvec1,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT eps2 = simd_real_gather(tvec2,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT eps3 = simd_real_gather(tvec3,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+#else
+                MD_SIMD_FLOAT cutforcesq0 = cutforcesq_vec;
+                MD_SIMD_FLOAT cutforcesq1 = cutforcesq_vec;
+                MD_SIMD_FLOAT cutforcesq2 = cutforcesq_vec;
+                MD_SIMD_FLOAT cutforcesq3 = cutforcesq_vec;
+
+                MD_SIMD_FLOAT sigma6_0 = sigma6_vec;
+                MD_SIMD_FLOAT sigma6_1 = sigma6_vec;
+                MD_SIMD_FLOAT sigma6_2 = sigma6_vec;
+                MD_SIMD_FLOAT sigma6_3 = sigma6_vec;
+
+                MD_SIMD_FLOAT eps0 = eps_vec;
+                MD_SIMD_FLOAT eps1 = eps_vec;
+                MD_SIMD_FLOAT eps2 = eps_vec;
+                MD_SIMD_FLOAT eps3 = eps_vec;
+#endif
+
+                MD_SIMD_MASK cutoff_mask0 = simd_mask_and(excl_mask0,
+                    simd_mask_cond_lt(rsq0, cutforcesq0));
+                MD_SIMD_MASK cutoff_mask1 = simd_mask_and(excl_mask1,
+                    simd_mask_cond_lt(rsq1, cutforcesq1));
+                MD_SIMD_MASK cutoff_mask2 = simd_mask_and(excl_mask2,
+                    simd_mask_cond_lt(rsq2, cutforcesq2));
+                MD_SIMD_MASK cutoff_mask3 = simd_mask_and(excl_mask3,
+                    simd_mask_cond_lt(rsq3, cutforcesq3));
+
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask1) +
+                                 laneCount(excl_mask2) + laneCount(excl_mask3),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask1) +
+                        laneCount(cutoff_mask2) + laneCount(cutoff_mask3));
+
+                MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
+                MD_SIMD_FLOAT sr2_1 = simd_real_reciprocal(rsq1);
+                MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
+                MD_SIMD_FLOAT sr2_3 = simd_real_reciprocal(rsq3);
+
+                MD_SIMD_FLOAT sr6_0 = simd_real_mul(sr2_0,
+                    simd_real_mul(sr2_0, simd_real_mul(sr2_0, sigma6_0)));
+                MD_SIMD_FLOAT sr6_1 = simd_real_mul(sr2_1,
+                    simd_real_mul(sr2_1, simd_real_mul(sr2_1, sigma6_1)));
+                MD_SIMD_FLOAT sr6_2 = simd_real_mul(sr2_2,
+                    simd_real_mul(sr2_2, simd_real_mul(sr2_2, sigma6_2)));
+                MD_SIMD_FLOAT sr6_3 = simd_real_mul(sr2_3,
+                    simd_real_mul(sr2_3, simd_real_mul(sr2_3, sigma6_3)));
+
+                MD_SIMD_FLOAT force0 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_0,
+                        simd_real_mul(simd_real_sub(sr6_0, c05_vec),
+                            simd_real_mul(sr2_0, eps0))));
+                MD_SIMD_FLOAT force1 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_1,
+                        simd_real_mul(simd_real_sub(sr6_1, c05_vec),
+                            simd_real_mul(sr2_1, eps1))));
+                MD_SIMD_FLOAT force2 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_2,
+                        simd_real_mul(simd_real_sub(sr6_2, c05_vec),
+                            simd_real_mul(sr2_2, eps2))));
+                MD_SIMD_FLOAT force3 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_3,
+                        simd_real_mul(simd_real_sub(sr6_3, c05_vec),
+                            simd_real_mul(sr2_3, eps3))));
+
+                fix0 = simd_real_masked_add(fix0,
+                    simd_real_mul(delx0, force0),
+                    cutoff_mask0);
+                fiy0 = simd_real_masked_add(fiy0,
+                    simd_real_mul(dely0, force0),
+                    cutoff_mask0);
+                fiz0 = simd_real_masked_add(fiz0,
+                    simd_real_mul(delz0, force0),
+                    cutoff_mask0);
+                fix1 = simd_real_masked_add(fix1,
+                    simd_real_mul(delx1, force1),
+                    cutoff_mask1);
+                fiy1 = simd_real_masked_add(fiy1,
+                    simd_real_mul(dely1, force1),
+                    cutoff_mask1);
+                fiz1 = simd_real_masked_add(fiz1,
+                    simd_real_mul(delz1, force1),
+                    cutoff_mask1);
+                fix2 = simd_real_masked_add(fix2,
+                    simd_real_mul(delx2, force2),
+                    cutoff_mask2);
+                fiy2 = simd_real_masked_add(fiy2,
+                    simd_real_mul(dely2, force2),
+                    cutoff_mask2);
+                fiz2 = simd_real_masked_add(fiz2,
+                    simd_real_mul(delz2, force2),
+                    cutoff_mask2);
+                fix3 = simd_real_masked_add(fix3,
+                    simd_real_mul(delx3, force3),
+                    cutoff_mask3);
+                fiy3 = simd_real_masked_add(fiy3,
+                    simd_real_mul(dely3, force3),
+                    cutoff_mask3);
+                fiz3 = simd_real_masked_add(fiz3,
+                    simd_real_mul(delz3, force3),
+                    cutoff_mask3);
+            }
+
+            simd_real_incr_reduced_sum(&ci_f[CL_X_OFFSET], fix0, fix1, fix2, fix3);
+            simd_real_incr_reduced_sum(&ci_f[CL_Y_OFFSET], fiy0, fiy1, fiy2, fiy3);
+            simd_real_incr_reduced_sum(&ci_f[CL_Z_OFFSET], fiz0, fiz1, fiz2, fiz3);
+
+            addStat(stats->calculated_forces, 1);
+            addStat(stats->num_neighs, ncj);
+            addStat(stats->force_iters, ncj);
+        }
+
+        stopRegion(REGION_FORCE_THREAD);
+        LIKWID_MARKER_STOP("force");
+    }
+
+    double E = getTimeStamp();
+    DEBUG_MESSAGE("computeForceLJDirect end\n");
+    return E - S;
+}
+#elif defined(CLUSTERPAIR_KERNEL_2XNN)
+double computeForceLJDirect(
+    Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats)
+{
+    DEBUG_MESSAGE("computeForceLJDirect begin\n");
+    MD_FLOAT cutforcesq          = param->cutforce * param->cutforce;
+    MD_FLOAT sigma6              = param->sigma6;
+    MD_FLOAT epsilon             = param->epsilon;
+    MD_SIMD_FLOAT c48_vec        = simd_real_broadcast(48.0);
+    MD_SIMD_FLOAT c05_vec        = simd_real_broadcast(0.5);
+
+#ifdef ONE_ATOM_TYPE
+    MD_SIMD_FLOAT cutforcesq_vec = simd_real_broadcast(cutforcesq);
+    MD_SIMD_FLOAT sigma6_vec     = simd_real_broadcast(sigma6);
+    MD_SIMD_FLOAT eps_vec        = simd_real_broadcast(epsilon);
+#endif
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            ci_f[CL_X_OFFSET + cii] = 0.0;
+            ci_f[CL_Y_OFFSET + cii] = 0.0;
+            ci_f[CL_Z_OFFSET + cii] = 0.0;
+        }
+    }
+
+    initDirectBuffers();
+    double S = getTimeStamp();
+
+#pragma omp parallel
+    {
+        LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+        beginLaneStats(stats);
+
+#pragma omp for schedule(runtime) nowait
+        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+            int* cjs;
+            int* shifts;
+            int ncj         = collectDirect(atom, ci, &cjs, &shifts);
+            int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+            MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+            MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+            int shift       = CENTER_SHIFT;
+
+            MD_SIMD_FLOAT xi0_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]);
+            MD_SIMD_FLOAT xi2_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 2]);
+            MD_SIMD_FLOAT yi0_tmp = simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 0]);
+            MD_SIMD_FLOAT yi2_tmp = simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 2]);
+            MD_SIMD_FLOAT zi0_tmp = simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 0]);
+            MD_SIMD_FLOAT zi2_tmp = simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 2]);
+            MD_SIMD_FLOAT fix0    = simd_real_zero();
+            MD_SIMD_FLOAT fiy0    = simd_real_zero();
+            MD_SIMD_FLOAT fiz0    = simd_real_zero();
+            MD_SIMD_FLOAT fix2    = simd_real_zero();
+            MD_SIMD_FLOAT fiy2    = simd_real_zero();
+            MD_SIMD_FLOAT fiz2    = simd_real_zero();
+
+#ifndef ONE_ATOM_TYPE
+            int ci_sca_base       = CI_SCALAR_BASE_INDEX(ci);
+            int* ci_t             = &atom->cl_t[ci_sca_base];
+            MD_SIMD_INT tbase0    = simd_i32_load_h_dual_scaled(&ci_t[0], atom->ntypes);
+            MD_SIMD_INT tbase2    = simd_i32_load_h_dual_scaled(&ci_t[2], atom->ntypes);
+#endif
+
+            for (int k = 0; k < ncj; k++) {
+                if (shifts[k] != shift) {
+                    const MD_FLOAT* sh = atom->shiftvec[shifts[k]];
+                    shift              = shifts[k];
+                    xi0_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]),
+                        simd_real_broadcast(sh[0]));
+                    xi2_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 2]),
+                        simd_real_broadcast(sh[0]));
+                    yi0_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 0]),
+                        simd_real_broadcast(sh[1]));
+                    yi2_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_Y_OFFSET + 2]),
+                        simd_real_broadcast(sh[1]));
+                    zi0_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 0]),
+                        simd_real_broadcast(sh[2]));
+                    zi2_tmp = simd_real_sub(simd_real_load_h_dual(&ci_x[CL_Z_OFFSET + 2]),
+                        simd_real_broadcast(sh[2]));
+                }
+
+                int cj          = cjs[k];
+                int center      = (shift == CENTER_SHIFT);
+                int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
+                MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
+
+#ifndef ONE_ATOM_TYPE
+                int cj_sca_base = CJ_SCALAR_BASE_INDEX(cj);
+                int* cj_t       = &atom->cl_t[cj_sca_base];
+#endif
+
+                MD_SIMD_FLOAT xj_tmp    = simd_real_load_h_duplicate(&cj_x[CL_X_OFFSET]);
+                MD_SIMD_FLOAT yj_tmp    = simd_real_load_h_duplicate(&cj_x[CL_Y_OFFSET]);
+                MD_SIMD_FLOAT zj_tmp    = simd_real_load_h_duplicate(&cj_x[CL_Z_OFFSET]);
+                MD_SIMD_FLOAT delx0     = simd_real_sub(xi0_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely0     = simd_real_sub(yi0_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz0     = simd_real_sub(zi0_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx2     = simd_real_sub(xi2_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely2     = simd_real_sub(yi2_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz2     = simd_real_sub(zi2_tmp, zj_tmp);
+                MD_SIMD_FLOAT rsq0      = simd_real_fma(delx0,
+                    delx0,
+                    simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
+                MD_SIMD_FLOAT rsq2      = simd_real_fma(delx2,
+                    delx2,
+                    simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
+
+#if CLUSTER_M == CLUSTER_N
+                unsigned int cond0      = (unsigned int)(center && cj == CJ0_FROM_CI(ci));
+                MD_SIMD_MASK excl_mask0 = simd_mask_from_u32(
+                    atom->masks_2xnn_fn[cond0 * 2 + 0]);
+                MD_SIMD_MASK excl_mask2 = simd_mask_from_u32(
+                    atom->masks_2xnn_fn[cond0 * 2 + 1]);
+#else
+#if CLUSTER_M < CLUSTER_N
+                unsigned int cond0      = (unsigned int)(center && (cj << 1) + 0 == ci);
+                unsigned int cond1      = (unsigned int)(center && (cj << 1) + 1 == ci);
+#else
+                unsigned int cond0 = (unsigned int)(center && cj == CJ0_FROM_CI(ci));
+                unsigned int cond1 = (unsigned int)(center && cj == CJ1_FROM_CI(ci));
+#endif
+                MD_SIMD_MASK excl_mask0 = simd_mask_from_u32(
+                    atom->masks_2xnn_fn[cond0 * 4 + cond1 * 2 + 0]);
+                MD_SIMD_MASK excl_mask2 = simd_mask_from_u32(
+                    atom->masks_2xnn_fn[cond0 * 4 + cond1 * 2 + 1]);
+#endif
+
+#ifndef ONE_ATOM_TYPE
+                MD_SIMD_INT tj_tmp = simd_i32_load_h_duplicate(cj_t);
+                MD_SIMD_INT tvec0  = simd_i32_add(tbase0, tj_tmp);
+                MD_SIMD_INT tvec2  = simd_i32_add(tbase2, tj_tmp);
+
+                MD_SIMD_FLOAT cutforcesq0 = simd_real_gather(tvec0,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT cutforcesq2 = simd_real_gather(tvec2,
+                    atom->cutforcesq,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT sigma6_0    = simd_real_gather(tvec0,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT sigma6_2    = simd_real_gather(tvec2,
+                    atom->sigma6,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT eps0        = simd_real_gather(tvec0,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+                MD_SIMD_FLOAT eps2        = simd_real_gather(tvec2,
+                    atom->epsilon,
+                    sizeof(MD_FLOAT));
+#else
+                MD_SIMD_FLOAT cutforcesq0 = cutforcesq_vec;
+                MD_SIMD_FLOAT cutforcesq2 = cutforcesq_vec;
+                MD_SIMD_FLOAT sigma6_0    = sigma6_vec;
+                MD_SIMD_FLOAT sigma6_2    = sigma6_vec;
+                MD_SIMD_FLOAT eps0        = eps_vec;
+                MD_SIMD_FLOAT eps2        = eps_vec;
+#endif
+
+                MD_SIMD_MASK cutoff_mask0 = simd_mask_and(excl_mask0,
+                    simd_mask_cond_lt(rsq0, cutforcesq0));
+                MD_SIMD_MASK cutoff_mask2 = simd_mask_and(excl_mask2,
+                    simd_mask_cond_lt(rsq2, cutforcesq2));
+
+                addLaneStats(laneCount(excl_mask0) + laneCount(excl_mask2),
+                    laneCount(cutoff_mask0) + laneCount(cutoff_mask2));
+
+                MD_SIMD_FLOAT sr2_0 = simd_real_reciprocal(rsq0);
+                MD_SIMD_FLOAT sr2_2 = simd_real_reciprocal(rsq2);
+
+                MD_SIMD_FLOAT sr6_0 = simd_real_mul(sr2_0,
+                    simd_real_mul(sr2_0, simd_real_mul(sr2_0, sigma6_0)));
+                MD_SIMD_FLOAT sr6_2 = simd_real_mul(sr2_2,
+                    simd_real_mul(sr2_2, simd_real_mul(sr2_2, sigma6_2)));
+
+                MD_SIMD_FLOAT force0 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_0,
+                        simd_real_mul(simd_real_sub(sr6_0, c05_vec),
+                            simd_real_mul(sr2_0, eps0))));
+                MD_SIMD_FLOAT force2 = simd_real_mul(c48_vec,
+                    simd_real_mul(sr6_2,
+                        simd_real_mul(simd_real_sub(sr6_2, c05_vec),
+                            simd_real_mul(sr2_2, eps2))));
+
+                fix0 = simd_real_masked_add(fix0,
+                    simd_real_mul(delx0, force0),
+                    cutoff_mask0);
+                fiy0 = simd_real_masked_add(fiy0,
+                    simd_real_mul(dely0, force0),
+                    cutoff_mask0);
+                fiz0 = simd_real_masked_add(fiz0,
+                    simd_real_mul(delz0, force0),
+                    cutoff_mask0);
+                fix2 = simd_real_masked_add(fix2,
+                    simd_real_mul(delx2, force2),
+                    cutoff_mask2);
+                fiy2 = simd_real_masked_add(fiy2,
+                    simd_real_mul(dely2, force2),
+                    cutoff_mask2);
+                fiz2 = simd_real_masked_add(fiz2,
+                    simd_real_mul(delz2, force2),
+                    cutoff_mask2);
+            }
+
+            simd_real_h_dual_incr_reduced_sum(&ci_f[CL_X_OFFSET], fix0, fix2);
+            simd_real_h_dual_incr_reduced_sum(&ci_f[CL_Y_OFFSET], fiy0, fiy2);
+            simd_real_h_dual_incr_reduced_sum(&ci_f[CL_Z_OFFSET], fiz0, fiz2);
+
+            addStat(stats->calculated_forces, 1);
+            addStat(stats->num_neighs, ncj);
+            addStat(stats->force_iters, ncj);
+        }
+
+        stopRegion(REGION_FORCE_THREAD);
+        LIKWID_MARKER_STOP("force");
+    }
+
+    double E = getTimeStamp();
+    DEBUG_MESSAGE("computeForceLJDirect end\n");
+    return E - S;
+}
+#else
+double computeForceLJDirect(
+    Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats)
+{
+    DEBUG_MESSAGE("computeForceLJDirect begin\n");
+#ifdef ONE_ATOM_TYPE
+    MD_FLOAT cutforcesq = param->cutforce * param->cutforce;
+    MD_FLOAT sigma6     = param->sigma6;
+    MD_FLOAT epsilon    = param->epsilon;
+#endif
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            ci_f[CL_X_OFFSET + cii] = 0.0;
+            ci_f[CL_Y_OFFSET + cii] = 0.0;
+            ci_f[CL_Z_OFFSET + cii] = 0.0;
+        }
+    }
+
+    initDirectBuffers();
+    double S = getTimeStamp();
+
+#pragma omp parallel
+    {
+        LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+
+#pragma omp for schedule(runtime) nowait
+        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+            int* cjs;
+            int* shifts;
+            int ncj         = collectDirect(atom, ci, &cjs, &shifts);
+            int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+            MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+            MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+
+#ifndef ONE_ATOM_TYPE
+            int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
+            int* ci_t       = &atom->cl_t[ci_sca_base];
+#endif
+
+            for (int k = 0; k < ncj; k++) {
+                int cj             = cjs[k];
+                const MD_FLOAT* sh = atom->shiftvec[shifts[k]];
+                int ci_cj0         = (shifts[k] == CENTER_SHIFT) ? CJ0_FROM_CI(ci) : -1;
+                MD_FLOAT* cj_x     = &atom->cl_x[CJ_VECTOR_BASE_INDEX(cj)];
+#if CLUSTER_M > CLUSTER_N
+                int ci_cj1 = (shifts[k] == CENTER_SHIFT) ? CJ1_FROM_CI(ci) : -1;
+#endif
+#ifndef ONE_ATOM_TYPE
+                int* cj_t = &atom->cl_t[CJ_SCALAR_BASE_INDEX(cj)];
+#endif
+
+                for (int cii = 0; cii < CLUSTER_M; cii++) {
+#ifndef ONE_ATOM_TYPE
+                    int type_i = ci_t[cii];
+#endif
+                    MD_FLOAT xtmp = ci_x[CL_X_OFFSET + cii] - sh[0];
+                    MD_FLOAT ytmp = ci_x[CL_Y_OFFSET + cii] - sh[1];
+                    MD_FLOAT ztmp = ci_x[CL_Z_OFFSET + cii] - sh[2];
+                    MD_FLOAT fix  = 0;
+                    MD_FLOAT fiy  = 0;
+                    MD_FLOAT fiz  = 0;
+
+                    for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
+#if CLUSTER_M == CLUSTER_N
+                        int cond = ci_cj0 != cj || cii != cjj;
+#elif CLUSTER_M < CLUSTER_N
+                        int cond = ci_cj0 != cj || cii + CLUSTER_M * (ci & 0x1) != cjj;
+#else
+                        int cond = (ci_cj0 != cj || cii != cjj) &&
+                                   (ci_cj1 != cj || cii != cjj + CLUSTER_N);
+#endif
+                        MD_FLOAT delx = xtmp - cj_x[CL_X_OFFSET + cjj];
+                        MD_FLOAT dely = ytmp - cj_x[CL_Y_OFFSET + cjj];
+                        MD_FLOAT delz = ztmp - cj_x[CL_Z_OFFSET + cjj];
+                        MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
+
+#ifndef ONE_ATOM_TYPE
+                        int type_index      = type_i * atom->ntypes + cj_t[cjj];
+                        MD_FLOAT cutforcesq = atom->cutforcesq[type_index];
+                        MD_FLOAT sigma6     = atom->sigma6[type_index];
+                        MD_FLOAT epsilon    = atom->epsilon[type_index];
+#endif
+
+                        if (cond && rsq < cutforcesq) {
+                            MD_FLOAT sr2   = 1.0 / rsq;
+                            MD_FLOAT sr6   = sr2 * sr2 * sr2 * sigma6;
+                            MD_FLOAT force = 48.0 * sr6 * (sr6 - 0.5) * sr2 * epsilon;
+
+                            fix += delx * force;
+                            fiy += dely * force;
+                            fiz += delz * force;
+                        }
+                    }
+
+                    ci_f[CL_X_OFFSET + cii] += fix;
+                    ci_f[CL_Y_OFFSET + cii] += fiy;
+                    ci_f[CL_Z_OFFSET + cii] += fiz;
+                }
+            }
+
+            addStat(stats->calculated_forces, 1);
+            addStat(stats->num_neighs, ncj);
+            addStat(stats->force_iters, ncj);
+        }
+
+        stopRegion(REGION_FORCE_THREAD);
+        LIKWID_MARKER_STOP("force");
+    }
+
+    double E = getTimeStamp();
+    DEBUG_MESSAGE("computeForceLJDirect end\n");
+    return E - S;
+}
+#endif
+
 
  double computeForceLJ2xnFullNeigh(
      Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats){
@@ -10,17 +10,26 @@
 //---
 #include <likwid-marker.h>
 //---
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+//---
 #include <allocate.h>
 #include <atom.h>
+#include <cachesim.h>
 #include <eam.h>
 #include <force.h>
+#include <frequency.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <pbc.h>
+#include <roofline.h>
+#include <snapshot.h>
 #include <stats.h>
 #include <thermo.h>
 #include <timers.h>
 #include <timing.h>
+#include <tracing.h>
 #include <util.h>
 
 #define HLINE                                                                            \
@@ -31,6 +40,15 @@
 #define P_FIX  1
 #define P_RAND 2
 
+// Sweep mode: i-clusters grow by SWEEP_STEP from SWEEP_MIN_CLUSTERS up to -ni,
+// every point is repeated for at least SWEEP_MIN_TIME seconds
+#define SWEEP_MIN_CLUSTERS 16
+#define SWEEP_STEP         4
+#define SWEEP_MIN_TIME     0.1
+// Flops per computed pair of the LJ kernels (3 sub, 5 for rsq, 1 div, 3 for sr6,
+// 5 for the force factor, 6 for the force update)
+#define FLOPS_PER_PAIR 23
+
 void init(Parameter* param)
 {
     param->input_file  = NULL;
@@ -54,21 +72,89 @@ void init(Parameter* param)
     param->nstat         = 100;
     param->temp          = 1.44;
     param->reneigh_every = 20;
-    param->proc_freq     = 2.4;
+    param->proc_freq     = 0.0;
     param->eam_file      = NULL;
 }
 
+void initTypes(Atom* atom, Parameter* param)
+{
+    atom->ntypes     = param->ntypes;
+    atom->epsilon    = allocate(ALIGNMENT,
+        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+    atom->sigma6     = allocate(ALIGNMENT,
+        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+    atom->cutforcesq = allocate(ALIGNMENT,
+        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+    atom->cutneighsq = allocate(ALIGNMENT,
+        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+    for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
+        atom->epsilon[i]    = param->epsilon;
+        atom->sigma6[i]     = param->sigma6;
+        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
+        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+    }
+}
+
+void createClusters(Atom* atom, int niclusters, int iclusters_natoms)
+{
+    DEBUG_MESSAGE("Creating atoms...\n");
+    atom->Nlocal          = 0;
+    atom->Nclusters_local = 0;
+    while (atom->Nclusters_max < niclusters) {
+        growClusters(atom);
+    }
+
+    for (int ci = 0; ci < niclusters; ++ci) {
+        int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+        MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
+        int* ci_t       = &atom->cl_t[ci_sca_base];
+
+        for (int cii = 0; cii < iclusters_natoms; ++cii) {
+            ci_x[CL_X_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) *
+                                      0.00001;
+            ci_x[CL_Y_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) *
+                                      0.00001;
+            ci_x[CL_Z_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) *
+                                      0.00001;
+            ci_v[CL_X_OFFSET + cii] = 0.0;
+            ci_v[CL_Y_OFFSET + cii] = 0.0;
+            ci_v[CL_Z_OFFSET + cii] = 0.0;
+            ci_t[cii]               = rand() % atom->ntypes;
+            atom->Nlocal++;
+        }
+
+        for (int cii = iclusters_natoms; cii < CLUSTER_M; cii++) {
+            ci_x[CL_X_OFFSET + cii] = INFINITY;
+            ci_x[CL_Y_OFFSET + cii] = INFINITY;
+            ci_x[CL_Z_OFFSET + cii] = INFINITY;
+        }
+
+        atom->iclusters[ci].natoms = iclusters_natoms;
+        atom->Nclusters_local++;
+    }
+}
+
 void createNeighbors(
     Atom* atom, Neighbor* neighbor, int pattern, int nneighs, int nreps, int masked)
 {
     const int maxneighs       = nneighs * nreps;
     const int ncj             = get_ncj_from_nci(atom->Nclusters_local);
     const unsigned int imask  = NBNXN_INTERACTION_MASK_ALL;
-    neighbor->numneigh        = (int*)malloc(atom->Nclusters_max * sizeof(int));
-    neighbor->numneigh_masked = (int*)malloc(atom->Nclusters_max * sizeof(int));
-    neighbor->neighbors = (int*)malloc(atom->Nclusters_max * maxneighs * sizeof(int));
-    neighbor->neighbors_imask = (unsigned int*)malloc(
-        atom->Nclusters_max * maxneighs * sizeof(unsigned int));
+    if (neighbor->numneigh) deallocate(neighbor->numneigh);
+    if (neighbor->numneigh_masked) deallocate(neighbor->numneigh_masked);
+    if (neighbor->neighbors) deallocate(neighbor->neighbors);
+    if (neighbor->neighbors_imask) deallocate(neighbor->neighbors_imask);
+    neighbor->maxneighs       = maxneighs;
+    neighbor->numneigh        = (int*)allocate(ALIGNMENT,
+        atom->Nclusters_max * sizeof(int));
+    neighbor->numneigh_masked = (int*)allocate(ALIGNMENT,
+        atom->Nclusters_max * sizeof(int));
+    neighbor->neighbors       = (int*)allocate(ALIGNMENT,
+        (MD_INDEX)atom->Nclusters_max * maxneighs * sizeof(int));
+    neighbor->neighbors_imask = (unsigned int*)allocate(ALIGNMENT,
+        (MD_INDEX)atom->Nclusters_max * maxneighs * sizeof(unsigned int));
 
     if (pattern == P_RAND && ncj <= nneighs) {
         fprintf(stderr,
@@ -78,9 +164,10 @@ void createNeighbors(
     }
 
     for (int ci = 0; ci < atom->Nclusters_local; ci++) {
-        int* neighptr                = &(neighbor->neighbors[ci * neighbor->maxneighs]);
+        int* neighptr                = &(
+            neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)]);
         unsigned int* neighptr_imask = &(
-            neighbor->neighbors_imask[ci * neighbor->maxneighs]);
+            neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)]);
         int j = (pattern == P_SEQ) ? CJ0_FROM_CI(ci) : 0;
         int m = (pattern == P_SEQ) ? ncj : nneighs;
         int k = 0;
@@ -116,6 +203,129 @@ void createNeighbors(
         neighbor->numneigh[ci]        = nneighs * nreps;
         neighbor->numneigh_masked[ci] = (masked == 1) ? (nneighs * nreps) : 0;
     }
+
+    setCenterSegments(atom, neighbor);
+}
+
+double computeForceStub(Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats)
+{
+    if (param->force_field == FF_EAM) {
+        return computeForceEam(param, atom, neighbor, stats);
+    }
+
+    if (param->half_neigh) {
+        if (VECTOR_WIDTH > CLUSTER_M * 2) {
+            return computeForceLJ2xnnHalfNeigh(param, atom, neighbor, stats);
+        }
+
+        return computeForceLJ4xnHalfNeigh(param, atom, neighbor, stats);
+    }
+
+    if (VECTOR_WIDTH > CLUSTER_M * 2) {
+        return computeForceLJ2xnnFullNeigh(param, atom, neighbor, stats);
+    }
+
+    return computeForceLJ4xnFullNeigh(param, atom, neighbor, stats);
+}
+
+/* run the LJ kernel over working sets from L1 to DRAM for all access patterns,
+ * with and without interaction masks and for increasing thread counts, and
+ * print pair, byte and flop rates with the roofline estimate from the probes */
+void sweepKernels(
+    Parameter* param, Atom* atom, int maxclusters, int iclusters_natoms, int nneighs)
+{
+    const char* patterns[] = { "seq", "fix", "rand" };
+    const size_t fsize     = sizeof(MD_FLOAT);
+    Neighbor neighbor;
+    Stats stats;
+    int maxthreads = 1;
+
+#ifdef _OPENMP
+    maxthreads = omp_get_max_threads();
+#endif
+
+    initNeighbor(&neighbor, param);
+    printf("kernel,threads,pattern,masked,niclusters,nneighs,working set(kB),iters,"
+           "time(s),pairs/s(G),bytes/s(GB),flops/s(GF),flops/byte,probe bw(GB/s),"
+           "probe peak(GF/s),roof(GF/s),roof fraction,bound\n");
+
+    for (int threads = 1;; threads = MIN(threads * 2, maxthreads)) {
+#ifdef _OPENMP
+        omp_set_num_threads(threads);
+#endif
+        const double bw   = probeBandwidth();
+        const double peak = probePeakFlops();
+
+        for (int pattern = P_SEQ; pattern <= P_RAND; pattern++) {
+            for (int masked = 0; masked <= 1; masked++) {
+                for (int nci = SWEEP_MIN_CLUSTERS; nci <= maxclusters;
+                     nci *= SWEEP_STEP) {
+                    const int ncj = get_ncj_from_nci(nci);
+                    if (pattern == P_RAND && ncj <= nneighs) {
+                        continue;
+                    }
+
+                    createClusters(atom, nci, iclusters_natoms);
+                    defineJClusters(atom);
+                    createNeighbors(atom, &neighbor, pattern, nneighs, 1, masked);
+
+                    // Data touched per kernel call: i-cluster positions and forces
+                    // (read and write) and, per cluster pair, the j index, mask,
+                    // j-cluster positions and types
+                    const double npairs = (double)nci * nneighs;
+                    const double jbytes = CLUSTER_N * (3 * fsize + sizeof(int));
+                    const double bytes  = nci * CLUSTER_M * 9.0 * fsize +
+                                         npairs * ((1 + masked) * sizeof(int) + jbytes);
+                    const double flops  = npairs * CLUSTER_M * CLUSTER_N * FLOPS_PER_PAIR;
+
+                    // Distinct data, with the fix pattern only nneighs j-clusters
+                    const int ncjTouched = (pattern == P_FIX) ? nneighs : ncj;
+                    const double wset    = nci * CLUSTER_M * (6 * fsize + sizeof(int)) +
+                                        ncjTouched * jbytes +
+                                        npairs * (1 + masked) * sizeof(int);
+
+                    // Calibrate the number of iterations after a warm-up call
+                    initStats(&stats);
+                    computeForceStub(param, atom, &neighbor, &stats);
+                    double T  = computeForceStub(param, atom, &neighbor, &stats);
+                    int iters = MAX(param->ntimes, (int)(SWEEP_MIN_TIME / T) + 1);
+                    T         = 0.0;
+                    for (int i = 0; i < iters; i++) {
+                        T += computeForceStub(param, atom, &neighbor, &stats);
+                    }
+
+                    const double intensity = flops / bytes;
+                    const double roof      = MIN(peak, intensity * bw);
+                    const double flopRate  = flops * iters / T * 1e-9;
+                    printf("%s,%d,%s,%d,%d,%d,%.2f,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f,%.2f,"
+                           "%.2f,%.4f,%s\n",
+                        KERNEL_NAME,
+                        threads,
+                        patterns[pattern],
+                        masked,
+                        nci,
+                        nneighs,
+                        wset / 1e3,
+                        iters,
+                        T,
+                        npairs * CLUSTER_M * CLUSTER_N * iters / T * 1e-9,
+                        bytes * iters / T * 1e-9,
+                        flopRate,
+                        intensity,
+                        bw,
+                        peak,
+                        roof,
+                        flopRate / roof,
+                        (intensity * bw < peak) ? "memory" : "compute");
+                    fflush(stdout);
+                }
+            }
+        }
+
+        if (threads == maxthreads) {
+            break;
+        }
+    }
 }
 
 int main(int argc, const char* argv[])
@@ -134,6 +344,9 @@ int main(int argc, const char* argv[])
     int masked           = 0;         // Use masked loop
     int nreps            = 1;
     int csv              = 0;
+    char* replay_file    = NULL; // Snapshot written by the main binary
+    int replay_step      = 0;
+    int sweep_max        = 0; // Largest number of i-clusters in sweep mode
 
     LIKWID_MARKER_INIT;
     LIKWID_MARKER_REGISTER("force");
@@ -194,6 +407,14 @@ int main(int argc, const char* argv[])
             param.proc_freq = atof(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--sweep") == 0)) {
+            sweep_max = atoi(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--replay") == 0)) {
+            replay_file = strdup(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "--csv") == 0)) {
             csv = 1;
             continue;
@@ -212,8 +433,15 @@ int main(int argc, const char* argv[])
                    "(default 9)\n");
             printf("-nr <int>:            number of times neighbor lists should be "
                    "replicated (default 1)\n");
-            printf("--freq <real>:        set CPU frequency (GHz) and display average "
-                   "cycles per atom and neighbors\n");
+            printf("--freq <real>:        CPU frequency (GHz) for the cycles per atom "
+                   "and neighbor, measured\n");
+            printf("                      if not set\n");
+            printf("--sweep <int>:        sweep patterns, masks, threads and working "
+                   "sets up to <int>\n");
+            printf("                      i-clusters and print rates and roofline "
+                   "estimates as CSV\n");
+            printf("--replay <string>:    replay atoms and neighbor lists of a snapshot "
+                   "(see --snapshot)\n");
             printf("--csv:                set output as CSV style\n");
             printf(HLINE);
             exit(EXIT_SUCCESS);
@@ -233,55 +461,37 @@ int main(int argc, const char* argv[])
     initAtom(atom);
     initStats(&stats);
 
-    atom->ntypes  = param.ntypes;
-    atom->epsilon = allocate(ALIGNMENT, atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->sigma6  = allocate(ALIGNMENT, atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->cutforcesq = allocate(ALIGNMENT,
-        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->cutneighsq = allocate(ALIGNMENT,
-        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param.epsilon;
-        atom->sigma6[i]     = param.sigma6;
-        atom->cutneighsq[i] = param.cutneigh * param.cutneigh;
-        atom->cutforcesq[i] = param.cutforce * param.cutforce;
-    }
-
-    DEBUG_MESSAGE("Creating atoms...\n");
-    while (atom->Nmax < niclusters * iclusters_natoms) {
-        growAtom(atom);
-    }
+    if (sweep_max > 0) {
+        if (param.force_field != FF_LJ) {
+            fprintf(stderr, "Error: Sweep mode is only supported for LJ!\n");
+            exit(-1);
+        }
 
-    while (atom->Nclusters_max < niclusters) {
-        growClusters(atom);
+        initTypes(atom, &param);
+        sweepKernels(&param, atom, sweep_max, iclusters_natoms, nneighs);
+        LIKWID_MARKER_CLOSE;
+        return EXIT_SUCCESS;
     }
 
-    for (int ci = 0; ci < niclusters; ++ci) {
-        int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
-        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
-        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
-        MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
-        int* ci_t       = &atom->cl_t[ci_sca_base];
-
-        for (int cii = 0; cii < iclusters_natoms; ++cii) {
-            ci_x[CL_X_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) * 0.00001;
-            ci_x[CL_Y_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) * 0.00001;
-            ci_x[CL_Z_OFFSET + cii] = (MD_FLOAT)(ci * iclusters_natoms + cii) * 0.00001;
-            ci_v[CL_X_OFFSET + cii] = 0.0;
-            ci_v[CL_Y_OFFSET + cii] = 0.0;
-            ci_v[CL_Z_OFFSET + cii] = 0.0;
-            ci_t[cii]               = rand() % atom->ntypes;
-            atom->Nlocal++;
+    if (replay_file != NULL) {
+        DEBUG_MESSAGE("Reading snapshot...\n");
+        initNeighbor(&neighbor, &param);
+        replay_step = readSnapshot(replay_file, &param, atom, &neighbor);
+        free(pattern_str);
+        pattern_str = strdup("replay");
+        niclusters  = atom->Nclusters_local;
+        nreps       = 1;
+
+        long long npairs = 0;
+        for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+            npairs += neighbor.numneigh[ci];
         }
 
-        for (int cii = iclusters_natoms; cii < CLUSTER_M; cii++) {
-            ci_x[CL_X_OFFSET + cii] = INFINITY;
-            ci_x[CL_Y_OFFSET + cii] = INFINITY;
-            ci_x[CL_Z_OFFSET + cii] = INFINITY;
-        }
-
-        atom->iclusters[ci].natoms = iclusters_natoms;
-        atom->Nclusters_local++;
+        iclusters_natoms = (atom->Nlocal + niclusters - 1) / niclusters;
+        nneighs          = (int)((npairs + niclusters - 1) / niclusters);
+    } else {
+        initTypes(atom, &param);
+        createClusters(atom, niclusters, iclusters_natoms);
     }
 
     const double estim_atom_volume      = (double)(atom->Nlocal * 3 * sizeof(MD_FLOAT));
@@ -298,6 +508,12 @@ int main(int argc, const char* argv[])
             VECTOR_WIDTH);
         printf("Floating-point precision: %s\n", PRECISION_STRING);
         printf("Pattern: %s\n", pattern_str);
+        if (replay_file != NULL) {
+            printf("Snapshot: %s (step %d, %s neighbor lists)\n",
+                replay_file,
+                replay_step,
+                param.half_neigh ? "half" : "full");
+        }
         printf("Number of timesteps: %d\n", param.ntimes);
         printf("Number of i-clusters: %d\n", niclusters);
         printf("Number of atoms per i-cluster: %d\n", iclusters_natoms);
@@ -309,12 +525,15 @@ int main(int argc, const char* argv[])
             estim_neighbors_volume / 1000.0);
     }
 
-    DEBUG_MESSAGE("Defining j-clusters...\n");
-    defineJClusters(atom);
-    DEBUG_MESSAGE("Initializing neighbor lists...\n");
-    initNeighbor(&neighbor, &param);
-    DEBUG_MESSAGE("Creating neighbor lists...\n");
-    createNeighbors(atom, &neighbor, pattern, nneighs, nreps, masked);
+    if (replay_file == NULL) {
+        DEBUG_MESSAGE("Defining j-clusters...\n");
+        defineJClusters(atom);
+        DEBUG_MESSAGE("Initializing neighbor lists...\n");
+        initNeighbor(&neighbor, &param);
+        DEBUG_MESSAGE("Creating neighbor lists...\n");
+        createNeighbors(atom, &neighbor, pattern, nneighs, nreps, masked);
+    }
+
     DEBUG_MESSAGE("Computing forces...\n");
 
     double T_accum = 0.0;
@@ -323,38 +542,10 @@ int main(int argc, const char* argv[])
         traceAddresses(&param, atom, &neighbor, i + 1);
 #endif
 
-        if (param.force_field == FF_EAM) {
-            T_accum += computeForceEam(&param, atom, &neighbor, &stats);
-        } else {
-            if (param.half_neigh) {
-                if (VECTOR_WIDTH > CLUSTER_M * 2) {
-                    T_accum += computeForceLJ2xnnHalfNeigh(&param,
-                        atom,
-                        &neighbor,
-                        &stats);
-                } else {
-                    T_accum += computeForceLJ4xnHalfNeigh(&param,
-                        atom,
-                        &neighbor,
-                        &stats);
-                }
-            } else {
-                if (VECTOR_WIDTH > CLUSTER_M * 2) {
-                    T_accum += computeForceLJ2xnnFullNeigh(&param,
-                        atom,
-                        &neighbor,
-                        &stats);
-                } else {
-                    T_accum += computeForceLJ4xnFullNeigh(&param,
-                        atom,
-                        &neighbor,
-                        &stats);
-                }
-            }
-        }
+        T_accum += computeForceStub(&param, atom, &neighbor, &stats);
     }
 
-    double freq_hz                     = param.proc_freq * 1.e9;
+    double freq_hz                     = getFrequency(&param) * 1.e9;
     const double atoms_updates_per_sec = (double)(atom->Nlocal) / T_accum *
                                          (double)(param.ntimes);
     const double cycles_per_atom = T_accum / (double)(atom->Nlocal) /
@@ -365,7 +556,7 @@ int main(int argc, const char* argv[])
         printf("Total time: %.4f, Mega atom updates/s: %.4f\n",
             T_accum,
             atoms_updates_per_sec / 1.e6);
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf("Cycles per atom: %.4f, Cycles per neighbor: %.4f\n",
                 cycles_per_atom,
                 cycles_per_neigh);
@@ -373,7 +564,7 @@ int main(int argc, const char* argv[])
     } else {
         printf("steps,pattern,niclusters,iclusters_natoms,nneighs,nreps,total "
                "vol.(kB),atoms vol.(kB),neigh vol.(kB),time(s),atom upds/s(M)");
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf(",cy/atom,cy/neigh");
         }
         printf("\n");
@@ -391,7 +582,7 @@ int main(int argc, const char* argv[])
             T_accum,
             atoms_updates_per_sec / 1.e6);
 
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf(",%.4f,%.4f", cycles_per_atom, cycles_per_neigh);
         }
         printf("\n");
@@ -400,6 +591,12 @@ int main(int argc, const char* argv[])
     double timer[NUMTIMER];
     timer[FORCE] = T_accum;
     displayStatistics(atom, &param, &stats, timer);
+
+#ifdef CACHE_SIM
+    printCacheSim();
+    printf(HLINE);
+#endif
+
     LIKWID_MARKER_CLOSE;
     return EXIT_SUCCESS;
 }
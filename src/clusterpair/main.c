@@ -6,6 +6,7 @@
  */
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <likwid-marker.h>
@@ -15,17 +16,22 @@
 
 #include <allocate.h>
 #include <atom.h>
+#include <cachesim.h>
 #include <device.h>
 #include <eam.h>
+#include <energy.h>
 #include <force.h>
 #include <integrate.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <pbc.h>
+#include <report.h>
+#include <snapshot.h>
 #include <stats.h>
 #include <thermo.h>
 #include <timers.h>
 #include <timing.h>
+#include <tracing.h>
 #include <util.h>
 #include <vtk.h>
 #include <xtc.h>
@@ -35,6 +41,8 @@ extern void copyDataFromCUDADevice(Atom*);
 extern void cudaDeviceFree(void);
 
 #define HLINE "------------------------------------------------------------------\n"
+// List force computations timed on the final positions of a direct force run
+#define DIRECT_COMPARE_STEPS 10
 
 double setup(Parameter* param, Eam* eam, Atom* atom, Neighbor* neighbor, Stats* stats)
 {
@@ -48,28 +56,47 @@ double setup(Parameter* param, Eam* eam, Atom* atom, Neighbor* neighbor, Stats*
     param->zprd    = param->nz * param->lattice;
 
     timeStart = getTimeStamp();
+    startRegion(REGION_SETUP);
     initAtom(atom);
     initForce(param);
     initPbc(atom);
     initStats(stats);
     initNeighbor(neighbor, param);
+    startRegion(REGION_SETUP_ATOMS);
     if (param->input_file == NULL) {
         createAtom(atom, param);
     } else {
         readAtom(atom, param);
     }
+    stopRegion(REGION_SETUP_ATOMS);
 
     setupNeighbor(param, atom);
+    startRegion(REGION_SETUP_THERMO);
     setupThermo(param, atom->Natoms);
     if (param->input_file == NULL) {
         adjustThermo(param, atom);
     }
+    stopRegion(REGION_SETUP_THERMO);
+    startRegion(REGION_SETUP_CLUSTERS);
+    loadSingleAtoms(atom);
     buildClusters(atom);
     defineJClusters(atom);
+    stopRegion(REGION_SETUP_CLUSTERS);
+    startRegion(REGION_SETUP_GHOSTS);
     setupPbc(atom, param);
+    stopRegion(REGION_SETUP_GHOSTS);
+    startRegion(REGION_SETUP_BINNING);
     binClusters(atom);
-    buildNeighbor(atom, neighbor);
+    stopRegion(REGION_SETUP_BINNING);
+    startRegion(REGION_SETUP_NEIGHBOR);
+    if (!param->force_direct) {
+        buildNeighbor(atom, neighbor);
+    }
+    stopRegion(REGION_SETUP_NEIGHBOR);
+    startRegion(REGION_SETUP_DEVICE);
     initDevice(atom, neighbor);
+    stopRegion(REGION_SETUP_DEVICE);
+    stopRegion(REGION_SETUP);
     timeStop = getTimeStamp();
     return timeStop - timeStart;
 }
@@ -79,18 +106,152 @@ double reneighbour(Parameter* param, Atom* atom, Neighbor* neighbor)
     double timeStart, timeStop;
     timeStart = getTimeStamp();
     LIKWID_MARKER_START("reneighbour");
-    updateSingleAtoms(atom);
+    startRegion(REGION_REBUILD);
+    startRegion(REGION_REBUILD_PBC);
     updateAtomsPbc(atom, param, false);
+    stopRegion(REGION_REBUILD_PBC);
+    startRegion(REGION_REBUILD_CLUSTERS);
     buildClusters(atom);
     defineJClusters(atom);
+    stopRegion(REGION_REBUILD_CLUSTERS);
+    startRegion(REGION_REBUILD_GHOSTS);
     setupPbc(atom, param);
+    stopRegion(REGION_REBUILD_GHOSTS);
+    startRegion(REGION_REBUILD_BINNING);
     binClusters(atom);
-    buildNeighbor(atom, neighbor);
+    stopRegion(REGION_REBUILD_BINNING);
+    startRegion(REGION_REBUILD_NEIGHBOR);
+    if (!param->force_direct) {
+        buildNeighbor(atom, neighbor);
+    }
+    stopRegion(REGION_REBUILD_NEIGHBOR);
+    stopRegion(REGION_REBUILD);
     LIKWID_MARKER_STOP("reneighbour");
     timeStop = getTimeStamp();
     return timeStop - timeStart;
 }
 
+/* time the neighbor list mode on the final positions of a direct force run, one list
+ * build and DIRECT_COMPARE_STEPS list force computations whose statistics are not
+ * kept; returns the build time and sets *force to the mean force time */
+static double timeListMode(
+    Parameter* param, Atom* atom, Neighbor* neighbor, double* force)
+{
+    Stats stats;
+    double build = getTimeStamp();
+
+    initStats(&stats);
+    buildNeighbor(atom, neighbor);
+    build  = getTimeStamp() - build;
+    *force = 0.0;
+    for (int n = 0; n < DIRECT_COMPARE_STEPS; n++) {
+        *force += computeForceList(param, atom, neighbor, &stats);
+    }
+
+    *force /= DIRECT_COMPARE_STEPS;
+    return build;
+}
+
+// Per-atom arrays only exist while thermo output is computed
+void computeThermoClusters(int iflag, Parameter* param, Atom* atom)
+{
+    updateSingleAtoms(atom);
+    computeThermo(iflag, param, atom);
+    freeSingleAtoms(atom);
+}
+
+// Memory of the per-atom arrays, which are not kept besides the clusters
+static double getSingleAtomMemory(Atom* atom)
+{
+    return 1e-6 * (double)atom->Nmax * (6 * sizeof(MD_FLOAT) + sizeof(int));
+}
+
+void printPageReport(Atom* atom, Neighbor* neighbor)
+{
+    size_t nbytes = atom->Nclusters_max * CLUSTER_M * sizeof(MD_FLOAT);
+
+    printf("Page placement:\n");
+    printPagePlacement("cl_x", atom->cl_x, nbytes * 3);
+    printPagePlacement("cl_v", atom->cl_v, nbytes * 3);
+    printPagePlacement("cl_f", atom->cl_f, nbytes * 3);
+    printPagePlacement("cl_t", atom->cl_t, atom->Nclusters_max * CLUSTER_M * sizeof(int));
+    printPagePlacement("numneigh",
+        neighbor->numneigh,
+        atom->Nclusters_local * sizeof(int));
+    printPagePlacement("neighbors",
+        neighbor->neighbors,
+        (MD_INDEX)atom->Nclusters_local * neighbor->maxneighs * sizeof(int));
+    printPagePlacement("neighbors_imask",
+        neighbor->neighbors_imask,
+        (MD_INDEX)atom->Nclusters_local * neighbor->maxneighs * sizeof(unsigned int));
+}
+
+#ifdef PBC_SHIFTS
+#define PBC_MODE "shift vectors"
+#else
+#define PBC_MODE "ghost clusters"
+#endif
+
+#ifdef PBC_SHIFTS
+// Ghost clusters and the time per step of their update that the shift vectors save,
+// measured once on the final positions by printPbcReport
+static int ghost_avoided           = 0;
+static double ghost_update_avoided = 0.0;
+#endif
+
+// Ghost clusters carry positions, types, velocities and forces like the local
+// clusters, plus their cluster data and the border map with the PBC offsets
+double getGhostMemory(int nghost)
+{
+    size_t bytes = CLUSTER_N * (9 * sizeof(MD_FLOAT) + sizeof(int)) + sizeof(Cluster) +
+                   4 * sizeof(int);
+    return 1e-6 * (double)nghost * bytes;
+}
+
+double getSegmentMemory(Atom* atom)
+{
+    return 1e-6 * (double)atom->Nclusters_local *
+           (SEGMENT_OFFSET(1) * sizeof(NeighborSegment) + sizeof(int));
+}
+
+double getAvgSegments(Atom* atom, Neighbor* neighbor)
+{
+    long nsegments = 0;
+
+    if (neighbor->numsegments == NULL || atom->Nclusters_local == 0) {
+        return 0.0;
+    }
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        nsegments += neighbor->numsegments[ci];
+    }
+
+    return (double)nsegments / atom->Nclusters_local;
+}
+
+void printPbcReport(Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    double pbcTime = getRegionTime(REGION_PBC) + getRegionTime(REGION_REBUILD_GHOSTS);
+
+    printf("Periodic boundaries: %s\n", PBC_MODE);
+    printf("\tghost clusters: %d (%.2f MB)\n",
+        atom->Nclusters_ghost,
+        getGhostMemory(atom->Nclusters_ghost));
+    printf("\tlist segments: %.2f per i-cluster (%.2f MB)\n",
+        getAvgSegments(atom, neighbor),
+        getSegmentMemory(atom));
+    printf("\tghost setup and update: %.4f ms per step\n",
+        1e3 * pbcTime / param->ntimes);
+#ifdef PBC_SHIFTS
+    ghost_update_avoided = timeGhostUpdate(atom, param, &ghost_avoided);
+    printf("\tavoided versus ghost clusters: %d ghost clusters (%.2f MB), %.4f ms per "
+           "step of ghost updates\n",
+        ghost_avoided,
+        getGhostMemory(ghost_avoided),
+        1e3 * ghost_update_avoided);
+#endif
+}
+
 void printAtomState(Atom* atom)
 {
     printf("Atom counts: Natoms=%d Nlocal=%d Nghost=%d Nmax=%d\n",
@@ -123,6 +284,8 @@ int main(int argc, char** argv)
         // LIKWID_MARKER_REGISTER("pbc");
     }
 
+    initRegions();
+
     initParameter(&param);
     for (int i = 0; i < argc; i++) {
         if ((strcmp(argv[i], "-p") == 0) || (strcmp(argv[i], "--param") == 0)) {
@@ -164,6 +327,25 @@ int main(int argc, char** argv)
             param.half_neigh = atoi(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--super") == 0)) {
+            param.super_cluster = atoi(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--direct") == 0)) {
+            param.force_direct = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--balance") == 0)) {
+            param.force_balance = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--cluster-shape") == 0)) {
+            if ((param.cluster_shape = str2shape(argv[++i])) < 0) {
+                fprintf(stderr, "Invalid cluster shape!\n");
+                exit(-1);
+            }
+            continue;
+        }
         if ((strcmp(argv[i], "-m") == 0) || (strcmp(argv[i], "--mass") == 0)) {
             param.mass = atof(argv[++i]);
             continue;
@@ -176,6 +358,13 @@ int main(int argc, char** argv)
             param.skin = atof(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--reneigh") == 0)) {
+            if ((param.reneigh_every = atoi(argv[++i])) < 1) {
+                fprintf(stderr, "Invalid reneighbor interval!\n");
+                exit(-1);
+            }
+            continue;
+        }
         if ((strcmp(argv[i], "--freq") == 0)) {
             param.proc_freq = atof(argv[++i]);
             continue;
@@ -184,6 +373,18 @@ int main(int argc, char** argv)
             param.vtk_file = strdup(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--page-report") == 0)) {
+            param.page_report = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--report") == 0)) {
+            param.report_file = strdup(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--report-csv") == 0)) {
+            param.report_csv_file = strdup(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "--xtc") == 0)) {
 #ifndef XTC_OUTPUT
             fprintf(stderr,
@@ -195,6 +396,14 @@ int main(int argc, char** argv)
 #endif
             continue;
         }
+        if ((strcmp(argv[i], "--snapshot") == 0)) {
+            param.snapshot_file = strdup(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--snapshot-step") == 0)) {
+            param.snapshot_step = atoi(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
             printf("MD Bench: A minimalistic re-implementation of miniMD\n");
             printf(HLINE);
@@ -208,33 +417,85 @@ int main(int argc, char** argv)
                    "direction\n");
             printf("-r / --radius <real>: set cutoff radius\n");
             printf("-s / --skin <real>:   set skin (verlet buffer)\n");
-            printf("--freq <real>:        processor frequency (GHz)\n");
+            printf("--reneigh <int>:      reneighbor every <int> timesteps\n");
+            printf("--super <int>:        clusters per super-cluster of the pair search, "
+                   "0 disables them\n");
+            printf("--direct:             compute forces from the bins without "
+                   "neighbor lists\n");
+            printf("--balance:            static thread ranges of equal neighbor list "
+                   "work\n");
+            printf("--cluster-shape <string>: order of the atoms of a bin cut into "
+                   "clusters (z, subcolumn or morton)\n");
+            printf("--freq <real>:        processor frequency (GHz), measured if "
+                   "not set\n");
             printf("--vtk <string>:       VTK file for visualization\n");
             printf("--xtc <string>:       XTC file for visualization\n");
+            printf("--page-report:        print NUMA page placement of main arrays\n");
+            printf("--report <string>:    write a JSON report of the run\n");
+            printf("--report-csv <string>: append a CSV line of the report\n");
+            printf("--snapshot <string>:  dump positions and neighbor lists for the "
+                   "stub\n");
+            printf("--snapshot-step <int>: step at which the snapshot is written "
+                   "(default 0)\n");
             printf(HLINE);
             exit(EXIT_SUCCESS);
         }
     }
 
     param.cutneigh = param.cutforce + param.skin;
-    setup(&param, &eam, &atom, &neighbor, &stats);
+    // Atoms are ordered by the cluster binning, there is no separate resort
+    param.sort_atoms = SORT_NONE;
+#if defined(CUDA_TARGET) || defined(MEM_TRACER) || defined(INDEX_TRACER)
+    if (param.force_direct) {
+        fprintf(stderr, "Warning: Direct force is not supported by this build!\n");
+        param.force_direct = 0;
+    }
+#endif
+    if (param.force_direct &&
+        (param.force_field != FF_LJ || param.snapshot_file != NULL)) {
+        fprintf(stderr, "Warning: Direct force requires LJ and no snapshot!\n");
+        param.force_direct = 0;
+    }
+    if (param.force_direct && param.half_neigh) {
+        fprintf(stderr, "Warning: Direct force computes full neighbor pairs!\n");
+        param.half_neigh = 0;
+    }
+#ifdef CUDA_TARGET
+    if (param.force_balance) {
+        fprintf(stderr, "Warning: Force balancing is not supported by this build!\n");
+        param.force_balance = 0;
+    }
+#endif
+    timer[SETUP] = setup(&param, &eam, &atom, &neighbor, &stats);
     printParameter(&param);
+    printf("Per-atom arrays released: %.2f MB (cluster arrays: %.2f MB)\n",
+        getSingleAtomMemory(&atom),
+        1e-6 * (double)atom.Nclusters_max * CLUSTER_M *
+            (9 * sizeof(MD_FLOAT) + sizeof(int)));
     printf(HLINE);
 
     printf("step\ttemp\t\tpressure\n");
-    computeThermo(0, &param, &atom);
+    computeThermoClusters(0, &param, &atom);
 #if defined(MEM_TRACER) || defined(INDEX_TRACER)
-    traceAddresses(&param, &atom, &neighbor, n + 1);
+    traceAddresses(&param, &atom, &neighbor, 0);
 #endif
 
 #ifdef CUDA_TARGET
     copyDataToCUDADevice(&atom, &neighbor);
 #endif
 
+    if (param.snapshot_file != NULL && param.snapshot_step == 0) {
+        writeSnapshot(param.snapshot_file, &param, &atom, &neighbor, 0);
+    }
+
+    // As with timer[FORCE], the force region includes this initial computation
+    startRegion(REGION_FORCE);
     timer[FORCE] = computeForce(&param, &atom, &neighbor, &stats);
+    stopRegion(REGION_FORCE);
 
     timer[NEIGH] = 0.0;
     timer[TOTAL] = getTimeStamp();
+    startRegion(REGION_LOOP);
 
     if (param.vtk_file != NULL) {
         write_data_to_vtk_file(param.vtk_file, &atom, 0);
@@ -245,14 +506,20 @@ int main(int argc, char** argv)
     }
 
     for (int n = 0; n < param.ntimes; n++) {
+        startRegion(REGION_INTEGRATE);
         initialIntegrate(&param, &atom);
+        stopRegion(REGION_INTEGRATE);
 
         if ((n + 1) % param.reneigh_every) {
-            if (!((n + 1) % param.prune_every)) {
+            if (!((n + 1) % param.prune_every) && !param.force_direct) {
+                startRegion(REGION_PRUNE);
                 pruneNeighbor(&param, &atom, &neighbor);
+                stopRegion(REGION_PRUNE);
             }
 
+            startRegion(REGION_PBC);
             updatePbc(&atom, &param, 0);
+            stopRegion(REGION_PBC);
         } else {
 #ifdef CUDA_TARGET
             copyDataFromCUDADevice(&atom);
@@ -269,16 +536,27 @@ int main(int argc, char** argv)
         traceAddresses(&param, &atom, &neighbor, n + 1);
 #endif
 
+        if (param.snapshot_file != NULL && param.snapshot_step == n + 1) {
+            writeSnapshot(param.snapshot_file, &param, &atom, &neighbor, n + 1);
+        }
+
+        startRegion(REGION_FORCE);
         timer[FORCE] += computeForce(&param, &atom, &neighbor, &stats);
+        stopRegion(REGION_FORCE);
+        startRegion(REGION_INTEGRATE);
         finalIntegrate(&param, &atom);
+        stopRegion(REGION_INTEGRATE);
 
         if (!((n + 1) % param.nstat) && (n + 1) < param.ntimes) {
-            computeThermo(n + 1, &param, &atom);
+            startRegion(REGION_THERMO);
+            computeThermoClusters(n + 1, &param, &atom);
+            stopRegion(REGION_THERMO);
         }
 
         int writePos = !((n + 1) % param.x_out_every);
         int writeVel = !((n + 1) % param.v_out_every);
         if (writePos || writeVel) {
+            startRegion(REGION_OUTPUT);
             if (param.vtk_file != NULL) {
                 write_data_to_vtk_file(param.vtk_file, &atom, n + 1);
             }
@@ -286,6 +564,7 @@ int main(int argc, char** argv)
             if (param.xtc_file != NULL) {
                 xtc_write(&atom, n + 1, write_pos, write_vel);
             }
+            stopRegion(REGION_OUTPUT);
         }
     }
 
@@ -293,14 +572,18 @@ int main(int argc, char** argv)
     copyDataFromCUDADevice(&atom);
 #endif
 
+    stopRegion(REGION_LOOP);
     timer[TOTAL] = getTimeStamp() - timer[TOTAL];
-    updateSingleAtoms(&atom);
-    computeThermo(-1, &param, &atom);
+    computeThermoClusters(-1, &param, &atom);
 
     if (param.xtc_file != NULL) {
         xtc_end();
     }
 
+    if (!param.force_direct) {
+        timeSuperClusters(&atom, &neighbor);
+    }
+
 #ifdef CUDA_TARGET
     cudaDeviceFree();
 #endif
@@ -310,12 +593,58 @@ int main(int argc, char** argv)
         atom.Natoms,
         atom.Nghost,
         param.ntimes);
+    printf("Bins: %d of %d occupied (%.2f MB)\n",
+        getOccupiedBins(),
+        getTotalBins(),
+        getBinningMemory());
+    printTypeStencil(getTypeStencil(), "cluster pairs");
+    printSuperClusters();
+    printClusterShape(&param, &atom, &neighbor);
+    printBalance(&neighbor.balance, "i-clusters");
     printf("TOTAL %.2fs FORCE %.2fs NEIGH %.2fs REST %.2fs\n",
         timer[TOTAL],
         timer[FORCE],
         timer[NEIGH],
         timer[TOTAL] - timer[FORCE] - timer[NEIGH]);
+    printf("SETUP %.2fs\n", timer[SETUP]);
+    printf("Array growth: %d reallocations, %.2f MB copied\n",
+        getNumReallocations(),
+        1e-6 * getReallocatedBytes());
+    printf(HLINE);
+    printRegions();
+    printf(HLINE);
+
+    double list_build   = 0.0, list_force = 0.0;
+    double direct_force = timer[FORCE] / (param.ntimes + 1);
+    double direct_neigh = timer[NEIGH] / MAX(param.ntimes, 1);
+    if (param.force_direct) {
+        list_build = timeListMode(&param, &atom, &neighbor, &list_force);
+        printf("Direct force: %.3f ms per step (force %.3f ms, rebuild %.3f ms)\n",
+            1e3 * (direct_force + direct_neigh),
+            1e3 * direct_force,
+            1e3 * direct_neigh);
+        printf("Neighbor lists on the final positions: %.3f ms per step (force %.3f "
+               "ms, rebuild %.3f ms with a list build of %.3f ms every %d steps)\n",
+            1e3 * (list_force + direct_neigh + list_build / param.reneigh_every),
+            1e3 * list_force,
+            1e3 * (direct_neigh + list_build / param.reneigh_every),
+            1e3 * list_build,
+            param.reneigh_every);
+        printf(HLINE);
+    }
+
+    if (param.page_report) {
+        printPageReport(&atom, &neighbor);
+        printf(HLINE);
+    }
+
+    printPbcReport(&param, &atom, &neighbor);
+    printf(HLINE);
+
+#ifdef CACHE_SIM
+    printCacheSim();
     printf(HLINE);
+#endif
 
 #ifdef _OPENMP
     int nthreads  = 0;
@@ -351,9 +680,67 @@ int main(int argc, char** argv)
 
     printf("Performance: %.2f million atom updates per second\n",
         1e-6 * (double)atom.Natoms * param.ntimes / timer[TOTAL]);
+    printf("Performance: %.4f %s/day\n",
+        getTimePerDay(&param, timer[TOTAL]),
+        getTimePerDayUnit(&param));
+    printEnergy(timer, atom.Natoms, param.ntimes);
+
+    reportBuildConfig(&param);
+#ifdef _OPENMP
+    reportSection("openmp");
+    reportInt("num_threads", nthreads);
+    reportString("schedule", schedType);
+    reportInt("chunk_size", chunkSize);
+#endif
+    reportSection("system");
+    reportInt("natoms", atom.Natoms);
+    reportInt("nlocal", atom.Nlocal);
+    reportInt("nghost", atom.Nghost);
+    reportInt("nclusters_local", atom.Nclusters_local);
+    reportInt("nclusters_ghost", atom.Nclusters_ghost);
+    reportInt("bins_occupied", getOccupiedBins());
+    reportInt("bins_total", getTotalBins());
+    reportReal("binning_mb", getBinningMemory());
+    reportString("pbc", PBC_MODE);
+    reportReal("ghost_mb", getGhostMemory(atom.Nclusters_ghost));
+    reportReal("segment_mb", getSegmentMemory(&atom));
+    reportReal("single_atoms_released_mb", getSingleAtomMemory(&atom));
+    reportReal("avg_segments", getAvgSegments(&atom, &neighbor));
+    reportReal("pbc_time",
+        getRegionTime(REGION_PBC) + getRegionTime(REGION_REBUILD_GHOSTS));
+#ifdef PBC_SHIFTS
+    reportInt("ghost_avoided", ghost_avoided);
+    reportReal("ghost_avoided_mb", getGhostMemory(ghost_avoided));
+    reportReal("ghost_update_avoided", ghost_update_avoided);
+#endif
+    reportTypeStencil(getTypeStencil());
+    reportSuperClusters();
+    reportClusterShape();
+    reportBalance(&neighbor.balance);
+    if (param.force_direct) {
+        reportSection("direct_force");
+        reportReal("direct_force_per_step", direct_force);
+        reportReal("direct_neigh_per_step", direct_neigh);
+        reportReal("list_force_per_step", list_force);
+        reportReal("list_build", list_build);
+        reportReal("list_per_step",
+            list_force + direct_neigh + list_build / param.reneigh_every);
+    }
+    reportSection("timers");
+    reportReal("total", timer[TOTAL]);
+    reportReal("force", timer[FORCE]);
+    reportReal("neigh", timer[NEIGH]);
+    reportReal("rest", timer[TOTAL] - timer[FORCE] - timer[NEIGH]);
+    reportReal("setup", timer[SETUP]);
+    reportRegions();
+    reportSection("performance");
+    reportReal("maups", 1e-6 * (double)atom.Natoms * param.ntimes / timer[TOTAL]);
+    reportTimePerDay(&param, timer[TOTAL]);
+    reportEnergy(timer, atom.Natoms, param.ntimes);
 #ifdef COMPUTE_STATS
     displayStatistics(&atom, &param, &stats, timer);
 #endif
+    writeReport(&param);
     LIKWID_MARKER_CLOSE;
     return EXIT_SUCCESS;
 }
@@ -7,16 +7,37 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <allocate.h>
 #include <atom.h>
+#include <cellgrid.h>
 #include <force.h>
 #include <neighbor.h>
 #include <parameter.h>
+#include <report.h>
 #include <simd.h>
+#include <timing.h>
+#include <typestencil.h>
 #include <util.h>
 
 #define SMALL  1.0e-6
 #define FACTOR 0.999
+// Force work of an i-cluster besides its list entries, in list entries
+#define ICLUSTER_COST 2
+
+// Atoms live only in the cluster arrays, they are addressed by their slot
+// (CI_SCALAR_BASE_INDEX(ci) + cii) and this gives the matching vector index
+#define SLOT_VECTOR_INDEX(s) (CI_VECTOR_BASE_INDEX((s) / CLUSTER_M) + (s) % CLUSTER_M)
+
+// Type a slot is binned by. If the type stencil splits the bins by atom type every
+// cluster holds atoms of a single type and the type of its first slot is the type
+// of the cluster, otherwise clusters mix types and all of them have bin type 0
+#ifdef ONE_ATOM_TYPE
+#define BIN_TYPE(atom, s) 0
+#else
+#define BIN_TYPE(atom, s) ((tstencil.ntypes > 1) ? (atom)->cl_t[s] : 0)
+#endif
 
 #ifdef CUDA_TARGET
 BuildNeighborFunction buildNeighbor = buildNeighborCPU;
@@ -29,20 +50,61 @@ static MD_FLOAT xprd, yprd, zprd;
 static MD_FLOAT bininvx, bininvy;
 static int mbinxlo, mbinylo;
 static int nbinx, nbiny;
-static int mbinx, mbiny; // n bins in x, y
-static int* bincount;
-static int* bins;
-static int* bin_nclusters;
-static int* bin_clusters;
-static int mbins;            // total number of bins
-static int atoms_per_bin;    // max atoms per bin
-static int clusters_per_bin; // max clusters per bin
+static int mbinx, mbiny;      // n bins in x, y
+static CellGrid atom_grid;    // occupied (bin, type) cells of the local atom slots
+static CellGrid cluster_grid; // occupied (bin, type) cells of the j-clusters
 static MD_FLOAT cutneigh;
 static MD_FLOAT cutneighsq; // neighbor cutoff squared
 static int nmax;
-static int nstencil; // # of bins in stencil
-static int* stencil; // stencil list of bin offsets
+static int nstencil;  // # of bins in stencil
+static int* stencil;  // stencil list of bin offsets
+static int* stencilx; // x and y bin offsets of the stencil entries
+static int* stencily;
+static MD_FLOAT* stencil_distsq; // distance of each stencil bin to the center bin
+static TypeStencil tstencil;      // stencil entries per type pair
+static int tstencil_valid;
+static MD_FLOAT* type_rbbsq; // bounding box distance per type pair below which
+                             // every atom pair is within the cutoff
 static MD_FLOAT binsizex, binsizey;
+static int* slot_dest; // destination slot of each atom when rebuilding clusters
+static int nslots_max;
+static int super_size;   // z-adjacent clusters per super-cluster, 0 disables them
+static Cluster* jsupers; // box of each j-super-cluster, at the item of its first cluster
+static int jsupers_max;
+static char* super_class; // class of each j-super-cluster walked by an i-super-cluster
+static int super_class_max;
+static long long super_pairs[3]; // super-cluster pairs per class, summed over all builds
+static long long super_decided;  // cluster pairs decided by their super-cluster pair
+static double super_build[2];    // list build time with and without super-clusters
+
+// Sort key of an atom slot when ordering the atoms of a bin into clusters
+typedef struct {
+    double key;
+    int slot;
+} ShapeKey;
+
+static int cluster_shape; // order of the atoms of a bin that are cut into clusters
+static int shape_split;   // sub-columns per bin edge the shape is sized for
+static ShapeKey* shape_keys;
+static int shape_keys_max;
+static double shape_volume[2];      // bounding box volume of the i- and j-clusters
+static long long shape_clusters[2]; // and their number, summed over all builds
+// Atom pairs within the cutoff and pair lanes of the final lists
+static long long shape_inside, shape_lanes;
+
+enum { SUPER_OUT = 0, SUPER_IN, SUPER_BOUNDARY };
+#ifdef PBC_SHIFTS
+static int* shift_buf; // shift of each list entry before sorting by shift
+static int* sort_buf;
+static int sort_max;
+#define STENCIL_ZIMAGES 3
+#define SET_SHIFT(k, s) (shift_buf[k] = (s))
+#define GET_SHIFT(k)    (shift_buf[k])
+#else
+#define STENCIL_ZIMAGES 1
+#define SET_SHIFT(k, s)
+#define GET_SHIFT(k) CENTER_SHIFT
+#endif
 
 static int coord2bin(MD_FLOAT, MD_FLOAT);
 static MD_FLOAT bindist(int, int);
@@ -56,19 +118,47 @@ void initNeighbor(Neighbor* neighbor, Parameter* param)
     zprd                      = param->nz * param->lattice;
     cutneigh                  = param->cutneigh;
     nmax                      = 0;
-    atoms_per_bin             = 8;
-    clusters_per_bin          = (atoms_per_bin / CLUSTER_M) + 10;
     stencil                   = NULL;
-    bins                      = NULL;
-    bincount                  = NULL;
-    bin_clusters              = NULL;
-    bin_nclusters             = NULL;
+    stencilx                  = NULL;
+    stencily                  = NULL;
+    stencil_distsq            = NULL;
+    type_rbbsq                = NULL;
+    tstencil_valid            = 0;
+    slot_dest                 = NULL;
+    nslots_max                = 0;
+    super_size                = param->super_cluster;
+    jsupers                   = NULL;
+    jsupers_max               = 0;
+    super_class               = NULL;
+    super_class_max           = 0;
+    super_decided             = 0;
+    cluster_shape             = param->cluster_shape;
+    shape_split               = (cluster_shape == SHAPE_Z) ? 1 : 2;
+    shape_keys                = NULL;
+    shape_keys_max            = 0;
+    shape_inside              = 0;
+    shape_lanes               = 0;
     neighbor->half_neigh      = param->half_neigh;
     neighbor->maxneighs       = 150;
     neighbor->numneigh        = NULL;
     neighbor->numneigh_masked = NULL;
     neighbor->neighbors       = NULL;
     neighbor->neighbors_imask = NULL;
+    neighbor->numsegments     = NULL;
+    neighbor->segments        = NULL;
+    initBalance(&neighbor->balance, param->force_balance);
+    memset(super_pairs, 0, sizeof(super_pairs));
+    memset(super_build, 0, sizeof(super_build));
+    memset(shape_volume, 0, sizeof(shape_volume));
+    memset(shape_clusters, 0, sizeof(shape_clusters));
+    initCellGrid(&atom_grid);
+    initCellGrid(&cluster_grid);
+    initTypeStencil(&tstencil);
+#ifdef PBC_SHIFTS
+    shift_buf = NULL;
+    sort_buf  = NULL;
+    sort_max  = 0;
+#endif
 }
 
 void setupNeighbor(Parameter* param, Atom* atom)
@@ -93,7 +183,8 @@ void setupNeighbor(Parameter* param, Atom* atom)
 
     MD_FLOAT atom_density = ((MD_FLOAT)(atom->Nlocal)) /
                             ((xhi - xlo) * (yhi - ylo) * (zhi - zlo));
-    MD_FLOAT atoms_in_cell = MAX(CLUSTER_M, CLUSTER_N);
+    // The subcolumn and morton shapes cut bins of shape_split x shape_split columns
+    MD_FLOAT atoms_in_cell = MAX(CLUSTER_M, CLUSTER_N) * shape_split * shape_split;
     MD_FLOAT targetsizex   = cbrt(atoms_in_cell / atom_density);
     MD_FLOAT targetsizey   = cbrt(atoms_in_cell / atom_density);
     nbinx                  = MAX(1, (int)ceil((xhi - xlo) / targetsizex));
@@ -133,43 +224,49 @@ void setupNeighbor(Parameter* param, Atom* atom)
     if (nextx * binsizex < FACTOR * cutneigh) nextx++;
     if (nexty * binsizey < FACTOR * cutneigh) nexty++;
 
+#ifdef PBC_SHIFTS
+    // Only the nearest periodic images are searched
+    if (xprd < cutneigh || yprd < cutneigh || zprd < cutneigh || nextx > nbinx ||
+        nexty > nbiny) {
+        fprintf(stderr,
+            "Error: PBC_SHIFTS requires a box of at least the neighbor cutoff (%f) in "
+            "each dimension!\n",
+            cutneigh);
+        exit(-1);
+    }
+#endif
+
     if (stencil) {
         free(stencil);
+        free(stencilx);
+        free(stencily);
+        free(stencil_distsq);
     }
-    stencil  = (int*)malloc((2 * nexty + 1) * (2 * nextx + 1) * sizeof(int));
+    stencil        = (int*)malloc((2 * nexty + 1) * (2 * nextx + 1) * sizeof(int));
+    stencilx       = (int*)malloc((2 * nexty + 1) * (2 * nextx + 1) * sizeof(int));
+    stencily       = (int*)malloc((2 * nexty + 1) * (2 * nextx + 1) * sizeof(int));
+    stencil_distsq = (MD_FLOAT*)malloc(
+        (2 * nexty + 1) * (2 * nextx + 1) * sizeof(MD_FLOAT));
     nstencil = 0;
 
     for (int j = -nexty; j <= nexty; j++) {
         for (int i = -nextx; i <= nextx; i++) {
             if (bindist(i, j) < cutneighsq) {
-                stencil[nstencil++] = j * mbinx + i;
+                stencil_distsq[nstencil] = bindist(i, j);
+                stencilx[nstencil]       = i;
+                stencily[nstencil]       = j;
+                stencil[nstencil++]      = j * mbinx + i;
             }
         }
     }
 
-    if (bincount) {
-        free(bincount);
-    }
-    if (bins) {
-        free(bins);
-    }
-    if (bin_nclusters) {
-        free(bin_nclusters);
-    }
-    if (bin_clusters) {
-        free(bin_clusters);
-    }
-    mbins         = mbinx * mbiny;
-    bincount      = (int*)malloc(mbins * sizeof(int));
-    bins          = (int*)malloc(mbins * atoms_per_bin * sizeof(int));
-    bin_nclusters = (int*)malloc(mbins * sizeof(int));
-    bin_clusters  = (int*)malloc(mbins * clusters_per_bin * sizeof(int));
+    tstencil_valid = 0;
 
     /*
     DEBUG_MESSAGE("lo, hi = (%e, %e, %e), (%e, %e, %e)\n", xlo, ylo, zlo, xhi, yhi, zhi);
     DEBUG_MESSAGE("binsize = %e, %e\n", binsizex, binsizey);
     DEBUG_MESSAGE("mbin lo, hi = (%d, %d), (%d, %d)\n", mbinxlo, mbinylo, mbinxhi,
-    mbinyhi); DEBUG_MESSAGE("mbins = %d (%d x %d)\n", mbins, mbinx, mbiny);
+    mbinyhi); DEBUG_MESSAGE("mbins = %d (%d x %d)\n", mbinx * mbiny, mbinx, mbiny);
     DEBUG_MESSAGE("nextx = %d, nexty = %d\n", nextx, nexty);
     */
 }
@@ -239,44 +336,494 @@ static unsigned int get_imask_simd_j8(int rdiag, int ci, int cj)
 #error "Invalid cluster configuration"
 #endif
 
+/* in half lists a pair is kept by the i-cluster with the lower j-cluster index;
+ * a cluster and its own periodic image (ci, ci, s) mirror (ci, ci, -s), so only
+ * the upper half of the shifts is kept for them */
+static inline int isHalfPair(int ci, int cj, int shift)
+{
+    if (CJ0_FROM_CI(ci) > cj) {
+        return 0;
+    }
+
+#ifdef PBC_SHIFTS
+    if ((cj == CJ0_FROM_CI(ci) || cj == CJ1_FROM_CI(ci)) && shift < CENTER_SHIFT) {
+        return 0;
+    }
+#endif
+
+    return 1;
+}
+
+#ifdef PBC_SHIFTS
+/* map stencil entry k around ibin into the interior bins, a stencil bin that
+ * leaves the box is replaced by its periodic image on the other side */
+static int wrapStencilBin(int ibin, int k, int* sx, int* sy)
+{
+    int ix = (ibin - 1) % mbinx + stencilx[k];
+    int iy = (ibin - 1) / mbinx + stencily[k];
+
+    *sx = 0;
+    *sy = 0;
+    if (ix < -mbinxlo) {
+        ix += nbinx;
+        *sx = -1;
+    } else if (ix >= nbinx - mbinxlo) {
+        ix -= nbinx;
+        *sx = 1;
+    }
+
+    if (iy < -mbinylo) {
+        iy += nbiny;
+        *sy = -1;
+    } else if (iy >= nbiny - mbinylo) {
+        iy -= nbiny;
+        *sy = 1;
+    }
+
+    return iy * mbinx + ix + 1;
+}
+
+/* counting sort of the unmasked entries [nmasked, n) by their shift, the center
+ * shift goes first so it continues the masked entries; returns the number of
+ * segments */
+static int sortByShift(int* neighptr, int n, int nmasked, NeighborSegment* segments)
+{
+    int count[NUM_SHIFTS] = { 0 };
+    int start[NUM_SHIFTS];
+    int nsegments = 0;
+    int pos       = nmasked;
+
+    for (int k = nmasked; k < n; k++) {
+        count[shift_buf[k]]++;
+        sort_buf[k] = neighptr[k];
+    }
+
+    for (int o = 0; o < NUM_SHIFTS; o++) {
+        int shift = (o == 0) ? CENTER_SHIFT : ((o <= CENTER_SHIFT) ? o - 1 : o);
+
+        start[shift] = pos;
+        pos += count[shift];
+        if (count[shift] > 0 || (shift == CENTER_SHIFT && nmasked > 0)) {
+            segments[nsegments].shift = shift;
+            segments[nsegments].end   = pos;
+            nsegments++;
+        }
+    }
+
+    for (int k = nmasked; k < n; k++) {
+        neighptr[start[shift_buf[k]]++] = sort_buf[k];
+    }
+
+    return nsegments;
+}
+#endif
+
+/* turn every list into a single CENTER_SHIFT segment, for the drivers that
+ * create or load cluster pair lists without buildNeighbor */
+void setCenterSegments(Atom* atom, Neighbor* neighbor)
+{
+    if (neighbor->numsegments) deallocate(neighbor->numsegments);
+    if (neighbor->segments) deallocate(neighbor->segments);
+    neighbor->numsegments = (int*)allocate(ALIGNMENT, atom->Nclusters_max * sizeof(int));
+    neighbor->segments    = (NeighborSegment*)allocate(ALIGNMENT,
+        SEGMENT_OFFSET(atom->Nclusters_max) * sizeof(NeighborSegment));
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        NeighborSegment* segment  = &neighbor->segments[SEGMENT_OFFSET(ci)];
+        segment->shift            = CENTER_SHIFT;
+        segment->end              = neighbor->numneigh[ci];
+        neighbor->numsegments[ci] = 1;
+    }
+}
+
+int getOccupiedBins(void) { return cluster_grid.ncells; }
+
+int getTotalBins(void) { return mbinx * mbiny * MAX(tstencil.ntypes, 1); }
+
+const TypeStencil* getTypeStencil(void) { return &tstencil; }
+
+double getBinningMemory(void)
+{
+    return 1e-6 * (double)(getCellGridMemory(&atom_grid) +
+                           getCellGridMemory(&cluster_grid));
+}
+
+static void setupStencilTypes(Atom* atom)
+{
+    MD_FLOAT bbx = 0.5 * (binsizex + binsizex) / shape_split;
+    MD_FLOAT bby = 0.5 * (binsizey + binsizey) / shape_split;
+
+#ifdef ONE_ATOM_TYPE
+    setupTypeStencil(&tstencil, 1, &cutneighsq, nstencil, stencil_distsq);
+#else
+    setupTypeStencil(&tstencil, atom->ntypes, atom->cutneighsq, nstencil, stencil_distsq);
+#endif
+    free(type_rbbsq);
+    type_rbbsq = (MD_FLOAT*)malloc(tstencil.ntypes * tstencil.ntypes * sizeof(MD_FLOAT));
+    for (int tp = 0; tp < tstencil.ntypes * tstencil.ntypes; tp++) {
+        MD_FLOAT rbb = MAX(0.0,
+            sqrt(tstencil.cutneighsq[tp]) - 0.5 * sqrt(bbx * bbx + bby * bby));
+        type_rbbsq[tp] = rbb * rbb;
+    }
+
+    tstencil_valid = 1;
+}
+
+static void addClusterBox(Cluster* box, const Cluster* cluster)
+{
+    box->bbminx = MIN(box->bbminx, cluster->bbminx);
+    box->bbmaxx = MAX(box->bbmaxx, cluster->bbmaxx);
+    box->bbminy = MIN(box->bbminy, cluster->bbminy);
+    box->bbmaxy = MAX(box->bbmaxy, cluster->bbmaxy);
+    box->bbminz = MIN(box->bbminz, cluster->bbminz);
+    box->bbmaxz = MAX(box->bbmaxz, cluster->bbmaxz);
+}
+
+// List builds timed with and without super-clusters at the end of the run
+#define SUPER_COMPARE_BUILDS 5
+// Relative margin of the SUPER_IN test for the rounding of the atom distances
+#define SUPER_IN_MARGIN 1e-5
+
+/* SUPER_OUT if no pair of member clusters can be within the cutoff and SUPER_IN if
+ * the farthest atoms of the two boxes are within it, so every atom pair is and the
+ * cluster test would accept every cluster pair. The minimum distance is summed in
+ * the order of the cluster test and the maximum one kept a margin below the cutoff,
+ * so the bounds also hold after rounding and the lists do not change */
+static int classifySuperPair(const Cluster* is,
+    const Cluster* js,
+    MD_FLOAT jshx,
+    MD_FLOAT jshy,
+    MD_FLOAT jshz,
+    MD_FLOAT cutsq)
+{
+    MD_FLOAT jmin[3] = { js->bbminz + jshz, js->bbminy + jshy, js->bbminx + jshx };
+    MD_FLOAT jmax[3] = { js->bbmaxz + jshz, js->bbmaxy + jshy, js->bbmaxx + jshx };
+    MD_FLOAT imin[3] = { is->bbminz, is->bbminy, is->bbminx };
+    MD_FLOAT imax[3] = { is->bbmaxz, is->bbmaxy, is->bbmaxx };
+    MD_FLOAT dmin_sq = 0.0, dmax_sq = 0.0;
+
+    for (int d = 0; d < 3; d++) {
+        MD_FLOAT dmin = MAX(MAX(imin[d] - jmax[d], jmin[d] - imax[d]), 0.0);
+        MD_FLOAT dmax = MAX(imax[d] - jmin[d], jmax[d] - imin[d]);
+        dmin_sq += dmin * dmin;
+        dmax_sq += dmax * dmax;
+    }
+
+    if (dmin_sq >= cutsq) {
+        return SUPER_OUT;
+    }
+
+    return (dmax_sq < cutsq * (1.0 - SUPER_IN_MARGIN)) ? SUPER_IN : SUPER_BOUNDARY;
+}
+
+/* the j-super-clusters are runs of super_size clusters of an occupied bin, which
+ * are sorted by z, so they stay adjacent in space */
+static void buildSuperClusters(Atom* atom)
+{
+    if (super_size <= 0) {
+        return;
+    }
+
+    if (cluster_grid.maxitems > jsupers_max) {
+        if (jsupers) deallocate(jsupers);
+        jsupers_max = cluster_grid.maxitems;
+        jsupers     = (Cluster*)allocate(ALIGNMENT, jsupers_max * sizeof(Cluster));
+    }
+
+    for (int bin = 0; bin < cluster_grid.ncells; bin++) {
+        const int end = cluster_grid.start[bin + 1];
+
+        for (int s = cluster_grid.start[bin]; s < end; s += super_size) {
+            jsupers[s] = atom->jclusters[cluster_grid.items[s]];
+            for (int m = s + 1; m < MIN(s + super_size, end); m++) {
+                addClusterBox(&jsupers[s], &atom->jclusters[cluster_grid.items[m]]);
+            }
+        }
+    }
+}
+
+void printSuperClusters(void)
+{
+    const long long npairs = super_pairs[SUPER_OUT] + super_pairs[SUPER_IN] +
+                             super_pairs[SUPER_BOUNDARY];
+
+    if (npairs == 0) {
+        return;
+    }
+
+    printf("Super-clusters: %d clusters, %lld pairs (%.1f%% out, %.1f%% in, %.1f%% "
+           "boundary), %lld cluster pairs decided without a cluster test\n",
+        super_size,
+        npairs,
+        100.0 * super_pairs[SUPER_OUT] / npairs,
+        100.0 * super_pairs[SUPER_IN] / npairs,
+        100.0 * super_pairs[SUPER_BOUNDARY] / npairs,
+        super_decided);
+
+    if (super_build[1] > 0.0) {
+        printf("Super-cluster list build on the final positions: %.3f ms against %.3f "
+               "ms without super-clusters (%+.1f%%)\n",
+            1e3 * super_build[0],
+            1e3 * super_build[1],
+            100.0 * (super_build[0] / super_build[1] - 1.0));
+    }
+}
+
+void reportSuperClusters(void)
+{
+    if (super_size <= 0) {
+        return;
+    }
+
+    reportSection("super_clusters");
+    reportInt("super_size", super_size);
+    reportInt("pairs_out", super_pairs[SUPER_OUT]);
+    reportInt("pairs_in", super_pairs[SUPER_IN]);
+    reportInt("pairs_boundary", super_pairs[SUPER_BOUNDARY]);
+    reportInt("decided", super_decided);
+    reportReal("build", super_build[0]);
+    reportReal("build_without", super_build[1]);
+}
+
+/* mean time of SUPER_COMPARE_BUILDS list builds on the current positions with and
+ * without super-clusters, the builds without them come first so the lists end up
+ * as before. The statistics of these builds are not kept */
+void timeSuperClusters(Atom* atom, Neighbor* neighbor)
+{
+    const int npairs  = tstencil.ntypes * tstencil.ntypes;
+    const int size    = super_size;
+    long long* tested = (long long*)malloc(npairs * sizeof(long long));
+    long long* kept   = (long long*)malloc(npairs * sizeof(long long));
+    long long pairs[3], decided = super_decided;
+    Balance balance = neighbor->balance;
+
+    if (size <= 0) {
+        free(tested);
+        free(kept);
+        return;
+    }
+
+    memcpy(pairs, super_pairs, sizeof(super_pairs));
+    memcpy(tested, tstencil.tested, npairs * sizeof(long long));
+    memcpy(kept, tstencil.kept, npairs * sizeof(long long));
+
+    for (int with = 0; with <= 1; with++) {
+        double start = getTimeStamp();
+
+        super_size = with ? size : 0;
+        for (int b = 0; b < SUPER_COMPARE_BUILDS; b++) {
+            buildNeighbor(atom, neighbor);
+        }
+
+        super_build[1 - with] = (getTimeStamp() - start) / SUPER_COMPARE_BUILDS;
+    }
+
+    memcpy(super_pairs, pairs, sizeof(super_pairs));
+    memcpy(tstencil.tested, tested, npairs * sizeof(long long));
+    memcpy(tstencil.kept, kept, npairs * sizeof(long long));
+    super_decided                        = decided;
+    neighbor->balance.nbuilds            = balance.nbuilds;
+    neighbor->balance.imbalance_static   = balance.imbalance_static;
+    neighbor->balance.imbalance_balanced = balance.imbalance_balanced;
+    free(tested);
+    free(kept);
+}
+
+static double clusterVolume(const Cluster* cluster)
+{
+    return (cluster->bbmaxx - cluster->bbminx) * (cluster->bbmaxy - cluster->bbminy) *
+           (cluster->bbmaxz - cluster->bbminz);
+}
+
+// Add the bounding boxes of the local i- and j-clusters of this build to the stats
+static void recordClusterShape(Atom* atom)
+{
+    const int ncj = get_ncj_from_nci(atom->Nclusters_local);
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        if (atom->iclusters[ci].natoms > 0) {
+            shape_volume[0] += clusterVolume(&atom->iclusters[ci]);
+            shape_clusters[0]++;
+        }
+    }
+
+    for (int cj = 0; cj < ncj; cj++) {
+        if (atom->jclusters[cj].natoms > 0) {
+            shape_volume[1] += clusterVolume(&atom->jclusters[cj]);
+            shape_clusters[1]++;
+        }
+    }
+}
+
+/* count the atom pairs of the lists within the force cutoff of their types, against
+ * the CLUSTER_M x CLUSTER_N pairs the kernels compute for every list entry. Padding
+ * atoms are at infinity and the self pairs at zero distance, neither is counted */
+static void countPairsInCutoff(Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    long long inside = 0, lanes = 0;
+
+#pragma omp parallel for reduction(+ : inside, lanes)
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        const MD_FLOAT* ci_x = &atom->cl_x[CI_VECTOR_BASE_INDEX(ci)];
+        const int* neighs    = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
+        const MD_FLOAT* sh   = atom->shiftvec[CENTER_SHIFT];
+#ifdef PBC_SHIFTS
+        NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+        int seg = -1, seg_end = 0;
+#endif
+
+        for (int k = 0; k < neighbor->numneigh[ci]; k++) {
+#ifdef PBC_SHIFTS
+            while (k >= seg_end) {
+                seg++;
+                seg_end = segments[seg].end;
+                sh      = atom->shiftvec[segments[seg].shift];
+            }
+#endif
+            const int cj         = neighs[k];
+            const MD_FLOAT* cj_x = &atom->cl_x[CJ_VECTOR_BASE_INDEX(cj)];
+
+            for (int cii = 0; cii < CLUSTER_M; cii++) {
+                for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
+                    MD_FLOAT delx = ci_x[CL_X_OFFSET + cii] - sh[0] -
+                                    cj_x[CL_X_OFFSET + cjj];
+                    MD_FLOAT dely = ci_x[CL_Y_OFFSET + cii] - sh[1] -
+                                    cj_x[CL_Y_OFFSET + cjj];
+                    MD_FLOAT delz = ci_x[CL_Z_OFFSET + cii] - sh[2] -
+                                    cj_x[CL_Z_OFFSET + cjj];
+                    MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
+#ifdef ONE_ATOM_TYPE
+                    MD_FLOAT cutforcesq = param->cutforce * param->cutforce;
+#else
+                    int ti              = atom->cl_t[CI_SCALAR_BASE_INDEX(ci) + cii];
+                    int tj              = atom->cl_t[CJ_SCALAR_BASE_INDEX(cj) + cjj];
+                    MD_FLOAT cutforcesq = atom->cutforcesq[ti * atom->ntypes + tj];
+#endif
+
+                    if (rsq > 0.0 && rsq < cutforcesq) {
+                        inside++;
+                    }
+                }
+            }
+
+            lanes += CLUSTER_M * CLUSTER_N;
+        }
+    }
+
+    shape_inside = inside;
+    shape_lanes  = lanes;
+}
+
+// The direct force mode has no lists to count the pairs in the cutoff
+void printClusterShape(Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    printf("Cluster shape: %s, mean bounding box volume %.4f (i-clusters) %.4f "
+           "(j-clusters)",
+        shape2str(cluster_shape),
+        (shape_clusters[0] > 0) ? shape_volume[0] / shape_clusters[0] : 0.0,
+        (shape_clusters[1] > 0) ? shape_volume[1] / shape_clusters[1] : 0.0);
+    if (!param->force_direct) {
+        countPairsInCutoff(param, atom, neighbor);
+        printf(", %.2f%% of the pairs of the final lists in the cutoff",
+            (shape_lanes > 0) ? 100.0 * shape_inside / shape_lanes : 0.0);
+    }
+
+    printf("\n");
+}
+
+// Uses the pair counts of printClusterShape
+void reportClusterShape(void)
+{
+    reportSection("cluster_shape");
+    reportString("shape", shape2str(cluster_shape));
+    reportReal("ivolume",
+        (shape_clusters[0] > 0) ? shape_volume[0] / shape_clusters[0] : 0.0);
+    reportReal("jvolume",
+        (shape_clusters[1] > 0) ? shape_volume[1] / shape_clusters[1] : 0.0);
+    reportInt("pairs_inside", shape_inside);
+    reportInt("pairs_computed", shape_lanes);
+}
+
+/* split the i-clusters into one contiguous range per thread with about the same
+ * force work of the current lists, a masked entry counts twice since the kernels
+ * load and apply its mask */
+static void balanceNeighbor(Atom* atom, Neighbor* neighbor)
+{
+    Balance* b = &neighbor->balance;
+
+    if (!b->enabled) {
+        return;
+    }
+
+    reserveBalance(b, atom->Nclusters_local);
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        b->cost[ci] = neighbor->numneigh[ci] + neighbor->numneigh_masked[ci] +
+                      ICLUSTER_COST;
+    }
+
+    buildBalance(b, atom->Nclusters_local);
+}
+
 void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 {
     DEBUG_MESSAGE("buildNeighbor start\n");
 
     /* extend atom arrays if necessary */
     if (atom->Nclusters_local > nmax) {
-        nmax = atom->Nclusters_local;
-        if (neighbor->numneigh) free(neighbor->numneigh);
-        if (neighbor->numneigh_masked) free(neighbor->numneigh_masked);
-        if (neighbor->neighbors) free(neighbor->neighbors);
-        if (neighbor->neighbors_imask) free(neighbor->neighbors_imask);
-        neighbor->numneigh        = (int*)malloc(nmax * sizeof(int));
-        neighbor->numneigh_masked = (int*)malloc(nmax * sizeof(int));
-        neighbor->neighbors = (int*)malloc(nmax * neighbor->maxneighs * sizeof(int));
-        neighbor->neighbors_imask = (unsigned int*)malloc(
-            nmax * neighbor->maxneighs * sizeof(unsigned int));
-    }
-
-    MD_FLOAT bbx    = 0.5 * (binsizex + binsizex);
-    MD_FLOAT bby    = 0.5 * (binsizey + binsizey);
-    MD_FLOAT rbb_sq = MAX(0.0, cutneigh - 0.5 * sqrt(bbx * bbx + bby * bby));
-    rbb_sq          = rbb_sq * rbb_sq;
-    int resize      = 1;
+        nmax = MAX(atom->Nclusters_local, nmax + nmax / 2);
+        if (neighbor->numneigh) deallocate(neighbor->numneigh);
+        if (neighbor->numneigh_masked) deallocate(neighbor->numneigh_masked);
+        if (neighbor->neighbors) deallocate(neighbor->neighbors);
+        if (neighbor->neighbors_imask) deallocate(neighbor->neighbors_imask);
+        if (neighbor->numsegments) deallocate(neighbor->numsegments);
+        if (neighbor->segments) deallocate(neighbor->segments);
+        neighbor->numneigh = (int*)allocate(ALIGNMENT, nmax * sizeof(int));
+        neighbor->numneigh_masked = (int*)allocate(ALIGNMENT, nmax * sizeof(int));
+        neighbor->neighbors = (int*)allocate(ALIGNMENT,
+            (MD_INDEX)nmax * neighbor->maxneighs * sizeof(int));
+        neighbor->neighbors_imask = (unsigned int*)allocate(ALIGNMENT,
+            (MD_INDEX)nmax * neighbor->maxneighs * sizeof(unsigned int));
+        neighbor->numsegments = (int*)allocate(ALIGNMENT, nmax * sizeof(int));
+        neighbor->segments    = (NeighborSegment*)allocate(ALIGNMENT,
+            SEGMENT_OFFSET(nmax) * sizeof(NeighborSegment));
+    }
+
+    const int nt = tstencil.ntypes;
+    int resize   = 1;
 
     /* loop over each atom, storing neighbors */
     while (resize) {
-        int new_maxneighs = neighbor->maxneighs;
-        resize            = 0;
+        int new_maxneighs        = neighbor->maxneighs;
+        int isuper_end           = 0;
+        long long build_super[3] = { 0 };
+        long long build_decided  = 0;
+        Cluster isuper           = { 0 };
+        resize                   = 0;
+        startTypeStencilCount(&tstencil);
+
+#ifdef PBC_SHIFTS
+        if (neighbor->maxneighs > sort_max) {
+            deallocate(shift_buf);
+            deallocate(sort_buf);
+            sort_max  = neighbor->maxneighs;
+            shift_buf = (int*)allocate(ALIGNMENT, sort_max * sizeof(int));
+            sort_buf  = (int*)allocate(ALIGNMENT, sort_max * sizeof(int));
+        }
+#endif
 
         for (int ci = 0; ci < atom->Nclusters_local; ci++) {
-            int ci_cj0    = CJ0_FROM_CI(ci);
-            int* neighptr = &(neighbor->neighbors[ci * neighbor->maxneighs]);
+            int* neighptr                = &(
+                neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)]);
             unsigned int* neighptr_imask = &(
-                neighbor->neighbors_imask[ci * neighbor->maxneighs]);
-            int n = 0, nmasked = 0;
+                neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)]);
+            NeighborSegment* segments = &neighbor->segments[SEGMENT_OFFSET(ci)];
+            int n = 0, nmasked = 0, nsegments = 1;
             int ibin        = atom->icluster_bin[ci];
             int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
             MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+            const int ti    = BIN_TYPE(atom, CI_SCALAR_BASE_INDEX(ci));
+            const int* ent  = &tstencil.entry[tstencil.start[ti]];
+            const int nent  = tstencil.start[ti + 1] - tstencil.start[ti];
 
 #ifndef ONE_ATOM_TYPE
             int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
@@ -289,6 +836,23 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
             MD_FLOAT ibb_ymax = atom->iclusters[ci].bbmaxy;
             MD_FLOAT ibb_zmin = atom->iclusters[ci].bbminz;
             MD_FLOAT ibb_zmax = atom->iclusters[ci].bbmaxz;
+            int classify      = (ci == isuper_end);
+            int q             = 0;
+
+            // An i-super-cluster is a run of up to super_size i-clusters of the same
+            // bin and type, all of them walk the same stencil bins. Empty clusters
+            // are left alone, their inverted box would let the others accept them
+            if (classify) {
+                isuper     = atom->iclusters[ci];
+                isuper_end = ci + 1;
+                while (isuper_end < atom->Nclusters_local &&
+                       isuper_end - ci < super_size && isuper.natoms > 0 &&
+                       atom->iclusters[isuper_end].natoms > 0 &&
+                       atom->icluster_bin[isuper_end] == ibin &&
+                       BIN_TYPE(atom, CI_SCALAR_BASE_INDEX(isuper_end)) == ti) {
+                    addClusterBox(&isuper, &atom->iclusters[isuper_end++]);
+                }
+            }
 
 #if defined(CLUSTERPAIR_KERNEL_2XNN)
             MD_SIMD_FLOAT xi0_tmp = simd_real_load_h_dual(&ci_x[CL_X_OFFSET + 0]);
@@ -330,47 +894,88 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 
 #endif
 
-            for (int k = 0; k < nstencil; k++) {
-                int jbin     = ibin + stencil[k];
-                int* loc_bin = &bin_clusters[jbin * clusters_per_bin];
-                int cj, m = -1;
-                MD_FLOAT jbb_xmin, jbb_xmax, jbb_ymin, jbb_ymax, jbb_zmin, jbb_zmax;
-                const int c = bin_nclusters[jbin];
+            // Only the bins within the cutoff of each type pair are searched, with
+            // shift vectors the stencil is walked once per z image of the box
+            for (int e = 0; e < nent * STENCIL_ZIMAGES; e++) {
+                const int k           = ent[e % nent] / nt + (e / nent) * nstencil;
+                const int tp          = ti * nt + ent[e % nent] % nt;
+                const MD_FLOAT cutsq  = tstencil.cutneighsq[tp];
+                const MD_FLOAT rbb_sq = type_rbbsq[tp];
+                const int n0          = n;
+#ifdef PBC_SHIFTS
+                int sx, sy, sz = k / nstencil - 1;
+                int jbin = wrapStencilBin(ibin, k % nstencil, &sx, &sy);
+                if ((sz < 0 && isuper.bbminz >= cutneigh) ||
+                    (sz > 0 && isuper.bbmaxz < zprd - cutneigh)) {
+                    continue;
+                }
+
+                const int shift = SHIFT_INDEX(sx, sy, sz);
+#else
+                int jbin        = ibin + stencil[k];
+                const int shift = CENTER_SHIFT;
+#endif
+                MD_FLOAT jshx = atom->shiftvec[shift][0];
+                MD_FLOAT jshy = atom->shiftvec[shift][1];
+                MD_FLOAT jshz = atom->shiftvec[shift][2];
+                int c;
+                int* loc_bin    = getCellItems(&cluster_grid, jbin * nt + tp % nt, &c);
+                const int ssize = (super_size > 0) ? super_size : MAX(c, 1);
+
+                // The j-super-clusters of the bin are classified once for all
+                // members of the i-super-cluster, only boundary pairs test clusters
+                for (int s = 0; s < c; s += ssize) {
+                    int cls = SUPER_BOUNDARY;
+
+                    if (super_size > 0) {
+                        if (classify) {
+                            if (q == super_class_max) {
+                                super_class_max = GROW_CAPACITY(q, 1024);
+                                super_class     = (char*)reallocate(super_class,
+                                    ALIGNMENT,
+                                    super_class_max * sizeof(char),
+                                    q * sizeof(char));
+                            }
+
+                            super_class[q] = classifySuperPair(&isuper,
+                                &jsupers[loc_bin - cluster_grid.items + s],
+                                jshx,
+                                jshy,
+                                jshz,
+                                cutsq);
+                            build_super[(int)super_class[q]]++;
+                        }
+
+                        cls = super_class[q++];
+                        if (cls != SUPER_BOUNDARY) {
+                            build_decided += MIN(ssize, c - s);
+                        }
+                    }
+
+                    if (cls == SUPER_OUT) {
+                        continue;
+                    }
 
-                if (c > 0) {
-                    MD_FLOAT dl, dh, dm, dm0, d_bb_sq;
+                    for (int m = s; m < MIN(s + ssize, c); m++) {
+                        const int cj    = loc_bin[m];
+                        int is_neighbor = (cls == SUPER_IN);
 
-                    do {
-                        m++;
-                        cj = loc_bin[m];
-                        if (neighbor->half_neigh && ci_cj0 > cj) {
+                        if (neighbor->half_neigh && !isHalfPair(ci, cj, shift)) {
                             continue;
                         }
-                        jbb_zmin = atom->jclusters[cj].bbminz;
-                        jbb_zmax = atom->jclusters[cj].bbmaxz;
-                        dl       = ibb_zmin - jbb_zmax;
-                        dh       = jbb_zmin - ibb_zmax;
-                        dm       = MAX(dl, dh);
-                        dm0      = MAX(dm, 0.0);
-                        d_bb_sq  = dm0 * dm0;
-                    } while (m + 1 < c && d_bb_sq > cutneighsq);
-
-                    jbb_xmin = atom->jclusters[cj].bbminx;
-                    jbb_xmax = atom->jclusters[cj].bbmaxx;
-                    jbb_ymin = atom->jclusters[cj].bbminy;
-                    jbb_ymax = atom->jclusters[cj].bbmaxy;
-
-                    while (m < c) {
-                        if (!neighbor->half_neigh || ci_cj0 <= cj) {
-                            dl      = ibb_zmin - jbb_zmax;
-                            dh      = jbb_zmin - ibb_zmax;
-                            dm      = MAX(dl, dh);
-                            dm0     = MAX(dm, 0.0);
-                            d_bb_sq = dm0 * dm0;
-
-                            /*if(d_bb_sq > cutneighsq) {
-                                break;
-                            }*/
+
+                        if (cls == SUPER_BOUNDARY) {
+                            MD_FLOAT jbb_xmin = atom->jclusters[cj].bbminx + jshx;
+                            MD_FLOAT jbb_xmax = atom->jclusters[cj].bbmaxx + jshx;
+                            MD_FLOAT jbb_ymin = atom->jclusters[cj].bbminy + jshy;
+                            MD_FLOAT jbb_ymax = atom->jclusters[cj].bbmaxy + jshy;
+                            MD_FLOAT jbb_zmin = atom->jclusters[cj].bbminz + jshz;
+                            MD_FLOAT jbb_zmax = atom->jclusters[cj].bbmaxz + jshz;
+                            MD_FLOAT dl       = ibb_zmin - jbb_zmax;
+                            MD_FLOAT dh       = jbb_zmin - ibb_zmax;
+                            MD_FLOAT dm       = MAX(dl, dh);
+                            MD_FLOAT dm0      = MAX(dm, 0.0);
+                            MD_FLOAT d_bb_sq  = dm0 * dm0;
 
                             dl  = ibb_ymin - jbb_ymax;
                             dh  = jbb_ymin - ibb_ymax;
@@ -384,8 +989,8 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
                             dm0 = MAX(dm, 0.0);
                             d_bb_sq += dm0 * dm0;
 
-                            if (d_bb_sq < cutneighsq) {
-                                int is_neighbor = (d_bb_sq < rbb_sq) ? 1 : 0;
+                            if (d_bb_sq < cutsq) {
+                                is_neighbor = (d_bb_sq < rbb_sq) ? 1 : 0;
 
                                 if (!is_neighbor) {
                                     int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
@@ -398,12 +1003,15 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 
 #if defined(CLUSTERPAIR_KERNEL_2XNN)
 
-                                    MD_SIMD_FLOAT xj_tmp = simd_real_load_h_duplicate(
-                                        &cj_x[CL_X_OFFSET]);
-                                    MD_SIMD_FLOAT yj_tmp = simd_real_load_h_duplicate(
-                                        &cj_x[CL_Y_OFFSET]);
-                                    MD_SIMD_FLOAT zj_tmp = simd_real_load_h_duplicate(
-                                        &cj_x[CL_Z_OFFSET]);
+                                    MD_SIMD_FLOAT xj_tmp = simd_real_add(
+                                        simd_real_load_h_duplicate(&cj_x[CL_X_OFFSET]),
+                                        simd_real_broadcast(jshx));
+                                    MD_SIMD_FLOAT yj_tmp = simd_real_add(
+                                        simd_real_load_h_duplicate(&cj_x[CL_Y_OFFSET]),
+                                        simd_real_broadcast(jshy));
+                                    MD_SIMD_FLOAT zj_tmp = simd_real_add(
+                                        simd_real_load_h_duplicate(&cj_x[CL_Z_OFFSET]),
+                                        simd_real_broadcast(jshz));
 
 #ifndef ONE_ATOM_TYPE
                                     MD_SIMD_INT tj_tmp = simd_i32_load_h_duplicate(cj_t);
@@ -450,12 +1058,15 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 
 #elif defined(CLUSTERPAIR_KERNEL_4XN)
 
-                                    MD_SIMD_FLOAT xj_tmp = simd_real_load(
-                                        &cj_x[CL_X_OFFSET]);
-                                    MD_SIMD_FLOAT yj_tmp = simd_real_load(
-                                        &cj_x[CL_Y_OFFSET]);
-                                    MD_SIMD_FLOAT zj_tmp = simd_real_load(
-                                        &cj_x[CL_Z_OFFSET]);
+                                    MD_SIMD_FLOAT xj_tmp = simd_real_add(
+                                        simd_real_load(&cj_x[CL_X_OFFSET]),
+                                        simd_real_broadcast(jshx));
+                                    MD_SIMD_FLOAT yj_tmp = simd_real_add(
+                                        simd_real_load(&cj_x[CL_Y_OFFSET]),
+                                        simd_real_broadcast(jshy));
+                                    MD_SIMD_FLOAT zj_tmp = simd_real_add(
+                                        simd_real_load(&cj_x[CL_Z_OFFSET]),
+                                        simd_real_broadcast(jshz));
 #ifndef ONE_ATOM_TYPE
                                     MD_SIMD_INT tj_tmp = simd_i32_load(cj_t);
                                     MD_SIMD_INT tvec0  = simd_i32_add(tbase0, tj_tmp);
@@ -537,14 +1148,17 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
                                     for (int cii = 0; cii < CLUSTER_M; cii++) {
                                         for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
                                             MD_FLOAT delx = ci_x[CL_X_OFFSET + cii] -
-                                                            cj_x[CL_X_OFFSET + cjj];
+                                                            cj_x[CL_X_OFFSET + cjj] -
+                                                            jshx;
                                             MD_FLOAT dely = ci_x[CL_Y_OFFSET + cii] -
-                                                            cj_x[CL_Y_OFFSET + cjj];
+                                                            cj_x[CL_Y_OFFSET + cjj] -
+                                                            jshy;
                                             MD_FLOAT delz = ci_x[CL_Z_OFFSET + cii] -
-                                                            cj_x[CL_Z_OFFSET + cjj];
+                                                            cj_x[CL_Z_OFFSET + cjj] -
+                                                            jshz;
 
                                             if (delx * delx + dely * dely + delz * delz <
-                                                cutneighsq) {
+                                                cutsq) {
                                                 is_neighbor = 1;
                                             }
                                         }
@@ -552,52 +1166,55 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 
 #endif
                                 }
+                            }
+                        }
 
-                                if (is_neighbor) {
-                                    // We use true (1) for rdiag because we only care if
-                                    // there are masks at all, and when this is set to
-                                    // false (0) the self-exclusions are not accounted
-                                    // for, which  makes the optimized version to not
-                                    // work!
-                                    unsigned int imask;
+                        if (is_neighbor) {
+                            // We use true (1) for rdiag because we only care if there
+                            // are masks at all, and when this is set to false (0) the
+                            // self-exclusions are not accounted for, which  makes the
+                            // optimized version to not work!
+                            // Periodic images never need the diagonal masks
+                            unsigned int imask = NBNXN_INTERACTION_MASK_ALL;
+                            if (shift == CENTER_SHIFT) {
 #ifdef CLUSTERPAIR_KERNEL_2XNN
-                                    imask = get_imask_simd_2xnn(1, ci, cj);
+                                imask = get_imask_simd_2xnn(1, ci, cj);
 #else
-                                    imask = get_imask_simd_4xn(1, ci, cj);
+                                imask = get_imask_simd_4xn(1, ci, cj);
 #endif
+                            }
 
-                                    if (n < neighbor->maxneighs) {
-                                        if (imask == NBNXN_INTERACTION_MASK_ALL) {
-                                            neighptr[n]       = cj;
-                                            neighptr_imask[n] = imask;
-                                        } else {
-                                            neighptr[n]       = neighptr[nmasked];
-                                            neighptr_imask[n] = neighptr_imask[nmasked];
-                                            neighptr[nmasked] = cj;
-                                            neighptr_imask[nmasked] = imask;
-                                            nmasked++;
-                                        }
-                                    }
-
-                                    n++;
+                            if (n < neighbor->maxneighs) {
+                                if (imask == NBNXN_INTERACTION_MASK_ALL) {
+                                    neighptr[n]       = cj;
+                                    neighptr_imask[n] = imask;
+                                    SET_SHIFT(n, shift);
+                                } else {
+                                    neighptr[n]       = neighptr[nmasked];
+                                    neighptr_imask[n] = neighptr_imask[nmasked];
+                                    SET_SHIFT(n, GET_SHIFT(nmasked));
+                                    neighptr[nmasked] = cj;
+                                    neighptr_imask[nmasked] = imask;
+                                    SET_SHIFT(nmasked, CENTER_SHIFT);
+                                    nmasked++;
                                 }
                             }
-                        }
 
-                        m++;
-                        if (m < c) {
-                            cj       = loc_bin[m];
-                            jbb_xmin = atom->jclusters[cj].bbminx;
-                            jbb_xmax = atom->jclusters[cj].bbmaxx;
-                            jbb_ymin = atom->jclusters[cj].bbminy;
-                            jbb_ymax = atom->jclusters[cj].bbmaxy;
-                            jbb_zmin = atom->jclusters[cj].bbminz;
-                            jbb_zmax = atom->jclusters[cj].bbmaxz;
+                            n++;
                         }
                     }
                 }
+
+                tstencil.build_tested[tp] += c;
+                tstencil.build_kept[tp] += n - n0;
             }
 
+#ifdef PBC_SHIFTS
+            if (n <= neighbor->maxneighs) {
+                nsegments = sortByShift(neighptr, n, nmasked, segments);
+            }
+#endif
+
             // Fill neighbor list with dummy values to fit vector width
             if (CLUSTER_N < VECTOR_WIDTH) {
                 while (n % (VECTOR_WIDTH / CLUSTER_N)) {
@@ -608,8 +1225,20 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
                 }
             }
 
+            // The dummy clusters extend the last segment
+            if (n == 0) {
+                nsegments = 0;
+            } else if (nsegments == 1) {
+                segments[0].shift = CENTER_SHIFT;
+            }
+
+            if (nsegments > 0 && n <= neighbor->maxneighs) {
+                segments[nsegments - 1].end = n;
+            }
+
             neighbor->numneigh[ci]        = n;
             neighbor->numneigh_masked[ci] = nmasked;
+            neighbor->numsegments[ci]     = nsegments;
             if (n >= neighbor->maxneighs) {
                 resize = 1;
 
@@ -619,14 +1248,22 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
             }
         }
 
-        if (resize) {
+        if (!resize) {
+            stopTypeStencilCount(&tstencil);
+            for (int cls = 0; cls < 3; cls++) {
+                super_pairs[cls] += build_super[cls];
+            }
+
+            super_decided += build_decided;
+        } else {
             neighbor->maxneighs = new_maxneighs * 1.2;
             fprintf(stdout, "RESIZE %d\n", neighbor->maxneighs);
-            free(neighbor->neighbors);
-            free(neighbor->neighbors_imask);
-            neighbor->neighbors = (int*)malloc(nmax * neighbor->maxneighs * sizeof(int));
-            neighbor->neighbors_imask = (unsigned int*)malloc(
-                nmax * neighbor->maxneighs * sizeof(unsigned int));
+            deallocate(neighbor->neighbors);
+            deallocate(neighbor->neighbors_imask);
+            neighbor->neighbors = (int*)allocate(ALIGNMENT,
+                (MD_INDEX)nmax * neighbor->maxneighs * sizeof(int));
+            neighbor->neighbors_imask = (unsigned int*)allocate(ALIGNMENT,
+                (MD_INDEX)nmax * neighbor->maxneighs * sizeof(unsigned int));
         }
     }
 
@@ -635,7 +1272,8 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
     for(int ci = 0; ci < 6; ci++) {
         int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
         MD_FLOAT *ci_x = &atom->cl_x[ci_vec_base];
-        int* neighptr = &(neighbor->neighbors[ci * neighbor->maxneighs]);
+        int* neighptr                = &(
+            neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)]);
 
         DEBUG_MESSAGE("Cluster %d, bbx = {%f, %f}, bby = {%f, %f}, bbz = {%f, %f}\n",
             ci,
@@ -672,9 +1310,73 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
     }
     */
 
+    balanceNeighbor(atom, neighbor);
     DEBUG_MESSAGE("buildNeighbor end\n");
 }
 
+/* j-clusters in the stencil bins of i-cluster ci whose bounding boxes are within the
+ * neighbor cutoff of its box, for the direct force without stored lists. Like a list,
+ * the boxes of the last binClusters cover every pair within the force cutoff while
+ * no atom moved more than half the skin. Up to max j-clusters and their shifts are
+ * stored, the return value is their total number */
+int collectDirectClusters(Atom* atom, int ci, int* cjs, int* shifts, int max)
+{
+    const int nt      = tstencil.ntypes;
+    const int ibin    = atom->icluster_bin[ci];
+    const int ti      = BIN_TYPE(atom, CI_SCALAR_BASE_INDEX(ci));
+    const int* ent    = &tstencil.entry[tstencil.start[ti]];
+    const int nent    = tstencil.start[ti + 1] - tstencil.start[ti];
+    const Cluster* ib = &atom->iclusters[ci];
+    int n             = 0;
+
+    for (int e = 0; e < nent * STENCIL_ZIMAGES; e++) {
+        const int k          = ent[e % nent] / nt + (e / nent) * nstencil;
+        const int tp         = ti * nt + ent[e % nent] % nt;
+        const MD_FLOAT cutsq = tstencil.cutneighsq[tp];
+#ifdef PBC_SHIFTS
+        int sx, sy, sz = k / nstencil - 1;
+        int jbin = wrapStencilBin(ibin, k % nstencil, &sx, &sy);
+        if ((sz < 0 && ib->bbminz >= cutneigh) ||
+            (sz > 0 && ib->bbmaxz < zprd - cutneigh)) {
+            continue;
+        }
+
+        const int shift = SHIFT_INDEX(sx, sy, sz);
+#else
+        int jbin        = ibin + stencil[k];
+        const int shift = CENTER_SHIFT;
+#endif
+        const MD_FLOAT* sh = atom->shiftvec[shift];
+        int c;
+        int* loc_bin = getCellItems(&cluster_grid, jbin * nt + tp % nt, &c);
+
+        for (int m = 0; m < c; m++) {
+            const Cluster* jb = &atom->jclusters[loc_bin[m]];
+
+            MD_FLOAT dx = MAX(MAX(ib->bbminx - jb->bbmaxx - sh[0],
+                                  jb->bbminx + sh[0] - ib->bbmaxx),
+                0.0);
+            MD_FLOAT dy = MAX(MAX(ib->bbminy - jb->bbmaxy - sh[1],
+                                  jb->bbminy + sh[1] - ib->bbmaxy),
+                0.0);
+            MD_FLOAT dz = MAX(MAX(ib->bbminz - jb->bbmaxz - sh[2],
+                                  jb->bbminz + sh[2] - ib->bbmaxz),
+                0.0);
+
+            if (dx * dx + dy * dy + dz * dz < cutsq) {
+                if (n < max) {
+                    cjs[n]    = loc_bin[m];
+                    shifts[n] = shift;
+                }
+
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
 void pruneNeighbor(Parameter* param, Atom* atom, Neighbor* neighbor)
 {
     DEBUG_MESSAGE("pruneNeighbor start\n");
@@ -682,13 +1384,16 @@ void pruneNeighbor(Parameter* param, Atom* atom, Neighbor* neighbor)
     MD_FLOAT cutsq = cutneighsq;
 
     for (int ci = 0; ci < atom->Nclusters_local; ci++) {
-        int* neighs                = &neighbor->neighbors[ci * neighbor->maxneighs];
-        unsigned int* neighs_imask = &neighbor->neighbors_imask[ci * neighbor->maxneighs];
+        int* neighs                = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
+        unsigned int* neighs_imask = &(
+            neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)]);
+        NeighborSegment* segments  = &neighbor->segments[SEGMENT_OFFSET(ci)];
         int numneighs              = neighbor->numneigh[ci];
         int numneighs_masked       = neighbor->numneigh_masked[ci];
-        int k                      = 0;
+        int numsegments            = neighbor->numsegments[ci];
         int ci_vec_base            = CI_VECTOR_BASE_INDEX(ci);
         MD_FLOAT* ci_x             = &atom->cl_x[ci_vec_base];
+        int n = 0, nmasked = 0, nsegments = 0, kbegin = 0;
 
 #if defined(CLUSTERPAIR_KERNEL_2XNN)
         MD_SIMD_FLOAT cutneighsq_vec = simd_real_broadcast(cutsq);
@@ -716,121 +1421,153 @@ void pruneNeighbor(Parameter* param, Atom* atom, Neighbor* neighbor)
 
         // Remove dummy clusters if necessary
         if (CLUSTER_N < VECTOR_WIDTH) {
-            while (neighs[numneighs - 1] == atom->dummy_cj) {
+            while (numneighs > 0 && neighs[numneighs - 1] == atom->dummy_cj) {
                 numneighs--;
             }
         }
 
-        while (k < numneighs) {
-            int cj                 = neighs[k];
-            int cj_vec_base        = CJ_VECTOR_BASE_INDEX(cj);
-            MD_FLOAT* cj_x         = &atom->cl_x[cj_vec_base];
-            int atom_dist_in_range = 0;
+        // The remaining entries are compacted in order, so the masked entries stay
+        // in front and every entry stays in the segment of its shift
+        for (int seg = 0; seg < numsegments; seg++) {
+            const int shift     = segments[seg].shift;
+            const int kend      = MIN(segments[seg].end, numneighs);
+            const MD_FLOAT jshx = atom->shiftvec[shift][0];
+            const MD_FLOAT jshy = atom->shiftvec[shift][1];
+            const MD_FLOAT jshz = atom->shiftvec[shift][2];
+
+            for (int k = kbegin; k < kend; k++) {
+                int cj                 = neighs[k];
+                int cj_vec_base        = CJ_VECTOR_BASE_INDEX(cj);
+                MD_FLOAT* cj_x         = &atom->cl_x[cj_vec_base];
+                int atom_dist_in_range = 0;
 
 #if defined(CLUSTERPAIR_KERNEL_2XNN)
 
-            MD_SIMD_FLOAT xj_tmp = simd_real_load_h_duplicate(&cj_x[CL_X_OFFSET]);
-            MD_SIMD_FLOAT yj_tmp = simd_real_load_h_duplicate(&cj_x[CL_Y_OFFSET]);
-            MD_SIMD_FLOAT zj_tmp = simd_real_load_h_duplicate(&cj_x[CL_Z_OFFSET]);
-            MD_SIMD_FLOAT delx0  = simd_real_sub(xi0_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely0  = simd_real_sub(yi0_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz0  = simd_real_sub(zi0_tmp, zj_tmp);
-            MD_SIMD_FLOAT delx2  = simd_real_sub(xi2_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely2  = simd_real_sub(yi2_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz2  = simd_real_sub(zi2_tmp, zj_tmp);
-            MD_SIMD_FLOAT rsq0   = simd_real_fma(delx0,
-                delx0,
-                simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
-            MD_SIMD_FLOAT rsq2   = simd_real_fma(delx2,
-                delx2,
-                simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
-
-            MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutneighsq_vec);
-            MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutneighsq_vec);
-
-            if (simd_test_any(cutoff_mask0) || simd_test_any(cutoff_mask2)) {
-                atom_dist_in_range = 1;
-            }
+                MD_SIMD_FLOAT xj_tmp = simd_real_add(
+                    simd_real_load_h_duplicate(&cj_x[CL_X_OFFSET]),
+                    simd_real_broadcast(jshx));
+                MD_SIMD_FLOAT yj_tmp = simd_real_add(
+                    simd_real_load_h_duplicate(&cj_x[CL_Y_OFFSET]),
+                    simd_real_broadcast(jshy));
+                MD_SIMD_FLOAT zj_tmp = simd_real_add(
+                    simd_real_load_h_duplicate(&cj_x[CL_Z_OFFSET]),
+                    simd_real_broadcast(jshz));
+                MD_SIMD_FLOAT delx0  = simd_real_sub(xi0_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely0  = simd_real_sub(yi0_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz0  = simd_real_sub(zi0_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx2  = simd_real_sub(xi2_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely2  = simd_real_sub(yi2_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz2  = simd_real_sub(zi2_tmp, zj_tmp);
+                MD_SIMD_FLOAT rsq0   = simd_real_fma(delx0,
+                    delx0,
+                    simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
+                MD_SIMD_FLOAT rsq2   = simd_real_fma(delx2,
+                    delx2,
+                    simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
+
+                MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutneighsq_vec);
+                MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutneighsq_vec);
+
+                if (simd_test_any(cutoff_mask0) || simd_test_any(cutoff_mask2)) {
+                    atom_dist_in_range = 1;
+                }
 
 #elif defined(CLUSTERPAIR_KERNEL_4XN)
 
-            MD_SIMD_FLOAT xj_tmp = simd_real_load(&cj_x[CL_X_OFFSET]);
-            MD_SIMD_FLOAT yj_tmp = simd_real_load(&cj_x[CL_Y_OFFSET]);
-            MD_SIMD_FLOAT zj_tmp = simd_real_load(&cj_x[CL_Z_OFFSET]);
-            MD_SIMD_FLOAT delx0  = simd_real_sub(xi0_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely0  = simd_real_sub(yi0_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz0  = simd_real_sub(zi0_tmp, zj_tmp);
-            MD_SIMD_FLOAT delx1  = simd_real_sub(xi1_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely1  = simd_real_sub(yi1_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz1  = simd_real_sub(zi1_tmp, zj_tmp);
-            MD_SIMD_FLOAT delx2  = simd_real_sub(xi2_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely2  = simd_real_sub(yi2_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz2  = simd_real_sub(zi2_tmp, zj_tmp);
-            MD_SIMD_FLOAT delx3  = simd_real_sub(xi3_tmp, xj_tmp);
-            MD_SIMD_FLOAT dely3  = simd_real_sub(yi3_tmp, yj_tmp);
-            MD_SIMD_FLOAT delz3  = simd_real_sub(zi3_tmp, zj_tmp);
-
-            MD_SIMD_FLOAT rsq0 = simd_real_fma(delx0,
-                delx0,
-                simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
-            MD_SIMD_FLOAT rsq1 = simd_real_fma(delx1,
-                delx1,
-                simd_real_fma(dely1, dely1, simd_real_mul(delz1, delz1)));
-            MD_SIMD_FLOAT rsq2 = simd_real_fma(delx2,
-                delx2,
-                simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
-            MD_SIMD_FLOAT rsq3 = simd_real_fma(delx3,
-                delx3,
-                simd_real_fma(dely3, dely3, simd_real_mul(delz3, delz3)));
-
-            MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutneighsq_vec);
-            MD_SIMD_MASK cutoff_mask1 = simd_mask_cond_lt(rsq1, cutneighsq_vec);
-            MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutneighsq_vec);
-            MD_SIMD_MASK cutoff_mask3 = simd_mask_cond_lt(rsq3, cutneighsq_vec);
-
-            if (simd_test_any(cutoff_mask0) || simd_test_any(cutoff_mask1) ||
-                simd_test_any(cutoff_mask2) || simd_test_any(cutoff_mask3)) {
-                atom_dist_in_range = 1;
-            }
+                MD_SIMD_FLOAT xj_tmp = simd_real_add(
+                    simd_real_load(&cj_x[CL_X_OFFSET]), simd_real_broadcast(jshx));
+                MD_SIMD_FLOAT yj_tmp = simd_real_add(
+                    simd_real_load(&cj_x[CL_Y_OFFSET]), simd_real_broadcast(jshy));
+                MD_SIMD_FLOAT zj_tmp = simd_real_add(
+                    simd_real_load(&cj_x[CL_Z_OFFSET]), simd_real_broadcast(jshz));
+                MD_SIMD_FLOAT delx0  = simd_real_sub(xi0_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely0  = simd_real_sub(yi0_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz0  = simd_real_sub(zi0_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx1  = simd_real_sub(xi1_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely1  = simd_real_sub(yi1_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz1  = simd_real_sub(zi1_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx2  = simd_real_sub(xi2_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely2  = simd_real_sub(yi2_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz2  = simd_real_sub(zi2_tmp, zj_tmp);
+                MD_SIMD_FLOAT delx3  = simd_real_sub(xi3_tmp, xj_tmp);
+                MD_SIMD_FLOAT dely3  = simd_real_sub(yi3_tmp, yj_tmp);
+                MD_SIMD_FLOAT delz3  = simd_real_sub(zi3_tmp, zj_tmp);
+
+                MD_SIMD_FLOAT rsq0 = simd_real_fma(delx0,
+                    delx0,
+                    simd_real_fma(dely0, dely0, simd_real_mul(delz0, delz0)));
+                MD_SIMD_FLOAT rsq1 = simd_real_fma(delx1,
+                    delx1,
+                    simd_real_fma(dely1, dely1, simd_real_mul(delz1, delz1)));
+                MD_SIMD_FLOAT rsq2 = simd_real_fma(delx2,
+                    delx2,
+                    simd_real_fma(dely2, dely2, simd_real_mul(delz2, delz2)));
+                MD_SIMD_FLOAT rsq3 = simd_real_fma(delx3,
+                    delx3,
+                    simd_real_fma(dely3, dely3, simd_real_mul(delz3, delz3)));
+
+                MD_SIMD_MASK cutoff_mask0 = simd_mask_cond_lt(rsq0, cutneighsq_vec);
+                MD_SIMD_MASK cutoff_mask1 = simd_mask_cond_lt(rsq1, cutneighsq_vec);
+                MD_SIMD_MASK cutoff_mask2 = simd_mask_cond_lt(rsq2, cutneighsq_vec);
+                MD_SIMD_MASK cutoff_mask3 = simd_mask_cond_lt(rsq3, cutneighsq_vec);
+
+                if (simd_test_any(cutoff_mask0) || simd_test_any(cutoff_mask1) ||
+                    simd_test_any(cutoff_mask2) || simd_test_any(cutoff_mask3)) {
+                    atom_dist_in_range = 1;
+                }
 #else
-            for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
-                for (int cjj = 0; cjj < atom->jclusters[cj].natoms; cjj++) {
-                    MD_FLOAT delx = ci_x[CL_X_OFFSET + cii] - cj_x[CL_X_OFFSET + cjj];
-                    MD_FLOAT dely = ci_x[CL_Y_OFFSET + cii] - cj_x[CL_Y_OFFSET + cjj];
-                    MD_FLOAT delz = ci_x[CL_Z_OFFSET + cii] - cj_x[CL_Z_OFFSET + cjj];
-                    if (delx * delx + dely * dely + delz * delz < cutsq) {
-                        atom_dist_in_range = 1;
-                        break;
+                for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+                    for (int cjj = 0; cjj < atom->jclusters[cj].natoms; cjj++) {
+                        MD_FLOAT delx = ci_x[CL_X_OFFSET + cii] -
+                                        cj_x[CL_X_OFFSET + cjj] - jshx;
+                        MD_FLOAT dely = ci_x[CL_Y_OFFSET + cii] -
+                                        cj_x[CL_Y_OFFSET + cjj] - jshy;
+                        MD_FLOAT delz = ci_x[CL_Z_OFFSET + cii] -
+                                        cj_x[CL_Z_OFFSET + cjj] - jshz;
+                        if (delx * delx + dely * dely + delz * delz < cutsq) {
+                            atom_dist_in_range = 1;
+                            break;
+                        }
                     }
                 }
-            }
 #endif
 
-            if (atom_dist_in_range) {
-                k++;
-            } else {
-                numneighs--;
-                if (k < numneighs_masked) {
-                    numneighs_masked--;
+                if (atom_dist_in_range) {
+                    neighs[n]       = cj;
+                    neighs_imask[n] = neighs_imask[k];
+                    nmasked += (k < numneighs_masked);
+                    n++;
                 }
-                neighs[k] = neighs[numneighs];
             }
+
+            if (n > 0 && (nsegments == 0 || segments[nsegments - 1].end < n)) {
+                segments[nsegments].shift = shift;
+                segments[nsegments].end   = n;
+                nsegments++;
+            }
+
+            kbegin = kend;
         }
 
         // Readd dummy clusters if necessary
         if (CLUSTER_N < VECTOR_WIDTH) {
-            while (numneighs % (VECTOR_WIDTH / CLUSTER_N)) {
-                neighs[numneighs] =
-                    atom->dummy_cj; // Last cluster is always a dummy cluster
-                neighs_imask[numneighs] = 0;
-                numneighs++;
+            while (n % (VECTOR_WIDTH / CLUSTER_N)) {
+                neighs[n] = atom->dummy_cj; // Last cluster is always a dummy cluster
+                neighs_imask[n] = 0;
+                n++;
             }
         }
 
-        neighbor->numneigh[ci]        = numneighs;
-        neighbor->numneigh_masked[ci] = numneighs_masked;
+        if (nsegments > 0) {
+            segments[nsegments - 1].end = n;
+        }
+
+        neighbor->numneigh[ci]        = n;
+        neighbor->numneigh_masked[ci] = nmasked;
+        neighbor->numsegments[ci]     = nsegments;
     }
 
+    balanceNeighbor(atom, neighbor);
     DEBUG_MESSAGE("pruneNeighbor end\n");
 }
 
@@ -865,7 +1602,7 @@ int coord2bin(MD_FLOAT xin, MD_FLOAT yin)
     if (xin >= xprd) {
         ix = (int)((xin - xprd) * bininvx) + nbinx - mbinxlo;
     } else if (xin >= 0.0) {
-        ix = (int)(xin * bininvx) - mbinxlo;
+        ix = MIN((int)(xin * bininvx), nbinx - 1) - mbinxlo;
     } else {
         ix = (int)(xin * bininvx) - mbinxlo - 1;
     }
@@ -873,7 +1610,7 @@ int coord2bin(MD_FLOAT xin, MD_FLOAT yin)
     if (yin >= yprd) {
         iy = (int)((yin - yprd) * bininvy) + nbiny - mbinylo;
     } else if (yin >= 0.0) {
-        iy = (int)(yin * bininvy) - mbinylo;
+        iy = MIN((int)(yin * bininvy), nbiny - 1) - mbinylo;
     } else {
         iy = (int)(yin * bininvy) - mbinylo - 1;
     }
@@ -903,32 +1640,32 @@ void coord2bin2D(MD_FLOAT xin, MD_FLOAT yin, int* ix, int* iy)
 void binAtoms(Atom* atom)
 {
     DEBUG_MESSAGE("binAtoms start\n");
-    int resize = 1;
+    int n = 0;
 
-    while (resize > 0) {
-        resize = 0;
+    if (!tstencil_valid) {
+        setupStencilTypes(atom);
+    }
 
-        for (int i = 0; i < mbins; i++) {
-            bincount[i] = 0;
-        }
+    reserveCellGrid(&atom_grid, atom->Nclusters_local * CLUSTER_M);
 
-        for (int i = 0; i < atom->Nlocal; i++) {
-            int ibin = coord2bin(atom_x(i), atom_y(i));
-            if (bincount[ibin] < atoms_per_bin) {
-                int ac                          = bincount[ibin]++;
-                bins[ibin * atoms_per_bin + ac] = i;
-            } else {
-                resize = 1;
-            }
-        }
+    // Atoms are binned by their slot in the local clusters, there is no
+    // separate per-atom storage to index into
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
 
-        if (resize) {
-            free(bins);
-            atoms_per_bin *= 2;
-            bins = (int*)malloc(mbins * atoms_per_bin * sizeof(int));
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            const int s         = CI_SCALAR_BASE_INDEX(ci) + cii;
+            atom_grid.keys[n]   = coord2bin(ci_x[CL_X_OFFSET + cii],
+                                    ci_x[CL_Y_OFFSET + cii]) *
+                                    tstencil.ntypes +
+                                BIN_TYPE(atom, s);
+            atom_grid.values[n] = s;
+            n++;
         }
     }
 
+    buildCellGrid(&atom_grid, n);
     DEBUG_MESSAGE("binAtoms end\n");
 }
 
@@ -936,19 +1673,19 @@ void binAtoms(Atom* atom)
 void sortAtomsByZCoord(Atom* atom)
 {
     DEBUG_MESSAGE("sortAtomsByZCoord start\n");
-    for (int bin = 0; bin < mbins; bin++) {
-        int c        = bincount[bin];
-        int* bin_ptr = &bins[bin * atoms_per_bin];
+    for (int bin = 0; bin < atom_grid.ncells; bin++) {
+        int c        = atom_grid.start[bin + 1] - atom_grid.start[bin];
+        int* bin_ptr = &atom_grid.items[atom_grid.start[bin]];
 
         for (int ac_i = 0; ac_i < c; ac_i++) {
             int i          = bin_ptr[ac_i];
             int min_ac     = ac_i;
             int min_idx    = i;
-            MD_FLOAT min_z = atom_z(i);
+            MD_FLOAT min_z = atom->cl_x[SLOT_VECTOR_INDEX(i) + CL_Z_OFFSET];
 
             for (int ac_j = ac_i + 1; ac_j < c; ac_j++) {
                 int j       = bin_ptr[ac_j];
-                MD_FLOAT zj = atom_z(j);
+                MD_FLOAT zj = atom->cl_x[SLOT_VECTOR_INDEX(j) + CL_Z_OFFSET];
                 if (zj < min_z) {
                     min_ac  = ac_j;
                     min_idx = j;
@@ -964,33 +1701,261 @@ void sortAtomsByZCoord(Atom* atom)
     DEBUG_MESSAGE("sortAtomsByZCoord end\n");
 }
 
+static int compareShapeKey(const void* a, const void* b)
+{
+    const ShapeKey* ka = (const ShapeKey*)a;
+    const ShapeKey* kb = (const ShapeKey*)b;
+
+    if (ka->key != kb->key) {
+        return (ka->key > kb->key) - (ka->key < kb->key);
+    }
+
+    return (ka->slot > kb->slot) - (ka->slot < kb->slot);
+}
+
+// Sort the first n keys and store their slots in this order
+static void sortShapeKeys(int* slots, int n)
+{
+    qsort(shape_keys, n, sizeof(ShapeKey), compareShapeKey);
+    for (int i = 0; i < n; i++) {
+        slots[i] = shape_keys[i].slot;
+    }
+}
+
+// Sort n atom slots by one coordinate, offset is CL_X_OFFSET, CL_Y_OFFSET or
+// CL_Z_OFFSET
+static void sortSlotsByCoord(Atom* atom, int* slots, int n, int offset)
+{
+    for (int i = 0; i < n; i++) {
+        shape_keys[i].key  = atom->cl_x[SLOT_VECTOR_INDEX(slots[i]) + offset];
+        shape_keys[i].slot = slots[i];
+    }
+
+    sortShapeKeys(slots, n);
+}
+
+/* split the atoms of a bin by their x rank into nsx slabs, every slab by its y rank
+ * into nsy sub-columns and sort the sub-columns by z. The sub-columns are sized for
+ * roughly cubic groups of unit atoms, which fill the widest cluster, and they hold
+ * whole groups so that only the last cluster of the bin is partially filled */
+static void splitSubColumns(Atom* atom, int* bin_ptr, int c)
+{
+    const int unit   = MAX(CLUSTER_M, CLUSTER_N);
+    const int nunits = (c + unit - 1) / unit;
+    MD_FLOAT zmin = INFINITY, zmax = -INFINITY;
+
+    for (int ac = 0; ac < c; ac++) {
+        MD_FLOAT z = atom->cl_x[SLOT_VECTOR_INDEX(bin_ptr[ac]) + CL_Z_OFFSET];
+        zmin       = MIN(zmin, z);
+        zmax       = MAX(zmax, z);
+    }
+
+    MD_FLOAT height = MAX(zmax - zmin, SMALL);
+    MD_FLOAT edge   = cbrt(binsizex * binsizey * height * unit / c);
+    int nsx         = MAX(1, (int)(binsizex / edge + 0.5));
+    int nsy         = MAX(1, (int)(binsizey / edge + 0.5));
+
+    while (nsx * nsy > nunits) {
+        if (nsx >= nsy) {
+            nsx--;
+        } else {
+            nsy--;
+        }
+    }
+
+    sortSlotsByCoord(atom, bin_ptr, c, CL_X_OFFSET);
+    for (int sx = 0; sx < nsx; sx++) {
+        const int xunit0 = sx * nunits / nsx;
+        const int xunits = (sx + 1) * nunits / nsx - xunit0;
+        const int xlo    = xunit0 * unit;
+        const int xhi    = MIN(xlo + xunits * unit, c);
+
+        sortSlotsByCoord(atom, &bin_ptr[xlo], xhi - xlo, CL_Y_OFFSET);
+        for (int sy = 0; sy < nsy; sy++) {
+            const int lo = MIN(xlo + sy * xunits / nsy * unit, xhi);
+            const int hi = MIN(xlo + (sy + 1) * xunits / nsy * unit, xhi);
+
+            sortSlotsByCoord(atom, &bin_ptr[lo], hi - lo, CL_Z_OFFSET);
+        }
+    }
+}
+
+/* order the atoms of a bin along a Morton curve. The bin is cut in z into cubes as
+ * wide as its atoms spread in x and y, the cubes are visited by z and the curve
+ * runs through each of them, so consecutive atoms stay compact in all directions */
+static void sortMorton(Atom* atom, int* bin_ptr, int c)
+{
+    const int bits   = 8;
+    const int levels = 1 << bits;
+    MD_FLOAT xmin = INFINITY, xmax = -INFINITY;
+    MD_FLOAT ymin = INFINITY, ymax = -INFINITY;
+    MD_FLOAT zmin = INFINITY;
+
+    for (int ac = 0; ac < c; ac++) {
+        int vs = SLOT_VECTOR_INDEX(bin_ptr[ac]);
+        xmin   = MIN(xmin, atom->cl_x[vs + CL_X_OFFSET]);
+        xmax   = MAX(xmax, atom->cl_x[vs + CL_X_OFFSET]);
+        ymin   = MIN(ymin, atom->cl_x[vs + CL_Y_OFFSET]);
+        ymax   = MAX(ymax, atom->cl_x[vs + CL_Y_OFFSET]);
+        zmin   = MIN(zmin, atom->cl_x[vs + CL_Z_OFFSET]);
+    }
+
+    MD_FLOAT edge = MAX(MAX(xmax - xmin, ymax - ymin), SMALL);
+
+    for (int ac = 0; ac < c; ac++) {
+        int vs          = SLOT_VECTOR_INDEX(bin_ptr[ac]);
+        MD_FLOAT fx     = (atom->cl_x[vs + CL_X_OFFSET] - xmin) / edge;
+        MD_FLOAT fy     = (atom->cl_x[vs + CL_Y_OFFSET] - ymin) / edge;
+        MD_FLOAT fz     = (atom->cl_x[vs + CL_Z_OFFSET] - zmin) / edge;
+        MD_FLOAT cube   = floor(fz);
+        unsigned int ix = MIN((int)(fx * levels), levels - 1);
+        unsigned int iy = MIN((int)(fy * levels), levels - 1);
+        unsigned int iz = MIN((int)((fz - cube) * levels), levels - 1);
+
+        shape_keys[ac].key  = cube * levels * levels * levels +
+                              interleaveBits(ix, iy, iz, bits);
+        shape_keys[ac].slot = bin_ptr[ac];
+    }
+
+    sortShapeKeys(bin_ptr, c);
+}
+
+// Order the atoms of every bin for the cluster shapes other than SHAPE_Z
+static void shapeAtomsInBins(Atom* atom)
+{
+    DEBUG_MESSAGE("shapeAtomsInBins start\n");
+    if (atom_grid.nitems > shape_keys_max) {
+        free(shape_keys);
+        shape_keys_max = atom_grid.maxitems;
+        shape_keys     = (ShapeKey*)malloc(shape_keys_max * sizeof(ShapeKey));
+    }
+
+    for (int bin = 0; bin < atom_grid.ncells; bin++) {
+        int c        = atom_grid.start[bin + 1] - atom_grid.start[bin];
+        int* bin_ptr = &atom_grid.items[atom_grid.start[bin]];
+
+        if (cluster_shape == SHAPE_SUBCOLUMN) {
+            splitSubColumns(atom, bin_ptr, c);
+        } else {
+            sortMorton(atom, bin_ptr, c);
+        }
+    }
+
+    DEBUG_MESSAGE("shapeAtomsInBins end\n");
+}
+
+/* move every atom slot s to slot_dest[s] following the permutation cycles, so
+ * positions, velocities and types are reordered without a second copy of the
+ * cluster arrays; slots not holding an atom are marked with -1 */
+static void permuteClusterSlots(Atom* atom, int nslots)
+{
+    MD_FLOAT* cl_x = atom->cl_x;
+    MD_FLOAT* cl_v = atom->cl_v;
+    int* cl_t      = atom->cl_t;
+
+    for (int s = 0; s < nslots; s++) {
+        if (slot_dest[s] < 0) {
+            continue;
+        }
+
+        int vs      = SLOT_VECTOR_INDEX(s);
+        MD_FLOAT cx = cl_x[vs + CL_X_OFFSET];
+        MD_FLOAT cy = cl_x[vs + CL_Y_OFFSET];
+        MD_FLOAT cz = cl_x[vs + CL_Z_OFFSET];
+        MD_FLOAT cvx = cl_v[vs + CL_X_OFFSET];
+        MD_FLOAT cvy = cl_v[vs + CL_Y_OFFSET];
+        MD_FLOAT cvz = cl_v[vs + CL_Z_OFFSET];
+        int ct       = cl_t[s];
+        int cur      = s;
+
+        while (1) {
+            int d          = slot_dest[cur];
+            int vd         = SLOT_VECTOR_INDEX(d);
+            slot_dest[cur] = -1;
+
+            MD_FLOAT tx  = cl_x[vd + CL_X_OFFSET];
+            MD_FLOAT ty  = cl_x[vd + CL_Y_OFFSET];
+            MD_FLOAT tz  = cl_x[vd + CL_Z_OFFSET];
+            MD_FLOAT tvx = cl_v[vd + CL_X_OFFSET];
+            MD_FLOAT tvy = cl_v[vd + CL_Y_OFFSET];
+            MD_FLOAT tvz = cl_v[vd + CL_Z_OFFSET];
+            int tt       = cl_t[d];
+
+            cl_x[vd + CL_X_OFFSET] = cx;
+            cl_x[vd + CL_Y_OFFSET] = cy;
+            cl_x[vd + CL_Z_OFFSET] = cz;
+            cl_v[vd + CL_X_OFFSET] = cvx;
+            cl_v[vd + CL_Y_OFFSET] = cvy;
+            cl_v[vd + CL_Z_OFFSET] = cvz;
+            cl_t[d]                = ct;
+
+            // Stop when the displaced slot was empty or already moved
+            if (slot_dest[d] < 0) {
+                break;
+            }
+
+            cx  = tx;
+            cy  = ty;
+            cz  = tz;
+            cvx = tvx;
+            cvy = tvy;
+            cvz = tvz;
+            ct  = tt;
+            cur = d;
+        }
+    }
+}
+
 void buildClusters(Atom* atom)
 {
     DEBUG_MESSAGE("buildClusters start\n");
-    atom->Nclusters_local = 0;
+    const int nclusters_old = atom->Nclusters_local;
 
     /* bin local atoms */
     binAtoms(atom);
-    sortAtomsByZCoord(atom);
+    if (cluster_shape == SHAPE_Z) {
+        sortAtomsByZCoord(atom);
+    } else {
+        shapeAtomsInBins(atom);
+    }
 
-    for (int bin = 0; bin < mbins; bin++) {
-        int c         = bincount[bin];
+    int nclusters_new = 0;
+    for (int bin = 0; bin < atom_grid.ncells; bin++) {
+        int c         = atom_grid.start[bin + 1] - atom_grid.start[bin];
+        int nclusters = ((c + CLUSTER_M - 1) / CLUSTER_M);
+        if (CLUSTER_N > CLUSTER_M && nclusters % 2) {
+            nclusters++;
+        }
+        nclusters_new += nclusters;
+    }
+
+    while (nclusters_new > atom->Nclusters_max) {
+        growClusters(atom);
+    }
+
+    int nslots = MAX(nclusters_old, nclusters_new) * CLUSTER_M;
+    if (nslots > nslots_max) {
+        deallocate(slot_dest);
+        nslots_max = nslots;
+        slot_dest  = (int*)allocate(ALIGNMENT, nslots_max * sizeof(int));
+    }
+
+    for (int s = 0; s < nslots; s++) {
+        slot_dest[s] = -1;
+    }
+
+    atom->Nclusters_local = 0;
+    for (int bin = 0; bin < atom_grid.ncells; bin++) {
+        int c         = atom_grid.start[bin + 1] - atom_grid.start[bin];
+        int* bin_ptr  = &atom_grid.items[atom_grid.start[bin]];
         int ac        = 0;
         int nclusters = ((c + CLUSTER_M - 1) / CLUSTER_M);
         if (CLUSTER_N > CLUSTER_M && nclusters % 2) {
             nclusters++;
         }
         for (int cl = 0; cl < nclusters; cl++) {
-            const int ci = atom->Nclusters_local;
-            if (ci >= atom->Nclusters_max) {
-                growClusters(atom);
-            }
-
+            const int ci    = atom->Nclusters_local;
             int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
-            int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
-            MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
-            MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
-            int* ci_t       = &atom->cl_t[ci_sca_base];
             MD_FLOAT bbminx = INFINITY, bbmaxx = -INFINITY;
             MD_FLOAT bbminy = INFINITY, bbmaxy = -INFINITY;
             MD_FLOAT bbminz = INFINITY, bbmaxz = -INFINITY;
@@ -998,17 +1963,12 @@ void buildClusters(Atom* atom)
             atom->iclusters[ci].natoms = 0;
             for (int cii = 0; cii < CLUSTER_M; cii++) {
                 if (ac < c) {
-                    int i         = bins[bin * atoms_per_bin + ac];
-                    MD_FLOAT xtmp = atom_x(i);
-                    MD_FLOAT ytmp = atom_y(i);
-                    MD_FLOAT ztmp = atom_z(i);
-
-                    ci_x[CL_X_OFFSET + cii] = xtmp;
-                    ci_x[CL_Y_OFFSET + cii] = ytmp;
-                    ci_x[CL_Z_OFFSET + cii] = ztmp;
-                    ci_v[CL_X_OFFSET + cii] = atom->vx[i];
-                    ci_v[CL_Y_OFFSET + cii] = atom->vy[i];
-                    ci_v[CL_Z_OFFSET + cii] = atom->vz[i];
+                    // Atoms are not moved yet, so read them from their old slot
+                    int s         = bin_ptr[ac];
+                    int vs        = SLOT_VECTOR_INDEX(s);
+                    MD_FLOAT xtmp = atom->cl_x[vs + CL_X_OFFSET];
+                    MD_FLOAT ytmp = atom->cl_x[vs + CL_Y_OFFSET];
+                    MD_FLOAT ztmp = atom->cl_x[vs + CL_Z_OFFSET];
 
                     // TODO: To create the bounding boxes faster, we can use SIMD
                     // operations
@@ -1031,19 +1991,14 @@ void buildClusters(Atom* atom)
                         bbmaxz = ztmp;
                     }
 
-                    ci_t[cii] = atom->type[i];
+                    slot_dest[s] = ci_sca_base + cii;
                     atom->iclusters[ci].natoms++;
-                } else {
-                    ci_x[CL_X_OFFSET + cii] = INFINITY;
-                    ci_x[CL_Y_OFFSET + cii] = INFINITY;
-                    ci_x[CL_Z_OFFSET + cii] = INFINITY;
-                    ci_t[cii]               = 0;
                 }
 
                 ac++;
             }
 
-            atom->icluster_bin[ci]     = bin;
+            atom->icluster_bin[ci]     = atom_grid.id[bin] / tstencil.ntypes;
             atom->iclusters[ci].bbminx = bbminx;
             atom->iclusters[ci].bbmaxx = bbmaxx;
             atom->iclusters[ci].bbminy = bbminy;
@@ -1054,6 +2009,26 @@ void buildClusters(Atom* atom)
         }
     }
 
+    permuteClusterSlots(atom, nslots);
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+        MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
+        int* ci_t       = &atom->cl_t[ci_sca_base];
+
+        for (int cii = atom->iclusters[ci].natoms; cii < CLUSTER_M; cii++) {
+            ci_x[CL_X_OFFSET + cii] = INFINITY;
+            ci_x[CL_Y_OFFSET + cii] = INFINITY;
+            ci_x[CL_Z_OFFSET + cii] = INFINITY;
+            ci_v[CL_X_OFFSET + cii] = 0.0;
+            ci_v[CL_Y_OFFSET + cii] = 0.0;
+            ci_v[CL_Z_OFFSET + cii] = 0.0;
+            ci_t[cii]               = 0;
+        }
+    }
+
     DEBUG_MESSAGE("buildClusters end\n");
 }
 
@@ -1204,141 +2179,188 @@ void binClusters(Atom* atom)
 
     const int nlocal = atom->Nclusters_local;
     const int ncj    = get_ncj_from_nci(nlocal);
-    int resize       = 1;
-    while (resize > 0) {
-        resize = 0;
-
-        for (int bin = 0; bin < mbins; bin++) {
-            bin_nclusters[bin] = 0;
+    const int nt     = tstencil.ntypes;
+    int n            = 0;
+
+    reserveCellGrid(&cluster_grid, ncj + atom->Nclusters_ghost);
+    for (int ci = 0; ci < nlocal; ci++) {
+        // Assure we add this j-cluster only once in the bin
+        if (CLUSTER_M >= CLUSTER_N || ci % 2 == 0) {
+            int key = atom->icluster_bin[ci] * nt +
+                      BIN_TYPE(atom, CI_SCALAR_BASE_INDEX(ci));
+            cluster_grid.keys[n]     = key;
+            cluster_grid.values[n++] = CJ0_FROM_CI(ci);
+
+            if (CLUSTER_M > CLUSTER_N) {
+                int cj1 = CJ1_FROM_CI(ci);
+                if (atom->jclusters[cj1].natoms > 0) {
+                    cluster_grid.keys[n]     = key;
+                    cluster_grid.values[n++] = cj1;
+                }
+            }
         }
+    }
 
-        for (int ci = 0; ci < nlocal && !resize; ci++) {
-            // Assure we add this j-cluster only once in the bin
-            if (CLUSTER_M >= CLUSTER_N || ci % 2 == 0) {
-                int bin = atom->icluster_bin[ci];
-                int c   = bin_nclusters[bin];
-                if (c + 1 < clusters_per_bin) {
-                    bin_clusters[bin * clusters_per_bin + c] = CJ0_FROM_CI(ci);
-                    bin_nclusters[bin]++;
-
-                    if (CLUSTER_M > CLUSTER_N) {
-                        int cj1 = CJ1_FROM_CI(ci);
-                        if (atom->jclusters[cj1].natoms > 0) {
-                            bin_clusters[bin * clusters_per_bin + c + 1] = cj1;
-                            bin_nclusters[bin]++;
-                        }
-                    }
-                } else {
-                    resize = 1;
+    for (int cg = 0; cg < atom->Nclusters_ghost; cg++) {
+        const int cj = ncj + cg;
+        int ix = -1, iy = -1;
+        MD_FLOAT xtmp, ytmp;
+
+        if (atom->jclusters[cj].natoms > 0) {
+            int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
+            MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
+
+            xtmp = cj_x[CL_X_OFFSET + 0];
+            ytmp = cj_x[CL_Y_OFFSET + 0];
+            coord2bin2D(xtmp, ytmp, &ix, &iy);
+            ix = MAX(MIN(ix, mbinx - 1), 0);
+            iy = MAX(MIN(iy, mbiny - 1), 0);
+            for (int cjj = 1; cjj < atom->jclusters[cj].natoms; cjj++) {
+                int nix, niy;
+                xtmp = cj_x[CL_X_OFFSET + cjj];
+                ytmp = cj_x[CL_Y_OFFSET + cjj];
+                coord2bin2D(xtmp, ytmp, &nix, &niy);
+                nix = MAX(MIN(nix, mbinx - 1), 0);
+                niy = MAX(MIN(niy, mbiny - 1), 0);
+
+                // Always put the cluster on the bin of its innermost atom so
+                // the cluster should be closer to local clusters
+                if (atom->PBCx[cg] > 0 && ix > nix) {
+                    ix = nix;
+                }
+                if (atom->PBCx[cg] < 0 && ix < nix) {
+                    ix = nix;
+                }
+                if (atom->PBCy[cg] > 0 && iy > niy) {
+                    iy = niy;
+                }
+                if (atom->PBCy[cg] < 0 && iy < niy) {
+                    iy = niy;
                 }
             }
+
+            cluster_grid.keys[n] = (iy * mbinx + ix + 1) * nt +
+                                   BIN_TYPE(atom, CJ_SCALAR_BASE_INDEX(cj));
+            cluster_grid.values[n++] = cj;
         }
+    }
 
-        for (int cg = 0; cg < atom->Nclusters_ghost && !resize; cg++) {
-            const int cj = ncj + cg;
-            int ix = -1, iy = -1;
-            MD_FLOAT xtmp, ytmp;
-
-            if (atom->jclusters[cj].natoms > 0) {
-                int cj_vec_base  = CJ_VECTOR_BASE_INDEX(cj);
-                MD_FLOAT* cj_x   = &atom->cl_x[cj_vec_base];
-                MD_FLOAT cj_minz = atom->jclusters[cj].bbminz;
-
-                xtmp = cj_x[CL_X_OFFSET + 0];
-                ytmp = cj_x[CL_Y_OFFSET + 0];
-                coord2bin2D(xtmp, ytmp, &ix, &iy);
-                ix = MAX(MIN(ix, mbinx - 1), 0);
-                iy = MAX(MIN(iy, mbiny - 1), 0);
-                for (int cjj = 1; cjj < atom->jclusters[cj].natoms; cjj++) {
-                    int nix, niy;
-                    xtmp = cj_x[CL_X_OFFSET + cjj];
-                    ytmp = cj_x[CL_Y_OFFSET + cjj];
-                    coord2bin2D(xtmp, ytmp, &nix, &niy);
-                    nix = MAX(MIN(nix, mbinx - 1), 0);
-                    niy = MAX(MIN(niy, mbiny - 1), 0);
-
-                    // Always put the cluster on the bin of its innermost atom so
-                    // the cluster should be closer to local clusters
-                    if (atom->PBCx[cg] > 0 && ix > nix) {
-                        ix = nix;
-                    }
-                    if (atom->PBCx[cg] < 0 && ix < nix) {
-                        ix = nix;
-                    }
-                    if (atom->PBCy[cg] > 0 && iy > niy) {
-                        iy = niy;
-                    }
-                    if (atom->PBCy[cg] < 0 && iy < niy) {
-                        iy = niy;
-                    }
-                }
+    buildCellGrid(&cluster_grid, n);
 
-                int bin = iy * mbinx + ix + 1;
-                int c   = bin_nclusters[bin];
-                if (c < clusters_per_bin) {
-                    // Insert the current ghost cluster in the bin keeping clusters
-                    // sorted by z coordinate
-                    int inserted = 0;
-                    for (int i = 0; i < c; i++) {
-                        int last_cl = bin_clusters[bin * clusters_per_bin + i];
-                        if (atom->jclusters[last_cl].bbminz > cj_minz) {
-                            bin_clusters[bin * clusters_per_bin + i] = cj;
-
-                            for (int j = i + 1; j <= c; j++) {
-                                int tmp = bin_clusters[bin * clusters_per_bin + j];
-                                bin_clusters[bin * clusters_per_bin + j] = last_cl;
-                                last_cl                                  = tmp;
-                            }
+    // Every bin lists its local clusters, which are sorted by z coordinate for
+    // SHAPE_Z, before its ghost clusters; insert each ghost cluster in front of the
+    // first cluster above it to keep the bin sorted
+    for (int bin = 0; bin < cluster_grid.ncells; bin++) {
+        int* bin_ptr = &cluster_grid.items[cluster_grid.start[bin]];
+        int c        = cluster_grid.start[bin + 1] - cluster_grid.start[bin];
 
-                            inserted = 1;
-                            break;
-                        }
-                    }
+        for (int g = 0; g < c; g++) {
+            const int cj     = bin_ptr[g];
+            MD_FLOAT cj_minz = atom->jclusters[cj].bbminz;
+            int i            = 0;
 
-                    if (!inserted) {
-                        bin_clusters[bin * clusters_per_bin + c] = cj;
-                    }
+            if (cj < ncj) {
+                continue;
+            }
 
-                    bin_nclusters[bin]++;
-                } else {
-                    resize = 1;
-                }
+            while (i < g && atom->jclusters[bin_ptr[i]].bbminz <= cj_minz) {
+                i++;
+            }
+
+            for (int j = g; j > i; j--) {
+                bin_ptr[j] = bin_ptr[j - 1];
             }
-        }
 
-        if (resize) {
-            free(bin_clusters);
-            clusters_per_bin *= 2;
-            bin_clusters = (int*)malloc(mbins * clusters_per_bin * sizeof(int));
+            bin_ptr[i] = cj;
         }
     }
 
+    buildSuperClusters(atom);
+    recordClusterShape(atom);
+
     /*
     DEBUG_MESSAGE("bin_nclusters\n");
-    for(int i = 0; i < mbins; i++) { DEBUG_MESSAGE("%d, ", bin_nclusters[i]); }
+    for(int i = 0; i < cluster_grid.ncells; i++) { DEBUG_MESSAGE("%d, ",
+    cluster_grid.start[i + 1] - cluster_grid.start[i]); }
     DEBUG_MESSAGE("\n");
     */
 
     DEBUG_MESSAGE("binClusters stop\n");
 }
 
+/* copy the per-atom input arrays into consecutive cluster slots, the slots are
+ * then sorted into proper clusters by buildClusters; afterwards the per-atom
+ * arrays are released because the cluster arrays hold the only copy */
+void loadSingleAtoms(Atom* atom)
+{
+    DEBUG_MESSAGE("loadSingleAtoms start\n");
+    int nclusters = (atom->Nlocal + CLUSTER_M - 1) / CLUSTER_M;
+
+    while (nclusters > atom->Nclusters_max) {
+        growClusters(atom);
+    }
+
+    for (int ci = 0; ci < nclusters; ci++) {
+        int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+        MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
+        int* ci_t       = &atom->cl_t[ci_sca_base];
+
+        atom->iclusters[ci].natoms = MIN(CLUSTER_M, atom->Nlocal - ci * CLUSTER_M);
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            int i                   = ci * CLUSTER_M + cii;
+            ci_x[CL_X_OFFSET + cii] = atom_x(i);
+            ci_x[CL_Y_OFFSET + cii] = atom_y(i);
+            ci_x[CL_Z_OFFSET + cii] = atom_z(i);
+            ci_v[CL_X_OFFSET + cii] = atom->vx[i];
+            ci_v[CL_Y_OFFSET + cii] = atom->vy[i];
+            ci_v[CL_Z_OFFSET + cii] = atom->vz[i];
+            ci_t[cii]               = atom->type[i];
+        }
+    }
+
+    atom->Nclusters_local = nclusters;
+    freeSingleAtoms(atom);
+    DEBUG_MESSAGE("loadSingleAtoms end\n");
+}
+
+/* materialize the per-atom arrays from the clusters, this is only needed for
+ * output and thermo, call freeSingleAtoms() once done with them */
 void updateSingleAtoms(Atom* atom)
 {
     DEBUG_MESSAGE("updateSingleAtoms start\n");
     int Natom = 0;
 
+    if (atom->vx == NULL) {
+#ifdef AOS
+        atom->x = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT) * 3);
+#else
+        atom->x = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+        atom->y = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+        atom->z = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+#endif
+        atom->vx   = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+        atom->vy   = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+        atom->vz   = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
+        atom->type = (int*)allocate(ALIGNMENT, atom->Nmax * sizeof(int));
+    }
+
     for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_sca_base = CI_SCALAR_BASE_INDEX(ci);
         int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
         MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
         MD_FLOAT* ci_v  = &atom->cl_v[ci_vec_base];
+        int* ci_t       = &atom->cl_t[ci_sca_base];
 
         for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
-            atom_x(Natom)   = ci_x[CL_X_OFFSET + cii];
-            atom_y(Natom)   = ci_x[CL_Y_OFFSET + cii];
-            atom_z(Natom)   = ci_x[CL_Z_OFFSET + cii];
-            atom->vx[Natom] = ci_v[CL_X_OFFSET + cii];
-            atom->vy[Natom] = ci_v[CL_Y_OFFSET + cii];
-            atom->vz[Natom] = ci_v[CL_Z_OFFSET + cii];
+            atom_x(Natom)     = ci_x[CL_X_OFFSET + cii];
+            atom_y(Natom)     = ci_x[CL_Y_OFFSET + cii];
+            atom_z(Natom)     = ci_x[CL_Z_OFFSET + cii];
+            atom->vx[Natom]   = ci_v[CL_X_OFFSET + cii];
+            atom->vy[Natom]   = ci_v[CL_Y_OFFSET + cii];
+            atom->vz[Natom]   = ci_v[CL_Z_OFFSET + cii];
+            atom->type[Natom] = ci_t[cii];
             Natom++;
         }
     }
@@ -1349,3 +2371,21 @@ void updateSingleAtoms(Atom* atom)
 
     DEBUG_MESSAGE("updateSingleAtoms stop\n");
 }
+
+void freeSingleAtoms(Atom* atom)
+{
+    deallocate(atom->x);
+    deallocate(atom->y);
+    deallocate(atom->z);
+    deallocate(atom->vx);
+    deallocate(atom->vy);
+    deallocate(atom->vz);
+    deallocate(atom->type);
+    atom->x    = NULL;
+    atom->y    = NULL;
+    atom->z    = NULL;
+    atom->vx   = NULL;
+    atom->vy   = NULL;
+    atom->vz   = NULL;
+    atom->type = NULL;
+}
@@ -5,7 +5,9 @@
  * license that can be found in the LICENSE file.
  */
 #include <atom.h>
+#include <balance.h>
 #include <parameter.h>
+#include <typestencil.h>
 
 #ifndef __NEIGHBOR_H_
 #define __NEIGHBOR_H_
@@ -25,6 +27,21 @@
 #define NBNXN_INTERACTION_MASK_DIAG_J8_0 0xf0f8fcfeU
 #define NBNXN_INTERACTION_MASK_DIAG_J8_1 0x0080c0e0U
 
+// The list of an i-cluster is split into segments of entries that share one
+// periodic shift, the force kernels shift the i-cluster once per segment. The
+// masked entries come first and are always in the CENTER_SHIFT segment. With
+// ghost clusters every list is a single CENTER_SHIFT segment.
+typedef struct {
+    int shift; // index into atom->shiftvec, the j-cluster is moved by it
+    int end;   // one past the last list entry of the segment
+} NeighborSegment;
+
+#ifdef PBC_SHIFTS
+#define MAX_SEGMENTS NUM_SHIFTS
+#else
+#define MAX_SEGMENTS 1
+#endif
+
 typedef struct {
     int every;
     int ncalls;
@@ -34,8 +51,17 @@ typedef struct {
     int half_neigh;
     int* neighbors;
     unsigned int* neighbors_imask;
+    int* numsegments;
+    NeighborSegment* segments;
+
+    Balance balance; // i-cluster ranges of the threads, see balanceNeighbor
 } Neighbor;
 
+// Start of the neighbor list of cluster/atom i, neighbor IDs are 32-bit but
+// offsets use MD_INDEX so the total number of slots can exceed 2^31
+#define NEIGHBOR_OFFSET(nb, i) ((MD_INDEX)(i) * (nb)->maxneighs)
+#define SEGMENT_OFFSET(i)      ((MD_INDEX)(i)*MAX_SEGMENTS)
+
 typedef void (*BuildNeighborFunction)(Atom*, Neighbor*);
 extern BuildNeighborFunction buildNeighbor;
 
@@ -47,5 +73,18 @@ extern void pruneNeighbor(Parameter*, Atom*, Neighbor*);
 extern void buildClusters(Atom*);
 extern void defineJClusters(Atom*);
 extern void binClusters(Atom*);
+extern void loadSingleAtoms(Atom*);
 extern void updateSingleAtoms(Atom*);
+extern void freeSingleAtoms(Atom*);
+extern void setCenterSegments(Atom*, Neighbor*);
+extern int collectDirectClusters(Atom*, int ci, int* cjs, int* shifts, int max);
+extern int getOccupiedBins(void);
+extern int getTotalBins(void);
+extern double getBinningMemory(void);
+extern const TypeStencil* getTypeStencil(void);
+extern void printSuperClusters(void);
+extern void reportSuperClusters(void);
+extern void timeSuperClusters(Atom*, Neighbor*);
+extern void printClusterShape(Parameter*, Atom*, Neighbor*);
+extern void reportClusterShape(void);
 #endif
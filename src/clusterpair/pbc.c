@@ -10,14 +10,23 @@
 
 #include <allocate.h>
 #include <atom.h>
+#include <border.h>
 #include <force.h>
 #include <neighbor.h>
 #include <pbc.h>
+#include <timing.h>
 #include <util.h>
 
 #define DELTA 20000
 
+#if defined(PBC_SHIFTS) && defined(CUDA_TARGET)
+#error "PBC_SHIFTS is only supported by the CPU neighbor lists and kernels"
+#endif
+
 static int NmaxGhost;
+static int NmaxBorder;
+static int* border;       // sides of the box every j-cluster is close to
+static int* ghost_offset; // index of the first ghost of every j-cluster
 
 #ifdef CUDA_TARGET
 UpdatePbcFunction updatePbc      = updatePbcCUDA;
@@ -28,12 +37,20 @@ UpdatePbcFunction updatePbc      = updatePbcCPU;
 UpdatePbcFunction updateAtomsPbc = updateAtomsPbcCPU;
 #endif
 
+#ifndef PBC_SHIFTS
 static void growPbc(Atom*);
+#endif
+static void growBorders(int);
+static void setupShiftVectors(Atom*, Parameter*);
+static int findBorders(Atom*, Parameter*, int*);
 
 /* exported subroutines */
 void initPbc(Atom* atom)
 {
     NmaxGhost        = 0;
+    NmaxBorder       = 0;
+    border           = NULL;
+    ghost_offset     = NULL;
     atom->border_map = NULL;
     atom->PBCx       = NULL;
     atom->PBCy       = NULL;
@@ -45,6 +62,9 @@ void initPbc(Atom* atom)
 void updatePbcCPU(Atom* atom, Parameter* param, bool firstUpdate)
 {
     DEBUG_MESSAGE("updatePbc start\n");
+#ifdef PBC_SHIFTS
+    // No ghost clusters, the kernels apply the shift vectors of the list segments
+#else
     int ncj       = get_ncj_from_nci(atom->Nclusters_local);
     MD_FLOAT xprd = param->xprd;
     MD_FLOAT yprd = param->yprd;
@@ -113,6 +133,7 @@ void updatePbcCPU(Atom* atom, Parameter* param, bool firstUpdate)
             atom->jclusters[cj].bbmaxz = bbmaxz;
         }
     }
+#endif
 
     DEBUG_MESSAGE("updatePbc end\n");
 }
@@ -125,52 +146,52 @@ void updateAtomsPbcCPU(Atom* atom, Parameter* param, bool dummy)
     MD_FLOAT yprd = param->yprd;
     MD_FLOAT zprd = param->zprd;
 
-    for (int i = 0; i < atom->Nlocal; i++) {
-        if (atom_x(i) < 0.0) {
-            atom_x(i) += xprd;
-        } else if (atom_x(i) >= xprd) {
-            atom_x(i) -= xprd;
-        }
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
 
-        if (atom_y(i) < 0.0) {
-            atom_y(i) += yprd;
-        } else if (atom_y(i) >= yprd) {
-            atom_y(i) -= yprd;
-        }
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            if (ci_x[CL_X_OFFSET + cii] < 0.0) {
+                ci_x[CL_X_OFFSET + cii] += xprd;
+            } else if (ci_x[CL_X_OFFSET + cii] >= xprd) {
+                ci_x[CL_X_OFFSET + cii] -= xprd;
+            }
+
+            if (ci_x[CL_Y_OFFSET + cii] < 0.0) {
+                ci_x[CL_Y_OFFSET + cii] += yprd;
+            } else if (ci_x[CL_Y_OFFSET + cii] >= yprd) {
+                ci_x[CL_Y_OFFSET + cii] -= yprd;
+            }
 
-        if (atom_z(i) < 0.0) {
-            atom_z(i) += zprd;
-        } else if (atom_z(i) >= zprd) {
-            atom_z(i) -= zprd;
+            if (ci_x[CL_Z_OFFSET + cii] < 0.0) {
+                ci_x[CL_Z_OFFSET + cii] += zprd;
+            } else if (ci_x[CL_Z_OFFSET + cii] >= zprd) {
+                ci_x[CL_Z_OFFSET + cii] -= zprd;
+            }
         }
     }
 }
 
-/* setup periodic boundary conditions by
- * defining ghost atoms around domain
- * only creates mapping and coordinate corrections
- * that are then enforced in updatePbc */
-#define ADDGHOST(dx, dy, dz)                                                             \
-    Nghost++;                                                                            \
-    const int cg               = ncj + Nghost;                                           \
-    const int cj_natoms        = atom->jclusters[cj].natoms;                             \
-    atom->border_map[Nghost]   = cj;                                                     \
-    atom->PBCx[Nghost]         = dx;                                                     \
-    atom->PBCy[Nghost]         = dy;                                                     \
-    atom->PBCz[Nghost]         = dz;                                                     \
-    atom->jclusters[cg].natoms = cj_natoms;                                              \
-    Nghost_atoms += cj_natoms;                                                           \
-    int cj_sca_base = CJ_SCALAR_BASE_INDEX(cj);                                          \
-    int cg_sca_base = CJ_SCALAR_BASE_INDEX(cg);                                          \
-    for (int cjj = 0; cjj < cj_natoms; cjj++) {                                          \
-        atom->cl_t[cg_sca_base + cjj] = atom->cl_t[cj_sca_base + cjj];                   \
+/* internal subroutines */
+void setupShiftVectors(Atom* atom, Parameter* param)
+{
+    for (int sz = -1; sz <= 1; sz++) {
+        for (int sy = -1; sy <= 1; sy++) {
+            for (int sx = -1; sx <= 1; sx++) {
+                MD_FLOAT* shift = atom->shiftvec[SHIFT_INDEX(sx, sy, sz)];
+                shift[0]        = sx * param->xprd;
+                shift[1]        = sy * param->yprd;
+                shift[2]        = sz * param->zprd;
+            }
+        }
     }
+}
 
-/* internal subroutines */
+#ifndef PBC_SHIFTS
 void growPbc(Atom* atom)
 {
     int nold = NmaxGhost;
-    NmaxGhost += DELTA;
+    NmaxGhost = GROW_CAPACITY(NmaxGhost, DELTA);
 
     atom->border_map = (int*)reallocate(atom->border_map,
         ALIGNMENT,
@@ -183,132 +204,123 @@ void growPbc(Atom* atom)
     atom->PBCz = (int*)
         reallocate(atom->PBCz, ALIGNMENT, NmaxGhost * sizeof(int), nold * sizeof(int));
 }
+#endif
 
+// Scratch arrays of setupPbc, their contents are not kept between calls
+void growBorders(int n)
+{
+    if (n > NmaxBorder) {
+        deallocate(border);
+        deallocate(ghost_offset);
+        NmaxBorder   = GROW_CAPACITY(n, DELTA);
+        border       = (int*)allocate(ALIGNMENT, NmaxBorder * sizeof(int));
+        ghost_offset = (int*)allocate(ALIGNMENT, NmaxBorder * sizeof(int));
+    }
+}
+
+/* first pass of setupPbc: the box sides every j-cluster is close to and the index
+ * of its first ghost, returns the number of ghost clusters */
+static int findBorders(Atom* atom, Parameter* param, int* nghost_atoms)
+{
+    MD_FLOAT xprd              = param->xprd;
+    MD_FLOAT yprd              = param->yprd;
+    MD_FLOAT zprd              = param->zprd;
+    MD_FLOAT cutNeigh          = param->cutneigh;
+    MD_FLOAT lo[3]             = { cutNeigh, cutNeigh, cutNeigh };
+    MD_FLOAT hi[3]             = { xprd - cutNeigh, yprd - cutNeigh, zprd - cutNeigh };
+    const BorderImages* images = getBorderImages();
+    int ncj                    = get_ncj_from_nci(atom->Nclusters_local);
+    int Nghost                 = 0;
+    int Nghost_atoms           = 0;
+
+    growBorders(ncj);
+
+#pragma omp parallel for schedule(static) reduction(+ : Nghost_atoms)
+    for (int cj = 0; cj < ncj; cj++) {
+        Cluster* cluster = &atom->jclusters[cj];
+        border[cj]       = 0;
+        if (cluster->natoms > 0) {
+            border[cj] = getBorderMask(lo,
+                hi,
+                cluster->bbminx,
+                cluster->bbmaxx,
+                cluster->bbminy,
+                cluster->bbmaxy,
+                cluster->bbminz,
+                cluster->bbmaxz);
+            Nghost_atoms += images[border[cj]].nimages * cluster->natoms;
+        }
+    }
+
+    for (int cj = 0; cj < ncj; cj++) {
+        ghost_offset[cj] = Nghost;
+        Nghost += images[border[cj]].nimages;
+    }
+
+    *nghost_atoms = Nghost_atoms;
+    return Nghost;
+}
+
+/* setup periodic boundary conditions by
+ * defining ghost clusters around domain
+ * only creates mapping and coordinate corrections
+ * that are then enforced in updatePbc;
+ * the first pass finds the box sides every j-cluster is close to, after a prefix
+ * sum over its image counts the second pass writes the ghosts of each cluster at
+ * its offset, so the ghost order does not depend on the number of threads */
 void setupPbc(Atom* atom, Parameter* param)
 {
     DEBUG_MESSAGE("setupPbc start\n");
-    MD_FLOAT xprd     = param->xprd;
-    MD_FLOAT yprd     = param->yprd;
-    MD_FLOAT zprd     = param->zprd;
-    MD_FLOAT cutNeigh = param->cutneigh;
-    int jfac          = MAX(1, CLUSTER_N / CLUSTER_M);
-    int ncj           = get_ncj_from_nci(atom->Nclusters_local);
-    int Nghost        = -1;
-    int Nghost_atoms  = 0;
+    int jfac         = MAX(1, CLUSTER_N / CLUSTER_M);
+    int ncj          = get_ncj_from_nci(atom->Nclusters_local);
+    int Nghost       = 0;
+    int Nghost_atoms = 0;
+
+    setupShiftVectors(atom, param);
+
+    // With shift vectors the neighbor search visits the periodic images itself and
+    // only the dummy cluster follows the local j-clusters
+#ifndef PBC_SHIFTS
+    Nghost = findBorders(atom, param, &Nghost_atoms);
+    while (Nghost >= NmaxGhost) {
+        growPbc(atom);
+    }
+#endif
+
+    // Ghosts and the dummy cluster follow the local j-clusters
+    while (atom->Nclusters_local + (Nghost + 2) * jfac >= atom->Nclusters_max) {
+        growClusters(atom);
+    }
 
+#ifndef PBC_SHIFTS
+    const BorderImages* images = getBorderImages();
+
+#pragma omp parallel for schedule(static)
     for (int cj = 0; cj < ncj; cj++) {
-        if (atom->jclusters[cj].natoms > 0) {
-            if (atom->Nclusters_local + (Nghost + 7) * jfac >= atom->Nclusters_max) {
-                growClusters(atom);
-            }
+        const BorderImages* b = &images[border[cj]];
+        const int natoms      = atom->jclusters[cj].natoms;
+        const int* cjT        = &atom->cl_t[CJ_SCALAR_BASE_INDEX(cj)];
 
-            if ((Nghost + 7) * jfac >= NmaxGhost) {
-                growPbc(atom);
-            }
+        for (int g = 0; g < b->nimages; g++) {
+            const int ghost = ghost_offset[cj] + g;
+            const int cg    = ncj + ghost;
+            int* cgT        = &atom->cl_t[CJ_SCALAR_BASE_INDEX(cg)];
 
-            MD_FLOAT bbminx = atom->jclusters[cj].bbminx;
-            MD_FLOAT bbmaxx = atom->jclusters[cj].bbmaxx;
-            MD_FLOAT bbminy = atom->jclusters[cj].bbminy;
-            MD_FLOAT bbmaxy = atom->jclusters[cj].bbmaxy;
-            MD_FLOAT bbminz = atom->jclusters[cj].bbminz;
-            MD_FLOAT bbmaxz = atom->jclusters[cj].bbmaxz;
-
-            /* Setup ghost atoms */
-            /* 6 planes */
-            if (bbminx < cutNeigh) {
-                ADDGHOST(+1, 0, 0);
-            }
-            if (bbmaxx >= (xprd - cutNeigh)) {
-                ADDGHOST(-1, 0, 0);
-            }
-            if (bbminy < cutNeigh) {
-                ADDGHOST(0, +1, 0);
-            }
-            if (bbmaxy >= (yprd - cutNeigh)) {
-                ADDGHOST(0, -1, 0);
-            }
-            if (bbminz < cutNeigh) {
-                ADDGHOST(0, 0, +1);
-            }
-            if (bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(0, 0, -1);
-            }
-            /* 8 corners */
-            if (bbminx < cutNeigh && bbminy < cutNeigh && bbminz < cutNeigh) {
-                ADDGHOST(+1, +1, +1);
-            }
-            if (bbminx < cutNeigh && bbmaxy >= (yprd - cutNeigh) && bbminz < cutNeigh) {
-                ADDGHOST(+1, -1, +1);
-            }
-            if (bbminx < cutNeigh && bbminy < cutNeigh && bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(+1, +1, -1);
-            }
-            if (bbminx < cutNeigh && bbmaxy >= (yprd - cutNeigh) &&
-                bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(+1, -1, -1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbminy < cutNeigh && bbminz < cutNeigh) {
-                ADDGHOST(-1, +1, +1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbmaxy >= (yprd - cutNeigh) &&
-                bbminz < cutNeigh) {
-                ADDGHOST(-1, -1, +1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbminy < cutNeigh &&
-                bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(-1, +1, -1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbmaxy >= (yprd - cutNeigh) &&
-                bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(-1, -1, -1);
-            }
-            /* 12 edges */
-            if (bbminx < cutNeigh && bbminz < cutNeigh) {
-                ADDGHOST(+1, 0, +1);
-            }
-            if (bbminx < cutNeigh && bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(+1, 0, -1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbminz < cutNeigh) {
-                ADDGHOST(-1, 0, +1);
-            }
-            if (bbmaxx >= (xprd - cutNeigh) && bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(-1, 0, -1);
-            }
-            if (bbminy < cutNeigh && bbminz < cutNeigh) {
-                ADDGHOST(0, +1, +1);
-            }
-            if (bbminy < cutNeigh && bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(0, +1, -1);
-            }
-            if (bbmaxy >= (yprd - cutNeigh) && bbminz < cutNeigh) {
-                ADDGHOST(0, -1, +1);
-            }
-            if (bbmaxy >= (yprd - cutNeigh) && bbmaxz >= (zprd - cutNeigh)) {
-                ADDGHOST(0, -1, -1);
-            }
-            if (bbminy < cutNeigh && bbminx < cutNeigh) {
-                ADDGHOST(+1, +1, 0);
-            }
-            if (bbminy < cutNeigh && bbmaxx >= (xprd - cutNeigh)) {
-                ADDGHOST(-1, +1, 0);
-            }
-            if (bbmaxy >= (yprd - cutNeigh) && bbminx < cutNeigh) {
-                ADDGHOST(+1, -1, 0);
-            }
-            if (bbmaxy >= (yprd - cutNeigh) && bbmaxx >= (xprd - cutNeigh)) {
-                ADDGHOST(-1, -1, 0);
+            atom->border_map[ghost]    = cj;
+            atom->PBCx[ghost]          = b->image[g][0];
+            atom->PBCy[ghost]          = b->image[g][1];
+            atom->PBCz[ghost]          = b->image[g][2];
+            atom->jclusters[cg].natoms = natoms;
+            for (int cjj = 0; cjj < natoms; cjj++) {
+                cgT[cjj] = cjT[cjj];
             }
         }
     }
-
-    if (ncj + (Nghost + 1) * jfac >= atom->Nclusters_max) {
-        growClusters(atom);
-    }
+#endif
 
     // Add dummy cluster at the end
-    int cjScaBase = CJ_SCALAR_BASE_INDEX(ncj + Nghost + 1);
-    int cjVecBase = CJ_VECTOR_BASE_INDEX(ncj + Nghost + 1);
+    int cjScaBase = CJ_SCALAR_BASE_INDEX(ncj + Nghost);
+    int cjVecBase = CJ_VECTOR_BASE_INDEX(ncj + Nghost);
     int* cjT      = &atom->cl_t[cjScaBase];
     MD_FLOAT* cjX = &atom->cl_x[cjVecBase];
     for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
@@ -318,13 +330,57 @@ void setupPbc(Atom* atom, Parameter* param)
         cjT[cjj]               = 0;
     }
 
-    // increase by one to make it the ghost atom count
-    atom->dummy_cj        = ncj + Nghost + 1;
+    atom->dummy_cj        = ncj + Nghost;
     atom->Nghost          = Nghost_atoms;
-    atom->Nclusters_ghost = Nghost + 1;
-    atom->Nclusters       = atom->Nclusters_local + Nghost + 1;
+    atom->Nclusters_ghost = Nghost;
+    atom->Nclusters       = atom->Nclusters_local + Nghost;
 
     // Update created ghost clusters positions
     updatePbcCPU(atom, param, 1);
     DEBUG_MESSAGE("setupPbc end\n");
 }
+
+#ifdef PBC_SHIFTS
+#define GHOST_UPDATE_REPEAT 10
+
+/* what the ghost cluster mode would cost on the current positions: the number of
+ * its ghost clusters and the time of one update of their coordinates, which is
+ * timed on a scratch array that is released again */
+double timeGhostUpdate(Atom* atom, Parameter* param, int* nghost)
+{
+    const BorderImages* images = getBorderImages();
+    int ncj                    = get_ncj_from_nci(atom->Nclusters_local);
+    int Nghost_atoms           = 0;
+    int Nghost                 = findBorders(atom, param, &Nghost_atoms);
+    MD_FLOAT* ghost_x          = (MD_FLOAT*)allocate(ALIGNMENT,
+        (size_t)MAX(Nghost, 1) * CLUSTER_N * 3 * sizeof(MD_FLOAT));
+    double S, E;
+
+    S = getTimeStamp();
+    for (int r = 0; r < GHOST_UPDATE_REPEAT; r++) {
+#pragma omp parallel for schedule(static)
+        for (int cj = 0; cj < ncj; cj++) {
+            const BorderImages* b = &images[border[cj]];
+            const MD_FLOAT* cjX   = &atom->cl_x[CJ_VECTOR_BASE_INDEX(cj)];
+
+            for (int g = 0; g < b->nimages; g++) {
+                MD_FLOAT* cgX = &ghost_x[(size_t)(ghost_offset[cj] + g) * CLUSTER_N * 3];
+                MD_FLOAT sx   = b->image[g][0] * param->xprd;
+                MD_FLOAT sy   = b->image[g][1] * param->yprd;
+                MD_FLOAT sz   = b->image[g][2] * param->zprd;
+
+                for (int cjj = 0; cjj < atom->jclusters[cj].natoms; cjj++) {
+                    cgX[cjj]                 = cjX[CL_X_OFFSET + cjj] + sx;
+                    cgX[CLUSTER_N + cjj]     = cjX[CL_Y_OFFSET + cjj] + sy;
+                    cgX[2 * CLUSTER_N + cjj] = cjX[CL_Z_OFFSET + cjj] + sz;
+                }
+            }
+        }
+    }
+    E = getTimeStamp();
+
+    deallocate(ghost_x);
+    *nghost = Nghost;
+    return (E - S) / GHOST_UPDATE_REPEAT;
+}
+#endif
@@ -20,6 +20,9 @@ extern void initPbc(Atom*);
 extern void updatePbcCPU(Atom*, Parameter*, bool);
 extern void updateAtomsPbcCPU(Atom*, Parameter*, bool);
 extern void setupPbc(Atom*, Parameter*);
+#ifdef PBC_SHIFTS
+extern double timeGhostUpdate(Atom*, Parameter*, int*);
+#endif
 
 #ifdef CUDA_TARGET
 extern void updatePbcCUDA(Atom*, Parameter*, bool);
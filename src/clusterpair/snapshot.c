@@ -0,0 +1,249 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <allocate.h>
+#include <atom.h>
+#include <force.h>
+#include <neighbor.h>
+#include <parameter.h>
+#include <snapshot.h>
+#include <util.h>
+
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t float_size;
+    int32_t cluster_m;
+    int32_t cluster_n;
+    int32_t step;
+    int32_t force_field;
+    int32_t half_neigh;
+    int32_t ntypes;
+    int32_t nlocal;
+    int32_t nclusters_local;
+    int32_t nclusters_ghost;
+    int32_t nblocks; // Number of CLUSTER_M sized blocks in cl_x/cl_t
+    int32_t maxneighs;
+    int64_t nneighs;
+    double cutforce;
+    double epsilon;
+    double sigma6;
+} SnapshotHeader;
+
+static void writeData(FILE* fp, const void* ptr, size_t size, size_t n)
+{
+    if (n > 0 && fwrite(ptr, size, n, fp) != n) {
+        fprintf(stderr, "Error: Could not write snapshot data!\n");
+        exit(-1);
+    }
+}
+
+static void readData(FILE* fp, void* ptr, size_t size, size_t n)
+{
+    if (n > 0 && fread(ptr, size, n, fp) != n) {
+        fprintf(stderr, "Error: Snapshot file is truncated!\n");
+        exit(-1);
+    }
+}
+
+void writeSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor, int step)
+{
+    SnapshotHeader header;
+    FILE* fp;
+    int cjmax = 0;
+
+    if (param->force_field != FF_LJ) {
+        fprintf(stderr, "Warning: Snapshots are only supported for LJ, skipping!\n");
+        return;
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open snapshot file %s for writing!\n", filename);
+        return;
+    }
+
+    memset(&header, 0, sizeof(SnapshotHeader));
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int* neighs = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
+        for (int k = 0; k < neighbor->numneigh[ci]; k++) {
+            cjmax = MAX(cjmax, neighs[k]);
+        }
+
+        header.nneighs += neighbor->numneigh[ci];
+    }
+
+    // Cluster data must cover the local i-clusters and every referenced j-cluster
+    // (including ghosts and the dummy cluster), counted in i-cluster blocks
+    int cjEnd   = CJ_SCALAR_BASE_INDEX(cjmax) + CLUSTER_N;
+    int nblocks = MAX(atom->Nclusters_local, (cjEnd + CLUSTER_M - 1) / CLUSTER_M);
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version         = SNAPSHOT_VERSION;
+    header.float_size      = sizeof(MD_FLOAT);
+    header.cluster_m       = CLUSTER_M;
+    header.cluster_n       = CLUSTER_N;
+    header.step            = step;
+    header.force_field     = param->force_field;
+    header.half_neigh      = param->half_neigh;
+    header.ntypes          = atom->ntypes;
+    header.nlocal          = atom->Nlocal;
+    header.nclusters_local = atom->Nclusters_local;
+    header.nclusters_ghost = atom->Nclusters_ghost;
+    header.nblocks         = nblocks;
+    header.maxneighs       = neighbor->maxneighs;
+    header.cutforce        = param->cutforce;
+    header.epsilon         = param->epsilon;
+    header.sigma6          = param->sigma6;
+
+    const int ntypes2 = atom->ntypes * atom->ntypes;
+    writeData(fp, &header, sizeof(SnapshotHeader), 1);
+    writeData(fp, atom->epsilon, sizeof(MD_FLOAT), ntypes2);
+    writeData(fp, atom->sigma6, sizeof(MD_FLOAT), ntypes2);
+    writeData(fp, atom->cutforcesq, sizeof(MD_FLOAT), ntypes2);
+    writeData(fp, atom->iclusters, sizeof(Cluster), atom->Nclusters_local);
+    writeData(fp, atom->cl_x, sizeof(MD_FLOAT), (size_t)nblocks * CLUSTER_M * 3);
+    writeData(fp, atom->cl_t, sizeof(int), (size_t)nblocks * CLUSTER_M);
+    writeData(fp, neighbor->numneigh, sizeof(int), atom->Nclusters_local);
+    writeData(fp, neighbor->numneigh_masked, sizeof(int), atom->Nclusters_local);
+    writeData(fp, neighbor->numsegments, sizeof(int), atom->Nclusters_local);
+    writeData(fp, atom->shiftvec, sizeof(MD_FLOAT), NUM_SHIFTS * 3);
+
+    // Lists are stored compactly, without the padding up to maxneighs
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        writeData(fp,
+            &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)],
+            sizeof(int),
+            neighbor->numneigh[ci]);
+        writeData(fp,
+            &neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)],
+            sizeof(unsigned int),
+            neighbor->numneigh[ci]);
+        writeData(fp,
+            &neighbor->segments[SEGMENT_OFFSET(ci)],
+            sizeof(NeighborSegment),
+            neighbor->numsegments[ci]);
+    }
+
+    fclose(fp);
+    printf("Snapshot of step %d written to %s (%d i-clusters, %lld cluster pairs)\n",
+        step,
+        filename,
+        atom->Nclusters_local,
+        (long long)header.nneighs);
+}
+
+int readSnapshot(const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    SnapshotHeader header;
+    FILE* fp = fopen(filename, "rb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open snapshot file %s!\n", filename);
+        exit(-1);
+    }
+
+    readData(fp, &header, sizeof(SnapshotHeader), 1);
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) != 0 ||
+        header.version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Error: %s is not a cluster pair snapshot!\n", filename);
+        exit(-1);
+    }
+
+    if (header.float_size != sizeof(MD_FLOAT) || header.cluster_m != CLUSTER_M ||
+        header.cluster_n != CLUSTER_N) {
+        fprintf(stderr,
+            "Error: Snapshot was written with %s precision and %dx%d clusters, this "
+            "binary uses %s precision and %dx%d clusters!\n",
+            (header.float_size == 4) ? "single" : "double",
+            header.cluster_m,
+            header.cluster_n,
+            PRECISION_STRING,
+            CLUSTER_M,
+            CLUSTER_N);
+        exit(-1);
+    }
+
+    param->force_field = header.force_field;
+    param->half_neigh  = header.half_neigh;
+    param->ntypes      = header.ntypes;
+    param->cutforce    = header.cutforce;
+    param->epsilon     = header.epsilon;
+    param->sigma6      = header.sigma6;
+
+    const int ntypes2 = header.ntypes * header.ntypes;
+    atom->ntypes      = header.ntypes;
+    atom->epsilon     = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->sigma6      = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->cutforcesq  = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->cutneighsq  = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    readData(fp, atom->epsilon, sizeof(MD_FLOAT), ntypes2);
+    readData(fp, atom->sigma6, sizeof(MD_FLOAT), ntypes2);
+    readData(fp, atom->cutforcesq, sizeof(MD_FLOAT), ntypes2);
+    memcpy(atom->cutneighsq, atom->cutforcesq, ntypes2 * sizeof(MD_FLOAT));
+
+    while (atom->Nclusters_max < header.nblocks) {
+        growClusters(atom);
+    }
+
+    atom->Nlocal          = header.nlocal;
+    atom->Nclusters_local = header.nclusters_local;
+    atom->Nclusters_ghost = header.nclusters_ghost;
+    atom->Nclusters       = header.nclusters_local + header.nclusters_ghost;
+    readData(fp, atom->iclusters, sizeof(Cluster), header.nclusters_local);
+    readData(fp, atom->cl_x, sizeof(MD_FLOAT), (size_t)header.nblocks * CLUSTER_M * 3);
+    readData(fp, atom->cl_t, sizeof(int), (size_t)header.nblocks * CLUSTER_M);
+
+    const size_t nslots       = (size_t)atom->Nclusters_max * header.maxneighs;
+    neighbor->half_neigh      = header.half_neigh;
+    neighbor->maxneighs       = header.maxneighs;
+    neighbor->numneigh        = (int*)allocate(ALIGNMENT,
+        atom->Nclusters_max * sizeof(int));
+    neighbor->numneigh_masked = (int*)allocate(ALIGNMENT,
+        atom->Nclusters_max * sizeof(int));
+    neighbor->neighbors       = (int*)allocate(ALIGNMENT, nslots * sizeof(int));
+    neighbor->neighbors_imask = (unsigned int*)allocate(ALIGNMENT,
+        nslots * sizeof(unsigned int));
+    neighbor->numsegments     = (int*)allocate(ALIGNMENT,
+        atom->Nclusters_max * sizeof(int));
+    neighbor->segments        = (NeighborSegment*)allocate(ALIGNMENT,
+        SEGMENT_OFFSET(atom->Nclusters_max) * sizeof(NeighborSegment));
+    readData(fp, neighbor->numneigh, sizeof(int), header.nclusters_local);
+    readData(fp, neighbor->numneigh_masked, sizeof(int), header.nclusters_local);
+    readData(fp, neighbor->numsegments, sizeof(int), header.nclusters_local);
+    readData(fp, atom->shiftvec, sizeof(MD_FLOAT), NUM_SHIFTS * 3);
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        if (neighbor->numsegments[ci] > MAX_SEGMENTS) {
+            fprintf(stderr,
+                "Error: Snapshot lists use periodic shifts, rebuild with "
+                "PBC_SHIFTS=true to replay them!\n");
+            exit(-1);
+        }
+
+        readData(fp,
+            &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)],
+            sizeof(int),
+            neighbor->numneigh[ci]);
+        readData(fp,
+            &neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)],
+            sizeof(unsigned int),
+            neighbor->numneigh[ci]);
+        readData(fp,
+            &neighbor->segments[SEGMENT_OFFSET(ci)],
+            sizeof(NeighborSegment),
+            neighbor->numsegments[ci]);
+    }
+
+    fclose(fp);
+    return header.step;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <atom.h>
+#include <neighbor.h>
+#include <parameter.h>
+
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+// A snapshot holds everything computeForce reads: cluster positions and types
+// (local and ghost), the force field tables and the cluster pair lists with
+// their interaction masks, list segments and the periodic shift vectors. It is
+// written by the main binary and replayed by the stub, the cluster layout (MxN,
+// precision) must match between both.
+#define SNAPSHOT_MAGIC   "MDBSNPCP"
+#define SNAPSHOT_VERSION 2
+
+extern void writeSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor, int step);
+extern int readSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor);
+#endif
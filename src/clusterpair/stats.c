@@ -5,15 +5,38 @@
  * license that can be found in the LICENSE file.
  */
 #include <stdio.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+#include <allocate.h>
 #include <atom.h>
 #include <force.h>
+#include <frequency.h>
 #include <parameter.h>
+#include <perfctr.h>
+#include <report.h>
 #include <stats.h>
 #include <timers.h>
+#include <util.h>
+
+static LaneStats* lane_stats = NULL;
+static int nthreads          = 0;
 
 void initStats(Stats* s)
 {
+    if (lane_stats == NULL) {
+#ifdef _OPENMP
+        nthreads = omp_get_max_threads();
+#else
+        nthreads = 1;
+#endif
+        lane_stats = (LaneStats*)allocate(64, nthreads * sizeof(LaneStats));
+    }
+
+    memset(lane_stats, 0, nthreads * sizeof(LaneStats));
+
     s->calculated_forces       = 0;
     s->num_neighs              = 0;
     s->force_iters             = 0;
@@ -21,7 +44,59 @@ void initStats(Stats* s)
     s->atoms_outside_cutoff    = 0;
     s->clusters_within_cutoff  = 0;
     s->clusters_outside_cutoff = 0;
+    s->lanes                   = lane_stats;
+}
+
+#ifdef LANE_STATS
+static void displayLaneStats(Stats* stats)
+{
+    const int MxN   = CLUSTER_M * CLUSTER_N;
+    const int width = MAX(1, MxN / 8);
+    LaneStats total;
+
+    memset(&total, 0, sizeof(LaneStats));
+    for (int t = 0; t < nthreads; t++) {
+        total.iters += stats->lanes[t].iters;
+        total.lanes_interact += stats->lanes[t].lanes_interact;
+        total.lanes_active += stats->lanes[t].lanes_active;
+        for (int l = 0; l <= MxN; l++) {
+            total.histogram[l] += stats->lanes[t].histogram[l];
+        }
+    }
+
+    if (total.iters == 0) {
+        return;
+    }
+
+    const double lanes    = (double)total.iters * MxN;
+    const double inside   = 100.0 * total.lanes_active / lanes;
+    const double excluded = 100.0 * (lanes - total.lanes_interact) / lanes;
+    printf("\tSIMD lanes (%d per iteration): %.2f%% inside cutoff, %.2f%% excluded by "
+           "masks\n",
+        MxN,
+        inside,
+        excluded);
+    printf("\tActive lanes per iteration:");
+    printf(" 0: %.2f%%", 100.0 * total.histogram[0] / total.iters);
+    for (int lo = 1; lo <= MxN; lo += width) {
+        int hi              = MIN(lo + width - 1, MxN);
+        long long int count = 0;
+        for (int l = lo; l <= hi; l++) {
+            count += total.histogram[l];
+        }
+
+        if (lo == hi) {
+            printf(", %d: %.2f%%", lo, 100.0 * count / total.iters);
+        } else {
+            printf(", %d-%d: %.2f%%", lo, hi, 100.0 * count / total.iters);
+        }
+    }
+
+    printf("\n");
+    reportReal("lanes_inside_cutoff_pct", inside);
+    reportReal("lanes_excluded_pct", excluded);
 }
+#endif
 
 void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer)
 {
@@ -46,10 +121,14 @@ void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer
                          sizeof(int);
 #endif
 
+    const double freq   = getFrequency(param);
+    const double cycles = timer[FORCE] * freq * 1e9;
+
     printf("Statistics:\n");
-    printf("\tVector width: %d, Processor frequency: %.4f GHz\n",
+    printf("\tVector width: %d, Processor frequency: %.4f GHz (%s)\n",
         VECTOR_WIDTH,
-        param->proc_freq);
+        freq,
+        getFrequencySource());
     printf("\tAverage atoms per cluster: %.4f\n", avgAtomsCluster);
     printf("\tAverage neighbors per atom: %.4f\n", avgNeighAtom);
     printf("\tAverage neighbors per cluster: %.4f\n", avgNeighCluster);
@@ -59,8 +138,29 @@ void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer
     printf("\tTotal number of SIMD iterations: %lld\n", stats->force_iters);
     printf("\tUseful read data volume for force computation: %.2fGB\n",
         forceUsefulVolume);
-    printf("\tCycles/SIMD iteration: %.4f\n",
-        timer[FORCE] * param->proc_freq * 1e9 / stats->force_iters);
+    printf("\tCycles/SIMD iteration: %.4f\n", cycles / stats->force_iters);
+    printf("\tCycles/pair interaction: %.4f\n", cycles / (stats->num_neighs * MxN));
+#ifdef PERFCTR
+    perfctrPrintMetrics("force", (double)stats->num_neighs * MxN);
+#endif
+
+    reportSection("stats");
+    reportInt("calculated_forces", stats->calculated_forces);
+    reportInt("num_neighs", stats->num_neighs);
+    reportInt("force_iters", stats->force_iters);
+    reportInt("pair_interactions", stats->num_neighs * MxN);
+    reportReal("avg_atoms_per_cluster", avgAtomsCluster);
+    reportReal("avg_neighbors_per_atom", avgNeighAtom);
+    reportReal("avg_neighbors_per_cluster", avgNeighCluster);
+    reportReal("avg_simd_iters_per_atom", avgSimd);
+    reportReal("useful_force_volume_gb", forceUsefulVolume);
+    reportReal("frequency_ghz", freq);
+    reportString("frequency_source", getFrequencySource());
+    reportReal("cycles_per_simd_iter", cycles / stats->force_iters);
+    reportReal("cycles_per_pair", cycles / (stats->num_neighs * MxN));
+#ifdef LANE_STATS
+    displayLaneStats(stats);
+#endif
 
 #ifdef USE_REFERENCE_VERSION
     const double atoms_eff = (double)stats->atoms_within_cutoff /
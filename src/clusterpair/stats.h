@@ -9,6 +9,19 @@
 
 #ifndef __STATS_H_
 #define __STATS_H_
+#define LANE_STATS_MAX_LANES 64
+
+// Lane counters of the SIMD kernels, accumulated per thread. For every kernel
+// iteration (one cluster pair) the lanes left by the exclusion masks and the
+// lanes inside the cutoff are counted, the histogram is over the latter.
+typedef struct {
+    long long int iters;
+    long long int lanes_interact;
+    long long int lanes_active;
+    long long int histogram[LANE_STATS_MAX_LANES + 1];
+    char pad[64]; // keep the counters of neighbouring threads on separate lines
+} LaneStats;
+
 typedef struct {
     long long int calculated_forces;
     long long int num_neighs;
@@ -17,6 +30,7 @@ typedef struct {
     long long int atoms_outside_cutoff;
     long long int clusters_within_cutoff;
     long long int clusters_outside_cutoff;
+    LaneStats* lanes;
 } Stats;
 
 void initStats(Stats* s);
@@ -32,4 +46,29 @@ void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer
 #define endStatTimer(stat)
 #endif
 
+#ifdef LANE_STATS
+#ifdef _OPENMP
+#include <omp.h>
+#define LANE_STATS_THREAD omp_get_thread_num()
+#else
+#define LANE_STATS_THREAD 0
+#endif
+
+static inline void recordLanes(LaneStats* ls, int interact, int active)
+{
+    ls->iters++;
+    ls->lanes_interact += interact;
+    ls->lanes_active += active;
+    ls->histogram[active]++;
+}
+
+#define beginLaneStats(stats)                                                            \
+    LaneStats* lane_stats = &(stats)->lanes[LANE_STATS_THREAD]
+#define addLaneStats(interact, active) recordLanes(lane_stats, interact, active)
+#define laneCount(mask)                __builtin_popcount(simd_mask_to_u32(mask))
+#else
+#define beginLaneStats(stats)
+#define addLaneStats(interact, active)
+#endif
+
 #endif
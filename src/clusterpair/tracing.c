@@ -5,56 +5,94 @@
  * license that can be found in the LICENSE file.
  */
 #include <atom.h>
+#include <force.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <tracing.h>
 
+// Follows the access pattern of the cluster pair kernels: i-cluster positions
+// and types, then per cluster pair the list entry, its interaction mask and the
+// j-cluster positions and types, and finally the i-cluster force update
 void traceAddresses(Parameter* param, Atom* atom, Neighbor* neighbor, int timestep)
 {
     MEM_TRACER_INIT;
     INDEX_TRACER_INIT;
-    int Nlocal = atom->Nlocal;
     int* neighs;
     unsigned int* neighs_imask;
-    // MD_FLOAT* fx = atom->fx; MD_FLOAT* fy = atom->fy; MD_FLOAT* fz = atom->fz;
+    const int ncl = atom->Nclusters_max;
+    const int nci = atom->Nclusters_local;
 
-    INDEX_TRACE_NATOMS(Nlocal, atom->Nghost, neighbor->maxneighs);
-    for (int i = 0; i < Nlocal; i++) {
-        neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
-        int numneighs = neighbor->numneigh[i];
-        MEM_TRACE(atom_x(i), 'R');
-        MEM_TRACE(atom_y(i), 'R');
-        MEM_TRACE(atom_z(i), 'R');
-        INDEX_TRACE_ATOM(i);
+    MEM_TRACE_ARRAY("cl_x", atom->cl_x, (size_t)ncl * CLUSTER_M * 3);
+    MEM_TRACE_ARRAY("cl_f", atom->cl_f, (size_t)ncl * CLUSTER_M * 3);
+    MEM_TRACE_ARRAY("cl_t", atom->cl_t, (size_t)ncl * CLUSTER_M);
+    MEM_TRACE_ARRAY("numneigh", neighbor->numneigh, nci);
+    MEM_TRACE_ARRAY("neighbors", neighbor->neighbors, (size_t)nci * neighbor->maxneighs);
+    MEM_TRACE_ARRAY("neighbors_imask",
+        neighbor->neighbors_imask,
+        (size_t)nci * neighbor->maxneighs);
 
+    INDEX_TRACE_NATOMS(atom->Nclusters_local, atom->Nclusters_ghost, neighbor->maxneighs);
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+        MD_FLOAT* ci_f  = &atom->cl_f[ci_vec_base];
+        neighs          = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, ci)];
+        neighs_imask    = &neighbor->neighbors_imask[NEIGHBOR_OFFSET(neighbor, ci)];
+        int numneighs   = neighbor->numneigh[ci];
+        MEM_TRACE(neighbor->numneigh[ci], 'R');
+        INDEX_TRACE_ATOM(ci);
+
+        for (int cii = 0; cii < CLUSTER_M; cii++) {
+            MEM_TRACE(ci_x[CL_X_OFFSET + cii], 'R');
+            MEM_TRACE(ci_x[CL_Y_OFFSET + cii], 'R');
+            MEM_TRACE(ci_x[CL_Z_OFFSET + cii], 'R');
 #ifndef ONE_ATOM_TYPE
-        MEM_TRACE(atom->type[i], 'R');
+            MEM_TRACE(atom->cl_t[CI_SCALAR_BASE_INDEX(ci) + cii], 'R');
 #endif
+        }
 
-        DIST_TRACE_SORT(neighs, numneighs);
+        // Sorting the list in place (DIST_TRACE_SORT) would detach the entries
+        // from their interaction masks, so distances are traced in list order
         INDEX_TRACE(neighs, numneighs);
         DIST_TRACE(neighs, numneighs);
 
         for (int k = 0; k < numneighs; k++) {
-            int j = neighs[k];
-            MEM_TRACE(j, 'R');
-            MEM_TRACE(atom_x(j), 'R');
-            MEM_TRACE(atom_y(j), 'R');
-            MEM_TRACE(atom_z(j), 'R');
+            int cj          = neighs[k];
+            int cj_vec_base = CJ_VECTOR_BASE_INDEX(cj);
+            MD_FLOAT* cj_x  = &atom->cl_x[cj_vec_base];
+            MD_FLOAT* cj_f  = &atom->cl_f[cj_vec_base];
+            MEM_TRACE(neighs[k], 'R');
+            MEM_TRACE(neighs_imask[k], 'R');
 
+            for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
+                MEM_TRACE(cj_x[CL_X_OFFSET + cjj], 'R');
+                MEM_TRACE(cj_x[CL_Y_OFFSET + cjj], 'R');
+                MEM_TRACE(cj_x[CL_Z_OFFSET + cjj], 'R');
 #ifndef ONE_ATOM_TYPE
-            MEM_TRACE(atom->type[j], 'R');
+                MEM_TRACE(atom->cl_t[CJ_SCALAR_BASE_INDEX(cj) + cjj], 'R');
 #endif
+            }
+
+            if (param->half_neigh) {
+                for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
+                    MEM_TRACE(cj_f[CL_X_OFFSET + cjj], 'R');
+                    MEM_TRACE(cj_f[CL_X_OFFSET + cjj], 'W');
+                    MEM_TRACE(cj_f[CL_Y_OFFSET + cjj], 'R');
+                    MEM_TRACE(cj_f[CL_Y_OFFSET + cjj], 'W');
+                    MEM_TRACE(cj_f[CL_Z_OFFSET + cjj], 'R');
+                    MEM_TRACE(cj_f[CL_Z_OFFSET + cjj], 'W');
+                }
+            }
         }
 
-        /*
-        MEM_TRACE(fx[i], 'R');
-        MEM_TRACE(fx[i], 'W');
-        MEM_TRACE(fy[i], 'R');
-        MEM_TRACE(fy[i], 'W');
-        MEM_TRACE(fz[i], 'R');
-        MEM_TRACE(fz[i], 'W');
-        */
+        for (int cii = 0; cii < CLUSTER_M; cii++) {
+            MEM_TRACE(ci_f[CL_X_OFFSET + cii], 'R');
+            MEM_TRACE(ci_f[CL_X_OFFSET + cii], 'W');
+            MEM_TRACE(ci_f[CL_Y_OFFSET + cii], 'R');
+            MEM_TRACE(ci_f[CL_Y_OFFSET + cii], 'W');
+            MEM_TRACE(ci_f[CL_Z_OFFSET + cii], 'R');
+            MEM_TRACE(ci_f[CL_Z_OFFSET + cii], 'W');
+        }
     }
 
     INDEX_TRACER_END;
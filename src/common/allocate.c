@@ -8,27 +8,135 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <util.h>
 
+#include <allocate.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAX_MAPPINGS   256
+#define MAX_NODES      64
+#define MAX_SAMPLES    4096
+// Smaller arrays are left to the first thread writing them, a parallel region per
+// scratch buffer costs more than the placement of a few pages gains
+#define FIRST_TOUCH_MIN (1024 * 1024)
+
+// Explicit huge pages are mapped with mmap and must be released with munmap,
+// so these mappings are tracked and deallocate() checks them before free()
+static void* mappings[MAX_MAPPINGS];
+static size_t mapping_sizes[MAX_MAPPINGS];
+static int nmappings = 0;
+
+// Data copied when arrays grow, reported at the end of the run
+static size_t reallocated_bytes = 0;
+static int nreallocations       = 0;
+
+#ifdef HUGE_PAGES_EXPLICIT
+static void* allocateHugeMapping(size_t bytesize)
+{
+#ifdef MAP_HUGETLB
+    static int warned = 0;
+    size_t mapsize    = (bytesize + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+
+    if (nmappings < MAX_MAPPINGS) {
+        void* ptr = mmap(NULL,
+            mapsize,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0);
+
+        if (ptr != MAP_FAILED) {
+            mappings[nmappings]      = ptr;
+            mapping_sizes[nmappings] = mapsize;
+            nmappings++;
+            return ptr;
+        }
+    }
+
+    if (!warned) {
+        fprintf(stderr,
+            "Warning: MAP_HUGETLB failed (no huge pages reserved?), falling back to "
+            "transparent huge pages\n");
+        warned = 1;
+    }
+#endif
+
+    return NULL;
+}
+#endif
+
+static int findMapping(void* ptr)
+{
+    for (int i = 0; i < nmappings; i++) {
+        if (mappings[i] == ptr) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* touch every page from the same threads and with the same static schedule
+ * as the OpenMP compute loops, so pages end up on the NUMA node of the thread
+ * that later works on them */
+void firstTouch(void* ptr, size_t bytesize)
+{
+    char* bytes       = (char*)ptr;
+    const long page   = sysconf(_SC_PAGESIZE);
+    const long npages = (bytesize + page - 1) / page;
+
+#pragma omp parallel for schedule(static)
+    for (long p = 0; p < npages; p++) {
+        bytes[p * page] = 0;
+    }
+}
+
 void* allocate(int alignment, size_t bytesize)
 {
-    void* ptr;
+    void* ptr = NULL;
     int errorCode;
 
-    errorCode = posix_memalign(&ptr, alignment, bytesize);
-    if (errorCode == EINVAL) {
-        fprintf(stderr, "Error: Alignment parameter is not a power of two\n");
-        exit(EXIT_FAILURE);
+#ifdef HUGE_PAGES_EXPLICIT
+    if (bytesize >= HUGE_PAGE_SIZE) {
+        ptr = allocateHugeMapping(bytesize);
     }
+#endif
 
-    if (errorCode == ENOMEM) {
-        fprintf(stderr, "Error: Insufficient memory to fulfill the request\n");
-        exit(EXIT_FAILURE);
+    if (ptr == NULL) {
+#if defined(HUGE_PAGES_THP) || defined(HUGE_PAGES_EXPLICIT)
+        if (bytesize >= HUGE_PAGE_SIZE) {
+            alignment = MAX(alignment, HUGE_PAGE_SIZE);
+        }
+#endif
+
+        errorCode = posix_memalign(&ptr, alignment, bytesize);
+        if (errorCode == EINVAL) {
+            fprintf(stderr, "Error: Alignment parameter is not a power of two\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (errorCode == ENOMEM) {
+            fprintf(stderr, "Error: Insufficient memory to fulfill the request\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (ptr == NULL) {
+            fprintf(stderr, "Error: posix_memalign failed!\n");
+            exit(EXIT_FAILURE);
+        }
+
+#if defined(HUGE_PAGES_THP) || defined(HUGE_PAGES_EXPLICIT)
+        if (bytesize >= HUGE_PAGE_SIZE) {
+            madvise(ptr, bytesize, MADV_HUGEPAGE);
+        }
+#endif
     }
 
-    if (ptr == NULL) {
-        fprintf(stderr, "Error: posix_memalign failed!\n");
-        exit(EXIT_FAILURE);
+    if (bytesize >= FIRST_TOUCH_MIN) {
+        firstTouch(ptr, bytesize);
     }
 
     return ptr;
@@ -39,8 +147,94 @@ void* reallocate(void* ptr, int alignment, size_t new_bytesize, size_t old_bytes
     void* newarray = allocate(alignment, new_bytesize);
     if (ptr != NULL) {
         memcpy(newarray, ptr, old_bytesize);
-        free(ptr);
+        deallocate(ptr);
+        reallocated_bytes += old_bytesize;
+        nreallocations++;
     }
 
     return newarray;
 }
+
+size_t getReallocatedBytes(void) { return reallocated_bytes; }
+
+int getNumReallocations(void) { return nreallocations; }
+
+void deallocate(void* ptr)
+{
+    int m = findMapping(ptr);
+
+    if (m < 0) {
+        free(ptr);
+        return;
+    }
+
+    munmap(mappings[m], mapping_sizes[m]);
+    nmappings--;
+    mappings[m]      = mappings[nmappings];
+    mapping_sizes[m] = mapping_sizes[nmappings];
+}
+
+/* query the NUMA node of (a sample of) the pages of an array with move_pages
+ * and print the distribution, pages that were never touched are reported
+ * as not present */
+void printPagePlacement(const char* name, void* ptr, size_t bytesize)
+{
+    const char* kind = (findMapping(ptr) >= 0) ? "hugetlb" : "default";
+#if defined(HUGE_PAGES_THP) || defined(HUGE_PAGES_EXPLICIT)
+    if (findMapping(ptr) < 0 && bytesize >= HUGE_PAGE_SIZE) {
+        kind = "thp";
+    }
+#endif
+
+    if (ptr == NULL || bytesize == 0) {
+        printf("\t%-16s not allocated\n", name);
+        return;
+    }
+
+    const long page   = sysconf(_SC_PAGESIZE);
+    const long npages = (bytesize + page - 1) / page;
+    const int nsample = MIN(npages, MAX_SAMPLES);
+    void* pages[MAX_SAMPLES];
+    int status[MAX_SAMPLES];
+    int count[MAX_NODES];
+    int notPresent = 0;
+
+    for (int n = 0; n < MAX_NODES; n++) {
+        count[n] = 0;
+    }
+
+    for (int s = 0; s < nsample; s++) {
+        long p   = (long)s * npages / nsample;
+        pages[s] = (char*)ptr + p * page;
+    }
+
+    printf("\t%-16s %10.2f MB %-8s", name, bytesize / 1e6, kind);
+#ifdef SYS_move_pages
+    if (syscall(SYS_move_pages, 0, nsample, pages, NULL, status, 0) != 0) {
+        printf(" node query failed (%s)\n", strerror(errno));
+        return;
+    }
+
+    for (int s = 0; s < nsample; s++) {
+        if (status[s] >= 0 && status[s] < MAX_NODES) {
+            count[status[s]]++;
+        } else {
+            notPresent++;
+        }
+    }
+
+    for (int n = 0; n < MAX_NODES; n++) {
+        if (count[n] > 0) {
+            printf(" node%d: %.1f%%", n, 100.0 * count[n] / nsample);
+        }
+    }
+
+    if (notPresent > 0) {
+        printf(" not present: %.1f%%", 100.0 * notPresent / nsample);
+    }
+
+    printf("\n");
+#else
+    printf(" node query not supported\n");
+#endif
+}
@@ -8,6 +8,15 @@
 
 #ifndef __ALLOCATE_H_
 #define __ALLOCATE_H_
+// Capacities grow by half their size (at least by delta elements), so the
+// data copied by repeated growth stays linear in the final array size
+#define GROW_CAPACITY(n, delta) ((n) + ((n) / 2 > (delta) ? (n) / 2 : (delta)))
+
 extern void* allocate(int alignment, size_t bytesize);
 extern void* reallocate(void* ptr, int alignment, size_t newBytesize, size_t oldBytesize);
+extern void deallocate(void* ptr);
+extern size_t getReallocatedBytes(void);
+extern int getNumReallocations(void);
+extern void firstTouch(void* ptr, size_t bytesize);
+extern void printPagePlacement(const char* name, void* ptr, size_t bytesize);
 #endif
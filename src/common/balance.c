@@ -0,0 +1,158 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdio.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <allocate.h>
+#include <balance.h>
+#include <report.h>
+#include <timers.h>
+
+#define DELTA 1024
+
+static int getNumThreads(void)
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// First item of part p, the static schedule hands the first nitems % nparts parts
+// one more item if no partition is given
+static int getCut(const int* start, int nitems, int nparts, int p)
+{
+    if (start != NULL) {
+        return start[p];
+    }
+
+    return p * (nitems / nparts) + ((p < nitems % nparts) ? p : nitems % nparts);
+}
+
+/* max over mean work of the nparts contiguous ranges of a partition, with equal
+ * item counts for start NULL; no work at all counts as balanced */
+static double getImbalance(
+    const long long* prefix, const int* start, int nitems, int nparts)
+{
+    long long total = prefix[nitems];
+    long long most  = 0;
+
+    if (total == 0) {
+        return 1.0;
+    }
+
+    for (int p = 0; p < nparts; p++) {
+        long long work = prefix[getCut(start, nitems, nparts, p + 1)] -
+                         prefix[getCut(start, nitems, nparts, p)];
+        most = (work > most) ? work : most;
+    }
+
+    return (double)most * nparts / total;
+}
+
+void initBalance(Balance* b, int enabled)
+{
+    b->enabled            = enabled;
+    b->nparts             = 0;
+    b->maxitems           = 0;
+    b->start              = NULL;
+    b->cost               = NULL;
+    b->prefix             = NULL;
+    b->nbuilds            = 0;
+    b->imbalance_static   = 0.0;
+    b->imbalance_balanced = 0.0;
+}
+
+/* the buffers only have to hold the costs of the current lists, so nothing is
+ * copied when growing */
+void reserveBalance(Balance* b, int nitems)
+{
+    if (b->start == NULL) {
+        b->start = (int*)allocate(ALIGNMENT, (getNumThreads() + 1) * sizeof(int));
+    }
+
+    if (nitems <= b->maxitems) {
+        return;
+    }
+
+    deallocate(b->cost);
+    deallocate(b->prefix);
+    b->maxitems = GROW_CAPACITY(nitems, DELTA);
+    b->cost     = (int*)allocate(ALIGNMENT, b->maxitems * sizeof(int));
+    b->prefix   = (long long*)allocate(ALIGNMENT, (b->maxitems + 1) * sizeof(long long));
+}
+
+/* cut the prefix sum of the costs where it is nearest to equal shares of the
+ * total */
+void buildBalance(Balance* b, int nitems)
+{
+    const int nthreads = getNumThreads();
+    int i              = 0;
+
+    if (!b->enabled) {
+        return;
+    }
+
+    b->prefix[0] = 0;
+    for (int k = 0; k < nitems; k++) {
+        b->prefix[k + 1] = b->prefix[k] + b->cost[k];
+    }
+
+    b->nparts   = nthreads;
+    b->start[0] = 0;
+    for (int p = 1; p < nthreads; p++) {
+        long long target = b->prefix[nitems] * p / nthreads;
+        int cut;
+
+        while (i < nitems && b->prefix[i] < target) {
+            i++;
+        }
+
+        // The nearer one of the items around the target
+        cut = (i > 0 && target - b->prefix[i - 1] < b->prefix[i] - target) ? i - 1 : i;
+
+        b->start[p] = (cut < b->start[p - 1]) ? b->start[p - 1] : cut;
+    }
+
+    b->start[nthreads] = nitems;
+    b->imbalance_static += getImbalance(b->prefix, NULL, nitems, nthreads);
+    b->imbalance_balanced += getImbalance(b->prefix, b->start, nitems, nthreads);
+    b->nbuilds++;
+}
+
+void printBalance(const Balance* b, const char* unit)
+{
+    if (!b->enabled || b->nbuilds == 0) {
+        return;
+    }
+
+    printf("Balanced %s: %d parts, max over mean thread work %.3f with equal counts, "
+           "%.3f balanced (mean over %d builds), %.3f measured force time\n",
+        unit,
+        b->nparts,
+        b->imbalance_static / b->nbuilds,
+        b->imbalance_balanced / b->nbuilds,
+        b->nbuilds,
+        getRegionImbalance(REGION_FORCE_THREAD));
+}
+
+void reportBalance(const Balance* b)
+{
+    if (!b->enabled || b->nbuilds == 0) {
+        return;
+    }
+
+    reportSection("balance");
+    reportInt("parts", b->nparts);
+    reportInt("builds", b->nbuilds);
+    reportReal("imbalance_static", b->imbalance_static / b->nbuilds);
+    reportReal("imbalance_balanced", b->imbalance_balanced / b->nbuilds);
+    reportReal("imbalance_measured", getRegionImbalance(REGION_FORCE_THREAD));
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#ifndef __BALANCE_H_
+#define __BALANCE_H_
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Static partition of the i-atoms or i-clusters of the neighbor lists into one
+// contiguous range per thread with about the same force work. The caller fills
+// cost with the work of every item after each list build, buildBalance turns it
+// into a prefix sum and cuts that at equal shares. Part p covers the items
+// start[p] .. start[p + 1] - 1, without a partition every item is its own part
+// so the force loops keep their runtime schedule.
+typedef struct {
+    int enabled;
+    int nparts; // parts of the current partition, 0 if the items are not balanced
+    int maxitems;
+    int* start;        // first item of each part, nparts + 1 entries
+    int* cost;         // work of each item, filled by the caller
+    long long* prefix; // work of all items before each item, nitems + 1 entries
+    int nbuilds;
+    double imbalance_static;   // max over mean thread work of equal item counts
+    double imbalance_balanced; // the same for the balanced ranges, both summed
+} Balance;
+
+extern void initBalance(Balance* b, int enabled);
+extern void reserveBalance(Balance* b, int nitems);
+extern void buildBalance(Balance* b, int nitems);
+extern void printBalance(const Balance* b, const char* unit);
+extern void reportBalance(const Balance* b);
+
+// Number of parts the force loops distribute over the threads
+static inline int getNumParts(const Balance* b, int nitems)
+{
+    return (b->nparts > 0) ? b->nparts : nitems;
+}
+
+static inline int getPartBegin(const Balance* b, int p)
+{
+    return (b->nparts > 0) ? b->start[p] : p;
+}
+
+static inline int getPartEnd(const Balance* b, int p)
+{
+    return (b->nparts > 0) ? b->start[p + 1] : p + 1;
+}
+
+/* called by every thread of a force region before its part loop: with a partition
+ * the schedule of the calling thread's task is set to static, so thread t runs
+ * part t; the schedule of the loops outside the region is not changed */
+static inline void setPartSchedule(const Balance* b)
+{
+#ifdef _OPENMP
+    if (b->nparts > 0) {
+        omp_set_schedule(omp_sched_static, 0);
+    }
+#endif
+}
+#endif
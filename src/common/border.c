@@ -0,0 +1,75 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <border.h>
+
+static const int images[26][3] = {
+    // 6 planes
+    { +1, 0, 0 },
+    { -1, 0, 0 },
+    { 0, +1, 0 },
+    { 0, -1, 0 },
+    { 0, 0, +1 },
+    { 0, 0, -1 },
+    // 8 corners
+    { +1, +1, +1 },
+    { +1, -1, +1 },
+    { +1, +1, -1 },
+    { +1, -1, -1 },
+    { -1, +1, +1 },
+    { -1, -1, +1 },
+    { -1, +1, -1 },
+    { -1, -1, -1 },
+    // 12 edges
+    { +1, 0, +1 },
+    { +1, 0, -1 },
+    { -1, 0, +1 },
+    { -1, 0, -1 },
+    { 0, +1, +1 },
+    { 0, +1, -1 },
+    { 0, -1, +1 },
+    { 0, -1, -1 },
+    { +1, +1, 0 },
+    { -1, +1, 0 },
+    { +1, -1, 0 },
+    { -1, -1, 0 },
+};
+
+static BorderImages table[NUM_BORDERS];
+static int initialized = 0;
+
+// Image component s of dimension d needs the matching side in the mask
+static int needsSide(int border, int d, int s)
+{
+    int lo = BORDER_XLO << (2 * d);
+    int hi = BORDER_XHI << (2 * d);
+    return (s == 0) || (s > 0 && (border & lo)) || (s < 0 && (border & hi));
+}
+
+const BorderImages* getBorderImages(void)
+{
+    if (!initialized) {
+        for (int border = 0; border < NUM_BORDERS; border++) {
+            BorderImages* b = &table[border];
+            b->nimages      = 0;
+
+            for (int i = 0; i < 26; i++) {
+                if (needsSide(border, 0, images[i][0]) &&
+                    needsSide(border, 1, images[i][1]) &&
+                    needsSide(border, 2, images[i][2])) {
+                    b->image[b->nimages][0] = images[i][0];
+                    b->image[b->nimages][1] = images[i][1];
+                    b->image[b->nimages][2] = images[i][2];
+                    b->nimages++;
+                }
+            }
+        }
+
+        initialized = 1;
+    }
+
+    return table;
+}
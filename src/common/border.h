@@ -0,0 +1,46 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <parameter.h>
+
+#ifndef __BORDER_H_
+#define __BORDER_H_
+// Sides of the box an atom or cluster is within the cutoff of. A ghost image
+// (sx, sy, sz) is created for every combination of the set sides, a position
+// close to the lower side is imaged with +1, one close to the upper side with -1.
+#define BORDER_XLO  0x01
+#define BORDER_XHI  0x02
+#define BORDER_YLO  0x04
+#define BORDER_YHI  0x08
+#define BORDER_ZLO  0x10
+#define BORDER_ZHI  0x20
+#define NUM_BORDERS 64
+
+typedef struct {
+    int nimages;
+    int image[26][3];
+} BorderImages;
+
+// Images per border mask, in the order setupPbc always created them: 6 planes,
+// 8 corners and 12 edges
+extern const BorderImages* getBorderImages(void);
+
+// Positions below lo[d] or at and above hi[d] are close to a side of dimension d,
+// non-periodic dimensions use -INFINITY and INFINITY
+static inline int getBorderMask(const MD_FLOAT* lo,
+    const MD_FLOAT* hi,
+    MD_FLOAT xmin,
+    MD_FLOAT xmax,
+    MD_FLOAT ymin,
+    MD_FLOAT ymax,
+    MD_FLOAT zmin,
+    MD_FLOAT zmax)
+{
+    return ((xmin < lo[0]) ? BORDER_XLO : 0) | ((xmax >= hi[0]) ? BORDER_XHI : 0) |
+           ((ymin < lo[1]) ? BORDER_YLO : 0) | ((ymax >= hi[1]) ? BORDER_YHI : 0) |
+           ((zmin < lo[2]) ? BORDER_ZLO : 0) | ((zmax >= hi[2]) ? BORDER_ZHI : 0);
+}
+#endif
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cachesim.h>
+
+#define MAX_NAME_LENGTH 32
+
+typedef struct {
+    long size;
+    int ways;
+    int nsets;
+    uint64_t* tags;   // Line address + 1 per way, 0 marks an invalid way
+    uint64_t* stamps; // Last use of each way for LRU replacement
+} CacheLevel;
+
+static CacheLevel levels[CACHE_SIM_MAX_LEVELS];
+static int nlevels    = 0;
+static int line_size  = 64;
+static int line_shift = 6;
+static uint64_t ticks  = 0;
+
+static char arrays[CACHE_SIM_MAX_ARRAYS][MAX_NAME_LENGTH];
+static int narrays = 0;
+static uint64_t accesses[CACHE_SIM_MAX_ARRAYS];
+static uint64_t hits[CACHE_SIM_MAX_ARRAYS][CACHE_SIM_MAX_LEVELS];
+
+static long parseSize(const char* str, char** end)
+{
+    long size = strtol(str, end, 10);
+
+    switch (**end) {
+    case 'k':
+    case 'K':
+        size <<= 10;
+        (*end)++;
+        break;
+    case 'm':
+    case 'M':
+        size <<= 20;
+        (*end)++;
+        break;
+    case 'g':
+    case 'G':
+        size <<= 30;
+        (*end)++;
+        break;
+    }
+
+    return size;
+}
+
+void initCacheSim(const char* config, int line)
+{
+    char* copy = strdup((config != NULL) ? config : CACHE_SIM_DEFAULT);
+    char* save = NULL;
+
+    if (line <= 0 || (line & (line - 1)) != 0) {
+        fprintf(stderr, "Error: Cache line size must be a power of two, got %d!\n", line);
+        exit(-1);
+    }
+
+    line_size  = line;
+    line_shift = 0;
+    while ((1 << line_shift) < line_size) {
+        line_shift++;
+    }
+
+    nlevels = 0;
+    for (char* tok = strtok_r(copy, ",", &save); tok != NULL;
+         tok       = strtok_r(NULL, ",", &save)) {
+        char* end;
+        CacheLevel* level;
+
+        if (nlevels == CACHE_SIM_MAX_LEVELS) {
+            fprintf(stderr,
+                "Error: At most %d cache levels are supported!\n",
+                CACHE_SIM_MAX_LEVELS);
+            exit(-1);
+        }
+
+        level       = &levels[nlevels];
+        level->size = parseSize(tok, &end);
+        level->ways = (*end == ':') ? atoi(end + 1) : 0;
+        if (level->size <= 0 || level->ways <= 0 ||
+            level->size < (long)level->ways * line_size) {
+            fprintf(stderr, "Error: Invalid cache level '%s', expected size:ways!\n", tok);
+            exit(-1);
+        }
+
+        level->nsets  = level->size / ((long)level->ways * line_size);
+        level->tags   = (uint64_t*)calloc(
+            (size_t)level->nsets * level->ways, sizeof(uint64_t));
+        level->stamps = (uint64_t*)calloc(
+            (size_t)level->nsets * level->ways, sizeof(uint64_t));
+        nlevels++;
+    }
+
+    if (nlevels == 0) {
+        fprintf(stderr, "Error: Cache model needs at least one level!\n");
+        exit(-1);
+    }
+
+    free(copy);
+}
+
+int cacheSimArray(const char* name)
+{
+    for (int a = 0; a < narrays; a++) {
+        if (strncmp(arrays[a], name, MAX_NAME_LENGTH - 1) == 0) {
+            return a;
+        }
+    }
+
+    if (narrays == CACHE_SIM_MAX_ARRAYS) {
+        fprintf(stderr, "Error: Too many arrays for the cache model!\n");
+        exit(-1);
+    }
+
+    strncpy(arrays[narrays], name, MAX_NAME_LENGTH - 1);
+    return narrays++;
+}
+
+// Returns 1 on a hit, otherwise the least recently used way is replaced
+static int lookupLine(CacheLevel* level, uint64_t line)
+{
+    uint64_t* tags   = &level->tags[(line % level->nsets) * level->ways];
+    uint64_t* stamps = &level->stamps[(line % level->nsets) * level->ways];
+    int victim       = 0;
+
+    for (int w = 0; w < level->ways; w++) {
+        if (tags[w] == line + 1) {
+            stamps[w] = ++ticks;
+            return 1;
+        }
+
+        if (stamps[w] < stamps[victim]) {
+            victim = w;
+        }
+    }
+
+    tags[victim]   = line + 1;
+    stamps[victim] = ++ticks;
+    return 0;
+}
+
+void cacheSimAccess(uint64_t addr, int array)
+{
+    uint64_t line = addr >> line_shift;
+
+    accesses[array]++;
+    for (int l = 0; l < nlevels; l++) {
+        if (lookupLine(&levels[l], line)) {
+            hits[array][l]++;
+            return;
+        }
+    }
+}
+
+static void printRow(const char* name, uint64_t total, const uint64_t* level_hits)
+{
+    uint64_t reaching = total;
+
+    printf("\t%-16s %14llu", name, (unsigned long long)total);
+    for (int l = 0; l < nlevels; l++) {
+        printf("  %8.2f", (reaching > 0) ? 100.0 * level_hits[l] / reaching : 0.0);
+        reaching -= level_hits[l];
+    }
+
+    printf("  %8.2f\n", (total > 0) ? 100.0 * reaching / total : 0.0);
+}
+
+void printCacheSim(void)
+{
+    uint64_t total = 0;
+    uint64_t total_hits[CACHE_SIM_MAX_LEVELS];
+
+    printf("Cache model (line size %d B):\n", line_size);
+    for (int l = 0; l < nlevels; l++) {
+        printf("\tL%d: %ld KB, %d-way, %d sets\n",
+            l + 1,
+            levels[l].size >> 10,
+            levels[l].ways,
+            levels[l].nsets);
+    }
+
+    // Hit rates are local to each level (hits / accesses reaching the level),
+    // the last column is the share of all accesses that went to memory
+    printf("\t%-16s %14s", "Array", "Accesses");
+    for (int l = 0; l < nlevels; l++) {
+        printf("  L%d hit %%", l + 1);
+    }
+
+    printf("  %8s\n", "Memory %");
+    memset(total_hits, 0, sizeof(total_hits));
+    for (int a = 0; a < narrays; a++) {
+        if (accesses[a] == 0) {
+            continue;
+        }
+
+        printRow(arrays[a], accesses[a], hits[a]);
+        total += accesses[a];
+        for (int l = 0; l < nlevels; l++) {
+            total_hits[l] += hits[a][l];
+        }
+    }
+
+    printRow("total", total, total_hits);
+}
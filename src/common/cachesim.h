@@ -0,0 +1,25 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+
+#ifndef __CACHESIM_H_
+#define __CACHESIM_H_
+// Online model of a set-associative cache hierarchy with LRU replacement.
+// Levels are given as a comma separated list of size:ways pairs from L1
+// outwards, sizes accept K and M suffixes (e.g. "32K:8,1M:16,32M:16"). Every
+// access is looked up level by level until it hits and is filled into all
+// levels that missed, evictions are not propagated to inner levels. Hits are
+// attributed to the array id returned by cacheSimArray.
+#define CACHE_SIM_DEFAULT    "32K:8,1M:16,32M:16"
+#define CACHE_SIM_MAX_LEVELS 4
+#define CACHE_SIM_MAX_ARRAYS 16
+
+extern void initCacheSim(const char* config, int line_size);
+extern int cacheSimArray(const char* name);
+extern void cacheSimAccess(uint64_t addr, int array);
+extern void printCacheSim(void);
+#endif
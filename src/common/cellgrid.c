@@ -0,0 +1,130 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdlib.h>
+
+#include <allocate.h>
+#include <cellgrid.h>
+
+#define DELTA 1024
+
+static int compareInt(const void* a, const void* b)
+{
+    int ia = *(const int*)a;
+    int ib = *(const int*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+void initCellGrid(CellGrid* grid)
+{
+    grid->ncells   = 0;
+    grid->nitems   = 0;
+    grid->maxitems = 0;
+    grid->id       = NULL;
+    grid->start    = NULL;
+    grid->items    = NULL;
+    grid->keys     = NULL;
+    grid->values   = NULL;
+    grid->cell     = NULL;
+    grid->hashmask = 0;
+    grid->hashkey  = NULL;
+    grid->hashcell = NULL;
+}
+
+/* the buffers only have to hold the items, the contents are rebuilt from keys
+ * and values by every buildCellGrid, so nothing is copied when growing */
+void reserveCellGrid(CellGrid* grid, int nitems)
+{
+    int hashsize = 16;
+
+    if (nitems <= grid->maxitems) {
+        return;
+    }
+
+    deallocate(grid->id);
+    deallocate(grid->start);
+    deallocate(grid->items);
+    deallocate(grid->keys);
+    deallocate(grid->values);
+    deallocate(grid->cell);
+    deallocate(grid->hashkey);
+    deallocate(grid->hashcell);
+
+    grid->maxitems = GROW_CAPACITY(nitems, DELTA);
+    while (hashsize < 2 * grid->maxitems) {
+        hashsize *= 2;
+    }
+
+    grid->hashmask = hashsize - 1;
+    grid->id       = (int*)allocate(ALIGNMENT, grid->maxitems * sizeof(int));
+    grid->start    = (int*)allocate(ALIGNMENT, (grid->maxitems + 1) * sizeof(int));
+    grid->items    = (int*)allocate(ALIGNMENT, grid->maxitems * sizeof(int));
+    grid->keys     = (int*)allocate(ALIGNMENT, grid->maxitems * sizeof(int));
+    grid->values   = (int*)allocate(ALIGNMENT, grid->maxitems * sizeof(int));
+    grid->cell     = (int*)allocate(ALIGNMENT, grid->maxitems * sizeof(int));
+    grid->hashkey  = (int*)allocate(ALIGNMENT, hashsize * sizeof(int));
+    grid->hashcell = (int*)allocate(ALIGNMENT, hashsize * sizeof(int));
+}
+
+/* collect the distinct keys in the hash table, sort them so the occupied cells
+ * keep the order of the grid, then count and scatter the values; the scatter is
+ * stable so every cell lists its items in insertion order */
+void buildCellGrid(CellGrid* grid, int nitems)
+{
+    reserveCellGrid(grid, nitems);
+    grid->ncells = 0;
+    grid->nitems = nitems;
+    for (int h = 0; h <= grid->hashmask; h++) {
+        grid->hashkey[h] = -1;
+    }
+
+    for (int i = 0; i < nitems; i++) {
+        int key        = grid->keys[i];
+        unsigned int h = hashCell(key) & grid->hashmask;
+
+        while (grid->hashkey[h] != -1 && grid->hashkey[h] != key) {
+            h = (h + 1) & grid->hashmask;
+        }
+
+        if (grid->hashkey[h] == -1) {
+            grid->hashkey[h]         = key;
+            grid->id[grid->ncells++] = key;
+        }
+    }
+
+    qsort(grid->id, grid->ncells, sizeof(int), compareInt);
+    for (int c = 0; c < grid->ncells; c++) {
+        unsigned int h = hashCell(grid->id[c]) & grid->hashmask;
+
+        while (grid->hashkey[h] != grid->id[c]) {
+            h = (h + 1) & grid->hashmask;
+        }
+
+        grid->hashcell[h] = c;
+        grid->start[c]    = 0;
+    }
+
+    for (int i = 0; i < nitems; i++) {
+        grid->cell[i] = findCell(grid, grid->keys[i]);
+        grid->start[grid->cell[i]]++;
+    }
+
+    for (int c = 1; c < grid->ncells; c++) {
+        grid->start[c] += grid->start[c - 1];
+    }
+
+    // Filling every cell from its end backwards leaves start at the first item
+    grid->start[grid->ncells] = nitems;
+    for (int i = nitems - 1; i >= 0; i--) {
+        grid->items[--grid->start[grid->cell[i]]] = grid->values[i];
+    }
+}
+
+size_t getCellGridMemory(const CellGrid* grid)
+{
+    return (size_t)(6 * grid->maxitems + 1) * sizeof(int) +
+           (size_t)2 * (grid->hashmask + 1) * sizeof(int);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stddef.h>
+
+#ifndef __CELLGRID_H_
+#define __CELLGRID_H_
+// Binning that only stores the occupied cells of a grid. The items of occupied
+// cell c are items[start[c]] .. items[start[c + 1] - 1] in their insertion order,
+// and occupied cells are ordered by their grid index. A hash table maps grid
+// indices to occupied cells, so the memory scales with the number of items and
+// not with the volume of the box or the fullest cell.
+typedef struct {
+    int ncells; // number of occupied cells
+    int nitems;
+    int maxitems;
+    int* id;    // grid index of each occupied cell
+    int* start; // offset of each occupied cell in items, ncells + 1 entries
+    int* items;
+    int* keys;   // grid index of each item, filled by the caller
+    int* values; // value stored for each item, filled by the caller
+    int* cell;   // occupied cell of each item
+    int hashmask;
+    int* hashkey;
+    int* hashcell;
+} CellGrid;
+
+extern void initCellGrid(CellGrid* grid);
+extern void reserveCellGrid(CellGrid* grid, int nitems);
+extern void buildCellGrid(CellGrid* grid, int nitems);
+extern size_t getCellGridMemory(const CellGrid* grid);
+
+// Fibonacci hashing, the high bits of the product are folded into the low bits
+// kept by the mask, which otherwise only depend on the low bits of the key
+static inline unsigned int hashCell(int key)
+{
+    unsigned int h = (unsigned int)key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+// Occupied cell with grid index key, or -1 if the cell is empty
+static inline int findCell(const CellGrid* grid, int key)
+{
+    unsigned int h = hashCell(key) & grid->hashmask;
+
+    while (grid->hashkey[h] != -1) {
+        if (grid->hashkey[h] == key) {
+            return grid->hashcell[h];
+        }
+
+        h = (h + 1) & grid->hashmask;
+    }
+
+    return -1;
+}
+
+// Items of the cell with grid index key, *n is zero for empty cells
+static inline int* getCellItems(const CellGrid* grid, int key, int* n)
+{
+    int c = findCell(grid, key);
+
+    if (c < 0) {
+        *n = 0;
+        return NULL;
+    }
+
+    *n = grid->start[c + 1] - grid->start[c];
+    return &grid->items[grid->start[c]];
+}
+#endif
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <energy.h>
+#include <report.h>
+#include <timers.h>
+
+#ifndef POWERCAP_PATH
+#define POWERCAP_PATH "/sys/class/powercap"
+#endif
+#define MAX_DOMAINS   16
+
+typedef enum { DOMAIN_PACKAGE = 0, DOMAIN_DRAM, NUMDOMAINS } domaintype;
+
+typedef struct {
+    int fd;
+    domaintype type;
+    uint64_t last;  // last raw reading in uJ
+    uint64_t range; // the counter wraps around at max_energy_range_uj
+} EnergyCounter;
+
+static const char* domain_names[NUMDOMAINS] = { "package", "dram" };
+
+static EnergyCounter counters[MAX_DOMAINS];
+static int ncounters              = 0;
+static int available[NUMDOMAINS]  = { 0 };
+static double total[NUMDOMAINS]   = { 0.0 };
+static double start[NUMTIMER][NUMDOMAINS];
+static double energy[NUMTIMER][NUMDOMAINS];
+
+static int readValue(int fd, uint64_t* value)
+{
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (n <= 0) {
+        return 0;
+    }
+
+    buf[n] = '\0';
+    *value = strtoull(buf, NULL, 10);
+    return 1;
+}
+
+#ifdef RAPL
+static int readFile(const char* dir, const char* file, char* buf, int size)
+{
+    char path[512];
+    FILE* fp;
+
+    snprintf(path, sizeof(path), "%s/%s/%s", POWERCAP_PATH, dir, file);
+    if ((fp = fopen(path, "r")) == NULL) {
+        return 0;
+    }
+
+    if (fgets(buf, size, fp) == NULL) {
+        fclose(fp);
+        return 0;
+    }
+
+    buf[strcspn(buf, "\n")] = '\0';
+    fclose(fp);
+    return 1;
+}
+#endif
+
+/* fold the increments since the last sample into the running totals, a counter
+ * below its last reading has wrapped around once */
+static void sampleEnergy(void)
+{
+    for (int i = 0; i < ncounters; i++) {
+        EnergyCounter* c = &counters[i];
+        uint64_t value;
+
+        if (readValue(c->fd, &value)) {
+            uint64_t delta = (value >= c->last) ? value - c->last
+                                                : value + c->range - c->last;
+            total[c->type] += 1e-6 * (double)delta;
+            c->last = value;
+        }
+    }
+}
+
+/* packages are the top level zones intel-rapl:N, DRAM is a subzone
+ * intel-rapl:N:M named dram; the intel-rapl-mmio zones repeat the package
+ * counters and are skipped by the prefix */
+void initEnergy(void)
+{
+#ifdef RAPL
+    DIR* dir = opendir(POWERCAP_PATH);
+    struct dirent* entry;
+
+    if (dir == NULL) {
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL && ncounters < MAX_DOMAINS) {
+        EnergyCounter* c = &counters[ncounters];
+        char name[64], range[32], path[512];
+
+        if (strncmp(entry->d_name, "intel-rapl:", 11) != 0 ||
+            !readFile(entry->d_name, "name", name, sizeof(name)) ||
+            !readFile(entry->d_name, "max_energy_range_uj", range, sizeof(range))) {
+            continue;
+        }
+
+        if (strncmp(name, "package", 7) == 0) {
+            c->type = DOMAIN_PACKAGE;
+        } else if (strcmp(name, "dram") == 0) {
+            c->type = DOMAIN_DRAM;
+        } else {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "%s/%s/energy_uj", POWERCAP_PATH, entry->d_name);
+        c->fd    = open(path, O_RDONLY);
+        c->range = strtoull(range, NULL, 10);
+        if (c->fd < 0 || !readValue(c->fd, &c->last)) {
+            if (c->fd >= 0) close(c->fd);
+            continue;
+        }
+
+        available[c->type] = 1;
+        ncounters++;
+    }
+
+    closedir(dir);
+#endif
+}
+
+void startEnergy(timertype timer)
+{
+    if (ncounters > 0) {
+        sampleEnergy();
+        for (int d = 0; d < NUMDOMAINS; d++) {
+            start[timer][d] = total[d];
+        }
+    }
+}
+
+void stopEnergy(timertype timer)
+{
+    if (ncounters > 0) {
+        sampleEnergy();
+        for (int d = 0; d < NUMDOMAINS; d++) {
+            energy[timer][d] += total[d] - start[timer][d];
+        }
+    }
+}
+
+static double sumEnergy(timertype timer)
+{
+    double sum = 0.0;
+
+    for (int d = 0; d < NUMDOMAINS; d++) {
+        sum += energy[timer][d];
+    }
+
+    return sum;
+}
+
+static void printEnergyRow(const char* label, double epkg, double edram, double time)
+{
+    printf("\t%-8s %12.2f %12.2f %12.2f\n",
+        label,
+        epkg,
+        edram,
+        (time > 0.0) ? (epkg + edram) / time : 0.0);
+}
+
+void printEnergy(double* timer, int natoms, int ntimes)
+{
+    const double etotal = sumEnergy(TOTAL);
+
+    if (ncounters == 0) {
+#ifdef RAPL
+        printf("Energy: RAPL powercap counters not readable, skipped\n");
+#endif
+        return;
+    }
+
+    printf("Energy (RAPL%s%s):\n",
+        available[DOMAIN_PACKAGE] ? ", package" : "",
+        available[DOMAIN_DRAM] ? ", dram" : "");
+    printf("\t%-8s %12s %12s %12s\n", "region", "package [J]", "dram [J]", "power [W]");
+    printEnergyRow("total",
+        energy[TOTAL][DOMAIN_PACKAGE],
+        energy[TOTAL][DOMAIN_DRAM],
+        timer[TOTAL]);
+    printEnergyRow("force",
+        energy[FORCE][DOMAIN_PACKAGE],
+        energy[FORCE][DOMAIN_DRAM],
+        timer[FORCE]);
+    printEnergyRow("neigh",
+        energy[NEIGH][DOMAIN_PACKAGE],
+        energy[NEIGH][DOMAIN_DRAM],
+        timer[NEIGH]);
+    // Like REST in the timer line, also without the initial force computation
+    printEnergyRow("rest",
+        energy[TOTAL][DOMAIN_PACKAGE] - energy[FORCE][DOMAIN_PACKAGE] -
+            energy[NEIGH][DOMAIN_PACKAGE],
+        energy[TOTAL][DOMAIN_DRAM] - energy[FORCE][DOMAIN_DRAM] -
+            energy[NEIGH][DOMAIN_DRAM],
+        timer[TOTAL] - timer[FORCE] - timer[NEIGH]);
+    printf("Energy: %.4f J/step, %.4f J per million atom updates, %.2f W average\n",
+        etotal / ntimes,
+        etotal / (1e-6 * (double)natoms * ntimes),
+        (timer[TOTAL] > 0.0) ? etotal / timer[TOTAL] : 0.0);
+}
+
+void reportEnergy(double* timer, int natoms, int ntimes)
+{
+    const double etotal = sumEnergy(TOTAL);
+
+    if (ncounters == 0) {
+        return;
+    }
+
+    reportSection("energy");
+    for (int d = 0; d < NUMDOMAINS; d++) {
+        char key[32];
+
+        if (available[d]) {
+            snprintf(key, sizeof(key), "%s_j", domain_names[d]);
+            reportReal(key, energy[TOTAL][d]);
+        }
+    }
+
+    reportReal("force_j", sumEnergy(FORCE));
+    reportReal("neigh_j", sumEnergy(NEIGH));
+    reportReal("joules_per_step", etotal / ntimes);
+    reportReal("joules_per_mau", etotal / (1e-6 * (double)natoms * ntimes));
+    reportReal("avg_power_w", (timer[TOTAL] > 0.0) ? etotal / timer[TOTAL] : 0.0);
+}
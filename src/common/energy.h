@@ -0,0 +1,22 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <timers.h>
+
+#ifndef __ENERGY_H_
+#define __ENERGY_H_
+// Package and DRAM energy from the RAPL counters of the Linux powercap interface
+// (/sys/class/powercap/intel-rapl:*, also used on AMD), summed over all sockets.
+// The counters are sampled around the same regions as timer[] (total, force,
+// neighbor), every sample folds the counter wraparound into a running total.
+// Without readable counters (no RAPL, or energy_uj readable by root only) all
+// functions do nothing and the report says so.
+extern void initEnergy(void);
+extern void startEnergy(timertype timer);
+extern void stopEnergy(timertype timer);
+extern void printEnergy(double* timer, int natoms, int ntimes);
+extern void reportEnergy(double* timer, int natoms, int ntimes);
+#endif
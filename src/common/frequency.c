@@ -0,0 +1,226 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__x86_64__) && defined(__linux__)
+#include <sched.h>
+#include <x86intrin.h>
+#define HAVE_MSR
+#endif
+
+#include <allocate.h>
+#include <frequency.h>
+#include <parameter.h>
+#include <timing.h>
+
+#define MSR_MPERF         0xe7
+#define MSR_APERF         0xe8
+#define CALIBRATION_ITERS 1000000
+#define TSC_CALIBRATION_S 0.02
+
+typedef struct {
+    int cpu;
+    uint64_t aperf;
+    uint64_t mperf;
+    double aperf_sum;
+    double mperf_sum;
+    char pad[64]; // keep the accumulators of neighbouring threads on separate lines
+} FrequencyCounters;
+
+static FrequencyCounters* counters = NULL;
+static int* msr_fd                 = NULL;
+static int ncpus                   = 0;
+static int nthreads                = 0;
+static double tsc_ghz              = 0.0;
+static double calibrated_ghz       = 0.0;
+static const char* source          = "not measured";
+
+static inline int getThreadId(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#ifdef HAVE_MSR
+static int readMsr(int cpu, uint32_t reg, uint64_t* value)
+{
+    return pread(msr_fd[cpu], value, sizeof(uint64_t), reg) == sizeof(uint64_t);
+}
+
+static double calibrateTsc(void)
+{
+    double S       = getTimeStamp();
+    uint64_t start = __rdtsc();
+    double E       = S;
+
+    while (E - S < TSC_CALIBRATION_S) {
+        E = getTimeStamp();
+    }
+
+    return (double)(__rdtsc() - start) / (E - S) * 1e-9;
+}
+#endif
+
+/* the MSRs are only used if they can be read on every CPU, otherwise the
+ * frequency is calibrated when it is first needed. A failed open must not leave
+ * errno set for the caller */
+void initFrequency(void)
+{
+    int saved_errno = errno;
+
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#else
+    nthreads = 1;
+#endif
+
+#ifdef HAVE_MSR
+    uint64_t value;
+    char filename[64];
+
+    ncpus  = (int)sysconf(_SC_NPROCESSORS_CONF);
+    msr_fd = (int*)malloc(ncpus * sizeof(int));
+    for (int cpu = 0; cpu < ncpus; cpu++) {
+        snprintf(filename, sizeof filename, "/dev/cpu/%d/msr", cpu);
+        msr_fd[cpu] = open(filename, O_RDONLY);
+        if (msr_fd[cpu] < 0 || !readMsr(cpu, MSR_APERF, &value)) {
+            for (int c = 0; c <= cpu; c++) {
+                if (msr_fd[c] >= 0) close(msr_fd[c]);
+            }
+
+            free(msr_fd);
+            msr_fd = NULL;
+            errno  = saved_errno;
+            return;
+        }
+    }
+
+    counters = (FrequencyCounters*)allocate(64, nthreads * sizeof(FrequencyCounters));
+    memset(counters, 0, nthreads * sizeof(FrequencyCounters));
+    tsc_ghz = calibrateTsc();
+#endif
+    errno = saved_errno;
+}
+
+/* called by every thread of the force kernel, a thread that migrates between
+ * start and stop is read on the CPU it started on */
+void startFrequency(void)
+{
+#ifdef HAVE_MSR
+    if (counters != NULL) {
+        FrequencyCounters* c = &counters[getThreadId()];
+        c->cpu               = sched_getcpu();
+        readMsr(c->cpu, MSR_APERF, &c->aperf);
+        readMsr(c->cpu, MSR_MPERF, &c->mperf);
+    }
+#endif
+}
+
+void stopFrequency(void)
+{
+#ifdef HAVE_MSR
+    if (counters != NULL) {
+        FrequencyCounters* c = &counters[getThreadId()];
+        uint64_t aperf, mperf;
+
+        if (readMsr(c->cpu, MSR_APERF, &aperf) && readMsr(c->cpu, MSR_MPERF, &mperf)) {
+            c->aperf_sum += (double)(aperf - c->aperf);
+            c->mperf_sum += (double)(mperf - c->mperf);
+        }
+    }
+#endif
+}
+
+// Each thread runs a chain of dependent register adds, one cycle per add on
+// all current cores, the loop overhead executes in parallel to the chain. The
+// increment is a register, adds of immediates are folded by newer cores. The
+// chain is timed in thread CPU time, so threads that share a core with others
+// (more threads than cores) are not counted as slow while they wait.
+#if defined(__x86_64__) || defined(__aarch64__)
+#if defined(__x86_64__)
+#define ADD_1 "add %1, %0\n\t"
+#else
+#define ADD_1 "add %0, %0, %1\n\t"
+#endif
+#define ADD_10  ADD_1 ADD_1 ADD_1 ADD_1 ADD_1 ADD_1 ADD_1 ADD_1 ADD_1 ADD_1
+#define ADD_100 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10 ADD_10
+
+static double timedAddChain(void)
+{
+    uint64_t x   = 0;
+    uint64_t inc = (uint64_t)getTimeStamp() | 1;
+    double S, E;
+
+    for (int rep = 0; rep < 2; rep++) {
+        S = getThreadTime();
+        for (int i = 0; i < CALIBRATION_ITERS; i++) {
+            __asm__ volatile(ADD_100 : "+r"(x) : "r"(inc));
+        }
+        E = getThreadTime();
+    }
+
+    return 100.0 * CALIBRATION_ITERS / (E - S) * 1e-9;
+}
+#else
+static double timedAddChain(void) { return 0.0; }
+#endif
+
+static double calibrateFrequency(void)
+{
+    double sum = 0.0;
+    int n      = 0;
+
+#pragma omp parallel reduction(+ : sum, n)
+    {
+        sum += timedAddChain();
+        n++;
+    }
+
+    return sum / n;
+}
+
+double getFrequency(Parameter* param)
+{
+    double aperf = 0.0, mperf = 0.0;
+
+    if (param->proc_freq > 0.0) {
+        source = "user";
+        return param->proc_freq;
+    }
+
+    if (counters != NULL) {
+        for (int t = 0; t < nthreads; t++) {
+            aperf += counters[t].aperf_sum;
+            mperf += counters[t].mperf_sum;
+        }
+
+        if (mperf > 0.0) {
+            source = "APERF/MPERF";
+            return tsc_ghz * aperf / mperf;
+        }
+    }
+
+    if (calibrated_ghz == 0.0) {
+        calibrated_ghz = calibrateFrequency();
+    }
+
+    source = (calibrated_ghz > 0.0) ? "add chain" : "not measured";
+    return calibrated_ghz;
+}
+
+const char* getFrequencySource(void) { return source; }
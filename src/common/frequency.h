@@ -0,0 +1,22 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <parameter.h>
+
+#ifndef __FREQUENCY_H_
+#define __FREQUENCY_H_
+// Core frequency used for the cycle metrics. A frequency given with --freq is
+// taken as is. Otherwise the APERF/MPERF counters of every thread are sampled
+// around the force kernel (x86, needs read access to /dev/cpu/*/msr) and scaled
+// with the calibrated TSC rate. Without MSR access a timed chain of dependent
+// integer adds is run on all threads once, which shows turbo but not the lower
+// clock of wide SIMD units.
+extern void initFrequency(void);
+extern void startFrequency(void);
+extern void stopFrequency(void);
+extern double getFrequency(Parameter* param);
+extern const char* getFrequencySource(void);
+#endif
@@ -69,6 +69,18 @@ operation is performed
 #define LIKWID_MARKER_RESET(regionTag)    likwid_markerResetRegion(regionTag)
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)                       \
     likwid_markerGetRegion(regionTag, nevents, events, time, count)
+#elif defined(PERFCTR)
+/* Without likwid the markers can drive the built-in perf_event backend */
+#include <perfctr.h>
+#define LIKWID_MARKER_INIT                perfctrInit()
+#define LIKWID_MARKER_THREADINIT          perfctrThreadInit()
+#define LIKWID_MARKER_SWITCH
+#define LIKWID_MARKER_REGISTER(regionTag) perfctrRegister(regionTag)
+#define LIKWID_MARKER_START(regionTag)    perfctrStart(regionTag)
+#define LIKWID_MARKER_STOP(regionTag)     perfctrStop(regionTag)
+#define LIKWID_MARKER_CLOSE               perfctrClose()
+#define LIKWID_MARKER_RESET(regionTag)
+#define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)
 #else /* LIKWID_PERFMON */
 #define LIKWID_MARKER_INIT
 #define LIKWID_MARKER_THREADINIT
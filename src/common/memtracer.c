@@ -0,0 +1,153 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cachesim.h>
+#include <memtracer.h>
+#include <parameter.h>
+
+#define MAX_TRACED_ARRAYS CACHE_SIM_MAX_ARRAYS
+
+typedef struct {
+    uintptr_t begin;
+    uintptr_t end;
+    int id;
+} TracedArray;
+
+static FILE* fp            = NULL;
+static uintptr_t last_addr = 0;
+static TracedArray traced[MAX_TRACED_ARRAYS];
+static int ntraced   = 0;
+static int last_hit  = 0;
+static int other_id  = -1;
+static int simulated = 0;
+
+#ifdef MEM_TRACER_BINARY
+static void writeVarint(uint64_t v)
+{
+    while (v >= 0x80) {
+        putc((int)(v & 0x7f) | 0x80, fp);
+        v >>= 7;
+    }
+
+    putc((int)v, fp);
+}
+#endif
+
+void memTracerOpen(Parameter* param, int timestep)
+{
+#if defined(MEM_TRACER_TEXT) || defined(MEM_TRACER_BINARY)
+    char filename[128];
+#endif
+
+    ntraced   = 0;
+    last_hit  = 0;
+    last_addr = 0;
+
+#ifdef CACHE_SIM
+    // The cache state is kept across traced timesteps
+    if (!simulated) {
+        initCacheSim(param->cache_config, param->cache_line);
+        other_id  = cacheSimArray("other");
+        simulated = 1;
+    }
+#endif
+
+#if defined(MEM_TRACER_TEXT)
+    snprintf(filename, sizeof filename, "mem_tracer_%d.out", timestep);
+    fp = fopen(filename, "w");
+#elif defined(MEM_TRACER_BINARY)
+    const uint32_t version = MEMTRACER_VERSION;
+    snprintf(filename, sizeof filename, "mem_tracer_%d.bin", timestep);
+    fp = fopen(filename, "wb");
+    if (fp != NULL) {
+        fwrite(MEMTRACER_MAGIC, 1, 8, fp);
+        fwrite(&version, sizeof(uint32_t), 1, fp);
+    }
+#endif
+
+#if defined(MEM_TRACER_TEXT) || defined(MEM_TRACER_BINARY)
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open memory trace file %s!\n", filename);
+        exit(-1);
+    }
+#endif
+}
+
+void memTracerArray(const char* name, const void* ptr, size_t bytes)
+{
+    if (ntraced == MAX_TRACED_ARRAYS) {
+        fprintf(stderr, "Error: Too many traced arrays!\n");
+        exit(-1);
+    }
+
+    traced[ntraced].begin = (uintptr_t)ptr;
+    traced[ntraced].end   = (uintptr_t)ptr + bytes;
+    traced[ntraced].id    = simulated ? cacheSimArray(name) : -1;
+    ntraced++;
+
+#ifdef MEM_TRACER_BINARY
+    size_t len = strlen(name);
+    len        = (len > 255) ? 255 : len;
+    writeVarint(2);
+    putc((int)len, fp);
+    fwrite(name, 1, len, fp);
+    writeVarint((uint64_t)(uintptr_t)ptr);
+    writeVarint((uint64_t)bytes);
+#endif
+}
+
+static int findArray(uintptr_t addr)
+{
+    if (ntraced == 0) {
+        return other_id;
+    }
+
+    // Consecutive accesses mostly hit the same array, so try the last one first
+    if (addr >= traced[last_hit].begin && addr < traced[last_hit].end) {
+        return traced[last_hit].id;
+    }
+
+    for (int a = 0; a < ntraced; a++) {
+        if (addr >= traced[a].begin && addr < traced[a].end) {
+            last_hit = a;
+            return traced[a].id;
+        }
+    }
+
+    return other_id;
+}
+
+void memTracerAccess(const void* ptr, char op)
+{
+    uintptr_t addr = (uintptr_t)ptr;
+
+#if defined(MEM_TRACER_TEXT)
+    fprintf(fp, "%c: %p\n", op, ptr);
+#elif defined(MEM_TRACER_BINARY)
+    // Zigzag encoding keeps small backward strides small, addresses fit in
+    // 62 bits on all supported platforms
+    int64_t delta = (int64_t)(addr - last_addr);
+    writeVarint((((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) << 2 | (op == 'W'));
+#endif
+
+    last_addr = addr;
+    if (simulated) {
+        cacheSimAccess((uint64_t)addr, findArray(addr));
+    }
+}
+
+void memTracerClose(void)
+{
+    if (fp != NULL) {
+        fclose(fp);
+        fp = NULL;
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include <parameter.h>
+
+#ifndef __MEMTRACER_H_
+#define __MEMTRACER_H_
+// Binary traces (mem_tracer_<step>.bin) start with MEMTRACER_MAGIC and a
+// 32-bit version, followed by records that each begin with an unsigned LEB128
+// varint v. For v & 3 == 2 an array definition follows: one length byte, the
+// name, and the base address and size in bytes as varints. Otherwise v is an
+// access, v & 1 is set for writes and v >> 2 is the zigzag encoded distance to
+// the previously traced address.
+#define MEMTRACER_MAGIC   "MDBTRACE"
+#define MEMTRACER_VERSION 1
+
+extern void memTracerOpen(Parameter* param, int timestep);
+extern void memTracerArray(const char* name, const void* ptr, size_t bytes);
+extern void memTracerAccess(const void* addr, char op);
+extern void memTracerClose(void);
+#endif
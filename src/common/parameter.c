@@ -9,6 +9,7 @@
 #include <string.h>
 
 #include <atom.h>
+#include <cachesim.h>
 #include <force.h>
 #include <parameter.h>
 #include <util.h>
@@ -37,17 +38,35 @@ void initParameter(Parameter* param)
     param->cutforce        = 2.5;
     param->skin            = 0.3;
     param->cutneigh        = param->cutforce + param->skin;
+    param->type_cutforce   = NULL;
     param->temp            = 1.44;
     param->nstat           = 100;
     param->mass            = 1.0;
     param->dtforce         = 0.5 * param->dt;
     param->reneigh_every   = 20;
     param->resort_every    = 400;
+#ifdef SORT_ATOMS
+    param->sort_atoms = SORT_BINS;
+#else
+    param->sort_atoms = SORT_NONE;
+#endif
     param->prune_every     = 1000;
     param->x_out_every     = 20;
     param->v_out_every     = 5;
     param->half_neigh      = 0;
-    param->proc_freq       = 2.4;
+    param->super_cluster   = 0;
+    param->cluster_shape   = SHAPE_Z;
+    param->force_direct    = 0;
+    param->force_balance   = 0;
+    param->proc_freq       = 0.0;
+    param->page_report     = 0;
+    param->report_file     = NULL;
+    param->report_csv_file = NULL;
+    param->snapshot_file   = NULL;
+    param->snapshot_step   = 0;
+    param->trace_every     = 20;
+    param->cache_config    = NULL;
+    param->cache_line      = 64;
 }
 
 void readParameter(Parameter* param, const char* filename)
@@ -90,6 +109,7 @@ void readParameter(Parameter* param, const char* filename)
             PARSE_REAL(rho);
             PARSE_REAL(dt);
             PARSE_REAL(cutforce);
+            PARSE_STRING(type_cutforce);
             PARSE_REAL(skin);
             PARSE_REAL(temp);
             PARSE_REAL(mass);
@@ -105,13 +125,31 @@ void readParameter(Parameter* param, const char* filename)
             PARSE_INT(nstat);
             PARSE_INT(reneigh_every);
             PARSE_INT(resort_every);
+            PARSE_PARAM(sort_atoms, str2sort);
             PARSE_INT(prune_every);
             PARSE_INT(x_out_every);
             PARSE_INT(v_out_every);
             PARSE_INT(half_neigh);
+            PARSE_INT(super_cluster);
+            PARSE_PARAM(cluster_shape, str2shape);
+            PARSE_INT(force_direct);
+            PARSE_INT(force_balance);
+            PARSE_INT(page_report);
+            PARSE_STRING(report_file);
+            PARSE_STRING(report_csv_file);
+            PARSE_STRING(snapshot_file);
+            PARSE_INT(snapshot_step);
+            PARSE_INT(trace_every);
+            PARSE_STRING(cache_config);
+            PARSE_INT(cache_line);
         }
     }
 
+    if (param->reneigh_every < 1) {
+        fprintf(stderr, "Invalid reneighbor interval in parameter file: %s\n", filename);
+        exit(-1);
+    }
+
     // Update dtforce
     param->dtforce = 0.5 * param->dt;
 
@@ -140,6 +178,12 @@ void printParameter(Parameter* param)
         printf("\tEAM file: %s\n", param->eam_file);
     }
 
+    if (param->snapshot_file != NULL) {
+        printf("\tSnapshot file: %s (step %d)\n",
+            param->snapshot_file,
+            param->snapshot_step);
+    }
+
     printf("\tForce field: %s\n", ff2str(param->force_field));
 #ifdef CLUSTER_M
     printf("\tKernel: %s, MxN: %dx%d, Vector width: %d\n",
@@ -152,6 +196,7 @@ void printParameter(Parameter* param)
 #endif
     printf("\tData layout: %s\n", POS_DATA_LAYOUT);
     printf("\tFloating-point precision: %s\n", PRECISION_STRING);
+    printf("\tIndex type for offsets: %d-bit\n", (int)(sizeof(MD_INDEX) * 8));
     printf("\tUnit cells (nx, ny, nz): %d, %d, %d\n", param->nx, param->ny, param->nz);
     printf("\tDomain box sizes (x, y, z): %e, %e, %e\n",
         param->xprd,
@@ -171,17 +216,104 @@ void printParameter(Parameter* param)
     printf("\tNumber of timesteps: %d\n", param->ntimes);
     printf("\tReport stats every (timesteps): %d\n", param->nstat);
     printf("\tReneighbor every (timesteps): %d\n", param->reneigh_every);
-#ifdef SORT_ATOMS
-    printf("\tResort atoms every (timesteps): %d\n", param->resort_every);
-#else
-    printf("\tSort atoms: no\n");
-#endif
+    if (param->sort_atoms != SORT_NONE && param->resort_every > 0) {
+        printf("\tResort atoms every (timesteps): %d (%s order)\n",
+            param->resort_every,
+            sort2str(param->sort_atoms));
+    } else if (param->sort_atoms != SORT_NONE) {
+        printf("\tSort atoms: at setup only (%s order)\n", sort2str(param->sort_atoms));
+    } else {
+        printf("\tSort atoms: no\n");
+    }
     printf("\tPrune every (timesteps): %d\n", param->prune_every);
     printf("\tOutput positions every (timesteps): %d\n", param->x_out_every);
     printf("\tOutput velocities every (timesteps): %d\n", param->v_out_every);
     printf("\tDelta time (dt): %e\n", param->dt);
     printf("\tCutoff radius: %e\n", param->cutforce);
+    if (param->type_cutforce != NULL) {
+        printf("\tCutoff radius per type: %s\n", param->type_cutforce);
+    }
     printf("\tSkin: %e\n", param->skin);
     printf("\tHalf neighbor lists: %d\n", param->half_neigh);
-    printf("\tProcessor frequency (GHz): %.4f\n", param->proc_freq);
+    if (param->super_cluster > 0) {
+        printf("\tSuper-cluster size (clusters): %d\n", param->super_cluster);
+    }
+    if (param->cluster_shape != SHAPE_Z) {
+        printf("\tCluster shape: %s\n", shape2str(param->cluster_shape));
+    }
+    if (param->force_direct) {
+        printf("\tDirect force from the bins: yes\n");
+    }
+    if (param->force_balance) {
+        printf("\tBalanced static force partition: yes\n");
+    }
+    if (param->proc_freq > 0.0) {
+        printf("\tProcessor frequency (GHz): %.4f\n", param->proc_freq);
+    } else {
+        printf("\tProcessor frequency (GHz): measured\n");
+    }
+#if defined(HUGE_PAGES_THP)
+    printf("\tHuge pages: transparent\n");
+#elif defined(HUGE_PAGES_EXPLICIT)
+    printf("\tHuge pages: explicit\n");
+#else
+    printf("\tHuge pages: no\n");
+#endif
+#if defined(MEM_TRACER) || defined(INDEX_TRACER)
+    printf("\tTrace every (timesteps): %d\n", param->trace_every);
+#endif
+#ifdef CACHE_SIM
+    printf("\tCache model: %s, line size %d\n",
+        (param->cache_config != NULL) ? param->cache_config : CACHE_SIM_DEFAULT,
+        param->cache_line);
+#endif
+}
+
+/* per type cutoffs from the comma separated type_cutforce list, types that are
+ * not listed use cutforce; a type pair uses the mean cutoff of both types and
+ * the same skin as the global cutoff */
+void setTypeCutoffs(
+    Parameter* param, int ntypes, MD_FLOAT* cutforcesq, MD_FLOAT* cutneighsq)
+{
+    MD_FLOAT* cut = (MD_FLOAT*)malloc(ntypes * sizeof(MD_FLOAT));
+    MD_FLOAT skin = param->cutneigh - param->cutforce;
+
+    for (int t = 0; t < ntypes; t++) {
+        cut[t] = param->cutforce;
+    }
+
+    if (param->type_cutforce != NULL) {
+        char* list = strdup(param->type_cutforce);
+        char* tok  = strtok(list, ",");
+
+        for (int t = 0; t < ntypes && tok != NULL; t++) {
+            cut[t] = atof(tok);
+            if (cut[t] <= 0.0 || cut[t] > param->cutforce) {
+                fprintf(stderr,
+                    "Error: Cutoff %s of type %d must be positive and at most the "
+                    "cutoff radius %f!\n",
+                    tok,
+                    t,
+                    param->cutforce);
+                exit(-1);
+            }
+
+            tok = strtok(NULL, ",");
+        }
+
+        free(list);
+    }
+
+    for (int ti = 0; ti < ntypes; ti++) {
+        for (int tj = 0; tj < ntypes; tj++) {
+            MD_FLOAT cutforce = 0.5 * (cut[ti] + cut[tj]);
+            MD_FLOAT cutneigh = (cutforce == param->cutforce) ? param->cutneigh
+                                                              : cutforce + skin;
+
+            cutforcesq[ti * ntypes + tj] = cutforce * cutforce;
+            cutneighsq[ti * ntypes + tj] = cutneigh * cutneigh;
+        }
+    }
+
+    free(cut);
 }
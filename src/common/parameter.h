@@ -28,6 +28,21 @@
 */
 #endif
 
+// Integer type for offsets into large arrays (e.g. neighbor lists), counts
+// and IDs of atoms and clusters remain int
+#if INDEX_BITS == 32
+#define MD_INDEX int
+#else
+#define MD_INDEX int64_t
+#endif
+
+// Order of the local atoms, set up by sortAtom in the verlet list scheme
+enum sortorder { SORT_NONE = 0, SORT_BINS, SORT_MORTON, SORT_HILBERT };
+
+// Order of the atoms of a bin before they are cut into clusters, see buildClusters
+// in the cluster pair scheme
+enum clustershape { SHAPE_Z = 0, SHAPE_SUBCOLUMN, SHAPE_MORTON };
+
 typedef struct {
     int force_field;
     char* param_file;
@@ -46,15 +61,21 @@ typedef struct {
     int nstat;
     int reneigh_every;
     int resort_every;
+    int sort_atoms;
     int prune_every;
     int x_out_every;
     int v_out_every;
     int half_neigh;
+    int super_cluster;
+    int cluster_shape;
+    int force_direct;
+    int force_balance;
     MD_FLOAT dt;
     MD_FLOAT dtforce;
     MD_FLOAT skin;
     MD_FLOAT cutforce;
     MD_FLOAT cutneigh;
+    char* type_cutforce;
     int nx, ny, nz;
     int pbc_x, pbc_y, pbc_z;
     MD_FLOAT lattice;
@@ -62,10 +83,19 @@ typedef struct {
     MD_FLOAT xprd, yprd, zprd;
     double proc_freq;
     char* eam_file;
+    int page_report;
+    char* report_file;
+    char* report_csv_file;
+    char* snapshot_file;
+    int snapshot_step;
+    int trace_every;
+    char* cache_config;
+    int cache_line;
 } Parameter;
 
 void initParameter(Parameter*);
 void readParameter(Parameter*, const char*);
 void printParameter(Parameter*);
+void setTypeCutoffs(Parameter*, int, MD_FLOAT*, MD_FLOAT*);
 
 #endif
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <allocate.h>
+#include <parameter.h>
+#include <perfctr.h>
+#include <util.h>
+
+#define MAX_PERF_REGIONS 16
+#define MAX_TAG_LENGTH   32
+#define CACHE_LINE_SIZE  64
+
+typedef struct {
+    int fd[NUM_PERF_EVENTS];
+    int opened;
+    uint64_t start[MAX_PERF_REGIONS][NUM_PERF_EVENTS][3];
+    double count[MAX_PERF_REGIONS][NUM_PERF_EVENTS];
+    long calls[MAX_PERF_REGIONS];
+} ThreadCounters;
+
+static const char* event_names[NUM_PERF_EVENTS] = {
+    "cycles",
+    "instructions",
+    "L1D misses",
+    "L2 misses",
+    "LLC misses",
+    "FP scalar",
+    "FP 128-bit",
+    "FP 256-bit",
+    "FP 512-bit",
+};
+
+static char regions[MAX_PERF_REGIONS][MAX_TAG_LENGTH];
+static int nregions             = 0;
+static ThreadCounters* counters = NULL;
+static int nthreads             = 0;
+static int available[NUM_PERF_EVENTS];
+
+static inline int getThreadId(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+static int isIntelCpu(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    char line[MAXLINE];
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    int intel = 0;
+
+    if (fp == NULL) {
+        return 0;
+    }
+
+    while (fgets(line, MAXLINE, fp) != NULL) {
+        if (strncmp(line, "vendor_id", 9) == 0) {
+            intel = strstr(line, "GenuineIntel") != NULL;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return intel;
+#else
+    return 0;
+#endif
+}
+
+/* generic events where the kernel has them, L2 misses and FP operations only
+ * exist as model-specific raw events, these are the Intel encodings of
+ * L2_RQSTS.MISS and FP_ARITH_INST_RETIRED (Skylake and later) */
+static int setupEvent(perfevent event, struct perf_event_attr* attr)
+{
+    static int intel = -1;
+#if PRECISION == 1
+    const uint64_t fpUmask[4] = { 0x02, 0x08, 0x20, 0x80 };
+#else
+    const uint64_t fpUmask[4] = { 0x01, 0x04, 0x10, 0x40 };
+#endif
+
+    if (intel < 0) {
+        intel = isIntelCpu();
+    }
+
+    memset(attr, 0, sizeof(struct perf_event_attr));
+    attr->size           = sizeof(struct perf_event_attr);
+    attr->disabled       = 0;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv     = 1;
+    attr->read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+    case PERF_CYCLES:
+        attr->type   = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        return 1;
+    case PERF_INSTRUCTIONS:
+        attr->type   = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        return 1;
+    case PERF_L1D_MISSES:
+        attr->type   = PERF_TYPE_HW_CACHE;
+        attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        return 1;
+    case PERF_LLC_MISSES:
+        attr->type   = PERF_TYPE_HARDWARE;
+        attr->config = PERF_COUNT_HW_CACHE_MISSES;
+        return 1;
+    case PERF_L2_MISSES:
+        attr->type   = PERF_TYPE_RAW;
+        attr->config = 0x3F24;
+        return intel;
+    default:
+        attr->type   = PERF_TYPE_RAW;
+        attr->config = (fpUmask[event - PERF_FP_SCALAR] << 8) | 0xC7;
+        return intel;
+    }
+}
+#endif
+
+void perfctrInit(void)
+{
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#else
+    nthreads = 1;
+#endif
+    counters = (ThreadCounters*)allocate(ALIGNMENT, nthreads * sizeof(ThreadCounters));
+    memset(counters, 0, nthreads * sizeof(ThreadCounters));
+
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        available[e] = 0;
+    }
+}
+
+/* open the counters of the calling thread, they only count this thread
+ * (pid 0, any cpu) and in user space, so they work with perf_event_paranoid
+ * up to 2; events that fail to open are left out of the report */
+void perfctrThreadInit(void)
+{
+    ThreadCounters* tc = &counters[getThreadId()];
+    if (tc->opened) {
+        return;
+    }
+
+    tc->opened = 1;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        tc->fd[e] = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        if (setupEvent(e, &attr)) {
+            tc->fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+
+        if (tc->fd[e] >= 0) {
+#pragma omp atomic write
+            available[e] = 1;
+        } else if (e == PERF_CYCLES && getThreadId() == 0) {
+            fprintf(stderr,
+                "Warning: hardware counters unavailable (%s), check "
+                "/proc/sys/kernel/perf_event_paranoid\n",
+                strerror(errno));
+        }
+#endif
+    }
+}
+
+static int findRegion(const char* tag)
+{
+    for (int r = 0; r < nregions; r++) {
+        if (strncmp(regions[r], tag, MAX_TAG_LENGTH) == 0) {
+            return r;
+        }
+    }
+
+    return -1;
+}
+
+static int addRegion(const char* tag)
+{
+    int r;
+
+#pragma omp critical(perfctr)
+    {
+        r = findRegion(tag);
+        if (r < 0 && nregions < MAX_PERF_REGIONS) {
+            strncpy(regions[nregions], tag, MAX_TAG_LENGTH - 1);
+            r = nregions++;
+        }
+    }
+
+    return r;
+}
+
+void perfctrRegister(const char* tag)
+{
+    if (counters != NULL) {
+        perfctrThreadInit();
+        addRegion(tag);
+    }
+}
+
+static void readCounters(ThreadCounters* tc, uint64_t values[NUM_PERF_EVENTS][3])
+{
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        if (tc->fd[e] < 0 || read(tc->fd[e], values[e], 3 * sizeof(uint64_t)) < 0) {
+            values[e][0] = values[e][1] = values[e][2] = 0;
+        }
+    }
+}
+
+void perfctrStart(const char* tag)
+{
+    if (counters == NULL) {
+        return;
+    }
+
+    int r = findRegion(tag);
+    if (r < 0) {
+        r = addRegion(tag);
+    }
+
+    ThreadCounters* tc = &counters[getThreadId()];
+    perfctrThreadInit();
+    if (r >= 0) {
+        readCounters(tc, tc->start[r]);
+    }
+}
+
+/* counts are scaled by enabled/running time, so they stay meaningful when the
+ * kernel multiplexes more events than the PMU has counters */
+void perfctrStop(const char* tag)
+{
+    int r = (counters != NULL) ? findRegion(tag) : -1;
+    if (r < 0) {
+        return;
+    }
+
+    ThreadCounters* tc = &counters[getThreadId()];
+    uint64_t stop[NUM_PERF_EVENTS][3];
+    readCounters(tc, stop);
+
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        double value   = (double)(stop[e][0] - tc->start[r][e][0]);
+        double enabled = (double)(stop[e][1] - tc->start[r][e][1]);
+        double running = (double)(stop[e][2] - tc->start[r][e][2]);
+
+        if (running > 0.0) {
+            tc->count[r][e] += value * enabled / running;
+        }
+    }
+
+    tc->calls[r]++;
+}
+
+int perfctrGetCount(const char* tag, perfevent event, double* count)
+{
+    int r = (counters != NULL) ? findRegion(tag) : -1;
+    if (r < 0 || !available[event]) {
+        return -1;
+    }
+
+    *count = 0.0;
+    for (int t = 0; t < nthreads; t++) {
+        *count += counters[t].count[r][event];
+    }
+
+    return 0;
+}
+
+/* floating-point operations from the FP_ARITH counts, which already count an
+ * FMA twice, weighted with the number of MD_FLOAT lanes of each width */
+static int getFlops(const char* tag, double* flops)
+{
+    const int lanes[4] = { 1,
+        16 / sizeof(MD_FLOAT),
+        32 / sizeof(MD_FLOAT),
+        64 / sizeof(MD_FLOAT) };
+    int found          = 0;
+    double count;
+
+    *flops = 0.0;
+    for (int w = 0; w < 4; w++) {
+        if (perfctrGetCount(tag, PERF_FP_SCALAR + w, &count) == 0) {
+            *flops += count * lanes[w];
+            found = 1;
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
+void perfctrPrintMetrics(const char* tag, double pairs)
+{
+    double cycles, instr, l1, l2, llc, flops;
+
+    if (perfctrGetCount(tag, PERF_CYCLES, &cycles) < 0) {
+        printf("\tHardware counters (%s): not available\n", tag);
+        return;
+    }
+
+    printf("\tHardware counters (%s):\n", tag);
+    if (perfctrGetCount(tag, PERF_INSTRUCTIONS, &instr) == 0 && cycles > 0.0) {
+        printf("\t\tIPC: %.4f\n", instr / cycles);
+    }
+
+    if (pairs <= 0.0) {
+        return;
+    }
+
+    printf("\t\tCycles/pair: %.4f\n", cycles / pairs);
+    if (perfctrGetCount(tag, PERF_L1D_MISSES, &l1) == 0) {
+        printf("\t\tL1D bytes/pair: %.4f\n", l1 * CACHE_LINE_SIZE / pairs);
+    }
+
+    if (perfctrGetCount(tag, PERF_L2_MISSES, &l2) == 0) {
+        printf("\t\tL2 bytes/pair: %.4f\n", l2 * CACHE_LINE_SIZE / pairs);
+    }
+
+    if (perfctrGetCount(tag, PERF_LLC_MISSES, &llc) == 0) {
+        printf("\t\tMemory bytes/pair: %.4f\n", llc * CACHE_LINE_SIZE / pairs);
+    }
+
+    if (getFlops(tag, &flops) == 0) {
+        printf("\t\tFlops/pair: %.4f\n", flops / pairs);
+    }
+}
+
+/* print the counts of every region summed over threads with the spread of the
+ * cycles across threads, then release the counters */
+void perfctrClose(void)
+{
+    if (counters == NULL) {
+        return;
+    }
+
+    int any = 0;
+    for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+        any |= available[e];
+    }
+
+    if (!any) {
+        printf("Hardware counters (perf_event): not available\n");
+    }
+
+    for (int r = 0; any && r < nregions; r++) {
+        if (r == 0) {
+            printf("Hardware counters (perf_event, summed over threads):\n");
+        }
+
+        double cmin = 0.0, cmax = 0.0, csum = 0.0;
+        long calls  = 0;
+        int active  = 0;
+
+        for (int t = 0; t < nthreads; t++) {
+            if (counters[t].calls[r] > 0) {
+                double c = counters[t].count[r][PERF_CYCLES];
+                cmin     = (active == 0) ? c : MIN(cmin, c);
+                cmax     = MAX(cmax, c);
+                csum += c;
+                calls = MAX(calls, counters[t].calls[r]);
+                active++;
+            }
+        }
+
+        if (active == 0) {
+            continue;
+        }
+
+        printf("\t%s: %ld calls, %d threads\n", regions[r], calls, active);
+        for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+            double count;
+            if (perfctrGetCount(regions[r], e, &count) == 0) {
+                printf("\t\t%-14s %.4e\n", event_names[e], count);
+            } else {
+                printf("\t\t%-14s n/a\n", event_names[e]);
+            }
+        }
+
+        if (available[PERF_CYCLES]) {
+            printf("\t\tcycles/thread  min %.4e avg %.4e max %.4e\n",
+                cmin,
+                csum / active,
+                cmax);
+        }
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        for (int e = 0; e < NUM_PERF_EVENTS; e++) {
+            if (counters[t].opened && counters[t].fd[e] >= 0) {
+                close(counters[t].fd[e]);
+            }
+        }
+    }
+
+    deallocate(counters);
+    counters = NULL;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+typedef enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_L2_MISSES,
+    PERF_LLC_MISSES,
+    PERF_FP_SCALAR,
+    PERF_FP_128,
+    PERF_FP_256,
+    PERF_FP_512,
+    NUM_PERF_EVENTS
+} perfevent;
+
+extern void perfctrInit(void);
+extern void perfctrThreadInit(void);
+extern void perfctrRegister(const char* tag);
+extern void perfctrStart(const char* tag);
+extern void perfctrStop(const char* tag);
+extern void perfctrClose(void);
+extern int perfctrGetCount(const char* tag, perfevent event, double* count);
+extern void perfctrPrintMetrics(const char* tag, double pairs);
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atom.h>
+#include <force.h>
+#include <parameter.h>
+#include <report.h>
+#include <util.h>
+
+#define MAX_REPORT_ENTRIES 256
+#define MAX_KEY_LENGTH     48
+#define MAX_VALUE_LENGTH   128
+
+typedef enum { REPORT_STRING = 0, REPORT_INT, REPORT_REAL } reporttype;
+
+typedef struct {
+    char section[MAX_KEY_LENGTH];
+    char key[MAX_KEY_LENGTH];
+    reporttype type;
+    char string[MAX_VALUE_LENGTH];
+    long long int integer;
+    double real;
+} ReportEntry;
+
+// Entries are collected during the run in the order they are added and only
+// written out at the end, grouped by section
+static ReportEntry entries[MAX_REPORT_ENTRIES];
+static int nentries = 0;
+static char current_section[MAX_KEY_LENGTH] = "run";
+
+void reportSection(const char* section)
+{
+    snprintf(current_section, sizeof(current_section), "%s", section);
+}
+
+static ReportEntry* addEntry(const char* key, reporttype type)
+{
+    if (nentries == MAX_REPORT_ENTRIES) {
+        fprintf(stderr, "Warning: report full, dropping %s.%s\n", current_section, key);
+        return NULL;
+    }
+
+    ReportEntry* entry = &entries[nentries++];
+    snprintf(entry->section, sizeof(entry->section), "%s", current_section);
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    entry->type = type;
+    return entry;
+}
+
+void reportString(const char* key, const char* value)
+{
+    ReportEntry* entry = addEntry(key, REPORT_STRING);
+    if (entry != NULL) {
+        snprintf(entry->string, sizeof(entry->string), "%s", (value != NULL) ? value : "");
+    }
+}
+
+void reportInt(const char* key, long long int value)
+{
+    ReportEntry* entry = addEntry(key, REPORT_INT);
+    if (entry != NULL) {
+        entry->integer = value;
+    }
+}
+
+void reportReal(const char* key, double value)
+{
+    ReportEntry* entry = addEntry(key, REPORT_REAL);
+    if (entry != NULL) {
+        entry->real = value;
+    }
+}
+
+/* the default Lennard-Jones parameters (unit mass, epsilon and sigma) are reduced
+ * units with dt in tau, EAM and the parameter files of real systems such as argon
+ * use the metal and GROMACS unit systems with dt in ps */
+static int isReducedUnits(Parameter* param)
+{
+    return param->force_field == FF_LJ && param->mass == 1.0 && param->epsilon == 1.0 &&
+           param->sigma6 == 1.0;
+}
+
+const char* getTimePerDayUnit(Parameter* param)
+{
+    return isReducedUnits(param) ? "tau" : "ns";
+}
+
+// Simulated time per day of wall time, in ns or in tau for reduced units
+double getTimePerDay(Parameter* param, double time)
+{
+    double scale = isReducedUnits(param) ? 1.0 : 1e-3;
+    return (time > 0.0) ? scale * param->ntimes * param->dt * 86400.0 / time : 0.0;
+}
+
+// The key names the unit, ns_per_day or tau_per_day
+void reportTimePerDay(Parameter* param, double time)
+{
+    char key[MAX_KEY_LENGTH];
+
+    snprintf(key, MAX_KEY_LENGTH, "%s_per_day", getTimePerDayUnit(param));
+    reportReal(key, getTimePerDay(param, time));
+}
+
+void reportBuildConfig(Parameter* param)
+{
+    reportSection("build");
+#ifdef CLUSTER_M
+    reportString("scheme", "clusterpair");
+#else
+    reportString("scheme", "verletlist");
+#endif
+    reportString("kernel", KERNEL_NAME);
+    reportInt("vector_width", VECTOR_WIDTH);
+#ifdef CLUSTER_M
+    reportInt("cluster_m", CLUSTER_M);
+    reportInt("cluster_n", CLUSTER_N);
+#endif
+    reportString("precision", PRECISION_STRING);
+    reportString("data_layout", POS_DATA_LAYOUT);
+    reportInt("index_bits", sizeof(MD_INDEX) * 8);
+#if defined(HUGE_PAGES_THP)
+    reportString("huge_pages", "transparent");
+#elif defined(HUGE_PAGES_EXPLICIT)
+    reportString("huge_pages", "explicit");
+#else
+    reportString("huge_pages", "no");
+#endif
+    reportInt("sort_atoms", param->sort_atoms != SORT_NONE);
+    reportString("sort_order", sort2str(param->sort_atoms));
+#ifdef __VERSION__
+    reportString("compiler", __VERSION__);
+#endif
+
+    reportSection("parameters");
+    reportString("force_field", ff2str(param->force_field));
+    reportString("input_file", param->input_file);
+    reportInt("nx", param->nx);
+    reportInt("ny", param->ny);
+    reportInt("nz", param->nz);
+    reportInt("ntypes", param->ntypes);
+    reportInt("ntimes", param->ntimes);
+    reportReal("dt", param->dt);
+    reportReal("cutforce", param->cutforce);
+    reportReal("skin", param->skin);
+    reportInt("reneigh_every", param->reneigh_every);
+    reportInt("prune_every", param->prune_every);
+    reportInt("half_neigh", param->half_neigh);
+    reportInt("super_cluster", param->super_cluster);
+    reportString("cluster_shape", shape2str(param->cluster_shape));
+    reportInt("force_direct", param->force_direct);
+    reportInt("force_balance", param->force_balance);
+    reportReal("proc_freq", param->proc_freq);
+}
+
+static void writeJsonString(FILE* fp, const char* s)
+{
+    fputc('"', fp);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', fp);
+        }
+
+        fputc((*s == '\n') ? ' ' : *s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* fields with separators, quotes or line breaks are quoted with doubled quotes
+ * as in RFC 4180 */
+static void writeCsvString(FILE* fp, const char* s)
+{
+    if (strpbrk(s, ",\"\r\n") == NULL) {
+        fputs(s, fp);
+        return;
+    }
+
+    fputc('"', fp);
+    for (; *s != '\0'; s++) {
+        if (*s == '"') {
+            fputc('"', fp);
+        }
+
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* NaN and infinity have all exponent bits set; isfinite() cannot be used since
+ * -ffast-math lets the compiler assume that every value is finite */
+static int isFiniteReal(double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return ((bits >> 52) & 0x7ff) != 0x7ff;
+}
+
+// Reals that are not finite are written as null in JSON and as empty CSV fields
+static void writeValue(FILE* fp, ReportEntry* entry, int json)
+{
+    switch (entry->type) {
+    case REPORT_STRING:
+        if (json) {
+            writeJsonString(fp, entry->string);
+        } else {
+            writeCsvString(fp, entry->string);
+        }
+        break;
+    case REPORT_INT:
+        fprintf(fp, "%lld", entry->integer);
+        break;
+    case REPORT_REAL:
+        if (isFiniteReal(entry->real)) {
+            fprintf(fp, "%.9g", entry->real);
+        } else if (json) {
+            fprintf(fp, "null");
+        }
+        break;
+    }
+}
+
+static void writeJson(const char* filename)
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open report file: %s\n", filename);
+        return;
+    }
+
+    fprintf(fp, "{\n");
+    for (int i = 0; i < nentries; i++) {
+        int first = 1;
+
+        // every section is written once, at its first entry
+        for (int j = 0; j < i && first; j++) {
+            first = strcmp(entries[j].section, entries[i].section) != 0;
+        }
+
+        if (!first) {
+            continue;
+        }
+
+        fprintf(fp, "%s  \"%s\": {", (i > 0) ? ",\n" : "", entries[i].section);
+        int n = 0;
+        for (int j = i; j < nentries; j++) {
+            if (strcmp(entries[j].section, entries[i].section) == 0) {
+                fprintf(fp, "%s\n    \"%s\": ", (n++ > 0) ? "," : "", entries[j].key);
+                writeValue(fp, &entries[j], 1);
+            }
+        }
+        fprintf(fp, "\n  }");
+    }
+    fprintf(fp, "\n}\n");
+    fclose(fp);
+}
+
+// Header line of the entries of this run, the caller frees it
+static char* getCsvHeader(void)
+{
+    char* header = (char*)malloc(nentries * (2 * MAX_KEY_LENGTH + 1) + 2);
+    int n        = 0;
+
+    header[0] = '\0';
+    for (int i = 0; i < nentries; i++) {
+        n += sprintf(&header[n],
+            "%s%s.%s",
+            (i > 0) ? "," : "",
+            entries[i].section,
+            entries[i].key);
+    }
+
+    header[n++] = '\n';
+    header[n]   = '\0';
+    return header;
+}
+
+/* one line per run appended to the file, the header is written when the file is
+ * new or empty so repeated runs build up a table. The columns depend on the build
+ * and on the enabled options (super-clusters, balancing...), a run whose
+ * header differs from the one in the file is not appended */
+static int writeCsv(const char* filename)
+{
+    char* header = getCsvHeader();
+    int length   = strlen(header);
+    char* line   = (char*)malloc(length + 2);
+    FILE* fp     = fopen(filename, "a+");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open report file: %s\n", filename);
+        free(header);
+        free(line);
+        return 0;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    if (ftell(fp) == 0) {
+        fputs(header, fp);
+    } else {
+        rewind(fp);
+        if (fgets(line, length + 2, fp) == NULL || strcmp(line, header) != 0) {
+            fprintf(stderr,
+                "Warning: columns of %s differ from this run, report not appended\n",
+                filename);
+            fclose(fp);
+            free(header);
+            free(line);
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < nentries; i++) {
+        if (i > 0) {
+            fputc(',', fp);
+        }
+
+        writeValue(fp, &entries[i], 0);
+    }
+    fprintf(fp, "\n");
+    fclose(fp);
+    free(header);
+    free(line);
+    return 1;
+}
+
+void writeReport(Parameter* param)
+{
+    if (param->report_file != NULL) {
+        writeJson(param->report_file);
+        printf("Report written to %s\n", param->report_file);
+    }
+
+    if (param->report_csv_file != NULL && writeCsv(param->report_csv_file)) {
+        printf("Report appended to %s\n", param->report_csv_file);
+    }
+}
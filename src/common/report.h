@@ -0,0 +1,22 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <parameter.h>
+
+#ifndef __REPORT_H_
+#define __REPORT_H_
+
+extern void reportSection(const char* section);
+extern void reportString(const char* key, const char* value);
+extern void reportInt(const char* key, long long int value);
+extern void reportReal(const char* key, double value);
+extern void reportBuildConfig(Parameter* param);
+extern void writeReport(Parameter* param);
+extern double getTimePerDay(Parameter* param, double time);
+extern const char* getTimePerDayUnit(Parameter* param);
+extern void reportTimePerDay(Parameter* param, double time);
+
+#endif
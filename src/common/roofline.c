@@ -0,0 +1,106 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <allocate.h>
+#include <parameter.h>
+#include <roofline.h>
+#include <timing.h>
+#include <util.h>
+
+// 3 x 64 MB arrays, large enough to exceed the last level cache
+#define STREAM_SIZE   (1 << 23)
+#define STREAM_NTIMES 5
+// Independent accumulators (chains x lanes) to hide the FMA latency
+#define FMA_CHAINS 12
+#define FMA_LANES  (64 / (int)sizeof(MD_FLOAT))
+#define FMA_ITERS  2000000
+
+double probeBandwidth(void)
+{
+    double* a   = (double*)allocate(ALIGNMENT, STREAM_SIZE * sizeof(double));
+    double* b   = (double*)allocate(ALIGNMENT, STREAM_SIZE * sizeof(double));
+    double* c   = (double*)allocate(ALIGNMENT, STREAM_SIZE * sizeof(double));
+    double best = 1e30;
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < STREAM_SIZE; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    for (int k = 0; k < STREAM_NTIMES; k++) {
+        double S = getTimeStamp();
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < STREAM_SIZE; i++) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+        best = MIN(best, getTimeStamp() - S);
+    }
+
+    if (a[STREAM_SIZE / 2] != 7.0) {
+        fprintf(stderr, "Warning: bandwidth probe produced wrong results\n");
+    }
+
+    deallocate(a);
+    deallocate(b);
+    deallocate(c);
+    // Like STREAM, write-allocate traffic is not counted
+    return 3.0 * STREAM_SIZE * sizeof(double) / best * 1e-9;
+}
+
+double probePeakFlops(void)
+{
+    double sum  = 0.0;
+    int threads = 1;
+    double S    = getTimeStamp();
+
+#pragma omp parallel reduction(+ : sum)
+    {
+        MD_FLOAT acc[FMA_CHAINS][FMA_LANES];
+        const MD_FLOAT scale = 0.999999;
+        const MD_FLOAT shift = 1e-6;
+
+#ifdef _OPENMP
+#pragma omp single
+        threads = omp_get_num_threads();
+#endif
+
+        for (int c = 0; c < FMA_CHAINS; c++) {
+            for (int l = 0; l < FMA_LANES; l++) {
+                acc[c][l] = (MD_FLOAT)(c + l);
+            }
+        }
+
+        for (int it = 0; it < FMA_ITERS; it++) {
+            for (int c = 0; c < FMA_CHAINS; c++) {
+#pragma omp simd
+                for (int l = 0; l < FMA_LANES; l++) {
+                    acc[c][l] = acc[c][l] * scale + shift;
+                }
+            }
+        }
+
+        for (int c = 0; c < FMA_CHAINS; c++) {
+            for (int l = 0; l < FMA_LANES; l++) {
+                sum += acc[c][l];
+            }
+        }
+    }
+
+    double T = getTimeStamp() - S;
+    if (sum == 0.0) {
+        fprintf(stderr, "Warning: peak probe produced wrong results\n");
+    }
+
+    return 2.0 * FMA_CHAINS * FMA_LANES * (double)FMA_ITERS * threads / T * 1e-9;
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#ifndef __ROOFLINE_H_
+#define __ROOFLINE_H_
+// Machine probes for roofline estimates, both run with the current number of
+// OpenMP threads: a STREAM triad for the memory bandwidth (GB/s) and chains of
+// independent FMAs in MD_FLOAT precision for the arithmetic peak (GFlop/s)
+extern double probeBandwidth(void);
+extern double probePeakFlops(void);
+#endif
@@ -49,7 +49,10 @@ static inline MD_SIMD_MASK simd_mask_from_u32(uint32_t a)
     return result;
 }
 
-static inline uint32_t simd_mask_to_u32(MD_SIMD_MASK mask) { return 0; }
+static inline uint32_t simd_mask_to_u32(MD_SIMD_MASK mask)
+{
+    return (uint32_t)((vgetq_lane_u64(mask, 0) & 0x1) | (vgetq_lane_u64(mask, 1) & 0x2));
+}
 
 static inline MD_SIMD_MASK simd_mask_and(MD_SIMD_MASK a, MD_SIMD_MASK b)
 {
@@ -48,7 +48,11 @@ static inline MD_SIMD_MASK simd_mask_from_u32(uint32_t a)
         3);
 }
 
-static inline uint32_t simd_mask_to_u32(MD_SIMD_MASK mask) { return 0; }
+static inline uint32_t simd_mask_to_u32(MD_SIMD_MASK mask)
+{
+    return (vgetq_lane_u32(mask, 0) & 0x1) | (vgetq_lane_u32(mask, 1) & 0x2) |
+           (vgetq_lane_u32(mask, 2) & 0x4) | (vgetq_lane_u32(mask, 3) & 0x8);
+}
 
 static inline MD_SIMD_MASK simd_mask_and(MD_SIMD_MASK a, MD_SIMD_MASK b)
 {
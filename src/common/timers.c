@@ -0,0 +1,296 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdio.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <allocate.h>
+#include <energy.h>
+#include <frequency.h>
+#include <report.h>
+#include <timers.h>
+#include <timing.h>
+#include <util.h>
+
+#define NO_PARENT -1
+
+typedef struct {
+    double start[NUMREGIONS];
+    double time[NUMREGIONS];
+    long calls[NUMREGIONS];
+    char pad[64]; // keep the accumulators of neighbouring threads on separate lines
+} RegionTimes;
+
+static const char* region_names[NUMREGIONS] = {
+    "setup",
+    "atoms",
+    "thermo",
+    "sort",
+    "clusters",
+    "ghosts",
+    "binning",
+    "neighbor",
+    "device",
+    "loop",
+    "integrate",
+    "pbc",
+    "prune",
+    "reneighbour",
+    "pbc",
+    "sort",
+    "clusters",
+    "ghosts",
+    "binning",
+    "neighbor",
+    "force",
+    "kernel/thread",
+    "thermo",
+    "output",
+};
+
+static const int region_parents[NUMREGIONS] = {
+    NO_PARENT,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    REGION_SETUP,
+    NO_PARENT,
+    REGION_LOOP,
+    REGION_LOOP,
+    REGION_LOOP,
+    REGION_LOOP,
+    REGION_REBUILD,
+    REGION_REBUILD,
+    REGION_REBUILD,
+    REGION_REBUILD,
+    REGION_REBUILD,
+    REGION_REBUILD,
+    REGION_LOOP,
+    REGION_FORCE,
+    REGION_LOOP,
+    REGION_LOOP,
+};
+
+static RegionTimes* regions = NULL;
+static int nthreads         = 0;
+
+// Regions sampled for energy, these match timer[] in the main drivers
+static int energyTimer(regiontype region)
+{
+    switch (region) {
+    case REGION_LOOP:
+        return TOTAL;
+    case REGION_FORCE:
+        return FORCE;
+    case REGION_REBUILD:
+        return NEIGH;
+    default:
+        return -1;
+    }
+}
+
+static inline int getThreadId(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+void initRegions(void)
+{
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#else
+    nthreads = 1;
+#endif
+    regions = (RegionTimes*)allocate(64, nthreads * sizeof(RegionTimes));
+    memset(regions, 0, nthreads * sizeof(RegionTimes));
+    initFrequency();
+    initEnergy();
+}
+
+/* regions are timed per thread: called outside of a parallel region only the
+ * master accumulates, called inside every thread records its own share, which is
+ * what exposes the load imbalance; does nothing before initRegions() so the stub
+ * drivers can share the instrumented kernels */
+void startRegion(regiontype region)
+{
+    if (regions != NULL) {
+        if (region == REGION_FORCE_THREAD) {
+            startFrequency();
+        } else if (energyTimer(region) >= 0) {
+            startEnergy(energyTimer(region));
+        }
+
+        regions[getThreadId()].start[region] = getTimeStamp();
+    }
+}
+
+void stopRegion(regiontype region)
+{
+    if (regions != NULL) {
+        RegionTimes* r = &regions[getThreadId()];
+        r->time[region] += getTimeStamp() - r->start[region];
+        r->calls[region]++;
+        if (region == REGION_FORCE_THREAD) {
+            stopFrequency();
+        } else if (energyTimer(region) >= 0) {
+            stopEnergy(energyTimer(region));
+        }
+    }
+}
+
+static int regionDepth(int region)
+{
+    int depth = 0;
+    while (region_parents[region] != NO_PARENT) {
+        region = region_parents[region];
+        depth++;
+    }
+
+    return depth;
+}
+
+static void printRegion(int region)
+{
+    double tmin = 0.0, tmax = 0.0, tsum = 0.0;
+    long calls  = 0;
+    int active  = 0;
+
+    for (int t = 0; t < nthreads; t++) {
+        if (regions[t].calls[region] == 0) {
+            continue;
+        }
+
+        double time = regions[t].time[region];
+        tmin        = (active == 0) ? time : MIN(tmin, time);
+        tmax        = MAX(tmax, time);
+        tsum += time;
+        calls = MAX(calls, regions[t].calls[region]);
+        active++;
+    }
+
+    if (active > 0) {
+        double tavg = tsum / active;
+        char label[32];
+
+        snprintf(label,
+            sizeof(label),
+            "%*s%s",
+            2 * regionDepth(region),
+            "",
+            region_names[region]);
+        printf("\t%-20s %8ld %7d %10.4f %10.4f %10.4f %7.1f%%\n",
+            label,
+            calls,
+            active,
+            tmin,
+            tavg,
+            tmax,
+            (tavg > 0.0) ? 100.0 * (tmax / tavg - 1.0) : 0.0);
+    }
+
+    // children are listed right below their parent
+    for (int child = 0; child < NUMREGIONS; child++) {
+        if (region_parents[child] == region) {
+            printRegion(child);
+        }
+    }
+}
+
+void printRegions(void)
+{
+    if (regions == NULL) {
+        return;
+    }
+
+    printf("Timer regions (seconds over threads, imbalance = max/avg - 1):\n");
+    printf("\t%-20s %8s %7s %10s %10s %10s %8s\n",
+        "region",
+        "calls",
+        "threads",
+        "min",
+        "avg",
+        "max",
+        "imbal");
+
+    for (int region = 0; region < NUMREGIONS; region++) {
+        if (region_parents[region] == NO_PARENT) {
+            printRegion(region);
+        }
+    }
+}
+
+/* add the average time of every region to the run report, keyed by its path
+ * so the regions that share a name stay apart */
+void reportRegions(void)
+{
+    if (regions == NULL) {
+        return;
+    }
+
+    reportSection("regions");
+    for (int region = 0; region < NUMREGIONS; region++) {
+        double tsum = 0.0;
+        int active  = 0;
+        char key[64];
+
+        for (int t = 0; t < nthreads; t++) {
+            if (regions[t].calls[region] > 0) {
+                tsum += regions[t].time[region];
+                active++;
+            }
+        }
+
+        if (active == 0) {
+            continue;
+        }
+
+        if (region_parents[region] == NO_PARENT) {
+            snprintf(key, sizeof(key), "%s", region_names[region]);
+        } else {
+            snprintf(key,
+                sizeof(key),
+                "%s/%s",
+                region_names[region_parents[region]],
+                region_names[region]);
+        }
+
+        reportReal(key, tsum / active);
+    }
+}
+
+// Max over mean time of a region over the threads that ran it, 0 if none did
+double getRegionImbalance(regiontype region)
+{
+    double tmax = 0.0, tsum = 0.0;
+    int active  = 0;
+
+    for (int t = 0; t < nthreads; t++) {
+        if (regions[t].calls[region] > 0) {
+            tmax = MAX(tmax, regions[t].time[region]);
+            tsum += regions[t].time[region];
+            active++;
+        }
+    }
+
+    return (tsum > 0.0) ? tmax * active / tsum : 0.0;
+}
+
+// Time of a region on the master thread, which times all serial regions
+double getRegionTime(regiontype region)
+{
+    return (regions != NULL) ? regions[0].time[region] : 0.0;
+}
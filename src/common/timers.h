@@ -7,6 +7,44 @@
 #ifndef __TIMERS_H_
 #define __TIMERS_H_
 
-typedef enum { TOTAL = 0, NEIGH, FORCE, NUMTIMER } timertype;
+typedef enum { TOTAL = 0, NEIGH, FORCE, SETUP, NUMTIMER } timertype;
+
+// Timed regions, the nesting used in the report is given by the parent table in
+// timers.c; regions that never ran are left out of the report
+typedef enum {
+    REGION_SETUP = 0,
+    REGION_SETUP_ATOMS,
+    REGION_SETUP_THERMO,
+    REGION_SETUP_SORT,
+    REGION_SETUP_CLUSTERS,
+    REGION_SETUP_GHOSTS,
+    REGION_SETUP_BINNING,
+    REGION_SETUP_NEIGHBOR,
+    REGION_SETUP_DEVICE,
+    REGION_LOOP,
+    REGION_INTEGRATE,
+    REGION_PBC,
+    REGION_PRUNE,
+    REGION_REBUILD,
+    REGION_REBUILD_PBC,
+    REGION_REBUILD_SORT,
+    REGION_REBUILD_CLUSTERS,
+    REGION_REBUILD_GHOSTS,
+    REGION_REBUILD_BINNING,
+    REGION_REBUILD_NEIGHBOR,
+    REGION_FORCE,
+    REGION_FORCE_THREAD,
+    REGION_THERMO,
+    REGION_OUTPUT,
+    NUMREGIONS
+} regiontype;
+
+extern void initRegions(void);
+extern void startRegion(regiontype region);
+extern void stopRegion(regiontype region);
+extern void printRegions(void);
+extern void reportRegions(void);
+extern double getRegionTime(regiontype region);
+extern double getRegionImbalance(regiontype region);
 
 #endif
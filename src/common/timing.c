@@ -13,6 +13,14 @@ double getTimeStamp(void)
     return (double)ts.tv_sec + (double)ts.tv_nsec * 1.e-9;
 }
 
+// CPU time of the calling thread, time the thread is descheduled does not count
+double getThreadTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1.e-9;
+}
+
 double getTimeResolution(void)
 {
     struct timespec ts;
@@ -8,6 +8,7 @@
 #define __TIMING_H_
 
 extern double getTimeStamp(void);
+extern double getThreadTime(void);
 extern double getTimeResolution(void);
 
 #endif
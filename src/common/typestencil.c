@@ -0,0 +1,147 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <report.h>
+#include <typestencil.h>
+
+void initTypeStencil(TypeStencil* ts)
+{
+    ts->ntypes       = 0;
+    ts->start        = NULL;
+    ts->entry        = NULL;
+    ts->nbins        = NULL;
+    ts->cutneighsq   = NULL;
+    ts->tested       = NULL;
+    ts->kept         = NULL;
+    ts->build_tested = NULL;
+    ts->build_kept   = NULL;
+}
+
+void setupTypeStencil(TypeStencil* ts,
+    int ntypes,
+    const MD_FLOAT* cutneighsq,
+    int nstencil,
+    const MD_FLOAT* stencil_distsq)
+{
+    int split = 0;
+    int n     = 0;
+
+    for (int tp = 1; tp < ntypes * ntypes; tp++) {
+        split |= (cutneighsq[tp] != cutneighsq[0]);
+    }
+
+    ntypes           = split ? ntypes : 1;
+    const int npairs = ntypes * ntypes;
+
+    free(ts->start);
+    free(ts->entry);
+    free(ts->nbins);
+    free(ts->cutneighsq);
+    free(ts->tested);
+    free(ts->kept);
+    free(ts->build_tested);
+    free(ts->build_kept);
+
+    ts->ntypes       = ntypes;
+    ts->start        = (int*)malloc((ntypes + 1) * sizeof(int));
+    ts->entry        = (int*)malloc(npairs * nstencil * sizeof(int));
+    ts->nbins        = (int*)malloc(npairs * sizeof(int));
+    ts->cutneighsq   = (MD_FLOAT*)malloc(npairs * sizeof(MD_FLOAT));
+    ts->tested       = (long long*)calloc(npairs, sizeof(long long));
+    ts->kept         = (long long*)calloc(npairs, sizeof(long long));
+    ts->build_tested = (long long*)calloc(npairs, sizeof(long long));
+    ts->build_kept   = (long long*)calloc(npairs, sizeof(long long));
+
+    for (int ti = 0; ti < ntypes; ti++) {
+        ts->start[ti] = n;
+        for (int tj = 0; tj < ntypes; tj++) {
+            const int tp       = ti * ntypes + tj;
+            ts->cutneighsq[tp] = cutneighsq[tp];
+            ts->nbins[tp]      = 0;
+
+            for (int k = 0; k < nstencil; k++) {
+                if (stencil_distsq[k] < cutneighsq[tp]) {
+                    ts->entry[n++] = k * ntypes + tj;
+                    ts->nbins[tp]++;
+                }
+            }
+        }
+    }
+
+    ts->start[ntypes] = n;
+}
+
+void startTypeStencilCount(TypeStencil* ts)
+{
+    memset(ts->build_tested, 0, ts->ntypes * ts->ntypes * sizeof(long long));
+    memset(ts->build_kept, 0, ts->ntypes * ts->ntypes * sizeof(long long));
+}
+
+void stopTypeStencilCount(TypeStencil* ts)
+{
+    for (int tp = 0; tp < ts->ntypes * ts->ntypes; tp++) {
+        ts->tested[tp] += ts->build_tested[tp];
+        ts->kept[tp] += ts->build_kept[tp];
+    }
+}
+
+void printTypeStencil(const TypeStencil* ts, const char* unit)
+{
+    if (ts->ntypes == 0) {
+        return;
+    }
+
+    printf("Type pairs (%s in the searched bins, summed over all builds):\n", unit);
+    printf("\t%-6s %8s %8s %14s %14s %8s\n",
+        "pair",
+        "cutneigh",
+        "bins",
+        "tested",
+        "kept",
+        "kept [%]");
+    for (int ti = 0; ti < ts->ntypes; ti++) {
+        for (int tj = 0; tj < ts->ntypes; tj++) {
+            const int tp = ti * ts->ntypes + tj;
+            char pair[24]; // two ints of up to 11 characters and the dash
+
+            snprintf(pair, sizeof(pair), "%d-%d", ti, tj);
+            printf("\t%-6s %8.4f %8d %14lld %14lld %8.2f\n",
+                pair,
+                sqrt(ts->cutneighsq[tp]),
+                ts->nbins[tp],
+                ts->tested[tp],
+                ts->kept[tp],
+                (ts->tested[tp] > 0) ? 100.0 * ts->kept[tp] / ts->tested[tp] : 0.0);
+        }
+    }
+}
+
+void reportTypeStencil(const TypeStencil* ts)
+{
+    if (ts->ntypes == 0) {
+        return;
+    }
+
+    reportSection("type_pairs");
+    for (int ti = 0; ti < ts->ntypes; ti++) {
+        for (int tj = 0; tj < ts->ntypes; tj++) {
+            const int tp = ti * ts->ntypes + tj;
+            char key[48];
+
+            snprintf(key, sizeof(key), "bins_%d_%d", ti, tj);
+            reportInt(key, ts->nbins[tp]);
+            snprintf(key, sizeof(key), "tested_%d_%d", ti, tj);
+            reportInt(key, ts->tested[tp]);
+            snprintf(key, sizeof(key), "kept_%d_%d", ti, tj);
+            reportInt(key, ts->kept[tp]);
+        }
+    }
+}
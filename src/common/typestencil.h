@@ -0,0 +1,41 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <parameter.h>
+
+#ifndef __TYPESTENCIL_H_
+#define __TYPESTENCIL_H_
+// Stencils per pair of atom types. The bins are split by type, and atoms of type ti
+// only search the bins of type tj within the neighbor cutoff of the pair (ti, tj),
+// so short-range types skip the outer part of the full stencil. If all type pairs
+// share one cutoff there is nothing to skip, then the bins are not split and all
+// types use the stencil of type 0. The entries for
+// type ti are entry[start[ti]] .. entry[start[ti + 1] - 1], each is k * ntypes + tj
+// for entry k of the stencil built from the largest cutoff.
+typedef struct {
+    int ntypes; // types the bins are split by, 1 with ONE_ATOM_TYPE or one cutoff
+    int* start;
+    int* entry;
+    int* nbins;           // stencil bins per type pair
+    MD_FLOAT* cutneighsq; // neighbor cutoff squared per type pair
+    long long* tested;    // candidates in the searched bins per type pair
+    long long* kept;      // neighbors found per type pair
+    long long* build_tested;
+    long long* build_kept;
+} TypeStencil;
+
+extern void initTypeStencil(TypeStencil* ts);
+extern void setupTypeStencil(TypeStencil* ts,
+    int ntypes,
+    const MD_FLOAT* cutneighsq,
+    int nstencil,
+    const MD_FLOAT* stencil_distsq);
+// A build that is repeated after resizing the lists only counts once
+extern void startTypeStencilCount(TypeStencil* ts);
+extern void stopTypeStencilCount(TypeStencil* ts);
+extern void printTypeStencil(const TypeStencil* ts, const char* unit);
+extern void reportTypeStencil(const TypeStencil* ts);
+#endif
@@ -6,6 +6,7 @@
  */
 #include <errno.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,36 @@ double myrandom(int* seed)
     return ans;
 }
 
+/* Philox4x32-10 counter-based RNG (Salmon et al., SC'11): the output only depends on
+ * the counter and the key, so random numbers can be drawn in any order and from any
+ * thread without sharing a generator state */
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+void counterRandom(uint64_t counter, uint32_t key, double* r)
+{
+    uint32_t c[4] = { (uint32_t)counter, (uint32_t)(counter >> 32), 0, 0 };
+    uint32_t k[2] = { key, 0 };
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+        uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+        uint32_t c1 = c[1];
+        c[0]        = (uint32_t)(p1 >> 32) ^ c1 ^ k[0];
+        c[1]        = (uint32_t)p1;
+        c[2]        = (uint32_t)(p0 >> 32) ^ c[3] ^ k[1];
+        c[3]        = (uint32_t)p0;
+        k[0] += PHILOX_W0;
+        k[1] += PHILOX_W1;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        r[i] = c[i] * (1.0 / 4294967296.0);
+    }
+}
+
 void random_reset(int* seed, int ibase, double* coord)
 {
     int i;
@@ -88,6 +119,66 @@ const char* ff2str(int ff)
     return "invalid";
 }
 
+int str2sort(const char* string)
+{
+    if (strncmp(string, "none", 4) == 0) return SORT_NONE;
+    if (strncmp(string, "bins", 4) == 0) return SORT_BINS;
+    if (strncmp(string, "morton", 6) == 0) return SORT_MORTON;
+    if (strncmp(string, "hilbert", 7) == 0) return SORT_HILBERT;
+    return -1;
+}
+
+const char* sort2str(int sort)
+{
+    if (sort == SORT_NONE) {
+        return "none";
+    }
+    if (sort == SORT_BINS) {
+        return "bins";
+    }
+    if (sort == SORT_MORTON) {
+        return "morton";
+    }
+    if (sort == SORT_HILBERT) {
+        return "hilbert";
+    }
+    return "invalid";
+}
+
+int interleaveBits(unsigned int x, unsigned int y, unsigned int z, int bits)
+{
+    int key = 0;
+
+    for (int b = bits - 1; b >= 0; b--) {
+        key = (key << 3) | (((x >> b) & 1) << 2) | (((y >> b) & 1) << 1) |
+              ((z >> b) & 1);
+    }
+
+    return key;
+}
+
+int str2shape(const char* string)
+{
+    if (strncmp(string, "z", 1) == 0) return SHAPE_Z;
+    if (strncmp(string, "subcolumn", 9) == 0) return SHAPE_SUBCOLUMN;
+    if (strncmp(string, "morton", 6) == 0) return SHAPE_MORTON;
+    return -1;
+}
+
+const char* shape2str(int shape)
+{
+    if (shape == SHAPE_Z) {
+        return "z";
+    }
+    if (shape == SHAPE_SUBCOLUMN) {
+        return "subcolumn";
+    }
+    if (shape == SHAPE_MORTON) {
+        return "morton";
+    }
+    return "invalid";
+}
+
 int get_cuda_num_threads(void)
 {
     const char* num_threads_env = getenv("NUM_THREADS");
@@ -96,8 +187,9 @@ int get_cuda_num_threads(void)
 
 void readline(char* line, FILE* fp)
 {
+    // errno may be left over from earlier calls, only a read error sets ferror
     if (fgets(line, MAXLINE, fp) == NULL) {
-        if (errno != 0) {
+        if (ferror(fp)) {
             perror("readline()");
             exit(-1);
         }
@@ -7,6 +7,7 @@
 #ifndef __UTIL_H_
 #define __UTIL_H_
 
+#include <stdint.h>
 #include <stdio.h>
 #ifndef MIN
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
@@ -33,9 +34,17 @@
 #endif
 
 extern double myrandom(int*);
+extern void counterRandom(uint64_t counter, uint32_t key, double* r);
 extern void random_reset(int* seed, int ibase, double* coord);
 extern int str2ff(const char* string);
 extern const char* ff2str(int ff);
+extern int str2sort(const char* string);
+extern const char* sort2str(int sort);
+// Interleave the bits of the cell coordinates, x is the most significant bit of
+// every triple
+extern int interleaveBits(unsigned int x, unsigned int y, unsigned int z, int bits);
+extern int str2shape(const char* string);
+extern const char* shape2str(int shape);
 extern void readline(char* line, FILE* fp);
 extern void debug_printf(const char* format, ...);
 extern int get_cuda_num_threads(void);
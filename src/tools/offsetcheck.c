@@ -0,0 +1,386 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+/*
+ * Check of the neighbor list offsets past 2^31 slots for the OPT_SCHEME and
+ * INDEX_TYPE it is built with, without a run that needs that much memory. The
+ * lists of nlists clusters/atoms with maxneighs slots each are mapped without
+ * reserving memory, NEIGHBOR_OFFSET is compared with the exact 64-bit offset and
+ * the first and last slot of every stride-th list are written through it and read
+ * back. Only the touched pages are backed, a few MB with the defaults.
+ *
+ * The macros are then checked against the arrays the setup path really builds:
+ * an nx^3 lattice is created and for the cluster pair scheme every coordinate
+ * buildClusters wrote is read back through the i- and j-cluster index macros,
+ * which must address each written slot exactly once, stay inside the cl_x
+ * allocation and return the created atoms. For the verlet list scheme the list
+ * of every atom read through NEIGHBOR_OFFSET must match a brute-force search.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <atom.h>
+#include <neighbor.h>
+#include <parameter.h>
+#include <pbc.h>
+// Only the cluster pair atom.h defines the cluster index macros
+#ifdef CI_VECTOR_BASE_INDEX
+#include <force.h>
+#endif
+
+static int isSampled(int i, int nlists, int stride)
+{
+    return (i % stride == 0) || (i == nlists - 1);
+}
+
+static void initLattice(Parameter* param, int nx)
+{
+    initParameter(param);
+    param->nx      = nx;
+    param->ny      = nx;
+    param->nz      = nx;
+    param->lattice = pow((4.0 / param->rho), (1.0 / 3.0));
+    param->xprd    = param->nx * param->lattice;
+    param->yprd    = param->ny * param->lattice;
+    param->zprd    = param->nz * param->lattice;
+}
+
+#ifdef CLUSTER_M
+static int comparePositions(const void* a, const void* b)
+{
+    const MD_FLOAT* pa = (const MD_FLOAT*)a;
+    const MD_FLOAT* pb = (const MD_FLOAT*)b;
+
+    for (int d = 0; d < 3; d++) {
+        if (pa[d] != pb[d]) {
+            return (pa[d] < pb[d]) ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+// Padding slots hold INFINITY, compared bitwise since fast-math builds may fold isinf
+static int isPadding(MD_FLOAT value)
+{
+    MD_FLOAT inf = INFINITY;
+    return memcmp(&value, &inf, sizeof(MD_FLOAT)) == 0;
+}
+
+static int checkLayout(int nx)
+{
+    const int offsets[3] = { CL_X_OFFSET, CL_Y_OFFSET, CL_Z_OFFSET };
+    Parameter param;
+    Atom atomdata, *atom = &atomdata;
+    Neighbor neighbor;
+    MD_FLOAT *created, *found;
+    char* owner;
+    int64_t nelems;
+    int natoms, nfound = 0, errors = 0;
+
+    initLattice(&param, nx);
+    initAtom(atom);
+    initForce(&param);
+    initPbc(atom);
+    initNeighbor(&neighbor, &param);
+    createAtom(atom, &param);
+    setupNeighbor(&param, atom);
+
+    natoms  = atom->Nlocal;
+    created = (MD_FLOAT*)malloc(natoms * 3 * sizeof(MD_FLOAT));
+    found   = (MD_FLOAT*)malloc(natoms * 3 * sizeof(MD_FLOAT));
+    for (int i = 0; i < natoms; i++) {
+        created[i * 3 + 0] = atom_x(i);
+        created[i * 3 + 1] = atom_y(i);
+        created[i * 3 + 2] = atom_z(i);
+    }
+
+    loadSingleAtoms(atom);
+    buildClusters(atom);
+    defineJClusters(atom);
+
+    // 0: not written, 1: written by an i-cluster, 2: also reached by a j-cluster
+    nelems = (int64_t)atom->Nclusters_max * CLUSTER_M * 3;
+    owner  = (char*)calloc(nelems, sizeof(char));
+
+    for (int ci = 0; ci < atom->Nclusters_local; ci++) {
+        int ci_vec_base = CI_VECTOR_BASE_INDEX(ci);
+        MD_FLOAT* ci_x  = &atom->cl_x[ci_vec_base];
+
+        if ((int64_t)ci_vec_base != CI_VECTOR_BASE_INDEX((int64_t)ci)) {
+            if (errors++ == 0) {
+                fprintf(stderr, "Base index of i-cluster %d overflows\n", ci);
+            }
+        }
+
+        for (int cii = 0; cii < atom->iclusters[ci].natoms; cii++) {
+            for (int d = 0; d < 3; d++) {
+                int64_t e = &ci_x[offsets[d] + cii] - atom->cl_x;
+                if (e < 0 || e >= nelems || owner[e]) {
+                    if (errors++ == 0) {
+                        fprintf(stderr,
+                            "Atom %d of i-cluster %d addresses element %lld %s\n",
+                            cii,
+                            ci,
+                            (long long)e,
+                            (e < 0 || e >= nelems) ? "outside of cl_x" : "twice");
+                    }
+                    continue;
+                }
+
+                owner[e] = 1;
+                if (nfound < natoms) {
+                    found[nfound * 3 + d] = ci_x[offsets[d] + cii];
+                }
+            }
+
+            nfound++;
+        }
+    }
+
+    if (nfound != natoms) {
+        fprintf(stderr, "Clusters hold %d atoms instead of %d\n", nfound, natoms);
+        errors++;
+    } else {
+        qsort(created, natoms, 3 * sizeof(MD_FLOAT), comparePositions);
+        qsort(found, natoms, 3 * sizeof(MD_FLOAT), comparePositions);
+        if (memcmp(created, found, natoms * 3 * sizeof(MD_FLOAT)) != 0) {
+            fprintf(stderr, "Clusters do not hold the positions of the created atoms\n");
+            errors++;
+        }
+    }
+
+    for (int cj = 0; cj < get_ncj_from_nci(atom->Nclusters_local); cj++) {
+        MD_FLOAT* cj_x = &atom->cl_x[CJ_VECTOR_BASE_INDEX(cj)];
+
+        for (int cjj = 0; cjj < CLUSTER_N; cjj++) {
+            for (int d = 0; d < 3; d++) {
+                int64_t e = &cj_x[offsets[d] + cjj] - atom->cl_x;
+                if (e < 0 || e >= nelems || owner[e] == 2 ||
+                    (owner[e] == 0 && !isPadding(cj_x[offsets[d] + cjj]))) {
+                    if (errors++ == 0) {
+                        fprintf(stderr,
+                            "Atom %d of j-cluster %d addresses element %lld, "
+                            "which is not an atom or padding of the i-clusters\n",
+                            cjj,
+                            cj,
+                            (long long)e);
+                    }
+                    continue;
+                }
+
+                if (owner[e] == 1) {
+                    owner[e] = 2;
+                }
+            }
+        }
+    }
+
+    for (int64_t e = 0; e < nelems; e++) {
+        if (owner[e] == 1) {
+            if (errors++ == 0) {
+                fprintf(stderr, "Element %lld is not reached by any j-cluster\n", (long long)e);
+            }
+        }
+    }
+
+    printf("%d atoms in %d i-clusters (M = %d) and %d j-clusters (N = %d): %s\n",
+        natoms,
+        atom->Nclusters_local,
+        CLUSTER_M,
+        get_ncj_from_nci(atom->Nclusters_local),
+        CLUSTER_N,
+        (errors > 0) ? "FAILED" : "OK");
+
+    free(owner);
+    free(found);
+    free(created);
+    return errors;
+}
+#else
+static int checkLayout(int nx)
+{
+    Parameter param;
+    Atom atomdata, *atom = &atomdata;
+    Neighbor neighbor;
+    int *seen, nall, npairs = 0, errors = 0;
+
+    initLattice(&param, nx);
+    param.half_neigh = 0;
+    initAtom(atom);
+    initPbc(atom);
+    initNeighbor(&neighbor, &param);
+    createAtom(atom, &param);
+    setupNeighbor(&param);
+    setupPbc(atom, &param);
+    updatePbc(atom, &param, true);
+    buildNeighbor(atom, &neighbor);
+
+    nall = atom->Nlocal + atom->Nghost;
+    seen = (int*)malloc(nall * sizeof(int));
+    for (int j = 0; j < nall; j++) {
+        seen[j] = -1;
+    }
+
+    for (int i = 0; i < atom->Nlocal; i++) {
+        int* neighs = &neighbor.neighbors[NEIGHBOR_OFFSET(&neighbor, i)];
+
+        for (int k = 0; k < neighbor.numneigh[i]; k++) {
+            int j = neighs[k];
+            if (j < 0 || j >= nall || j == i || seen[j] == i) {
+                if (errors++ == 0) {
+                    fprintf(stderr, "Atom %d lists invalid or repeated neighbor %d\n", i, j);
+                }
+                continue;
+            }
+
+            seen[j] = i;
+            npairs++;
+        }
+
+        // Pairs within a relative 1e-5 of the cutoff may go either way
+        for (int j = 0; j < nall; j++) {
+            MD_FLOAT delx = atom_x(i) - atom_x(j);
+            MD_FLOAT dely = atom_y(i) - atom_y(j);
+            MD_FLOAT delz = atom_z(i) - atom_z(j);
+            MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
+#ifdef ONE_ATOM_TYPE
+            MD_FLOAT cutneighsq = param.cutneigh * param.cutneigh;
+#else
+            MD_FLOAT cutneighsq =
+                atom->cutneighsq[atom->type[i] * atom->ntypes + atom->type[j]];
+#endif
+            int inside  = (j != i) && (rsq < cutneighsq * (1.0 - 1e-5));
+            int outside = (j == i) || (rsq > cutneighsq * (1.0 + 1e-5));
+
+            if ((inside && seen[j] != i) || (outside && seen[j] == i)) {
+                if (errors++ == 0) {
+                    fprintf(stderr,
+                        "Atom %d %s neighbor %d at distance^2 %f (cutoff^2 %f)\n",
+                        i,
+                        inside ? "misses" : "wrongly lists",
+                        j,
+                        rsq,
+                        cutneighsq);
+                }
+            }
+        }
+    }
+
+    printf("%d atoms with %d ghosts, %d list entries match a brute-force search: %s\n",
+        atom->Nlocal,
+        atom->Nghost,
+        npairs,
+        (errors > 0) ? "FAILED" : "OK");
+
+    free(seen);
+    return errors;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    int nlists    = (argc > 1) ? atoi(argv[1]) : 65536;
+    int maxneighs = (argc > 2) ? atoi(argv[2]) : 40000;
+    int stride    = (argc > 3) ? atoi(argv[3]) : 64;
+    int nx        = (argc > 4) ? atoi(argv[4]) : 8;
+    uint64_t nslots, last = 0;
+    size_t bytesize;
+    int nchecked = 0, errors = 0;
+    Neighbor neighbor;
+    int* neighbors;
+
+    if (nlists < 1 || maxneighs < 1 || stride < 1 || nx < 1) {
+        fprintf(stderr, "Usage: %s [nlists [maxneighs [stride [nx]]]]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&neighbor, 0, sizeof(Neighbor));
+    neighbor.maxneighs = maxneighs;
+    nslots             = (uint64_t)nlists * maxneighs;
+    bytesize           = nslots * sizeof(int);
+    printf("%d lists of %d slots: %llu slots (%.2f GB), MD_INDEX has %d bits\n",
+        nlists,
+        maxneighs,
+        (unsigned long long)nslots,
+        bytesize / 1e9,
+        (int)(sizeof(MD_INDEX) * 8));
+
+    // The offset arithmetic alone, a wrapped offset would address memory before
+    // the lists in the second pass
+    for (int i = 0; i < nlists; i++) {
+        uint64_t exact = (uint64_t)i * maxneighs;
+        int64_t offset = (int64_t)NEIGHBOR_OFFSET(&neighbor, i);
+
+        if (offset < 0 || (uint64_t)offset != exact) {
+            if (errors++ == 0) {
+                fprintf(stderr,
+                    "Offset of list %d is %lld instead of %llu\n",
+                    i,
+                    (long long)offset,
+                    (unsigned long long)exact);
+            }
+        }
+    }
+
+    if (errors > 0) {
+        fprintf(stderr,
+            "FAILED: %d wrong offsets, build with INDEX_TYPE=INT64\n",
+            errors);
+        exit(EXIT_FAILURE);
+    }
+
+    neighbors = (int*)mmap(NULL,
+        bytesize,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+    if (neighbors == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < nlists; i++) {
+        if (isSampled(i, nlists, stride)) {
+            int* neighs           = &neighbors[NEIGHBOR_OFFSET(&neighbor, i)];
+            neighs[0]             = i;
+            neighs[maxneighs - 1] = -i - 1;
+        }
+    }
+
+    for (int i = 0; i < nlists; i++) {
+        if (isSampled(i, nlists, stride)) {
+            int* neighs = &neighbors[NEIGHBOR_OFFSET(&neighbor, i)];
+            if (neighs[0] != i || neighs[maxneighs - 1] != -i - 1) {
+                if (errors++ == 0) {
+                    fprintf(stderr,
+                        "List %d reads %d and %d\n",
+                        i,
+                        neighs[0],
+                        neighs[maxneighs - 1]);
+                }
+            }
+
+            last = (uint64_t)NEIGHBOR_OFFSET(&neighbor, i) + maxneighs - 1;
+            nchecked++;
+        }
+    }
+
+    munmap(neighbors, bytesize);
+    printf("%d lists checked up to slot %llu (2^31 = %llu): %s\n",
+        nchecked,
+        (unsigned long long)last,
+        1ULL << 31,
+        (errors > 0) ? "FAILED" : "OK");
+
+    errors += checkLayout(nx);
+    return (errors > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
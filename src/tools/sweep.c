@@ -0,0 +1,599 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+/*
+ * Benchmark sweep driver: runs an MD-Bench binary over the parameter matrix of a
+ * sweep file, every run in its own pinned subprocess, and collects the results
+ * from the CSV run report (--report-csv) into strong/weak scaling tables.
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define HLINE "------------------------------------------------------------------\n"
+
+#define MAXLINE      4096
+#define MAX_VALUES   32
+#define MAX_CASES    16
+#define MAX_ARGS     64
+#define MAX_REPEAT   100
+#define MAX_BASELINE 4096
+#define KEY_LENGTH   256
+
+typedef struct {
+    char name[64];
+    char* args[MAX_ARGS];
+    int nargs;
+} Case;
+
+typedef struct {
+    char* binary;
+    char* output;
+    char* baseline;
+    char* pin;
+    int weak;
+    int repeat;
+    int nsteps;
+    double tolerance;
+    char* threads[MAX_VALUES];
+    char* size[MAX_VALUES];
+    char* reneigh[MAX_VALUES];
+    char* skin[MAX_VALUES];
+    char* half[MAX_VALUES];
+    int nthreads, nsize, nreneigh, nskin, nhalf;
+    Case cases[MAX_CASES];
+    int ncases;
+} Sweep;
+
+typedef struct {
+    double time, maups, per_day; // per_day in simulated ns, or tau for reduced units
+    long natoms;
+} RunResult;
+
+typedef struct {
+    char key[KEY_LENGTH];
+    double time;
+} BaselineEntry;
+
+static BaselineEntry baseline[MAX_BASELINE];
+static int nbaseline = 0;
+
+static int splitTokens(char* line, char** tokens, int max)
+{
+    int n     = 0;
+    char* tok = strtok(line, " \t\n");
+
+    while (tok != NULL && n < max) {
+        tokens[n++] = strdup(tok);
+        tok         = strtok(NULL, " \t\n");
+    }
+
+    return n;
+}
+
+// Cases that read their atoms from a file ignore -nx, their size is fixed
+static int readsInput(const Case* c)
+{
+    for (int a = 0; a < c->nargs; a++) {
+        if (strcmp(c->args[a], "-i") == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void readSweep(Sweep* sweep, const char* filename)
+{
+    FILE* fp = fopen(filename, "r");
+    char line[MAXLINE];
+    char* tokens[MAX_ARGS + 2];
+
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open sweep file: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    while (fgets(line, MAXLINE, fp) != NULL) {
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        int n = splitTokens(line, tokens, MAX_ARGS + 2);
+        if (n < 2) {
+            continue;
+        }
+
+#define PARSE_LIST(p)                                                                    \
+    if (strcmp(tokens[0], #p) == 0) {                                                    \
+        sweep->n##p = 0;                                                                 \
+        for (int v = 1; v < n && v <= MAX_VALUES; v++) {                                 \
+            sweep->p[sweep->n##p++] = tokens[v];                                         \
+        }                                                                                \
+        continue;                                                                        \
+    }
+        PARSE_LIST(threads);
+        PARSE_LIST(size);
+        PARSE_LIST(reneigh);
+        PARSE_LIST(skin);
+        PARSE_LIST(half);
+
+        if (strcmp(tokens[0], "case") == 0 && sweep->ncases < MAX_CASES) {
+            Case* c = &sweep->cases[sweep->ncases++];
+            snprintf(c->name, sizeof(c->name), "%s", tokens[1]);
+            c->nargs = 0;
+            for (int v = 2; v < n; v++) {
+                c->args[c->nargs++] = tokens[v];
+            }
+        } else if (strcmp(tokens[0], "binary") == 0) {
+            sweep->binary = tokens[1];
+        } else if (strcmp(tokens[0], "output") == 0) {
+            sweep->output = tokens[1];
+        } else if (strcmp(tokens[0], "baseline") == 0) {
+            sweep->baseline = tokens[1];
+        } else if (strcmp(tokens[0], "pin") == 0) {
+            sweep->pin = tokens[1];
+        } else if (strcmp(tokens[0], "mode") == 0) {
+            sweep->weak = strcmp(tokens[1], "weak") == 0;
+        } else if (strcmp(tokens[0], "repeat") == 0) {
+            sweep->repeat = atoi(tokens[1]);
+        } else if (strcmp(tokens[0], "nsteps") == 0) {
+            sweep->nsteps = atoi(tokens[1]);
+        } else if (strcmp(tokens[0], "tolerance") == 0) {
+            sweep->tolerance = atof(tokens[1]);
+        } else {
+            fprintf(stderr, "Warning: unknown sweep option %s\n", tokens[0]);
+        }
+    }
+
+    fclose(fp);
+}
+
+/* split one CSV line in place, quoted fields may contain commas and doubled
+ * quotes */
+static int splitCsv(char* line, char** fields, int max)
+{
+    int n   = 0;
+    char* p = line;
+
+    while (*p != '\0' && *p != '\n' && n < max) {
+        if (*p == '"') {
+            char* q     = ++p;
+            fields[n++] = p;
+            while (*p != '\0' && !(*p == '"' && p[1] != '"')) {
+                p += (*p == '"') ? 2 : 1;
+                *q++ = p[-1];
+            }
+            if (*p == '"') {
+                p++;
+            }
+            *q = '\0';
+        } else {
+            fields[n++] = p;
+            while (*p != '\0' && *p != ',' && *p != '\n') {
+                p++;
+            }
+        }
+
+        if (*p == ',') {
+            *p++ = '\0';
+        } else if (*p == '\n') {
+            *p = '\0';
+        }
+    }
+
+    return n;
+}
+
+/* pick the columns of interest from the two-line report of a single run */
+static int readRunReport(const char* filename, RunResult* result)
+{
+    static char header[MAXLINE * 4], values[MAXLINE * 4];
+    char* names[512];
+    char* fields[512];
+    FILE* fp = fopen(filename, "r");
+    int found = 0;
+
+    if (fp == NULL) {
+        return -1;
+    }
+
+    if (fgets(header, sizeof(header), fp) == NULL ||
+        fgets(values, sizeof(values), fp) == NULL) {
+        fclose(fp);
+        return -1;
+    }
+
+    fclose(fp);
+    int nnames  = splitCsv(header, names, 512);
+    int nfields = splitCsv(values, fields, 512);
+
+    for (int i = 0; i < nnames && i < nfields; i++) {
+        if (strcmp(names[i], "timers.total") == 0) {
+            result->time = atof(fields[i]);
+            found++;
+        } else if (strcmp(names[i], "performance.maups") == 0) {
+            result->maups = atof(fields[i]);
+        } else if (strcmp(names[i], "performance.ns_per_day") == 0 ||
+                   strcmp(names[i], "performance.tau_per_day") == 0) {
+            result->per_day = atof(fields[i]);
+        } else if (strcmp(names[i], "system.natoms") == 0) {
+            result->natoms = atol(fields[i]);
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
+/* run the benchmark once in a child process with the OpenMP threads pinned,
+ * the output of the binary goes to the log file */
+static int runOnce(Sweep* sweep,
+    Case* c,
+    const char* threads,
+    int nx,
+    const char* size,
+    const char* reneigh,
+    const char* skin,
+    const char* half,
+    FILE* log,
+    RunResult* result)
+{
+    char report[] = "/tmp/mdbench-sweep-XXXXXX";
+    char nsteps[32], nxstr[32];
+    char* argv[MAX_ARGS + 32];
+    int argc = 0;
+    int fd   = mkstemp(report);
+
+    if (fd < 0) {
+        fprintf(stderr, "Could not create temporary report file\n");
+        return -1;
+    }
+
+    close(fd);
+    unlink(report);
+    snprintf(nsteps, sizeof(nsteps), "%d", sweep->nsteps);
+    snprintf(nxstr, sizeof(nxstr), "%d", nx);
+
+    // Case arguments first so that parameter files (-p) are overridden by the sweep
+    argv[argc++] = sweep->binary;
+    for (int a = 0; a < c->nargs; a++) {
+        argv[argc++] = c->args[a];
+    }
+
+    argv[argc++] = "-n";
+    argv[argc++] = nsteps;
+    if (size != NULL) {
+        argv[argc++] = "-nx";
+        argv[argc++] = nxstr;
+        argv[argc++] = "-ny";
+        argv[argc++] = (char*)size;
+        argv[argc++] = "-nz";
+        argv[argc++] = (char*)size;
+    }
+    if (reneigh != NULL) {
+        argv[argc++] = "--reneigh";
+        argv[argc++] = (char*)reneigh;
+    }
+    if (skin != NULL) {
+        argv[argc++] = "-s";
+        argv[argc++] = (char*)skin;
+    }
+    if (half != NULL) {
+        argv[argc++] = "-half";
+        argv[argc++] = (char*)half;
+    }
+    argv[argc++] = "--report-csv";
+    argv[argc++] = report;
+    argv[argc]   = NULL;
+
+    fflush(log);
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("OMP_NUM_THREADS", threads, 1);
+        if (strcmp(sweep->pin, "none") != 0) {
+            setenv("OMP_PLACES", sweep->pin, 1);
+            setenv("OMP_PROC_BIND", "close", 1);
+        }
+
+        dup2(fileno(log), STDOUT_FILENO);
+        dup2(fileno(log), STDERR_FILENO);
+        execv(sweep->binary, argv);
+        perror("execv");
+        _exit(127);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    int ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+             readRunReport(report, result) == 0;
+    unlink(report);
+    return ok ? 0 : -1;
+}
+
+static void readBaseline(const char* filename)
+{
+    FILE* fp = fopen(filename, "r");
+    char line[MAXLINE];
+    char* fields[32];
+
+    if (fp == NULL) {
+        fprintf(stderr, "Warning: could not open baseline file %s\n", filename);
+        return;
+    }
+
+    // skip the header, the key are the first 8 columns as written by the sweep
+    if (fgets(line, MAXLINE, fp) == NULL) {
+        fclose(fp);
+        return;
+    }
+
+    while (fgets(line, MAXLINE, fp) != NULL && nbaseline < MAX_BASELINE) {
+        if (splitCsv(line, fields, 32) < 11) {
+            continue;
+        }
+
+        BaselineEntry* b = &baseline[nbaseline++];
+        snprintf(b->key,
+            KEY_LENGTH,
+            "%s,%s,%s,%s,%s,%s,%s,%s",
+            fields[0],
+            fields[1],
+            fields[2],
+            fields[3],
+            fields[4],
+            fields[5],
+            fields[6],
+            fields[7]);
+        b->time = atof(fields[10]);
+    }
+
+    fclose(fp);
+}
+
+static double findBaseline(const char* key)
+{
+    for (int i = 0; i < nbaseline; i++) {
+        if (strcmp(baseline[i].key, key) == 0) {
+            return baseline[i].time;
+        }
+    }
+
+    return 0.0;
+}
+
+#define VALUE(list, n, i) ((n) > 0 ? (list)[i] : NULL)
+#define COUNT(n)          ((n) > 0 ? (n) : 1)
+#define PRINT(v)          ((v) != NULL ? (v) : "-")
+
+int main(int argc, char** argv)
+{
+    Sweep sweep;
+    int regressions = 0;
+
+    if (argc < 2 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+        printf("MD Bench sweep driver\n");
+        printf("Usage: %s <sweep file>\n", argv[0]);
+        printf("See data/sweep/scaling.sweep for the sweep file format\n");
+        return (argc < 2) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    memset(&sweep, 0, sizeof(Sweep));
+    sweep.output    = "sweep.csv";
+    sweep.pin       = "cores";
+    sweep.repeat    = 3;
+    sweep.nsteps    = 200;
+    sweep.tolerance = 0.05;
+    readSweep(&sweep, argv[1]);
+
+    if (sweep.binary == NULL) {
+        fprintf(stderr, "Sweep file does not name a binary\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (sweep.ncases == 0) {
+        sweep.ncases = 1;
+        snprintf(sweep.cases[0].name, sizeof(sweep.cases[0].name), "lattice");
+    }
+
+    if (sweep.nthreads == 0) {
+        sweep.threads[sweep.nthreads++] = "1";
+    }
+
+    sweep.repeat = (sweep.repeat < 1) ? 1 : (sweep.repeat > MAX_REPEAT ? MAX_REPEAT : sweep.repeat);
+    if (sweep.baseline != NULL) {
+        readBaseline(sweep.baseline);
+    }
+
+    FILE* out = fopen(sweep.output, "w");
+    FILE* log = fopen("sweep.log", "w");
+    if (out == NULL || log == NULL) {
+        fprintf(stderr, "Could not open output files %s and sweep.log\n", sweep.output);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(out,
+        "case,mode,size,reneigh,skin,half,threads,nsteps,natoms,repeat,time_mean,"
+        "time_stddev,time_min,maups,time_per_day,speedup,efficiency,baseline_time,status\n");
+
+    printf("Sweep: %s, %s scaling, %d repetitions, binary %s\n",
+        argv[1],
+        sweep.weak ? "weak" : "strong",
+        sweep.repeat,
+        sweep.binary);
+    printf(HLINE);
+    printf("\t%-12s %6s %7s %6s %5s %7s %10s %10s %8s %8s %s\n",
+        "case",
+        "size",
+        "reneigh",
+        "skin",
+        "half",
+        "threads",
+        "time",
+        "stddev",
+        "speedup",
+        "effic.",
+        "status");
+
+    for (int c = 0; c < sweep.ncases; c++) {
+        if (sweep.weak && readsInput(&sweep.cases[c])) {
+            fprintf(stderr,
+                "Warning: case %s reads an input file and cannot grow for weak "
+                "scaling, skipped\n",
+                sweep.cases[c].name);
+            continue;
+        }
+
+        for (int s = 0; s < COUNT(sweep.nsize); s++) {
+            for (int r = 0; r < COUNT(sweep.nreneigh); r++) {
+                for (int k = 0; k < COUNT(sweep.nskin); k++) {
+                    for (int h = 0; h < COUNT(sweep.nhalf); h++) {
+                        double refTime = 0.0;
+                        int refThreads = 0;
+
+                        for (int t = 0; t < sweep.nthreads; t++) {
+                            const char* size    = VALUE(sweep.size, sweep.nsize, s);
+                            const char* reneigh = VALUE(sweep.reneigh, sweep.nreneigh, r);
+                            const char* skin    = VALUE(sweep.skin, sweep.nskin, k);
+                            const char* half    = VALUE(sweep.half, sweep.nhalf, h);
+                            int threads         = atoi(sweep.threads[t]);
+                            // weak scaling keeps the atoms per thread by growing x
+                            int nx = (size != NULL) ? atoi(size) * (sweep.weak ? threads : 1)
+                                                    : 0;
+                            double times[MAX_REPEAT];
+                            RunResult result;
+                            int nruns = 0;
+
+                            memset(&result, 0, sizeof(RunResult));
+                            for (int rep = 0; rep < sweep.repeat; rep++) {
+                                if (runOnce(&sweep,
+                                        &sweep.cases[c],
+                                        sweep.threads[t],
+                                        nx,
+                                        size,
+                                        reneigh,
+                                        skin,
+                                        half,
+                                        log,
+                                        &result) == 0) {
+                                    times[nruns++] = result.time;
+                                }
+                            }
+
+                            if (nruns == 0) {
+                                fprintf(stderr,
+                                    "Run failed for case %s with %d threads, see "
+                                    "sweep.log\n",
+                                    sweep.cases[c].name,
+                                    threads);
+                                continue;
+                            }
+
+                            double mean = 0.0, var = 0.0, tmin = times[0];
+                            for (int i = 0; i < nruns; i++) {
+                                mean += times[i] / nruns;
+                                tmin = (times[i] < tmin) ? times[i] : tmin;
+                            }
+                            for (int i = 0; i < nruns; i++) {
+                                var += (times[i] - mean) * (times[i] - mean);
+                            }
+                            double stddev = (nruns > 1) ? sqrt(var / (nruns - 1)) : 0.0;
+
+                            // the first thread count of a series is the reference
+                            if (refThreads == 0) {
+                                refTime    = mean;
+                                refThreads = threads;
+                            }
+
+                            double speedup, efficiency;
+                            if (sweep.weak) {
+                                efficiency = refTime / mean;
+                                speedup    = efficiency * threads / refThreads;
+                            } else {
+                                speedup    = refTime / mean;
+                                efficiency = speedup * refThreads / threads;
+                            }
+
+                            char key[KEY_LENGTH];
+                            snprintf(key,
+                                KEY_LENGTH,
+                                "%s,%s,%s,%s,%s,%s,%d,%d",
+                                sweep.cases[c].name,
+                                sweep.weak ? "weak" : "strong",
+                                PRINT(size),
+                                PRINT(reneigh),
+                                PRINT(skin),
+                                PRINT(half),
+                                threads,
+                                sweep.nsteps);
+
+                            double base        = findBaseline(key);
+                            const char* status = "new";
+                            if (base > 0.0) {
+                                if (mean > base * (1.0 + sweep.tolerance)) {
+                                    status = "REGRESSION";
+                                    regressions++;
+                                } else if (mean < base * (1.0 - sweep.tolerance)) {
+                                    status = "improved";
+                                } else {
+                                    status = "ok";
+                                }
+                            }
+
+                            fprintf(out,
+                                "%s,%ld,%d,%.6f,%.6f,%.6f,%.4f,%.4f,%.4f,%.4f,%.6f,%s\n",
+                                key,
+                                result.natoms,
+                                nruns,
+                                mean,
+                                stddev,
+                                tmin,
+                                result.maups,
+                                result.per_day,
+                                speedup,
+                                efficiency,
+                                base,
+                                status);
+                            fflush(out);
+
+                            printf("\t%-12s %6s %7s %6s %5s %7d %10.4f %10.4f %8.3f %8.3f "
+                                   "%s\n",
+                                sweep.cases[c].name,
+                                PRINT(size),
+                                PRINT(reneigh),
+                                PRINT(skin),
+                                PRINT(half),
+                                threads,
+                                mean,
+                                stddev,
+                                speedup,
+                                efficiency,
+                                status);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    fclose(out);
+    fclose(log);
+    printf(HLINE);
+    printf("Results written to %s, benchmark output to sweep.log\n", sweep.output);
+    if (regressions > 0) {
+        printf("%d regression(s) against baseline %s (tolerance %.1f%%)\n",
+            regressions,
+            sweep.baseline,
+            100.0 * sweep.tolerance);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+/*
+ * Decoder for binary memory traces (MEM_TRACER_FORMAT=BINARY): prints the
+ * accesses in the text format of the tracer ("R: 0x..."), array definitions
+ * as "# name base bytes" lines. With -s only a per-array summary is printed.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEMTRACER_MAGIC   "MDBTRACE"
+#define MEMTRACER_VERSION 1
+#define MAX_ARRAYS        64
+
+typedef struct {
+    char name[256];
+    uint64_t begin;
+    uint64_t end;
+    uint64_t reads;
+    uint64_t writes;
+} Array;
+
+static int readVarint(FILE* fp, uint64_t* v)
+{
+    int c, shift = 0;
+
+    *v = 0;
+    while ((c = getc(fp)) != EOF) {
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return 1;
+        }
+
+        shift += 7;
+    }
+
+    if (shift > 0) {
+        fprintf(stderr, "Error: Trace is truncated!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Array arrays[MAX_ARRAYS + 1];
+    int narrays = 0, summary = 0;
+    uint64_t addr = 0, v, naccesses = 0;
+    const char* filename = NULL;
+    char magic[8];
+    uint32_t version;
+    FILE* fp;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            summary = 1;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (filename == NULL) {
+        printf("Usage: %s [-s] <mem_tracer_N.bin>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        fprintf(stderr, "Could not open trace file %s!\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, MEMTRACER_MAGIC, 8) != 0 ||
+        fread(&version, sizeof(uint32_t), 1, fp) != 1 || version != MEMTRACER_VERSION) {
+        fprintf(stderr, "Error: %s is not a binary memory trace!\n", filename);
+        return EXIT_FAILURE;
+    }
+
+    memset(arrays, 0, sizeof(arrays));
+    strcpy(arrays[MAX_ARRAYS].name, "other");
+    while (readVarint(fp, &v)) {
+        if ((v & 3) == 2) {
+            Array* a = &arrays[(narrays < MAX_ARRAYS) ? narrays++ : MAX_ARRAYS - 1];
+            int len  = getc(fp);
+            uint64_t bytes;
+
+            if (len == EOF || fread(a->name, 1, len, fp) != (size_t)len ||
+                !readVarint(fp, &a->begin) || !readVarint(fp, &bytes)) {
+                fprintf(stderr, "Error: Trace is truncated!\n");
+                return EXIT_FAILURE;
+            }
+
+            a->name[len] = '\0';
+            a->end       = a->begin + bytes;
+            a->reads     = 0;
+            a->writes    = 0;
+            if (!summary) {
+                printf("# %s 0x%llx %llu\n",
+                    a->name,
+                    (unsigned long long)a->begin,
+                    (unsigned long long)bytes);
+            }
+
+            continue;
+        }
+
+        uint64_t zz = v >> 2;
+        addr += (uint64_t)((int64_t)(zz >> 1) ^ -(int64_t)(zz & 1));
+        naccesses++;
+        if (summary) {
+            Array* a = &arrays[MAX_ARRAYS];
+            for (int i = 0; i < narrays; i++) {
+                if (addr >= arrays[i].begin && addr < arrays[i].end) {
+                    a = &arrays[i];
+                    break;
+                }
+            }
+
+            if (v & 1) {
+                a->writes++;
+            } else {
+                a->reads++;
+            }
+        } else {
+            printf("%c: 0x%llx\n", (v & 1) ? 'W' : 'R', (unsigned long long)addr);
+        }
+    }
+
+    fclose(fp);
+    if (summary) {
+        printf("%-16s %14s %14s\n", "Array", "Reads", "Writes");
+        for (int i = 0; i <= MAX_ARRAYS; i++) {
+            if (i < narrays || (i == MAX_ARRAYS && arrays[i].reads + arrays[i].writes)) {
+                printf("%-16s %14llu %14llu\n",
+                    arrays[i].name,
+                    (unsigned long long)arrays[i].reads,
+                    (unsigned long long)arrays[i].writes);
+            }
+        }
+
+        printf("Total accesses: %llu\n", (unsigned long long)naccesses);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -64,6 +64,68 @@ void initAtom(Atom* atom)
     d_atom->cutneighsq = NULL;
 }
 
+#define SUBBOX_DIM   8
+#define LATTICE_SEED 5287
+
+typedef struct {
+    MD_FLOAT alat, xhi, yhi, zhi;
+    int ilo, ihi, jlo, jhi, klo, khi;
+    int nx, ny;
+} Lattice;
+
+/* visit the lattice sites of one subbox in the order of the former serial loop
+ * and return the number of atoms in it, the atoms are only stored when dest is
+ * not negative; velocities and types are drawn from a counter-based RNG keyed
+ * by the lattice index, so they do not depend on the number of threads */
+static int createSubbox(Atom* atom, Lattice* lat, int ox, int oy, int oz, int dest)
+{
+    int count = 0;
+
+    for (int sz = 0; sz < SUBBOX_DIM; sz++) {
+        for (int sy = 0; sy < SUBBOX_DIM; sy++) {
+            for (int sx = 0; sx < SUBBOX_DIM; sx++) {
+                int k = oz * SUBBOX_DIM + sz;
+                int j = oy * SUBBOX_DIM + sy;
+                int i = ox * SUBBOX_DIM + sx;
+
+                if (((i + j + k) % 2 != 0) || (i < lat->ilo) || (i > lat->ihi) ||
+                    (j < lat->jlo) || (j > lat->jhi) || (k < lat->klo) ||
+                    (k > lat->khi)) {
+                    continue;
+                }
+
+                MD_FLOAT xtmp = 0.5 * lat->alat * i;
+                MD_FLOAT ytmp = 0.5 * lat->alat * j;
+                MD_FLOAT ztmp = 0.5 * lat->alat * k;
+
+                if (xtmp < 0.0 || xtmp >= lat->xhi || ytmp < 0.0 || ytmp >= lat->yhi ||
+                    ztmp < 0.0 || ztmp >= lat->zhi) {
+                    continue;
+                }
+
+                if (dest >= 0) {
+                    uint64_t n = ((uint64_t)k * (2 * lat->ny) + j) * (2 * lat->nx) + i;
+                    int idx    = dest + count;
+                    double r[4];
+
+                    counterRandom(n, LATTICE_SEED, r);
+                    atom_x(idx)     = xtmp;
+                    atom_y(idx)     = ytmp;
+                    atom_z(idx)     = ztmp;
+                    atom_vx(idx)    = r[0];
+                    atom_vy(idx)    = r[1];
+                    atom_vz(idx)    = r[2];
+                    atom->type[idx] = MIN((int)(r[3] * atom->ntypes), atom->ntypes - 1);
+                }
+
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
 void createAtom(Atom* atom, Parameter* param)
 {
     MD_FLOAT xlo  = 0.0;
@@ -82,12 +144,12 @@ void createAtom(Atom* atom, Parameter* param)
     atom->cutneighsq = allocate(ALIGNMENT,
         atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
     for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param->epsilon;
-        atom->sigma6[i]     = param->sigma6;
-        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
-        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+        atom->epsilon[i] = param->epsilon;
+        atom->sigma6[i]  = param->sigma6;
     }
 
+    setTypeCutoffs(param, atom->ntypes, atom->cutforcesq, atom->cutneighsq);
+
     MD_FLOAT alat = pow((4.0 / param->rho), (1.0 / 3.0));
     int ilo       = (int)(xlo / (0.5 * alat) - 1);
     int ihi       = (int)(xhi / (0.5 * alat) + 1);
@@ -103,87 +165,42 @@ void createAtom(Atom* atom, Parameter* param)
     klo = MAX(klo, 0);
     khi = MIN(khi, 2 * param->nz - 1);
 
-    MD_FLOAT xtmp, ytmp, ztmp, vxtmp, vytmp, vztmp;
-    int i, j, k, m, n;
-    int sx        = 0;
-    int sy        = 0;
-    int sz        = 0;
-    int ox        = 0;
-    int oy        = 0;
-    int oz        = 0;
-    int subboxdim = 8;
-
-    while (oz * subboxdim <= khi) {
-
-        k = oz * subboxdim + sz;
-        j = oy * subboxdim + sy;
-        i = ox * subboxdim + sx;
-
-        if (((i + j + k) % 2 == 0) && (i >= ilo) && (i <= ihi) && (j >= jlo) &&
-            (j <= jhi) && (k >= klo) && (k <= khi)) {
-
-            xtmp = 0.5 * alat * i;
-            ytmp = 0.5 * alat * j;
-            ztmp = 0.5 * alat * k;
-
-            if (xtmp >= xlo && xtmp < xhi && ytmp >= ylo && ytmp < yhi && ztmp >= zlo &&
-                ztmp < zhi) {
-
-                n = k * (2 * param->ny) * (2 * param->nx) + j * (2 * param->nx) + i + 1;
-
-                for (m = 0; m < 5; m++) {
-                    myrandom(&n);
-                }
-                vxtmp = myrandom(&n);
-
-                for (m = 0; m < 5; m++) {
-                    myrandom(&n);
-                }
-                vytmp = myrandom(&n);
-
-                for (m = 0; m < 5; m++) {
-                    myrandom(&n);
-                }
-                vztmp = myrandom(&n);
-
-                if (atom->Nlocal == atom->Nmax) {
-                    growAtom(atom);
-                }
+    Lattice lat = { alat, xhi, yhi, zhi, ilo, ihi, jlo, jhi, klo, khi, param->nx,
+        param->ny };
+
+    int nbx        = ihi / SUBBOX_DIM + 1;
+    int nby        = jhi / SUBBOX_DIM + 1;
+    int nbz        = khi / SUBBOX_DIM + 1;
+    int nboxes     = nbx * nby * nbz;
+    int* boxOffset = (int*)allocate(ALIGNMENT, (nboxes + 1) * sizeof(int));
+
+    // Count the atoms per subbox first, a prefix sum then gives every subbox its
+    // place in the arrays so the atom order matches a serial traversal
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < nboxes; b++) {
+        int ox           = b % nbx;
+        int oy           = (b / nbx) % nby;
+        int oz           = b / (nbx * nby);
+        boxOffset[b + 1] = createSubbox(atom, &lat, ox, oy, oz, -1);
+    }
 
-                atom_x(atom->Nlocal)     = xtmp;
-                atom_y(atom->Nlocal)     = ytmp;
-                atom_z(atom->Nlocal)     = ztmp;
-                atom_vx(atom->Nlocal)    = vxtmp;
-                atom_vy(atom->Nlocal)    = vytmp;
-                atom_vz(atom->Nlocal)    = vztmp;
-                atom->type[atom->Nlocal] = rand() % atom->ntypes;
-                atom->Nlocal++;
-            }
-        }
+    boxOffset[0] = 0;
+    for (int b = 0; b < nboxes; b++) {
+        boxOffset[b + 1] += boxOffset[b];
+    }
 
-        sx++;
+    reserveAtom(atom, MAX(atom->Natoms, boxOffset[nboxes]));
 
-        if (sx == subboxdim) {
-            sx = 0;
-            sy++;
-        }
-        if (sy == subboxdim) {
-            sy = 0;
-            sz++;
-        }
-        if (sz == subboxdim) {
-            sz = 0;
-            ox++;
-        }
-        if (ox * subboxdim > ihi) {
-            ox = 0;
-            oy++;
-        }
-        if (oy * subboxdim > jhi) {
-            oy = 0;
-            oz++;
-        }
+#pragma omp parallel for schedule(static)
+    for (int b = 0; b < nboxes; b++) {
+        int ox = b % nbx;
+        int oy = (b / nbx) % nby;
+        int oz = b / (nbx * nby);
+        createSubbox(atom, &lat, ox, oy, oz, boxOffset[b]);
     }
+
+    atom->Nlocal = boxOffset[nboxes];
+    deallocate(boxOffset);
 }
 
 int type_str2int(const char* type)
@@ -293,12 +310,12 @@ int readAtom_pdb(Atom* atom, Parameter* param)
     atom->cutneighsq = allocate(ALIGNMENT,
         atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
     for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param->epsilon;
-        atom->sigma6[i]     = param->sigma6;
-        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
-        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+        atom->epsilon[i] = param->epsilon;
+        atom->sigma6[i]  = param->sigma6;
     }
 
+    setTypeCutoffs(param, atom->ntypes, atom->cutforcesq, atom->cutneighsq);
+
     fprintf(stdout, "Read %d atoms from %s\n", read_atoms, param->input_file);
     fclose(fp);
     return read_atoms;
@@ -379,12 +396,12 @@ int readAtom_gro(Atom* atom, Parameter* param)
     atom->cutneighsq = allocate(ALIGNMENT,
         atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
     for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param->epsilon;
-        atom->sigma6[i]     = param->sigma6;
-        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
-        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+        atom->epsilon[i] = param->epsilon;
+        atom->sigma6[i]  = param->sigma6;
     }
 
+    setTypeCutoffs(param, atom->ntypes, atom->cutforcesq, atom->cutneighsq);
+
     fprintf(stdout, "Read %d atoms from %s\n", read_atoms, param->input_file);
     fclose(fp);
     return read_atoms;
@@ -477,12 +494,12 @@ int readAtom_dmp(Atom* atom, Parameter* param)
     atom->cutneighsq = allocate(ALIGNMENT,
         atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
     for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param->epsilon;
-        atom->sigma6[i]     = param->sigma6;
-        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
-        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+        atom->epsilon[i] = param->epsilon;
+        atom->sigma6[i]  = param->sigma6;
     }
 
+    setTypeCutoffs(param, atom->ntypes, atom->cutforcesq, atom->cutneighsq);
+
     fprintf(stdout, "Read %d atoms from %s\n", natoms, param->input_file);
     return natoms;
 }
@@ -551,12 +568,12 @@ int readAtom_in(Atom* atom, Parameter* param)
     atom->cutneighsq = allocate(ALIGNMENT,
         atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
     for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param->epsilon;
-        atom->sigma6[i]     = param->sigma6;
-        atom->cutneighsq[i] = param->cutneigh * param->cutneigh;
-        atom->cutforcesq[i] = param->cutforce * param->cutforce;
+        atom->epsilon[i] = param->epsilon;
+        atom->sigma6[i]  = param->sigma6;
     }
 
+    setTypeCutoffs(param, atom->ntypes, atom->cutforcesq, atom->cutneighsq);
+
     fprintf(stdout, "Read %d atoms from %s\n", natoms, param->input_file);
     return natoms;
 }
@@ -587,11 +604,17 @@ void writeAtom(Atom* atom, Parameter* param)
         param->zprd);
 }
 
-void growAtom(Atom* atom)
+void growAtom(Atom* atom) { reserveAtom(atom, GROW_CAPACITY(atom->Nmax, DELTA)); }
+
+void reserveAtom(Atom* atom, int nmax)
 {
     DeviceAtom* d_atom = &(atom->d_atom);
     int nold           = atom->Nmax;
-    atom->Nmax += DELTA;
+    if (nmax <= nold) {
+        return;
+    }
+
+    atom->Nmax = nmax;
 
 #undef REALLOC
 #define REALLOC(p, t, ns, os)                                                            \
@@ -47,6 +47,7 @@ extern int readAtom_dmp(Atom*, Parameter*);
 extern int readAtom_in(Atom*, Parameter*);
 extern void writeAtom(Atom*, Parameter*);
 extern void growAtom(Atom*);
+extern void reserveAtom(Atom*, int);
 
 #ifdef AOS
 #define POS_DATA_LAYOUT "AoS"
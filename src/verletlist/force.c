@@ -9,6 +9,7 @@
 #include <stdlib.h>
 
 ComputeForceFunction computeForce;
+ComputeForceFunction computeForceList;
 
 void initForce(Parameter* param)
 {
@@ -31,4 +32,9 @@ void initForce(Parameter* param)
         fprintf(stderr, "Error: Unknown force field!\n");
         exit(EXIT_FAILURE);
     }
+
+    computeForceList = computeForce;
+    if (param->force_direct) {
+        computeForce = computeForceLJDirect;
+    }
 }
@@ -15,6 +15,8 @@
 
 typedef double (*ComputeForceFunction)(Parameter*, Atom*, Neighbor*, Stats*);
 extern ComputeForceFunction computeForce;
+// The neighbor list kernel, differs from computeForce in the direct force mode
+extern ComputeForceFunction computeForceList;
 
 enum forcetype { FF_LJ = 0, FF_EAM };
 
@@ -22,6 +24,7 @@ extern void initForce(Parameter*);
 extern double computeForceLJHalfNeigh(Parameter*, Atom*, Neighbor*, Stats*);
 extern double computeForceLJFullNeigh(Parameter*, Atom*, Neighbor*, Stats*);
 extern double computeForceEam(Parameter*, Atom*, Neighbor*, Stats*);
+extern double computeForceLJDirect(Parameter*, Atom*, Neighbor*, Stats*);
 
 #ifdef CUDA_TARGET
 extern double computeForceLJCUDA(Parameter*, Atom*, Neighbor*, Stats*);
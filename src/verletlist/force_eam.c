@@ -13,6 +13,7 @@
 #include <neighbor.h>
 #include <parameter.h>
 #include <stats.h>
+#include <timers.h>
 #include <timing.h>
 #include <util.h>
 
@@ -21,7 +22,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
     if (eam.nmax < atom->Nmax) {
         eam.nmax = atom->Nmax;
         if (eam.fp != NULL) {
-            free(eam.fp);
+            deallocate(eam.fp);
         }
         eam.fp = (MD_FLOAT*)allocate(ALIGNMENT, atom->Nmax * sizeof(MD_FLOAT));
     }
@@ -44,10 +45,11 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for
+#pragma omp for nowait
         for (int i = 0; i < Nlocal; i++) {
-            neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
+            neighs        = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
             int numneighs = neighbor->numneigh[i];
             MD_FLOAT xtmp = atom_x(i);
             MD_FLOAT ytmp = atom_y(i);
@@ -111,6 +113,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
 #endif
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -122,10 +125,11 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for
+#pragma omp for nowait
         for (int i = 0; i < Nlocal; i++) {
-            neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
+            neighs        = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
             int numneighs = neighbor->numneigh[i];
             MD_FLOAT xtmp = atom_x(i);
             MD_FLOAT ytmp = atom_y(i);
@@ -223,6 +227,7 @@ double computeForceEam(Parameter* param, Atom* atom, Neighbor* neighbor, Stats*
                 (numneighs + VECTOR_WIDTH - 1) / VECTOR_WIDTH);
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -12,6 +12,7 @@
 #include <neighbor.h>
 #include <parameter.h>
 #include <stats.h>
+#include <timers.h>
 #include <timing.h>
 
 #ifdef __SIMD_KERNEL__
@@ -48,10 +49,12 @@ double computeForceLJFullNeigh_simd(
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for schedule(runtime)
+#pragma omp for schedule(runtime) nowait
         for (int i = 0; i < Nlocal; i++) {
-            neighs                    = &neighbor->neighbors[i * neighbor->maxneighs];
+            neighs                    = &(
+                neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)]);
             int numneighs             = neighbor->numneigh[i];
             MD_SIMD_INT numneighs_vec = simd_i32_broadcast(numneighs);
             MD_SIMD_FLOAT xtmp        = simd_real_broadcast(atom_x(i));
@@ -107,6 +110,7 @@ double computeForceLJFullNeigh_simd(
             atom_fz(i) += simd_real_h_reduce_sum(fiz);
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 #endif
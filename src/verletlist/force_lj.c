@@ -4,11 +4,14 @@
  * Use of this source code is governed by a LGPL-3.0
  * license that can be found in the LICENSE file.
  */
+#include <stdlib.h>
+
 #include <atom.h>
 #include <likwid-marker.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <stats.h>
+#include <timers.h>
 #include <timing.h>
 
 double computeForceLJFullNeigh(
@@ -30,15 +33,22 @@ double computeForceLJFullNeigh(
         atom_fy(i) = 0.0;
         atom_fz(i) = 0.0;
     }
+
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, nLocal);
+
     double timeStart = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for schedule(runtime)
-        for (int i = 0; i < nLocal; i++) {
-            neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int i = getPartBegin(balance, part); i < getPartEnd(balance, part); i++) {
+            neighs        = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
             int numneighs = neighbor->numneigh[i];
             MD_FLOAT xtmp = atom_x(i);
             MD_FLOAT ytmp = atom_y(i);
@@ -97,6 +107,7 @@ double computeForceLJFullNeigh(
                 (numneighs + VECTOR_WIDTH - 1) / VECTOR_WIDTH);
         }
 
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
     }
 
@@ -124,15 +135,21 @@ double computeForceLJHalfNeigh(
         atom_fz(i) = 0.0;
     }
 
+    const Balance* balance = &neighbor->balance;
+    const int nparts       = getNumParts(balance, nlocal);
+
     double timeStart = getTimeStamp();
 
 #pragma omp parallel
     {
         LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
 
-#pragma omp for schedule(runtime)
-        for (int i = 0; i < nlocal; i++) {
-            neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
+        setPartSchedule(balance);
+#pragma omp for schedule(runtime) nowait
+        for (int part = 0; part < nparts; part++)
+        for (int i = getPartBegin(balance, part); i < getPartEnd(balance, part); i++) {
+            neighs        = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
             int numneighs = neighbor->numneigh[i];
             MD_FLOAT xtmp = atom_x(i);
             MD_FLOAT ytmp = atom_y(i);
@@ -190,7 +207,114 @@ double computeForceLJHalfNeigh(
                 (numneighs + VECTOR_WIDTH - 1) / VECTOR_WIDTH);
         }
 
+        stopRegion(REGION_FORCE_THREAD);
+        LIKWID_MARKER_STOP("force");
+    }
+
+    double timeStop = getTimeStamp();
+    return timeStop - timeStart;
+}
+
+/* forces straight from the bins of the last binatoms without stored neighbor
+ * lists, the atoms are visited bin by bin so the stencil is looked up once per bin */
+double computeForceLJDirect(
+    Parameter* param, Atom* atom, Neighbor* neighbor, Stats* stats)
+{
+    const CellGrid* grid = getAtomGrid();
+    const int nentries   = getTypeStencil()->start[getTypeStencil()->ntypes];
+    int nLocal           = atom->Nlocal;
+#ifdef ONE_ATOM_TYPE
+    MD_FLOAT cutforcesq = param->cutforce * param->cutforce;
+    MD_FLOAT sigma6     = param->sigma6;
+    MD_FLOAT epsilon    = param->epsilon;
+#endif
+    const MD_FLOAT num1  = 1.0;
+    const MD_FLOAT num48 = 48.0;
+    const MD_FLOAT num05 = 0.5;
+
+    for (int i = 0; i < nLocal; i++) {
+        atom_fx(i) = 0.0;
+        atom_fy(i) = 0.0;
+        atom_fz(i) = 0.0;
+    }
+    double timeStart = getTimeStamp();
+
+#pragma omp parallel
+    {
+        int* cells = (int*)malloc(nentries * sizeof(int));
+
+        LIKWID_MARKER_START("force");
+        startRegion(REGION_FORCE_THREAD);
+
+#pragma omp for schedule(runtime) nowait
+        for (int c = 0; c < grid->ncells; c++) {
+            const int nent = getStencilCells(c, cells);
+
+            for (int ic = grid->start[c]; ic < grid->start[c + 1]; ic++) {
+                int i = grid->items[ic];
+                if (i >= nLocal) {
+                    continue;
+                }
+
+                MD_FLOAT xtmp = atom_x(i);
+                MD_FLOAT ytmp = atom_y(i);
+                MD_FLOAT ztmp = atom_z(i);
+                MD_FLOAT fix  = 0;
+                MD_FLOAT fiy  = 0;
+                MD_FLOAT fiz  = 0;
+                int ntested   = 0;
+
+#ifndef ONE_ATOM_TYPE
+                const int type_i = atom->type[i];
+#endif
+
+                for (int e = 0; e < nent; e++) {
+                    const int jcell = cells[e];
+                    if (jcell < 0) {
+                        continue;
+                    }
+
+                    for (int m = grid->start[jcell]; m < grid->start[jcell + 1]; m++) {
+                        int j         = grid->items[m];
+                        MD_FLOAT delx = xtmp - atom_x(j);
+                        MD_FLOAT dely = ytmp - atom_y(j);
+                        MD_FLOAT delz = ztmp - atom_z(j);
+                        MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
+
+#ifndef ONE_ATOM_TYPE
+                        const int type_j          = atom->type[j];
+                        const int type_ij         = type_i * atom->ntypes + type_j;
+                        const MD_FLOAT cutforcesq = atom->cutforcesq[type_ij];
+                        const MD_FLOAT sigma6     = atom->sigma6[type_ij];
+                        const MD_FLOAT epsilon    = atom->epsilon[type_ij];
+#endif
+
+                        if (j != i && rsq < cutforcesq) {
+                            MD_FLOAT sr2   = num1 / rsq;
+                            MD_FLOAT sr6   = sr2 * sr2 * sr2 * sigma6;
+                            MD_FLOAT force = num48 * sr6 * (sr6 - num05) * sr2 * epsilon;
+                            fix += delx * force;
+                            fiy += dely * force;
+                            fiz += delz * force;
+                        }
+                    }
+
+                    ntested += grid->start[jcell + 1] - grid->start[jcell];
+                }
+
+                atom_fx(i) += fix;
+                atom_fy(i) += fiy;
+                atom_fz(i) += fiz;
+
+                addStat(stats->total_force_neighs, ntested);
+                addStat(stats->total_force_iters,
+                    (ntested + VECTOR_WIDTH - 1) / VECTOR_WIDTH);
+            }
+        }
+
+        stopRegion(REGION_FORCE_THREAD);
         LIKWID_MARKER_STOP("force");
+        free(cells);
     }
 
     double timeStop = getTimeStamp();
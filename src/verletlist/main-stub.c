@@ -11,15 +11,19 @@
 //---
 #include <allocate.h>
 #include <atom.h>
+#include <cachesim.h>
 #include <eam.h>
 #include <force.h>
+#include <frequency.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <pbc.h>
+#include <snapshot.h>
 #include <stats.h>
 #include <thermo.h>
 #include <timers.h>
 #include <timing.h>
+#include <tracing.h>
 #include <util.h>
 
 #define HLINE                                                                            \
@@ -53,15 +57,17 @@ void init(Parameter* param)
     param->nstat         = 100;
     param->temp          = 1.44;
     param->reneigh_every = 20;
-    param->proc_freq     = 2.4;
+    param->proc_freq     = 0.0;
     param->eam_file      = NULL;
 }
 
 void createNeighbors(Atom* atom, Neighbor* neighbor, int pattern, int nneighs, int nreps)
 {
     const int maxneighs = nneighs * nreps;
-    neighbor->numneigh  = (int*)malloc(atom->Nmax * sizeof(int));
-    neighbor->neighbors = (int*)malloc(atom->Nmax * maxneighs * sizeof(int));
+    neighbor->maxneighs = maxneighs;
+    neighbor->numneigh  = (int*)allocate(ALIGNMENT, atom->Nmax * sizeof(int));
+    neighbor->neighbors = (int*)allocate(ALIGNMENT,
+        (MD_INDEX)atom->Nmax * maxneighs * sizeof(int));
 
     if (pattern == P_RAND && atom->Nlocal <= nneighs) {
         fprintf(stderr,
@@ -71,7 +77,7 @@ void createNeighbors(Atom* atom, Neighbor* neighbor, int pattern, int nneighs, i
     }
 
     for (int i = 0; i < atom->Nlocal; i++) {
-        int* neighptr = &(neighbor->neighbors[i * neighbor->maxneighs]);
+        int* neighptr = &(neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)]);
         int j         = (pattern == P_SEQ) ? (i + 1) : 0;
         int m         = (pattern == P_SEQ) ? atom->Nlocal : nneighs;
 
@@ -118,6 +124,8 @@ int main(int argc, const char* argv[])
     int nneighs       = 76;
     int nreps         = 1;
     int csv           = 0;
+    char* replay_file = NULL; // Snapshot written by the main binary
+    int replay_step   = 0;
 
     LIKWID_MARKER_INIT;
     LIKWID_MARKER_REGISTER("force");
@@ -170,6 +178,10 @@ int main(int argc, const char* argv[])
             param.proc_freq = atof(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--replay") == 0)) {
+            replay_file = strdup(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "--csv") == 0)) {
             csv = 1;
             continue;
@@ -185,8 +197,11 @@ int main(int argc, const char* argv[])
             printf("-nn <int>:            number of neighbors per atom (default 76)\n");
             printf("-nr <int>:            number of times neighbor lists should be "
                    "replicated (default 1)\n");
-            printf("--freq <real>:        set CPU frequency (GHz) and display average "
-                   "cycles per atom and neighbors\n");
+            printf("--freq <real>:        CPU frequency (GHz) for the cycles per atom "
+                   "and neighbor, measured\n");
+            printf("                      if not set\n");
+            printf("--replay <string>:    replay atoms and neighbor lists of a snapshot "
+                   "(see --snapshot)\n");
             printf("--csv:                set output as CSV style\n");
             printf(HLINE);
             exit(EXIT_SUCCESS);
@@ -206,34 +221,53 @@ int main(int argc, const char* argv[])
     initAtom(atom);
     initStats(&stats);
 
-    atom->ntypes  = param.ntypes;
-    atom->epsilon = allocate(ALIGNMENT, atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->sigma6  = allocate(ALIGNMENT, atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->cutforcesq = allocate(ALIGNMENT,
-        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    atom->cutneighsq = allocate(ALIGNMENT,
-        atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
-    for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
-        atom->epsilon[i]    = param.epsilon;
-        atom->sigma6[i]     = param.sigma6;
-        atom->cutneighsq[i] = param.cutneigh * param.cutneigh;
-        atom->cutforcesq[i] = param.cutforce * param.cutforce;
-    }
+    if (replay_file != NULL) {
+        DEBUG_MESSAGE("Reading snapshot...\n");
+        initNeighbor(&neighbor, &param);
+        replay_step = readSnapshot(replay_file, &param, atom, &neighbor);
+        free(pattern_str);
+        pattern_str = strdup("replay");
+        natoms      = atom->Nlocal;
+        nreps       = 1;
+
+        long long npairs = 0;
+        for (int i = 0; i < atom->Nlocal; i++) {
+            npairs += neighbor.numneigh[i];
+        }
 
-    DEBUG_MESSAGE("Creating atoms...\n");
-    for (int i = 0; i < natoms; ++i) {
-        while (atom->Nlocal > atom->Nmax - natoms) {
-            growAtom(atom);
+        nneighs = (int)((npairs + natoms - 1) / natoms);
+    } else {
+        atom->ntypes     = param.ntypes;
+        atom->epsilon    = allocate(ALIGNMENT,
+            atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+        atom->sigma6     = allocate(ALIGNMENT,
+            atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+        atom->cutforcesq = allocate(ALIGNMENT,
+            atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+        atom->cutneighsq = allocate(ALIGNMENT,
+            atom->ntypes * atom->ntypes * sizeof(MD_FLOAT));
+        for (int i = 0; i < atom->ntypes * atom->ntypes; i++) {
+            atom->epsilon[i]    = param.epsilon;
+            atom->sigma6[i]     = param.sigma6;
+            atom->cutneighsq[i] = param.cutneigh * param.cutneigh;
+            atom->cutforcesq[i] = param.cutforce * param.cutforce;
         }
 
-        atom->type[atom->Nlocal] = rand() % atom->ntypes;
-        atom_x(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
-        atom_y(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
-        atom_z(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
-        atom_vx(atom->Nlocal)    = 0.0;
-        atom_vy(atom->Nlocal)    = 0.0;
-        atom_vz(atom->Nlocal)    = 0.0;
-        atom->Nlocal++;
+        DEBUG_MESSAGE("Creating atoms...\n");
+        for (int i = 0; i < natoms; ++i) {
+            while (atom->Nlocal > atom->Nmax - natoms) {
+                growAtom(atom);
+            }
+
+            atom->type[atom->Nlocal] = rand() % atom->ntypes;
+            atom_x(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
+            atom_y(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
+            atom_z(atom->Nlocal)     = (MD_FLOAT)(i)*0.00001;
+            atom_vx(atom->Nlocal)    = 0.0;
+            atom_vy(atom->Nlocal)    = 0.0;
+            atom_vz(atom->Nlocal)    = 0.0;
+            atom->Nlocal++;
+        }
     }
 
     const double estim_atom_volume      = (double)(atom->Nlocal * 3 * sizeof(MD_FLOAT));
@@ -244,6 +278,12 @@ int main(int argc, const char* argv[])
 
     if (!csv) {
         printf("Pattern: %s\n", pattern_str);
+        if (replay_file != NULL) {
+            printf("Snapshot: %s (step %d, %s neighbor lists)\n",
+                replay_file,
+                replay_step,
+                param.half_neigh ? "half" : "full");
+        }
         printf("Number of timesteps: %d\n", param.ntimes);
         printf("Number of atoms: %d\n", natoms);
         printf("Number of neighbors per atom: %d\n", nneighs);
@@ -254,10 +294,13 @@ int main(int argc, const char* argv[])
             estim_neighbors_volume / 1000.0);
     }
 
-    DEBUG_MESSAGE("Initializing neighbor lists...\n");
-    initNeighbor(&neighbor, &param);
-    DEBUG_MESSAGE("Creating neighbor lists...\n");
-    createNeighbors(atom, &neighbor, pattern, nneighs, nreps);
+    if (replay_file == NULL) {
+        DEBUG_MESSAGE("Initializing neighbor lists...\n");
+        initNeighbor(&neighbor, &param);
+        DEBUG_MESSAGE("Creating neighbor lists...\n");
+        createNeighbors(atom, &neighbor, pattern, nneighs, nreps);
+    }
+
     DEBUG_MESSAGE("Computing forces...\n");
 
     double T_accum = 0.0;
@@ -277,7 +320,7 @@ int main(int argc, const char* argv[])
         }
     }
 
-    double freq_hz                     = param.proc_freq * 1.e9;
+    double freq_hz                     = getFrequency(&param) * 1.e9;
     const double atoms_updates_per_sec = (double)(atom->Nlocal) / T_accum *
                                          (double)(param.ntimes);
     const double cycles_per_atom = T_accum / (double)(atom->Nlocal) /
@@ -288,7 +331,7 @@ int main(int argc, const char* argv[])
         printf("Total time: %.4f, Mega atom updates/s: %.4f\n",
             T_accum,
             atoms_updates_per_sec / 1.e6);
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf("Cycles per atom: %.4f, Cycles per neighbor: %.4f\n",
                 cycles_per_atom,
                 cycles_per_neigh);
@@ -296,7 +339,7 @@ int main(int argc, const char* argv[])
     } else {
         printf("steps,pattern,natoms,nneighs,nreps,total vol.(kB),atoms vol.(kB),neigh "
                "vol.(kB),time(s),atom upds/s(M)");
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf(",cy/atom,cy/neigh");
         }
         printf("\n");
@@ -313,7 +356,7 @@ int main(int argc, const char* argv[])
             T_accum,
             atoms_updates_per_sec / 1.e6);
 
-        if (param.proc_freq > 0.0) {
+        if (freq_hz > 0.0) {
             printf(",%.4f,%.4f", cycles_per_atom, cycles_per_neigh);
         }
         printf("\n");
@@ -322,6 +365,12 @@ int main(int argc, const char* argv[])
     double timer[NUMTIMER];
     timer[FORCE] = T_accum;
     displayStatistics(atom, &param, &stats, timer);
+
+#ifdef CACHE_SIM
+    printCacheSim();
+    printf(HLINE);
+#endif
+
     LIKWID_MARKER_CLOSE;
     return EXIT_SUCCESS;
 }
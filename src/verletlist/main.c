@@ -17,21 +17,28 @@
 
 #include <allocate.h>
 #include <atom.h>
+#include <cachesim.h>
 #include <device.h>
 #include <eam.h>
+#include <energy.h>
 #include <force.h>
 #include <integrate.h>
 #include <neighbor.h>
 #include <parameter.h>
 #include <pbc.h>
+#include <report.h>
+#include <snapshot.h>
 #include <stats.h>
 #include <thermo.h>
 #include <timers.h>
 #include <timing.h>
+#include <tracing.h>
 #include <util.h>
 #include <vtk.h>
 
 #define HLINE "------------------------------------------------------------------\n"
+// List force computations timed on the final positions of a direct force run
+#define DIRECT_COMPARE_STEPS 10
 
 double setup(Parameter* param, Eam* eam, Atom* atom, Neighbor* neighbor, Stats* stats)
 {
@@ -45,50 +52,89 @@ double setup(Parameter* param, Eam* eam, Atom* atom, Neighbor* neighbor, Stats*
     param->zprd    = param->nz * param->lattice;
 
     timeStart = getTimeStamp();
+    startRegion(REGION_SETUP);
     initAtom(atom);
     initPbc(atom);
     initStats(stats);
     initNeighbor(neighbor, param);
+    startRegion(REGION_SETUP_ATOMS);
     if (param->input_file == NULL) {
         createAtom(atom, param);
     } else {
         readAtom(atom, param);
     }
+    stopRegion(REGION_SETUP_ATOMS);
 
     setupNeighbor(param);
+    startRegion(REGION_SETUP_THERMO);
     setupThermo(param, atom->Natoms);
     if (param->input_file == NULL) {
         adjustThermo(param, atom);
     }
-#ifdef SORT_ATOMS
-    atom->Nghost = 0;
-    sortAtom(atom);
-#endif
+    stopRegion(REGION_SETUP_THERMO);
+    if (param->sort_atoms != SORT_NONE) {
+        startRegion(REGION_SETUP_SORT);
+        atom->Nghost = 0;
+        sortAtom(param, atom, neighbor);
+        stopRegion(REGION_SETUP_SORT);
+    }
+    startRegion(REGION_SETUP_GHOSTS);
     setupPbc(atom, param);
+    stopRegion(REGION_SETUP_GHOSTS);
+    startRegion(REGION_SETUP_DEVICE);
     initDevice(atom, neighbor);
+    stopRegion(REGION_SETUP_DEVICE);
+    startRegion(REGION_SETUP_GHOSTS);
     updatePbc(atom, param, true);
-    buildNeighbor(atom, neighbor);
+    stopRegion(REGION_SETUP_GHOSTS);
+    startRegion(REGION_SETUP_NEIGHBOR);
+    if (param->force_direct) {
+        binatoms(atom);
+    } else {
+        buildNeighbor(atom, neighbor);
+    }
+    stopRegion(REGION_SETUP_NEIGHBOR);
     initForce(param);
+    stopRegion(REGION_SETUP);
     timeStop = getTimeStamp();
     return timeStop - timeStart;
 }
 
+// Atoms are resorted every resort_every timesteps, 0 keeps the order of the setup
+static bool isResortStep(Parameter* param, int n)
+{
+    return param->sort_atoms != SORT_NONE && param->resort_every > 0 &&
+           (n + 1) % param->resort_every == 0;
+}
+
 double reneighbour(int n, Parameter* param, Atom* atom, Neighbor* neighbor)
 {
     double timeStart, timeStop;
     timeStart = getTimeStamp();
     LIKWID_MARKER_START("reneighbour");
+    startRegion(REGION_REBUILD);
+    startRegion(REGION_REBUILD_PBC);
     updateAtomsPbc(atom, param, true);
-#ifdef SORT_ATOMS
-    if ((n + 1) % param->resort_every == 0) {
+    stopRegion(REGION_REBUILD_PBC);
+    if (isResortStep(param, n)) {
         DEBUG_MESSAGE("Resorting atoms");
+        startRegion(REGION_REBUILD_SORT);
         atom->Nghost = 0;
-        sortAtom(atom);
+        sortAtom(param, atom, neighbor);
+        stopRegion(REGION_REBUILD_SORT);
     }
-#endif
+    startRegion(REGION_REBUILD_GHOSTS);
     setupPbc(atom, param);
     updatePbc(atom, param, true);
-    buildNeighbor(atom, neighbor);
+    stopRegion(REGION_REBUILD_GHOSTS);
+    startRegion(REGION_REBUILD_NEIGHBOR);
+    if (param->force_direct) {
+        binatoms(atom);
+    } else {
+        buildNeighbor(atom, neighbor);
+    }
+    stopRegion(REGION_REBUILD_NEIGHBOR);
+    stopRegion(REGION_REBUILD);
     LIKWID_MARKER_STOP("reneighbour");
     timeStop = getTimeStamp();
     return timeStop - timeStart;
@@ -107,6 +153,31 @@ void printAtomState(Atom* atom)
     // }
 }
 
+void printPageReport(Atom* atom, Neighbor* neighbor)
+{
+    size_t nbytes = atom->Nmax * sizeof(MD_FLOAT);
+
+    printf("Page placement:\n");
+#ifdef AOS
+    printPagePlacement("x", atom->x, nbytes * 3);
+    printPagePlacement("vx", atom->vx, nbytes * 3);
+    printPagePlacement("fx", atom->fx, nbytes * 3);
+#else
+    printPagePlacement("x", atom->x, nbytes);
+    printPagePlacement("y", atom->y, nbytes);
+    printPagePlacement("z", atom->z, nbytes);
+    printPagePlacement("vx", atom->vx, nbytes);
+    printPagePlacement("fx", atom->fx, nbytes);
+#endif
+    printPagePlacement("type", atom->type, atom->Nmax * sizeof(int));
+    printPagePlacement("numneigh",
+        neighbor->numneigh,
+        (atom->Nlocal + atom->Nghost) * sizeof(int));
+    printPagePlacement("neighbors",
+        neighbor->neighbors,
+        (MD_INDEX)(atom->Nlocal + atom->Nghost) * neighbor->maxneighs * sizeof(int));
+}
+
 void writeInput(Parameter* param, Atom* atom)
 {
     FILE* fpin = fopen("input.in", "w");
@@ -126,6 +197,27 @@ void writeInput(Parameter* param, Atom* atom)
     fclose(fpin);
 }
 
+/* time the neighbor list mode on the final positions of a direct force run, one list
+ * build and DIRECT_COMPARE_STEPS list force computations whose statistics are not
+ * kept; returns the build time and sets *force to the mean force time */
+static double timeListMode(
+    Parameter* param, Atom* atom, Neighbor* neighbor, double* force)
+{
+    Stats stats;
+    double build = getTimeStamp();
+
+    initStats(&stats);
+    buildNeighbor(atom, neighbor);
+    build  = getTimeStamp() - build;
+    *force = 0.0;
+    for (int n = 0; n < DIRECT_COMPARE_STEPS; n++) {
+        *force += computeForceList(param, atom, neighbor, &stats);
+    }
+
+    *force /= DIRECT_COMPARE_STEPS;
+    return build;
+}
+
 int main(int argc, char** argv)
 {
     double timer[NUMTIMER];
@@ -142,6 +234,8 @@ int main(int argc, char** argv)
         // LIKWID_MARKER_REGISTER("pbc");
     }
 
+    initRegions();
+
     initParameter(&param);
     for (int i = 0; i < argc; i++) {
         if ((strcmp(argv[i], "-p") == 0) || strcmp(argv[i], "--params") == 0) {
@@ -191,6 +285,32 @@ int main(int argc, char** argv)
             param.skin = atof(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--reneigh") == 0)) {
+            if ((param.reneigh_every = atoi(argv[++i])) < 1) {
+                fprintf(stderr, "Invalid reneighbor interval!\n");
+                exit(-1);
+            }
+            continue;
+        }
+        if ((strcmp(argv[i], "--direct") == 0)) {
+            param.force_direct = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--balance") == 0)) {
+            param.force_balance = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--sort") == 0)) {
+            if ((param.sort_atoms = str2sort(argv[++i])) < 0) {
+                fprintf(stderr, "Invalid atom sort order!\n");
+                exit(-1);
+            }
+            continue;
+        }
+        if ((strcmp(argv[i], "--resort") == 0)) {
+            param.resort_every = atoi(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "--freq") == 0)) {
             param.proc_freq = atof(argv[++i]);
             continue;
@@ -203,6 +323,26 @@ int main(int argc, char** argv)
             param.write_atom_file = strdup(argv[++i]);
             continue;
         }
+        if ((strcmp(argv[i], "--page-report") == 0)) {
+            param.page_report = 1;
+            continue;
+        }
+        if ((strcmp(argv[i], "--report") == 0)) {
+            param.report_file = strdup(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--report-csv") == 0)) {
+            param.report_csv_file = strdup(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--snapshot") == 0)) {
+            param.snapshot_file = strdup(argv[++i]);
+            continue;
+        }
+        if ((strcmp(argv[i], "--snapshot-step") == 0)) {
+            param.snapshot_step = atoi(argv[++i]);
+            continue;
+        }
         if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
             printf("MD Bench: A performance-oriented prototyping harness for MD "
                    "algorithms\n");
@@ -222,23 +362,62 @@ int main(int argc, char** argv)
                    "lists\n");
             printf("-r / --radius <real>:       set cutoff radius\n");
             printf("-s / --skin <real>:         set skin (verlet buffer)\n");
+            printf("--reneigh <int>:            reneighbor every <int> timesteps\n");
+            printf("--direct:                   compute forces from the bins without "
+                   "neighbor lists\n");
+            printf("--balance:                  static thread ranges of equal neighbor "
+                   "list work\n");
+            printf("--sort <string>:            atom order (none, bins, morton or "
+                   "hilbert)\n");
+            printf("--resort <int>:             resort atoms every <int> timesteps (0 "
+                   "never), reneighbors as well\n");
             printf("-w <file>:                  write input atoms to file\n");
-            printf("--freq <real>:              processor frequency (GHz)\n");
+            printf("--freq <real>:              processor frequency (GHz), measured if "
+                   "not set\n");
             printf("--vtk <string>:             VTK file for visualization\n");
+            printf("--page-report:              print NUMA page placement of main "
+                   "arrays\n");
+            printf("--report <string>:          write a JSON report of the run\n");
+            printf("--report-csv <string>:      append a CSV line of the report\n");
+            printf("--snapshot <string>:        dump positions and neighbor lists for the "
+                   "stub\n");
+            printf("--snapshot-step <int>:      step at which the snapshot is written "
+                   "(default 0)\n");
             printf(HLINE);
             exit(EXIT_SUCCESS);
         }
     }
 
     param.cutneigh = param.cutforce + param.skin;
-    setup(&param, &eam, &atom, &neighbor, &stats);
+#if defined(CUDA_TARGET) || defined(MEM_TRACER) || defined(INDEX_TRACER)
+    if (param.force_direct) {
+        fprintf(stderr, "Warning: Direct force is not supported by this build!\n");
+        param.force_direct = 0;
+    }
+#endif
+    if (param.force_direct &&
+        (param.force_field != FF_LJ || param.snapshot_file != NULL)) {
+        fprintf(stderr, "Warning: Direct force requires LJ and no snapshot!\n");
+        param.force_direct = 0;
+    }
+    if (param.force_direct && param.half_neigh) {
+        fprintf(stderr, "Warning: Direct force computes full neighbor pairs!\n");
+        param.half_neigh = 0;
+    }
+#ifdef CUDA_TARGET
+    if (param.force_balance) {
+        fprintf(stderr, "Warning: Force balancing is not supported by this build!\n");
+        param.force_balance = 0;
+    }
+#endif
+    timer[SETUP] = setup(&param, &eam, &atom, &neighbor, &stats);
     printParameter(&param);
     printf(HLINE);
 
     printf("step\ttemp\t\tpressure\n");
     computeThermo(0, &param, &atom);
 #if defined(MEM_TRACER) || defined(INDEX_TRACER)
-    traceAddresses(&param, &atom, &neighbor, n + 1);
+    traceAddresses(&param, &atom, &neighbor, 0);
 #endif
 
     if (param.write_atom_file != NULL) {
@@ -247,43 +426,69 @@ int main(int argc, char** argv)
 
     // writeInput(&param, &atom);
 
+    if (param.snapshot_file != NULL && param.snapshot_step == 0) {
+        writeSnapshot(param.snapshot_file, &param, &atom, &neighbor, 0);
+    }
+
+    // As with timer[FORCE], the force region includes this initial computation
+    startRegion(REGION_FORCE);
     timer[FORCE] = computeForce(&param, &atom, &neighbor, &stats);
+    stopRegion(REGION_FORCE);
     timer[NEIGH] = 0.0;
     timer[TOTAL] = getTimeStamp();
+    startRegion(REGION_LOOP);
 
     if (param.vtk_file != NULL) {
         write_atoms_to_vtk_file(param.vtk_file, &atom, 0);
     }
 
     for (int n = 0; n < param.ntimes; n++) {
-        bool reneigh = (n + 1) % param.reneigh_every == 0;
+        // Resorting invalidates the neighbor lists, so it also forces a rebuild
+        bool reneigh = (n + 1) % param.reneigh_every == 0 || isResortStep(&param, n);
+        startRegion(REGION_INTEGRATE);
         initialIntegrate(reneigh, &param, &atom);
+        stopRegion(REGION_INTEGRATE);
 
         if (reneigh) {
             timer[NEIGH] += reneighbour(n, &param, &atom, &neighbor);
         } else {
+            startRegion(REGION_PBC);
             updatePbc(&atom, &param, false);
+            stopRegion(REGION_PBC);
         }
 
 #if defined(MEM_TRACER) || defined(INDEX_TRACER)
         traceAddresses(&param, &atom, &neighbor, n + 1);
 #endif
 
+        if (param.snapshot_file != NULL && param.snapshot_step == n + 1) {
+            writeSnapshot(param.snapshot_file, &param, &atom, &neighbor, n + 1);
+        }
+
+        startRegion(REGION_FORCE);
         timer[FORCE] += computeForce(&param, &atom, &neighbor, &stats);
+        stopRegion(REGION_FORCE);
+        startRegion(REGION_INTEGRATE);
         finalIntegrate(reneigh, &param, &atom);
+        stopRegion(REGION_INTEGRATE);
 
         if (!((n + 1) % param.nstat) && (n + 1) < param.ntimes) {
+            startRegion(REGION_THERMO);
 #ifdef CUDA_TARGET
             memcpyFromGPU(atom.x, atom.d_atom.x, atom.Nmax * sizeof(MD_FLOAT) * 3);
 #endif
             computeThermo(n + 1, &param, &atom);
+            stopRegion(REGION_THERMO);
         }
 
         if (param.vtk_file != NULL) {
+            startRegion(REGION_OUTPUT);
             write_atoms_to_vtk_file(param.vtk_file, &atom, n + 1);
+            stopRegion(REGION_OUTPUT);
         }
     }
 
+    stopRegion(REGION_LOOP);
     timer[TOTAL] = getTimeStamp() - timer[TOTAL];
     computeThermo(-1, &param, &atom);
 
@@ -292,12 +497,54 @@ int main(int argc, char** argv)
         atom.Natoms,
         atom.Nghost,
         param.ntimes);
+    printf("Bins: %d of %d occupied (%.2f MB)\n",
+        getOccupiedBins(),
+        getTotalBins(),
+        getBinningMemory());
+    printTypeStencil(getTypeStencil(), "atom pairs");
+    printSortLocality();
+    printBalance(&neighbor.balance, "i-atoms");
     printf("TOTAL %.2fs FORCE %.2fs NEIGH %.2fs REST %.2fs\n",
         timer[TOTAL],
         timer[FORCE],
         timer[NEIGH],
         timer[TOTAL] - timer[FORCE] - timer[NEIGH]);
+    printf("SETUP %.2fs\n", timer[SETUP]);
+    printf("Array growth: %d reallocations, %.2f MB copied\n",
+        getNumReallocations(),
+        1e-6 * getReallocatedBytes());
+    printf(HLINE);
+    printRegions();
+    printf(HLINE);
+
+    double list_build   = 0.0, list_force = 0.0;
+    double direct_force = timer[FORCE] / (param.ntimes + 1);
+    double direct_neigh = timer[NEIGH] / MAX(param.ntimes, 1);
+    if (param.force_direct) {
+        list_build = timeListMode(&param, &atom, &neighbor, &list_force);
+        printf("Direct force: %.3f ms per step (force %.3f ms, rebuild %.3f ms)\n",
+            1e3 * (direct_force + direct_neigh),
+            1e3 * direct_force,
+            1e3 * direct_neigh);
+        printf("Neighbor lists on the final positions: %.3f ms per step (force %.3f "
+               "ms, rebuild %.3f ms with a list build of %.3f ms every %d steps)\n",
+            1e3 * (list_force + direct_neigh + list_build / param.reneigh_every),
+            1e3 * list_force,
+            1e3 * (direct_neigh + list_build / param.reneigh_every),
+            1e3 * list_build,
+            param.reneigh_every);
+        printf(HLINE);
+    }
+
+    if (param.page_report) {
+        printPageReport(&atom, &neighbor);
+        printf(HLINE);
+    }
+
+#ifdef CACHE_SIM
+    printCacheSim();
     printf(HLINE);
+#endif
 
 #ifdef _OPENMP
     int nthreads  = 0;
@@ -336,9 +583,52 @@ int main(int argc, char** argv)
 
     printf("Performance: %.2f million atom updates per second\n",
         1e-6 * (double)atom.Natoms * param.ntimes / timer[TOTAL]);
+    printf("Performance: %.4f %s/day\n",
+        getTimePerDay(&param, timer[TOTAL]),
+        getTimePerDayUnit(&param));
+    printEnergy(timer, atom.Natoms, param.ntimes);
+
+    reportBuildConfig(&param);
+#ifdef _OPENMP
+    reportSection("openmp");
+    reportInt("num_threads", nthreads);
+    reportString("schedule", schedType);
+    reportInt("chunk_size", chunkSize);
+#endif
+    reportSection("system");
+    reportInt("natoms", atom.Natoms);
+    reportInt("nlocal", atom.Nlocal);
+    reportInt("nghost", atom.Nghost);
+    reportInt("bins_occupied", getOccupiedBins());
+    reportInt("bins_total", getTotalBins());
+    reportReal("binning_mb", getBinningMemory());
+    reportTypeStencil(getTypeStencil());
+    reportSortLocality();
+    reportBalance(&neighbor.balance);
+    if (param.force_direct) {
+        reportSection("direct_force");
+        reportReal("direct_force_per_step", direct_force);
+        reportReal("direct_neigh_per_step", direct_neigh);
+        reportReal("list_force_per_step", list_force);
+        reportReal("list_build", list_build);
+        reportReal("list_per_step",
+            list_force + direct_neigh + list_build / param.reneigh_every);
+    }
+    reportSection("timers");
+    reportReal("total", timer[TOTAL]);
+    reportReal("force", timer[FORCE]);
+    reportReal("neigh", timer[NEIGH]);
+    reportReal("rest", timer[TOTAL] - timer[FORCE] - timer[NEIGH]);
+    reportReal("setup", timer[SETUP]);
+    reportRegions();
+    reportSection("performance");
+    reportReal("maups", 1e-6 * (double)atom.Natoms * param.ntimes / timer[TOTAL]);
+    reportTimePerDay(&param, timer[TOTAL]);
+    reportEnergy(timer, atom.Natoms, param.ntimes);
 #ifdef COMPUTE_STATS
     displayStatistics(&atom, &param, &stats, timer);
 #endif
+    writeReport(&param);
     LIKWID_MARKER_CLOSE;
     return EXIT_SUCCESS;
 }
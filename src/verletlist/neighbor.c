@@ -8,12 +8,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <allocate.h>
 #include <atom.h>
+#include <cellgrid.h>
 #include <neighbor.h>
 #include <parameter.h>
+#include <report.h>
+#include <typestencil.h>
+#include <util.h>
 
 #define SMALL  1.0e-6
 #define FACTOR 0.999
+// Force work of an i-atom besides its list entries, in list entries
+#define IATOM_COST 2
 
 #ifdef CUDA_TARGET
 BuildNeighborFunction buildNeighbor = buildNeighborCUDA;
@@ -26,18 +33,32 @@ MD_FLOAT bininvx, bininvy, bininvz;
 int mbinxlo, mbinylo, mbinzlo;
 int nbinx, nbiny, nbinz;
 int mbinx, mbiny, mbinz; // n bins in x, y, z
-int* bincount;
-int* bins;
-int mbins;         // total number of bins
-int atoms_per_bin; // max atoms per bin
+int mbins;               // total number of bins
+int atoms_per_bin;       // initial bin capacity of the CUDA binning
 MD_FLOAT cutneigh;
 MD_FLOAT cutneighsq; // neighbor cutoff squared
 int nmax;
 int nstencil; // # of bins in stencil
 int* stencil; // stencil list of bin offsets
 MD_FLOAT binsizex, binsizey, binsizez;
+static MD_FLOAT* stencil_distsq; // distance of each stencil bin to the center bin
+static TypeStencil tstencil;      // stencil entries per type pair
+static int tstencil_valid;
+static CellGrid grid;      // occupied bins of local and ghost atoms per type
+static int* stencil_cells; // occupied bin of each type stencil entry around a bin
+static MD_FLOAT *sort_x, *sort_y, *sort_z; // buffers swapped with the atom arrays
+static MD_FLOAT *sort_vx, *sort_vy, *sort_vz;
+static int* sort_type;
+static int sort_nmax;
+static int sort_line;            // cache line size of the locality measurement
+static int sort_pending;         // the next build measures the locality after a sort
+static int sort_count;           // sorts, including the one at setup
+static int sort_measured;        // sorts with a neighbor list to compare against
+static double sort_lines_before; // x cache lines per atom in the lists before sorts
+static double sort_lines_after;  // and after sorts, summed over sort_measured
 static int coord2bin(MD_FLOAT, MD_FLOAT, MD_FLOAT);
 static MD_FLOAT bindist(int, int, int);
+static double getNeighborLines(Atom*, Neighbor*);
 
 /* exported subroutines */
 void initNeighbor(Neighbor* neighbor, Parameter* param)
@@ -53,12 +74,30 @@ void initNeighbor(Neighbor* neighbor, Parameter* param)
     nmax                 = 0;
     atoms_per_bin        = 8;
     stencil              = NULL;
-    bins                 = NULL;
-    bincount             = NULL;
+    stencil_distsq       = NULL;
+    stencil_cells        = NULL;
+    tstencil_valid       = 0;
+    sort_x               = NULL;
+    sort_y               = NULL;
+    sort_z               = NULL;
+    sort_vx              = NULL;
+    sort_vy              = NULL;
+    sort_vz              = NULL;
+    sort_type            = NULL;
+    sort_nmax            = 0;
+    sort_line            = param->cache_line;
+    sort_pending         = 0;
+    sort_count           = 0;
+    sort_measured        = 0;
+    sort_lines_before    = 0.0;
+    sort_lines_after     = 0.0;
     neighbor->maxneighs  = 100;
     neighbor->numneigh   = NULL;
     neighbor->neighbors  = NULL;
     neighbor->half_neigh = param->half_neigh;
+    initBalance(&neighbor->balance, param->force_balance);
+    initCellGrid(&grid);
+    initTypeStencil(&tstencil);
 }
 
 void setupNeighbor(Parameter* param)
@@ -156,9 +195,12 @@ void setupNeighbor(Parameter* param)
 
     if (stencil) {
         free(stencil);
+        free(stencil_distsq);
     }
     stencil = (int*)malloc(
         (2 * nextz + 1) * (2 * nexty + 1) * (2 * nextx + 1) * sizeof(int));
+    stencil_distsq = (MD_FLOAT*)malloc(
+        (2 * nextz + 1) * (2 * nexty + 1) * (2 * nextx + 1) * sizeof(MD_FLOAT));
     nstencil   = 0;
     int kstart = -nextz;
 
@@ -166,21 +208,47 @@ void setupNeighbor(Parameter* param)
         for (int j = -nexty; j <= nexty; j++) {
             for (int i = -nextx; i <= nextx; i++) {
                 if (bindist(i, j, k) < cutneighsq) {
-                    stencil[nstencil++] = k * mbiny * mbinx + j * mbinx + i;
+                    stencil_distsq[nstencil] = bindist(i, j, k);
+                    stencil[nstencil++]      = k * mbiny * mbinx + j * mbinx + i;
                 }
             }
         }
     }
 
-    mbins = mbinx * mbiny * mbinz;
-    if (bincount) {
-        free(bincount);
+    mbins          = mbinx * mbiny * mbinz;
+    tstencil_valid = 0;
+}
+
+/* the type stencils need the cutoffs of the atoms, so they are set up with the
+ * first binning after setupNeighbor */
+static void setupStencilTypes(Atom* atom)
+{
+#ifdef ONE_ATOM_TYPE
+    setupTypeStencil(&tstencil, 1, &cutneighsq, nstencil, stencil_distsq);
+#else
+    setupTypeStencil(&tstencil, atom->ntypes, atom->cutneighsq, nstencil, stencil_distsq);
+#endif
+    free(stencil_cells);
+    stencil_cells  = (int*)malloc(tstencil.ntypes * nstencil * sizeof(int));
+    tstencil_valid = 1;
+}
+
+/* split the i-atoms into one contiguous range per thread with about the same
+ * force work of the current lists */
+static void balanceNeighbor(Atom* atom, Neighbor* neighbor)
+{
+    Balance* b = &neighbor->balance;
+
+    if (!b->enabled) {
+        return;
     }
-    bincount = (int*)malloc(mbins * sizeof(int));
-    if (bins) {
-        free(bins);
+
+    reserveBalance(b, atom->Nlocal);
+    for (int i = 0; i < atom->Nlocal; i++) {
+        b->cost[i] = neighbor->numneigh[i] + IATOM_COST;
     }
-    bins = (int*)malloc(mbins * atoms_per_bin * sizeof(int));
+
+    buildBalance(b, atom->Nlocal);
 }
 
 void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
@@ -189,11 +257,12 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
 
     /* extend atom arrays if necessary */
     if (nall > nmax) {
-        nmax = nall;
-        if (neighbor->numneigh) free(neighbor->numneigh);
-        if (neighbor->neighbors) free(neighbor->neighbors);
-        neighbor->numneigh  = (int*)malloc(nmax * sizeof(int));
-        neighbor->neighbors = (int*)malloc(nmax * neighbor->maxneighs * sizeof(int*));
+        nmax = MAX(nall, nmax + nmax / 2);
+        if (neighbor->numneigh) deallocate(neighbor->numneigh);
+        if (neighbor->neighbors) deallocate(neighbor->neighbors);
+        neighbor->numneigh  = (int*)allocate(ALIGNMENT, nmax * sizeof(int));
+        neighbor->neighbors = (int*)allocate(ALIGNMENT,
+            (MD_INDEX)nmax * neighbor->maxneighs * sizeof(int*));
     }
 
     /* bin local & ghost atoms */
@@ -205,62 +274,118 @@ void buildNeighborCPU(Atom* atom, Neighbor* neighbor)
         int new_maxneighs = neighbor->maxneighs;
         resize            = 0;
 
-        for (int i = 0; i < atom->Nlocal; i++) {
-            int* neighptr = &(neighbor->neighbors[i * neighbor->maxneighs]);
-            int n         = 0;
-            MD_FLOAT xtmp = atom_x(i);
-            MD_FLOAT ytmp = atom_y(i);
-            MD_FLOAT ztmp = atom_z(i);
-            int ibin      = coord2bin(xtmp, ytmp, ztmp);
-#ifndef ONE_ATOM_TYPE
-            int type_i = atom->type[i];
-#endif
-            for (int k = 0; k < nstencil; k++) {
-                int jbin     = ibin + stencil[k];
-                int* loc_bin = &bins[jbin * atoms_per_bin];
+        startTypeStencilCount(&tstencil);
+
+        // Atoms are visited bin by bin, so the stencil is looked up once per bin
+        for (int c = 0; c < grid.ncells; c++) {
+            const int nt   = tstencil.ntypes;
+            const int ibin = grid.id[c] / nt;
+            const int ti   = grid.id[c] % nt;
+            const int* ent = &tstencil.entry[tstencil.start[ti]];
+            const int nent = tstencil.start[ti + 1] - tstencil.start[ti];
+
+            for (int e = 0; e < nent; e++) {
+                int jbin         = ibin + stencil[ent[e] / nt];
+                stencil_cells[e] = findCell(&grid, jbin * nt + ent[e] % nt);
+            }
+
+            for (int ic = grid.start[c]; ic < grid.start[c + 1]; ic++) {
+                int i = grid.items[ic];
+                if (i >= atom->Nlocal) {
+                    continue;
+                }
 
-                for (int m = 0; m < bincount[jbin]; m++) {
-                    int j = loc_bin[m];
-                    if ((j == i) || (neighbor->half_neigh && (j < i))) {
+                int* neighptr = &(neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)]);
+                int n         = 0;
+                MD_FLOAT xtmp = atom_x(i);
+                MD_FLOAT ytmp = atom_y(i);
+                MD_FLOAT ztmp = atom_z(i);
+
+                for (int e = 0; e < nent; e++) {
+                    const int tp          = ti * nt + ent[e] % nt;
+                    const MD_FLOAT cutoff = tstencil.cutneighsq[tp];
+                    const int n0          = n;
+                    int jcell             = stencil_cells[e];
+                    if (jcell < 0) {
                         continue;
                     }
 
-                    MD_FLOAT delx = xtmp - atom_x(j);
-                    MD_FLOAT dely = ytmp - atom_y(j);
-                    MD_FLOAT delz = ztmp - atom_z(j);
-                    MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
-
-#ifndef ONE_ATOM_TYPE
-                    int type_j = atom->type[j];
-                    const MD_FLOAT cutoff =
-                        atom->cutneighsq[type_i * atom->ntypes + type_j];
-#else
-                    const MD_FLOAT cutoff = cutneighsq;
-#endif
-                    if (rsq <= cutoff) {
-                        neighptr[n++] = j;
+                    for (int m = grid.start[jcell]; m < grid.start[jcell + 1]; m++) {
+                        int j = grid.items[m];
+                        if ((j == i) || (neighbor->half_neigh && (j < i))) {
+                            continue;
+                        }
+
+                        MD_FLOAT delx = xtmp - atom_x(j);
+                        MD_FLOAT dely = ytmp - atom_y(j);
+                        MD_FLOAT delz = ztmp - atom_z(j);
+                        MD_FLOAT rsq  = delx * delx + dely * dely + delz * delz;
+                        if (rsq <= cutoff) {
+                            neighptr[n++] = j;
+                        }
                     }
+
+                    tstencil.build_tested[tp] += grid.start[jcell + 1] - grid.start[jcell];
+                    tstencil.build_kept[tp] += n - n0;
                 }
-            }
 
-            neighbor->numneigh[i] = n;
-            if (n >= neighbor->maxneighs) {
-                resize = 1;
+                neighbor->numneigh[i] = n;
+                if (n >= neighbor->maxneighs) {
+                    resize = 1;
 
-                if (n >= new_maxneighs) {
-                    new_maxneighs = n;
+                    if (n >= new_maxneighs) {
+                        new_maxneighs = n;
+                    }
                 }
             }
         }
 
-        if (resize) {
+        if (!resize) {
+            stopTypeStencilCount(&tstencil);
+            if (sort_pending) {
+                sort_lines_after += getNeighborLines(atom, neighbor);
+                sort_measured++;
+                sort_pending = 0;
+            }
+        } else {
             printf("RESIZE %d\n", neighbor->maxneighs);
             neighbor->maxneighs = new_maxneighs * 1.2;
-            free(neighbor->neighbors);
-            neighbor->neighbors = (int*)malloc(
-                atom->Nmax * neighbor->maxneighs * sizeof(int));
+            deallocate(neighbor->neighbors);
+            neighbor->neighbors = (int*)allocate(ALIGNMENT,
+                (MD_INDEX)atom->Nmax * neighbor->maxneighs * sizeof(int));
         }
     }
+
+    balanceNeighbor(atom, neighbor);
+}
+
+int getOccupiedBins(void) { return grid.ncells; }
+
+int getTotalBins(void) { return mbins * MAX(tstencil.ntypes, 1); }
+
+double getBinningMemory(void) { return 1e-6 * (double)getCellGridMemory(&grid); }
+
+const TypeStencil* getTypeStencil(void) { return &tstencil; }
+
+const CellGrid* getAtomGrid(void) { return &grid; }
+
+/* occupied bins of the type stencil around occupied bin c of the last binatoms, -1
+ * for empty ones, for the direct force without stored lists; returns the number of
+ * stencil entries, which is at most the total number of type stencil entries */
+int getStencilCells(int c, int* cells)
+{
+    const int nt   = tstencil.ntypes;
+    const int ibin = grid.id[c] / nt;
+    const int ti   = grid.id[c] % nt;
+    const int* ent = &tstencil.entry[tstencil.start[ti]];
+    const int nent = tstencil.start[ti + 1] - tstencil.start[ti];
+
+    for (int e = 0; e < nent; e++) {
+        int jbin = ibin + stencil[ent[e] / nt];
+        cells[e] = findCell(&grid, jbin * nt + ent[e] % nt);
+    }
+
+    return nent;
 }
 
 /* internal subroutines */
@@ -328,99 +453,229 @@ int coord2bin(MD_FLOAT xin, MD_FLOAT yin, MD_FLOAT zin)
 
 void binatoms(Atom* atom)
 {
-    int nall   = atom->Nlocal + atom->Nghost;
-    int resize = 1;
+    int nall = atom->Nlocal + atom->Nghost;
+
+    if (!tstencil_valid) {
+        setupStencilTypes(atom);
+    }
 
-    while (resize > 0) {
-        resize = 0;
+    reserveCellGrid(&grid, nall);
+    for (int i = 0; i < nall; i++) {
+        grid.keys[i] = coord2bin(atom_x(i), atom_y(i), atom_z(i)) * tstencil.ntypes;
+#ifndef ONE_ATOM_TYPE
+        grid.keys[i] += (tstencil.ntypes > 1) ? atom->type[i] : 0;
+#endif
+        grid.values[i] = i;
+    }
+
+    buildCellGrid(&grid, nall);
+}
 
-        for (int i = 0; i < mbins; i++) {
-            bincount[i] = 0;
+/* x cache lines touched per atom when walking the neighbor lists, a line is
+ * counted again whenever the list leaves it, so this approximates the misses of
+ * the force loop on the positions when no line survives in the cache */
+static double getNeighborLines(Atom* atom, Neighbor* neighbor)
+{
+#ifdef AOS
+    const MD_INDEX stride = 3 * sizeof(MD_FLOAT);
+#else
+    const MD_INDEX stride = sizeof(MD_FLOAT);
+#endif
+    long long lines = 0;
+
+    for (int i = 0; i < atom->Nlocal; i++) {
+        int* neighs   = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
+        MD_INDEX last = -1;
+
+        for (int k = 0; k < neighbor->numneigh[i]; k++) {
+            MD_INDEX line = neighs[k] * stride / sort_line;
+            if (line != last) {
+                last = line;
+                lines++;
+            }
         }
+    }
 
-        for (int i = 0; i < nall; i++) {
-            int ibin = coord2bin(atom_x(i), atom_y(i), atom_z(i));
+    return (atom->Nlocal > 0) ? (double)lines / atom->Nlocal : 0.0;
+}
 
-            if (bincount[ibin] < atoms_per_bin) {
-                int ac                          = bincount[ibin]++;
-                bins[ibin * atoms_per_bin + ac] = i;
+// Skilling's transform of the coordinates into the transposed Hilbert index,
+// interleaving its bits gives the position along the curve
+static int hilbertKey(unsigned int x, unsigned int y, unsigned int z, int bits)
+{
+    unsigned int c[3] = { x, y, z };
+    unsigned int t    = 0;
+
+    for (unsigned int q = 1u << (bits - 1); q > 1; q >>= 1) {
+        unsigned int p = q - 1;
+        for (int i = 0; i < 3; i++) {
+            if (c[i] & q) {
+                c[0] ^= p;
             } else {
-                resize = 1;
+                unsigned int s = (c[0] ^ c[i]) & p;
+                c[0] ^= s;
+                c[i] ^= s;
             }
         }
+    }
 
-        if (resize) {
-            free(bins);
-            atoms_per_bin *= 2;
-            bins = (int*)malloc(mbins * atoms_per_bin * sizeof(int));
+    c[1] ^= c[0];
+    c[2] ^= c[1];
+    for (unsigned int q = 1u << (bits - 1); q > 1; q >>= 1) {
+        if (c[2] & q) {
+            t ^= q - 1;
         }
     }
+
+    return interleaveBits(c[0] ^ t, c[1] ^ t, c[2] ^ t, bits);
 }
 
-void sortAtom(Atom* atom)
+/* order the local atoms along the bins or a space-filling curve through the
+ * bins, the curves use the bins as cells and are coarsened to fit the keys into
+ * 30 bits */
+static void sortCurve(Atom* atom, int order)
 {
-    binatoms(atom);
-    int Nmax    = atom->Nmax;
-    int* binpos = bincount;
+    int bits = 1, coarse = 0;
+
+    while ((1 << bits) < MAX(mbinx, MAX(mbiny, mbinz))) {
+        bits++;
+    }
+
+    if (bits > 10) {
+        coarse = bits - 10;
+        bits   = 10;
+    }
+
+    reserveCellGrid(&grid, atom->Nlocal);
+    for (int i = 0; i < atom->Nlocal; i++) {
+        int bin         = coord2bin(atom_x(i), atom_y(i), atom_z(i)) - 1;
+        unsigned int ix = (bin % mbinx) >> coarse;
+        unsigned int iy = (bin / mbinx % mbiny) >> coarse;
+        unsigned int iz = (bin / (mbinx * mbiny)) >> coarse;
 
-    for (int i = 1; i < mbins; i++) {
-        binpos[i] += binpos[i - 1];
+        grid.keys[i]   = (order == SORT_HILBERT) ? hilbertKey(ix, iy, iz, bits)
+                                                 : interleaveBits(ix, iy, iz, bits);
+        grid.values[i] = i;
     }
 
+    buildCellGrid(&grid, atom->Nlocal);
+}
+
+static void swapBuffer(MD_FLOAT** a, MD_FLOAT** b)
+{
+    MD_FLOAT* t = *a;
+    *a          = *b;
+    *b          = t;
+}
+
+/* the atoms are copied into persistent buffers that are swapped with the atom
+ * arrays afterwards, the buffers grow with Nmax; forces are not permuted since
+ * they are computed again before their next use */
+void sortAtom(Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    if (neighbor->numneigh != NULL) {
+        sort_lines_before += getNeighborLines(atom, neighbor);
+        sort_pending = 1;
+    }
+
+    if (param->sort_atoms == SORT_BINS) {
+        binatoms(atom);
+    } else {
+        sortCurve(atom, param->sort_atoms);
+    }
+
+    if (sort_nmax < atom->Nmax) {
+        sort_nmax = atom->Nmax;
 #ifdef AOS
-    MD_FLOAT* new_x  = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT) * 3);
-    MD_FLOAT* new_vx = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT) * 3);
+        deallocate(sort_x);
+        deallocate(sort_vx);
+        sort_x  = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT) * 3);
+        sort_vx = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT) * 3);
 #else
-    MD_FLOAT* new_x  = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
-    MD_FLOAT* new_y  = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
-    MD_FLOAT* new_z  = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
-    MD_FLOAT* new_vx = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
-    MD_FLOAT* new_vy = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
-    MD_FLOAT* new_vz = (MD_FLOAT*)malloc(Nmax * sizeof(MD_FLOAT));
+        deallocate(sort_x);
+        deallocate(sort_y);
+        deallocate(sort_z);
+        deallocate(sort_vx);
+        deallocate(sort_vy);
+        deallocate(sort_vz);
+        sort_x  = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
+        sort_y  = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
+        sort_z  = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
+        sort_vx = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
+        sort_vy = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
+        sort_vz = (MD_FLOAT*)allocate(ALIGNMENT, sort_nmax * sizeof(MD_FLOAT));
 #endif
-    MD_FLOAT* old_x  = atom->x;
-    MD_FLOAT* old_y  = atom->y;
-    MD_FLOAT* old_z  = atom->z;
-    MD_FLOAT* old_vx = atom->vx;
-    MD_FLOAT* old_vy = atom->vy;
-    MD_FLOAT* old_vz = atom->vz;
-
-    for (int mybin = 0; mybin < mbins; mybin++) {
-        int start = mybin > 0 ? binpos[mybin - 1] : 0;
-        int count = binpos[mybin] - start;
-        for (int k = 0; k < count; k++) {
-            int new_i = start + k;
-            int old_i = bins[mybin * atoms_per_bin + k];
+        deallocate(sort_type);
+        sort_type = (int*)allocate(ALIGNMENT, sort_nmax * sizeof(int));
+    }
+
+    // The bins list the atoms in sorted order, so an atom moves to its position
+    // there
+    for (int new_i = 0; new_i < grid.nitems; new_i++) {
+        int old_i = grid.items[new_i];
 #ifdef AOS
-            new_x[new_i * 3 + 0]  = old_x[old_i * 3 + 0];
-            new_x[new_i * 3 + 1]  = old_x[old_i * 3 + 1];
-            new_x[new_i * 3 + 2]  = old_x[old_i * 3 + 2];
-            new_vx[new_i * 3 + 0] = old_vx[old_i * 3 + 0];
-            new_vx[new_i * 3 + 1] = old_vx[old_i * 3 + 1];
-            new_vx[new_i * 3 + 2] = old_vx[old_i * 3 + 2];
+        sort_x[new_i * 3 + 0]  = atom->x[old_i * 3 + 0];
+        sort_x[new_i * 3 + 1]  = atom->x[old_i * 3 + 1];
+        sort_x[new_i * 3 + 2]  = atom->x[old_i * 3 + 2];
+        sort_vx[new_i * 3 + 0] = atom->vx[old_i * 3 + 0];
+        sort_vx[new_i * 3 + 1] = atom->vx[old_i * 3 + 1];
+        sort_vx[new_i * 3 + 2] = atom->vx[old_i * 3 + 2];
 #else
-            new_x[new_i]  = old_x[old_i];
-            new_y[new_i]  = old_y[old_i];
-            new_z[new_i]  = old_z[old_i];
-            new_vx[new_i] = old_vx[old_i];
-            new_vy[new_i] = old_vy[old_i];
-            new_vz[new_i] = old_vz[old_i];
+        sort_x[new_i]  = atom->x[old_i];
+        sort_y[new_i]  = atom->y[old_i];
+        sort_z[new_i]  = atom->z[old_i];
+        sort_vx[new_i] = atom->vx[old_i];
+        sort_vy[new_i] = atom->vy[old_i];
+        sort_vz[new_i] = atom->vz[old_i];
 #endif
-        }
+        sort_type[new_i] = atom->type[old_i];
     }
 
-    free(atom->x);
-    free(atom->vx);
-    atom->x  = new_x;
-    atom->vx = new_vx;
+    swapBuffer(&atom->x, &sort_x);
+    swapBuffer(&atom->vx, &sort_vx);
 #ifndef AOS
-    free(atom->y);
-    free(atom->z);
-    free(atom->vy);
-    free(atom->vz);
-    atom->y  = new_y;
-    atom->z  = new_z;
-    atom->vy = new_vy;
-    atom->vz = new_vz;
+    swapBuffer(&atom->y, &sort_y);
+    swapBuffer(&atom->z, &sort_z);
+    swapBuffer(&atom->vy, &sort_vy);
+    swapBuffer(&atom->vz, &sort_vz);
 #endif
+    int* type  = atom->type;
+    atom->type = sort_type;
+    sort_type  = type;
+    sort_count++;
+}
+
+void printSortLocality(void)
+{
+    if (sort_count == 0) {
+        return;
+    }
+
+    printf("Atom sorting: %d sorts", sort_count);
+    if (sort_measured > 0) {
+        double before = sort_lines_before / sort_measured;
+        double after  = sort_lines_after / sort_measured;
+        printf(", x cache lines per atom in the neighbor lists %.2f before and %.2f "
+               "after (%.1f%% fewer)",
+            before,
+            after,
+            (before > 0.0) ? 100.0 * (before - after) / before : 0.0);
+    }
+
+    printf("\n");
+}
+
+void reportSortLocality(void)
+{
+    int n = MAX(sort_measured, 1);
+
+    if (sort_count == 0) {
+        return;
+    }
+
+    reportSection("sort");
+    reportInt("sorts", sort_count);
+    reportInt("measured", sort_measured);
+    reportReal("lines_before", sort_lines_before / n);
+    reportReal("lines_after", sort_lines_after / n);
 }
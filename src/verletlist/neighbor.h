@@ -5,7 +5,10 @@
  * license that can be found in the LICENSE file.
  */
 #include <atom.h>
+#include <balance.h>
+#include <cellgrid.h>
 #include <parameter.h>
+#include <typestencil.h>
 
 #ifndef __NEIGHBOR_H_
 #define __NEIGHBOR_H_
@@ -22,11 +25,16 @@ typedef struct {
     int half_neigh;
     int* neighbors;
     int* numneigh;
+    Balance balance; // i-atom ranges of the threads, see balanceNeighbor
 
     // Device data
     DeviceNeighbor d_neighbor;
 } Neighbor;
 
+// Start of the neighbor list of cluster/atom i, neighbor IDs are 32-bit but
+// offsets use MD_INDEX so the total number of slots can exceed 2^31
+#define NEIGHBOR_OFFSET(nb, i) ((MD_INDEX)(i) * (nb)->maxneighs)
+
 typedef struct {
     MD_FLOAT xprd;
     MD_FLOAT yprd;
@@ -58,8 +66,16 @@ extern BuildNeighborFunction buildNeighbor;
 extern void initNeighbor(Neighbor*, Parameter*);
 extern void setupNeighbor(Parameter*);
 extern void binatoms(Atom*);
-extern void sortAtom(Atom*);
+extern void sortAtom(Parameter*, Atom*, Neighbor*);
+extern void printSortLocality(void);
+extern void reportSortLocality(void);
 extern void buildNeighborCPU(Atom*, Neighbor*);
+extern int getOccupiedBins(void);
+extern int getTotalBins(void);
+extern double getBinningMemory(void);
+extern const TypeStencil* getTypeStencil(void);
+extern const CellGrid* getAtomGrid(void);
+extern int getStencilCells(int c, int* cells);
 #ifdef CUDA_TARGET
 extern void buildNeighborCUDA(Atom*, Neighbor*);
 #endif
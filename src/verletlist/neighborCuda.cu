@@ -290,7 +290,7 @@ void buildNeighborCUDA(Atom* atom, Neighbor* neighbor)
     if (nall > nmax) {
         nmax                  = nall;
         d_neighbor->neighbors = (int*)reallocateGPU(d_neighbor->neighbors,
-            nmax * neighbor->maxneighs * sizeof(int));
+            (MD_INDEX)nmax * neighbor->maxneighs * sizeof(int));
         d_neighbor->numneigh  = (int*)reallocateGPU(d_neighbor->numneigh,
             nmax * sizeof(int));
     }
@@ -329,7 +329,7 @@ void buildNeighborCUDA(Atom* atom, Neighbor* neighbor)
             neighbor->maxneighs = new_maxneighs * 1.2;
             printf("NEW SIZE %d\n", neighbor->maxneighs);
             neighbor->neighbors = (int*)reallocateGPU(neighbor->neighbors,
-                atom->Nmax * neighbor->maxneighs * sizeof(int));
+                (MD_INDEX)atom->Nmax * neighbor->maxneighs * sizeof(int));
         }
     }
 
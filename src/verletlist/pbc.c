@@ -4,18 +4,23 @@
  * Use of this source code is governed by a LGPL-3.0
  * license that can be found in the LICENSE file.
  */
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <allocate.h>
 #include <atom.h>
+#include <border.h>
 #include <pbc.h>
 
 #define DELTA 20000
 
 int NmaxGhost;
 int *PBCx, *PBCy, *PBCz;
+static int NmaxBorder;
+static int* border;       // sides of the box every atom is close to
+static int* ghost_offset; // index of the first ghost of every atom
 
 #ifdef CUDA_TARGET
 UpdatePbcFunction updatePbc      = updatePbcCUDA;
@@ -26,11 +31,15 @@ UpdatePbcFunction updateAtomsPbc = updateAtomsPbcCPU;
 #endif
 
 static void growPbc(Atom*);
+static void growBorders(int);
 
 /* exported subroutines */
 void initPbc(Atom* atom)
 {
     NmaxGhost        = 0;
+    NmaxBorder       = 0;
+    border           = NULL;
+    ghost_offset     = NULL;
     atom->border_map = NULL;
     PBCx             = NULL;
     PBCy             = NULL;
@@ -86,151 +95,70 @@ void updateAtomsPbcCPU(Atom* atom, Parameter* param, bool doReneighbor)
 /* setup periodic boundary conditions by
  * defining ghost atoms around domain
  * only creates mapping and coordinate corrections
- * that are then enforced in updatePbc */
-#define ADDGHOST(dx, dy, dz)                                                             \
-    Nghost++;                                                                            \
-    border_map[Nghost]                = i;                                               \
-    PBCx[Nghost]                      = dx;                                              \
-    PBCy[Nghost]                      = dy;                                              \
-    PBCz[Nghost]                      = dz;                                              \
-    atom->type[atom->Nlocal + Nghost] = atom->type[i]
-
+ * that are then enforced in updatePbc;
+ * the first pass finds the box sides every atom is close to, after a prefix sum
+ * over its image counts the second pass writes the ghosts of each atom at its
+ * offset, so the ghost order does not depend on the number of threads */
 void setupPbc(Atom* atom, Parameter* param)
 {
-    int* border_map   = atom->border_map;
-    MD_FLOAT xprd     = param->xprd;
-    MD_FLOAT yprd     = param->yprd;
-    MD_FLOAT zprd     = param->zprd;
-    MD_FLOAT cutneigh = param->cutneigh;
-    int Nghost        = -1;
-
+    MD_FLOAT cutneigh          = param->cutneigh;
+    const BorderImages* images = getBorderImages();
+    int Nghost                 = 0;
+    MD_FLOAT lo[3], hi[3];
+
+    // Non-periodic dimensions get empty border ranges
+    lo[0] = param->pbc_x ? cutneigh : -INFINITY;
+    lo[1] = param->pbc_y ? cutneigh : -INFINITY;
+    lo[2] = param->pbc_z ? cutneigh : -INFINITY;
+    hi[0] = param->pbc_x ? param->xprd - cutneigh : INFINITY;
+    hi[1] = param->pbc_y ? param->yprd - cutneigh : INFINITY;
+    hi[2] = param->pbc_z ? param->zprd - cutneigh : INFINITY;
+
+    growBorders(atom->Nlocal);
+
+#pragma omp parallel for schedule(static)
     for (int i = 0; i < atom->Nlocal; i++) {
-        if (atom->Nlocal + Nghost + 7 >= atom->Nmax) {
-            growAtom(atom);
-        }
-
-        if (Nghost + 7 >= NmaxGhost) {
-            growPbc(atom);
-            border_map = atom->border_map;
-        }
-
         MD_FLOAT x = atom_x(i);
         MD_FLOAT y = atom_y(i);
         MD_FLOAT z = atom_z(i);
+        border[i]  = getBorderMask(lo, hi, x, x, y, y, z, z);
+    }
 
-        /* Setup ghost atoms */
-        /* 6 planes */
-        if (param->pbc_x != 0) {
-            if (x < cutneigh) {
-                ADDGHOST(+1, 0, 0);
-            }
-            if (x >= (xprd - cutneigh)) {
-                ADDGHOST(-1, 0, 0);
-            }
-        }
-
-        if (param->pbc_y != 0) {
-            if (y < cutneigh) {
-                ADDGHOST(0, +1, 0);
-            }
-            if (y >= (yprd - cutneigh)) {
-                ADDGHOST(0, -1, 0);
-            }
-        }
-
-        if (param->pbc_z != 0) {
-            if (z < cutneigh) {
-                ADDGHOST(0, 0, +1);
-            }
-            if (z >= (zprd - cutneigh)) {
-                ADDGHOST(0, 0, -1);
-            }
-        }
-
-        /* 8 corners */
-        if (param->pbc_x != 0 && param->pbc_y != 0 && param->pbc_z != 0) {
-            if (x < cutneigh && y < cutneigh && z < cutneigh) {
-                ADDGHOST(+1, +1, +1);
-            }
-            if (x < cutneigh && y >= (yprd - cutneigh) && z < cutneigh) {
-                ADDGHOST(+1, -1, +1);
-            }
-            if (x < cutneigh && y < cutneigh && z >= (zprd - cutneigh)) {
-                ADDGHOST(+1, +1, -1);
-            }
-            if (x < cutneigh && y >= (yprd - cutneigh) && z >= (zprd - cutneigh)) {
-                ADDGHOST(+1, -1, -1);
-            }
-            if (x >= (xprd - cutneigh) && y < cutneigh && z < cutneigh) {
-                ADDGHOST(-1, +1, +1);
-            }
-            if (x >= (xprd - cutneigh) && y >= (yprd - cutneigh) && z < cutneigh) {
-                ADDGHOST(-1, -1, +1);
-            }
-            if (x >= (xprd - cutneigh) && y < cutneigh && z >= (zprd - cutneigh)) {
-                ADDGHOST(-1, +1, -1);
-            }
-            if (x >= (xprd - cutneigh) && y >= (yprd - cutneigh) &&
-                z >= (zprd - cutneigh)) {
-                ADDGHOST(-1, -1, -1);
-            }
-        }
+    for (int i = 0; i < atom->Nlocal; i++) {
+        ghost_offset[i] = Nghost;
+        Nghost += images[border[i]].nimages;
+    }
 
-        /* 12 edges */
-        if (param->pbc_x != 0 && param->pbc_z != 0) {
-            if (x < cutneigh && z < cutneigh) {
-                ADDGHOST(+1, 0, +1);
-            }
-            if (x < cutneigh && z >= (zprd - cutneigh)) {
-                ADDGHOST(+1, 0, -1);
-            }
-            if (x >= (xprd - cutneigh) && z < cutneigh) {
-                ADDGHOST(-1, 0, +1);
-            }
-            if (x >= (xprd - cutneigh) && z >= (zprd - cutneigh)) {
-                ADDGHOST(-1, 0, -1);
-            }
-        }
+    while (atom->Nlocal + Nghost >= atom->Nmax) {
+        growAtom(atom);
+    }
 
-        if (param->pbc_y != 0 && param->pbc_z != 0) {
-            if (y < cutneigh && z < cutneigh) {
-                ADDGHOST(0, +1, +1);
-            }
-            if (y < cutneigh && z >= (zprd - cutneigh)) {
-                ADDGHOST(0, +1, -1);
-            }
-            if (y >= (yprd - cutneigh) && z < cutneigh) {
-                ADDGHOST(0, -1, +1);
-            }
-            if (y >= (yprd - cutneigh) && z >= (zprd - cutneigh)) {
-                ADDGHOST(0, -1, -1);
-            }
-        }
+    while (Nghost >= NmaxGhost) {
+        growPbc(atom);
+    }
 
-        if (param->pbc_x != 0 && param->pbc_y != 0) {
-            if (y < cutneigh && x < cutneigh) {
-                ADDGHOST(+1, +1, 0);
-            }
-            if (y < cutneigh && x >= (xprd - cutneigh)) {
-                ADDGHOST(-1, +1, 0);
-            }
-            if (y >= (yprd - cutneigh) && x < cutneigh) {
-                ADDGHOST(+1, -1, 0);
-            }
-            if (y >= (yprd - cutneigh) && x >= (xprd - cutneigh)) {
-                ADDGHOST(-1, -1, 0);
-            }
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < atom->Nlocal; i++) {
+        const BorderImages* b = &images[border[i]];
+
+        for (int g = 0; g < b->nimages; g++) {
+            const int ghost                  = ghost_offset[i] + g;
+            atom->border_map[ghost]          = i;
+            PBCx[ghost]                      = b->image[g][0];
+            PBCy[ghost]                      = b->image[g][1];
+            PBCz[ghost]                      = b->image[g][2];
+            atom->type[atom->Nlocal + ghost] = atom->type[i];
         }
     }
-    // increase by one to make it the ghost atom count
-    atom->Nghost = Nghost + 1;
+
+    atom->Nghost = Nghost;
 }
 
 /* internal subroutines */
 void growPbc(Atom* atom)
 {
     int nold = NmaxGhost;
-    NmaxGhost += DELTA;
+    NmaxGhost = GROW_CAPACITY(NmaxGhost, DELTA);
 
     atom->border_map = (int*)reallocate(atom->border_map,
         ALIGNMENT,
@@ -240,3 +168,15 @@ void growPbc(Atom* atom)
     PBCy = (int*)reallocate(PBCy, ALIGNMENT, NmaxGhost * sizeof(int), nold * sizeof(int));
     PBCz = (int*)reallocate(PBCz, ALIGNMENT, NmaxGhost * sizeof(int), nold * sizeof(int));
 }
+
+// Scratch arrays of setupPbc, their contents are not kept between calls
+void growBorders(int n)
+{
+    if (n > NmaxBorder) {
+        deallocate(border);
+        deallocate(ghost_offset);
+        NmaxBorder   = GROW_CAPACITY(n, DELTA);
+        border       = (int*)allocate(ALIGNMENT, NmaxBorder * sizeof(int));
+        ghost_offset = (int*)allocate(ALIGNMENT, NmaxBorder * sizeof(int));
+    }
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <allocate.h>
+#include <atom.h>
+#include <force.h>
+#include <neighbor.h>
+#include <parameter.h>
+#include <snapshot.h>
+#include <util.h>
+
+typedef struct {
+    char magic[8];
+    int32_t version;
+    int32_t float_size;
+    int32_t step;
+    int32_t force_field;
+    int32_t half_neigh;
+    int32_t ntypes;
+    int32_t nlocal;
+    int32_t nghost;
+    int32_t maxneighs;
+    int64_t nneighs;
+    double cutforce;
+    double epsilon;
+    double sigma6;
+} SnapshotHeader;
+
+static void writeData(FILE* fp, const void* ptr, size_t size, size_t n)
+{
+    if (n > 0 && fwrite(ptr, size, n, fp) != n) {
+        fprintf(stderr, "Error: Could not write snapshot data!\n");
+        exit(-1);
+    }
+}
+
+static void readData(FILE* fp, void* ptr, size_t size, size_t n)
+{
+    if (n > 0 && fread(ptr, size, n, fp) != n) {
+        fprintf(stderr, "Error: Snapshot file is truncated!\n");
+        exit(-1);
+    }
+}
+
+void writeSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor, int step)
+{
+    SnapshotHeader header;
+    FILE* fp;
+
+    if (param->force_field != FF_LJ) {
+        fprintf(stderr, "Warning: Snapshots are only supported for LJ, skipping!\n");
+        return;
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open snapshot file %s for writing!\n", filename);
+        return;
+    }
+
+    memset(&header, 0, sizeof(SnapshotHeader));
+    for (int i = 0; i < atom->Nlocal; i++) {
+        header.nneighs += neighbor->numneigh[i];
+    }
+
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version     = SNAPSHOT_VERSION;
+    header.float_size  = sizeof(MD_FLOAT);
+    header.step        = step;
+    header.force_field = param->force_field;
+    header.half_neigh  = param->half_neigh;
+    header.ntypes      = atom->ntypes;
+    header.nlocal      = atom->Nlocal;
+    header.nghost      = atom->Nghost;
+    header.maxneighs   = neighbor->maxneighs;
+    header.cutforce    = param->cutforce;
+    header.epsilon     = param->epsilon;
+    header.sigma6      = param->sigma6;
+
+    const int ntypes2 = atom->ntypes * atom->ntypes;
+    const int nall    = atom->Nlocal + atom->Nghost;
+    writeData(fp, &header, sizeof(SnapshotHeader), 1);
+    writeData(fp, atom->epsilon, sizeof(MD_FLOAT), ntypes2);
+    writeData(fp, atom->sigma6, sizeof(MD_FLOAT), ntypes2);
+    writeData(fp, atom->cutforcesq, sizeof(MD_FLOAT), ntypes2);
+
+    // Positions are stored as x, y, z triples independent of the data layout
+    for (int i = 0; i < nall; i++) {
+        MD_FLOAT pos[3] = { atom_x(i), atom_y(i), atom_z(i) };
+        writeData(fp, pos, sizeof(MD_FLOAT), 3);
+    }
+
+    writeData(fp, atom->type, sizeof(int), nall);
+    writeData(fp, neighbor->numneigh, sizeof(int), atom->Nlocal);
+    for (int i = 0; i < atom->Nlocal; i++) {
+        writeData(fp,
+            &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)],
+            sizeof(int),
+            neighbor->numneigh[i]);
+    }
+
+    fclose(fp);
+    printf("Snapshot of step %d written to %s (%d atoms, %lld neighbor pairs)\n",
+        step,
+        filename,
+        atom->Nlocal,
+        (long long)header.nneighs);
+}
+
+int readSnapshot(const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor)
+{
+    SnapshotHeader header;
+    FILE* fp = fopen(filename, "rb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open snapshot file %s!\n", filename);
+        exit(-1);
+    }
+
+    readData(fp, &header, sizeof(SnapshotHeader), 1);
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, 8) != 0 ||
+        header.version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Error: %s is not a verlet list snapshot!\n", filename);
+        exit(-1);
+    }
+
+    if (header.float_size != sizeof(MD_FLOAT)) {
+        fprintf(stderr,
+            "Error: Snapshot was written with %s precision, this binary uses %s "
+            "precision!\n",
+            (header.float_size == 4) ? "single" : "double",
+            PRECISION_STRING);
+        exit(-1);
+    }
+
+    param->force_field = header.force_field;
+    param->half_neigh  = header.half_neigh;
+    param->ntypes      = header.ntypes;
+    param->cutforce    = header.cutforce;
+    param->epsilon     = header.epsilon;
+    param->sigma6      = header.sigma6;
+
+    const int ntypes2 = header.ntypes * header.ntypes;
+    const int nall    = header.nlocal + header.nghost;
+    atom->ntypes      = header.ntypes;
+    atom->epsilon     = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->sigma6      = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->cutforcesq  = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    atom->cutneighsq  = allocate(ALIGNMENT, ntypes2 * sizeof(MD_FLOAT));
+    readData(fp, atom->epsilon, sizeof(MD_FLOAT), ntypes2);
+    readData(fp, atom->sigma6, sizeof(MD_FLOAT), ntypes2);
+    readData(fp, atom->cutforcesq, sizeof(MD_FLOAT), ntypes2);
+    memcpy(atom->cutneighsq, atom->cutforcesq, ntypes2 * sizeof(MD_FLOAT));
+
+    reserveAtom(atom, nall);
+    atom->Nlocal = header.nlocal;
+    atom->Nghost = header.nghost;
+    for (int i = 0; i < nall; i++) {
+        MD_FLOAT pos[3];
+        readData(fp, pos, sizeof(MD_FLOAT), 3);
+        atom_x(i)  = pos[0];
+        atom_y(i)  = pos[1];
+        atom_z(i)  = pos[2];
+        atom_vx(i) = 0.0;
+        atom_vy(i) = 0.0;
+        atom_vz(i) = 0.0;
+    }
+
+    readData(fp, atom->type, sizeof(int), nall);
+
+    neighbor->half_neigh = header.half_neigh;
+    neighbor->maxneighs  = header.maxneighs;
+    neighbor->numneigh   = (int*)allocate(ALIGNMENT, atom->Nmax * sizeof(int));
+    neighbor->neighbors  = (int*)allocate(ALIGNMENT,
+        (MD_INDEX)atom->Nmax * header.maxneighs * sizeof(int));
+    readData(fp, neighbor->numneigh, sizeof(int), header.nlocal);
+    for (int i = 0; i < atom->Nlocal; i++) {
+        readData(fp,
+            &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)],
+            sizeof(int),
+            neighbor->numneigh[i]);
+    }
+
+    fclose(fp);
+    return header.step;
+}
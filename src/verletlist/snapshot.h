@@ -0,0 +1,23 @@
+/*
+ * Copyright (C)  NHR@FAU, University Erlangen-Nuremberg.
+ * All rights reserved. This file is part of MD-Bench.
+ * Use of this source code is governed by a LGPL-3.0
+ * license that can be found in the LICENSE file.
+ */
+#include <atom.h>
+#include <neighbor.h>
+#include <parameter.h>
+
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+// A snapshot holds everything computeForce reads: positions and types of local
+// and ghost atoms, the force field tables and the neighbor lists. It is written
+// by the main binary and replayed by the stub with the same precision.
+#define SNAPSHOT_MAGIC   "MDBSNPVL"
+#define SNAPSHOT_VERSION 1
+
+extern void writeSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor, int step);
+extern int readSnapshot(
+    const char* filename, Parameter* param, Atom* atom, Neighbor* neighbor);
+#endif
@@ -7,7 +7,10 @@
 #include <stdio.h>
 
 #include <atom.h>
+#include <frequency.h>
 #include <parameter.h>
+#include <perfctr.h>
+#include <report.h>
 #include <stats.h>
 #include <timers.h>
 
@@ -39,10 +42,14 @@ void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer
                            sizeof(int);
 #endif
 
+    const double freq   = getFrequency(param);
+    const double cycles = timer[FORCE] * freq * 1e9;
+
     printf("Statistics:\n");
-    printf("\tVector width: %d, Processor frequency: %.4f GHz\n",
+    printf("\tVector width: %d, Processor frequency: %.4f GHz (%s)\n",
         VECTOR_WIDTH,
-        param->proc_freq);
+        freq,
+        getFrequencySource());
     printf("\tAverage neighbors per atom: %.4f\n", avg_neigh);
     printf("\tAverage SIMD iterations per atom: %.4f\n", avg_simd);
     printf("\tTotal number of computed pair interactions: %lld\n",
@@ -50,8 +57,23 @@ void displayStatistics(Atom* atom, Parameter* param, Stats* stats, double* timer
     printf("\tTotal number of SIMD iterations: %lld\n", stats->total_force_iters);
     printf("\tUseful read data volume for force computation: %.2fGB\n",
         force_useful_volume);
-    printf("\tCycles/SIMD iteration: %.4f\n",
-        timer[FORCE] * param->proc_freq * 1e9 / stats->total_force_iters);
+    printf("\tCycles/SIMD iteration: %.4f\n", cycles / stats->total_force_iters);
+    printf("\tCycles/pair interaction: %.4f\n", cycles / stats->total_force_neighs);
+#ifdef PERFCTR
+    perfctrPrintMetrics("force", (double)stats->total_force_neighs);
+#endif
+
+    reportSection("stats");
+    reportInt("total_force_neighs", stats->total_force_neighs);
+    reportInt("total_force_iters", stats->total_force_iters);
+    reportInt("pair_interactions", stats->total_force_neighs);
+    reportReal("avg_neighbors_per_atom", avg_neigh);
+    reportReal("avg_simd_iters_per_atom", avg_simd);
+    reportReal("useful_force_volume_gb", force_useful_volume);
+    reportReal("frequency_ghz", freq);
+    reportString("frequency_source", getFrequencySource());
+    reportReal("cycles_per_simd_iter", cycles / stats->total_force_iters);
+    reportReal("cycles_per_pair", cycles / stats->total_force_neighs);
 
 #ifdef USE_REFERENCE_VERSION
     const double eff_pct = (double)stats->atoms_within_cutoff /
@@ -14,12 +14,29 @@ void traceAddresses(Parameter* param, Atom* atom, Neighbor* neighbor, int timest
     MEM_TRACER_INIT;
     INDEX_TRACER_INIT;
     int Nlocal = atom->Nlocal;
+    int Nmax   = atom->Nmax;
     int* neighs;
 
+#ifdef AOS
+    MEM_TRACE_ARRAY("x", atom->x, (size_t)Nmax * 3);
+    MEM_TRACE_ARRAY("f", atom->fx, (size_t)Nmax * 3);
+#else
+    MEM_TRACE_ARRAY("x", atom->x, Nmax);
+    MEM_TRACE_ARRAY("y", atom->y, Nmax);
+    MEM_TRACE_ARRAY("z", atom->z, Nmax);
+    MEM_TRACE_ARRAY("fx", atom->fx, Nmax);
+    MEM_TRACE_ARRAY("fy", atom->fy, Nmax);
+    MEM_TRACE_ARRAY("fz", atom->fz, Nmax);
+#endif
+    MEM_TRACE_ARRAY("type", atom->type, Nmax);
+    MEM_TRACE_ARRAY("numneigh", neighbor->numneigh, Nlocal);
+    MEM_TRACE_ARRAY("neighbors", neighbor->neighbors, (size_t)Nlocal * neighbor->maxneighs);
+
     INDEX_TRACE_NATOMS(Nlocal, atom->Nghost, neighbor->maxneighs);
     for (int i = 0; i < Nlocal; i++) {
-        neighs        = &neighbor->neighbors[i * neighbor->maxneighs];
+        neighs        = &neighbor->neighbors[NEIGHBOR_OFFSET(neighbor, i)];
         int numneighs = neighbor->numneigh[i];
+        MEM_TRACE(neighbor->numneigh[i], 'R');
         MEM_TRACE(atom_x(i), 'R');
         MEM_TRACE(atom_y(i), 'R');
         MEM_TRACE(atom_z(i), 'R');
@@ -34,6 +51,7 @@ void traceAddresses(Parameter* param, Atom* atom, Neighbor* neighbor, int timest
         DIST_TRACE(neighs, numneighs);
 
         for (int k = 0; k < numneighs; k++) {
+            int j = neighs[k];
             MEM_TRACE(neighs[k], 'R');
             MEM_TRACE(atom_x(j), 'R');
             MEM_TRACE(atom_y(j), 'R');
@@ -8,6 +8,10 @@
 #include <neighbor.h>
 #include <parameter.h>
 
+#ifdef MEM_TRACER
+#include <memtracer.h>
+#endif
+
 #if defined(MEM_TRACER) || defined(INDEX_TRACER)
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,29 +22,31 @@
 #endif
 
 #ifndef TRACER_CONDITION
-#define TRACER_CONDITION (!(timestep % param->every))
+#define TRACER_CONDITION (!(timestep % param->trace_every))
 #endif
 
 #ifdef MEM_TRACER
 #define MEM_TRACER_INIT                                                                  \
-    FILE* mem_tracer_fp;                                                                 \
     if (TRACER_CONDITION) {                                                              \
-        char mem_tracer_fn[128];                                                         \
-        snprintf(mem_tracer_fn, sizeof mem_tracer_fn, "mem_tracer_%d.out", timestep);    \
-        mem_tracer_fp = fopen(mem_tracer_fn, "w");
-}
+        memTracerOpen(param, timestep);                                                  \
+    }
 
 #define MEM_TRACER_END                                                                   \
     if (TRACER_CONDITION) {                                                              \
-        fclose(mem_tracer_fp);                                                           \
+        memTracerClose();                                                                \
+    }
+#define MEM_TRACE_ARRAY(name, ptr, n)                                                    \
+    if (TRACER_CONDITION) {                                                              \
+        memTracerArray(name, (ptr), (size_t)(n) * sizeof(*(ptr)));                       \
     }
 #define MEM_TRACE(addr, op)                                                              \
     if (TRACER_CONDITION) {                                                              \
-        fprintf(mem_tracer_fp, "%c: %p\n", op, (void*)(&(addr)));                        \
+        memTracerAccess((void*)(&(addr)), op);                                           \
     }
 #else
 #define MEM_TRACER_INIT
 #define MEM_TRACER_END
+#define MEM_TRACE_ARRAY(name, ptr, n)
 #define MEM_TRACE(addr, op)
 #endif
 